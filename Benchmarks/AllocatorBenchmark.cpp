@@ -0,0 +1,202 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "Benchmark.h"
+#include "FrameArena.h"
+#include "MemoryTracker.h"
+#include "ObjectPool.h"
+#include "ShaderStructures.h"
+
+using namespace DirectX;
+
+// 描画キューの要素とフレームごとの作業領域を、ヒープ (new と malloc) から確保する従来の方法と、
+// ObjectPool と FrameArena から確保する方法で、同じフレームの列を処理して比べます。
+// 時間はフレームごとに計測して、中央値と 99 パーセンタイルと最大値で揺れを表します。
+namespace
+{
+	// DrawQueue の要素と同じ大きさの要素。
+	struct DrawItem
+	{
+		uint64_t sortKey;
+		uint32_t sequence;
+		InstanceData instance;
+	};
+
+	// フレームの負荷は Period フレームごとに繰り返します。1 周すれば、アロケーターはそれ以上ヒープから確保しません。
+	const uint32_t Period = 60;
+	const uint32_t BinCount = 64;
+
+	uint32_t GetItemCount(uint32_t frame, uint32_t baseCount)
+	{
+		return baseCount + (frame % Period * 37 % 61) * baseCount / 120;
+	}
+
+	uint32_t GetBinSize(uint32_t frame, uint32_t bin)
+	{
+		return 16 + (frame % Period * 131 + bin * 17) % 1009;
+	}
+
+	// 従来の方法。要素ごとに new、作業領域ごとに malloc します。
+	class HeapAllocator
+	{
+	public:
+		HeapAllocator() : m_allocationCount(0) {}
+
+		DrawItem* CreateItem() { ++m_allocationCount; return new DrawItem(); }
+		void DestroyItem(DrawItem* item) { delete item; }
+		uint32_t* AllocateBin(uint32_t size) { ++m_allocationCount; return static_cast<uint32_t*>(std::malloc(sizeof(uint32_t) * size)); }
+		void FreeBin(uint32_t* bin) { std::free(bin); }
+		void EndFrame() {}
+		uint64_t GetHeapAllocationCount() const { return m_allocationCount; }
+
+	private:
+		uint64_t m_allocationCount;
+	};
+
+	// ObjectPool と FrameArena から確保します。作業領域は個別に解放せず、フレームの終わりに Reset で捨てます。
+	class PoolAllocator
+	{
+	public:
+		PoolAllocator() : m_items(1024, MemoryCategory::DrawItems), m_arena(0) {}
+
+		DrawItem* CreateItem() { return m_items.Create(); }
+		void DestroyItem(DrawItem* item) { m_items.Destroy(item); }
+		uint32_t* AllocateBin(uint32_t size) { return m_arena.AllocateArray<uint32_t>(size); }
+		void FreeBin(uint32_t*) {}
+		void EndFrame() { m_arena.Reset(); }
+		uint64_t GetHeapAllocationCount() const
+		{
+			return MemoryTracker::GetStatistics(MemoryCategory::DrawItems).heapAllocationCount +
+				MemoryTracker::GetStatistics(MemoryCategory::FrameArena).heapAllocationCount;
+		}
+
+	private:
+		ObjectPool<DrawItem> m_items;
+		FrameArena m_arena;
+	};
+
+	// 1 フレーム分の確保と解放をして、書き込んだ内容の合計を返します。
+	template <typename Allocator>
+	uint64_t RunFrame(Allocator& allocator, uint32_t frame, uint32_t baseCount, std::vector<DrawItem*>& items, std::vector<uint32_t*>& bins)
+	{
+		uint64_t checksum = 0;
+		const uint32_t itemCount = GetItemCount(frame, baseCount);
+		for (uint32_t i = 0; i < itemCount; ++i)
+		{
+			DrawItem* item = allocator.CreateItem();
+			item->sortKey = (static_cast<uint64_t>(i % 3) << 32) | (i % 5);
+			item->sequence = i;
+			item->instance.color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			items.push_back(item);
+		}
+		for (uint32_t bin = 0; bin < BinCount; ++bin)
+		{
+			const uint32_t size = GetBinSize(frame, bin);
+			uint32_t* values = allocator.AllocateBin(size);
+			for (uint32_t i = 0; i < size; ++i)
+			{
+				values[i] = i ^ frame;
+			}
+			bins.push_back(values);
+		}
+
+		for (const DrawItem* item : items)
+		{
+			checksum += item->sortKey + item->sequence;
+		}
+		for (uint32_t bin = 0; bin < BinCount; ++bin)
+		{
+			const uint32_t size = GetBinSize(frame, bin);
+			for (uint32_t i = 0; i < size; ++i)
+			{
+				checksum += bins[bin][i];
+			}
+		}
+
+		// DrawQueue::Clear と同じく、後ろから返します。
+		for (size_t i = items.size(); i > 0; --i)
+		{
+			allocator.DestroyItem(items[i - 1]);
+		}
+		for (uint32_t* values : bins)
+		{
+			allocator.FreeBin(values);
+		}
+		items.clear();
+		bins.clear();
+		allocator.EndFrame();
+		return checksum;
+	}
+
+	struct FrameTimes
+	{
+		Benchmark::Timing total;
+		double p99;
+		uint64_t heapAllocations;
+	};
+
+	// 1 周分を慣らしに使ってから frameCount フレームを計測し、フレームごとの時間の分布を表示します。
+	template <typename Allocator>
+	FrameTimes RunFrames(const char* name, uint32_t frameCount, uint32_t baseCount, std::vector<uint64_t>& checksums)
+	{
+		Allocator allocator;
+		std::vector<DrawItem*> items;
+		std::vector<uint32_t*> bins;
+		items.reserve(GetItemCount(0, baseCount) * 2);
+		bins.reserve(BinCount);
+		for (uint32_t frame = 0; frame < Period; ++frame)
+		{
+			RunFrame(allocator, frame, baseCount, items, bins);
+		}
+
+		const uint64_t heapAllocationsBefore = allocator.GetHeapAllocationCount();
+		std::vector<double> times(frameCount);
+		checksums.resize(frameCount);
+		double total = 0.0;
+		for (uint32_t frame = 0; frame < frameCount; ++frame)
+		{
+			const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			checksums[frame] = RunFrame(allocator, frame, baseCount, items, bins);
+			times[frame] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+			total += times[frame];
+		}
+		std::sort(times.begin(), times.end());
+
+		FrameTimes result;
+		result.total.best = total;
+		result.total.median = times[frameCount / 2];
+		result.p99 = times[std::min(frameCount - 1, frameCount * 99 / 100)];
+		result.heapAllocations = allocator.GetHeapAllocationCount() - heapAllocationsBefore;
+		std::printf("  %-44s p50 %8.3f ms   p99 %8.3f ms   max %8.3f ms\n", name, result.total.median, result.p99, times.back());
+		std::printf("  %-44s %.1f per frame\n", "heap allocations", static_cast<double>(result.heapAllocations) / frameCount);
+		return result;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark::Options options;
+	if (!Benchmark::ParseOptions(argc, argv, options))
+	{
+		return 2;
+	}
+
+	const uint32_t frameCount = options.quick ? Period : Period * 20;
+	const uint32_t baseCount = options.quick ? 2000 : 20000;
+	std::printf("%u frames, %u-%u draw items and %u scratch arrays per frame\n", frameCount, baseCount, baseCount * 3 / 2, BinCount);
+
+	std::vector<uint64_t> heapChecksums;
+	std::vector<uint64_t> poolChecksums;
+	Benchmark::Section("frame time");
+	const FrameTimes heap = RunFrames<HeapAllocator>("new + malloc", frameCount, baseCount, heapChecksums);
+	const FrameTimes pool = RunFrames<PoolAllocator>("ObjectPool + FrameArena", frameCount, baseCount, poolChecksums);
+	Benchmark::PrintSpeedup("speedup (total frame time)", heap.total, pool.total);
+
+	Benchmark::Verify(heapChecksums == poolChecksums, "both allocators produce the same frame contents");
+	Benchmark::Verify(heap.heapAllocations > 0, "the heap path allocates every frame");
+	Benchmark::Verify(pool.heapAllocations == 0, "the pool and arena make no heap allocations after one period");
+	return Benchmark::Finish();
+}
@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// ベンチマーク用の小さな計測関数。処理を繰り返して最速と中央値の時間を表示し、
+// 従来の方法と新しい方法の結果が一致しなければ終了コードで失敗を返します。
+//
+// 使い方:
+//   Benchmark::Options options;
+//   if (!Benchmark::ParseOptions(argc, argv, options)) return 2;
+//   const Benchmark::Timing before = Benchmark::Measure("scalar", options.repetitions, [&] { ... });
+//   const Benchmark::Timing after = Benchmark::Measure("simd", options.repetitions, [&] { ... });
+//   Benchmark::PrintSpeedup("speedup (simd)", before, after);
+//   Benchmark::Verify(output == expected, "simd matches scalar");
+//   return Benchmark::Finish();
+//
+// --quick を付けると入力を小さくして 1 回だけ実行します。ctest はこれで結果の一致だけを確かめます。
+namespace Benchmark
+{
+	struct Options
+	{
+		bool quick;
+		uint32_t repetitions;
+	};
+
+	// 計測した時間 (ミリ秒)。
+	struct Timing
+	{
+		double best;
+		double median;
+	};
+
+	inline int& GetFailureCount()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline bool ParseOptions(int argc, char* argv[], Options& options)
+	{
+		options.quick = false;
+		options.repetitions = 10;
+		for (int i = 1; i < argc; ++i)
+		{
+			if (strcmp(argv[i], "--quick") == 0)
+			{
+				options.quick = true;
+				options.repetitions = 1;
+			}
+			else
+			{
+				std::fprintf(stderr, "usage: %s [--quick]\n", argv[0]);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// 見出しを表示します。
+	inline void Section(const char* title)
+	{
+		std::printf("\n%s\n", title);
+	}
+
+	template <typename Function>
+	Timing Measure(const char* name, uint32_t repetitions, Function function)
+	{
+		std::vector<double> times;
+		for (uint32_t i = 0; i < std::max(repetitions, 1u); ++i)
+		{
+			const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			function();
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+		}
+		std::sort(times.begin(), times.end());
+
+		Timing timing;
+		timing.best = times.front();
+		timing.median = times[times.size() / 2];
+		std::printf("  %-44s best %10.3f ms   median %10.3f ms\n", name, timing.best, timing.median);
+		return timing;
+	}
+
+	// baseline に対する速さの比を、最速の時間で表示します。
+	inline void PrintSpeedup(const char* name, const Timing& baseline, const Timing& timing)
+	{
+		std::printf("  %-44s %.2fx\n", name, timing.best > 0.0 ? baseline.best / timing.best : 0.0);
+	}
+
+	inline bool Verify(bool condition, const char* description)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "verification failed: %s\n", description);
+			++GetFailureCount();
+		}
+		return condition;
+	}
+
+	// main の戻り値を返します。
+	inline int Finish()
+	{
+		const int failures = GetFailureCount();
+		if (failures == 0)
+		{
+			std::printf("\nAll results matched.\n");
+			return 0;
+		}
+		std::printf("\n%d verification(s) failed.\n", failures);
+		return 1;
+	}
+}
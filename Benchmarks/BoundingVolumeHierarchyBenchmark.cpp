@@ -0,0 +1,282 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Benchmark.h"
+#include "BoundingVolumeHierarchy.h"
+
+using namespace DirectX;
+
+// BVH を使う前の方法 (すべての三角形とレイの判定、すべての球と視錐台の判定) と、
+// TriangleMeshBvh と BoundingVolumeHierarchy を使う方法で、ピッキングとカリングを比べます。
+// 構築は直列と JobSystem を使う並列で、動いたオブジェクトへの追従は作り直しと Refit で比べます。
+namespace
+{
+	// 表面を波打たせた球。経線 segments 本、緯線 rings 本で、三角形は 2 * segments * rings 個です。
+	MeshData CreateBumpySphere(uint32_t segments, uint32_t rings)
+	{
+		MeshData mesh;
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = ring * XM_PI / rings;
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = segment * XM_2PI / segments;
+				const float radius = 1.0f + 0.05f * std::sin(theta * 23.0f) * std::cos(phi * 17.0f);
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(radius * std::sin(theta) * std::cos(phi), radius * std::cos(theta), radius * std::sin(theta) * std::sin(phi));
+				vertex.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segments; ++segment)
+			{
+				const uint32_t a = ring * (segments + 1) + segment;
+				const uint32_t b = a + segments + 1;
+				const uint32_t quad[] = { a, b, a + 1, a + 1, b, b + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// TriangleMeshBvh::Raycast と同じ Möller-Trumbore 法で、すべての三角形を判定します。
+	bool RaycastBruteForce(const MeshData& mesh, const PickRay& ray, float& distance)
+	{
+		bool found = false;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const XMFLOAT3& v0 = mesh.vertices[mesh.indices[i]].pos;
+			const XMFLOAT3 edge1 = Subtract(mesh.vertices[mesh.indices[i + 1]].pos, v0);
+			const XMFLOAT3 edge2 = Subtract(mesh.vertices[mesh.indices[i + 2]].pos, v0);
+
+			const XMFLOAT3 p = Cross(ray.direction, edge2);
+			const float determinant = Dot(edge1, p);
+			if (determinant == 0.0f)
+			{
+				continue;
+			}
+			const float inverseDeterminant = 1.0f / determinant;
+
+			const XMFLOAT3 s = Subtract(ray.origin, v0);
+			const float u = Dot(s, p) * inverseDeterminant;
+			if (u < 0.0f || u > 1.0f)
+			{
+				continue;
+			}
+
+			const XMFLOAT3 q = Cross(s, edge1);
+			const float v = Dot(ray.direction, q) * inverseDeterminant;
+			if (v < 0.0f || u + v > 1.0f)
+			{
+				continue;
+			}
+
+			const float hitDistance = Dot(edge2, q) * inverseDeterminant;
+			if (hitDistance >= 0.0f && hitDistance <= distance)
+			{
+				distance = hitDistance;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	// 半径 3 の球面から、メッシュの少し外側までの点に向かうレイ。一部はメッシュに当たりません。
+	std::vector<PickRay> CreateRays(uint32_t count)
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+		std::vector<PickRay> rays(count);
+		for (PickRay& ray : rays)
+		{
+			const XMVECTOR origin = XMVectorScale(XMVector3Normalize(XMVectorSet(distribution(random), distribution(random), distribution(random), 0.0f)), 3.0f);
+			const XMVECTOR target = XMVectorScale(XMVectorSet(distribution(random), distribution(random), distribution(random), 0.0f), 0.8f);
+			XMStoreFloat3(&ray.origin, origin);
+			XMStoreFloat3(&ray.direction, XMVectorSubtract(target, origin));
+		}
+		return rays;
+	}
+
+	void RunPicking(const Benchmark::Options& options, uint32_t threadCount)
+	{
+		const MeshData mesh = options.quick ? CreateBumpySphere(48, 24) : CreateBumpySphere(424, 212);
+		const std::vector<PickRay> rays = CreateRays(options.quick ? 64 : 256);
+		std::printf("\npicking: %u triangles, %u rays\n", static_cast<uint32_t>(mesh.indices.size() / 3), static_cast<uint32_t>(rays.size()));
+
+		TriangleMeshBvh bvh;
+		Benchmark::Section("  TriangleMeshBvh::Build");
+		const Benchmark::Timing serialBuild = Benchmark::Measure("serial", options.repetitions, [&] {
+			bvh.Build(mesh, nullptr);
+		});
+		JobSystem jobSystem(threadCount - 1);
+		char name[64];
+		snprintf(name, sizeof(name), "JobSystem, %u thread(s)", threadCount);
+		const Benchmark::Timing parallelBuild = Benchmark::Measure(name, options.repetitions, [&] {
+			bvh.Build(mesh, &jobSystem);
+		});
+		Benchmark::PrintSpeedup("speedup (parallel build)", serialBuild, parallelBuild);
+
+		std::vector<float> bruteDistances(rays.size());
+		std::vector<float> bvhDistances(rays.size());
+		Benchmark::Section("  nearest hit per ray");
+		const Benchmark::Timing brute = Benchmark::Measure("all triangles", options.repetitions, [&] {
+			for (size_t i = 0; i < rays.size(); ++i)
+			{
+				bruteDistances[i] = 1.0e30f;
+				RaycastBruteForce(mesh, rays[i], bruteDistances[i]);
+			}
+		});
+		const Benchmark::Timing traced = Benchmark::Measure("TriangleMeshBvh::Raycast", options.repetitions, [&] {
+			for (size_t i = 0; i < rays.size(); ++i)
+			{
+				bvhDistances[i] = 1.0e30f;
+				uint32_t triangle = 0;
+				bvh.Raycast(rays[i], bvhDistances[i], triangle);
+			}
+		});
+		Benchmark::PrintSpeedup("speedup (BVH)", brute, traced);
+
+		// 同じ式で判定するので、最も近い交点の距離は一致します。辺を共有する三角形のどちらを返すかは問いません。
+		uint32_t hits = 0;
+		for (float distance : bruteDistances)
+		{
+			hits += distance < 1.0e30f ? 1 : 0;
+		}
+		std::printf("  %-44s %u of %u\n", "rays hitting the mesh", hits, static_cast<uint32_t>(rays.size()));
+		Benchmark::Verify(bvhDistances == bruteDistances, "BVH picking matches brute force");
+		Benchmark::Verify(hits > 0 && hits < rays.size(), "rays both hit and miss the mesh");
+	}
+
+	// カメラの周りに散らばった球と、その AABB。
+	void CreateObjects(uint32_t count, float spread, BoundingSphereArray& spheres, std::vector<BoundingBox>& boxes)
+	{
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> position(-spread, spread);
+		std::uniform_real_distribution<float> radius(0.05f, 0.5f);
+		spheres.Resize(count);
+		boxes.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			spheres.x[i] = position(random);
+			spheres.y[i] = position(random);
+			spheres.z[i] = position(random);
+			spheres.radius[i] = radius(random);
+			boxes[i].minimum = XMFLOAT3(spheres.x[i] - spheres.radius[i], spheres.y[i] - spheres.radius[i], spheres.z[i] - spheres.radius[i]);
+			boxes[i].maximum = XMFLOAT3(spheres.x[i] + spheres.radius[i], spheres.y[i] + spheres.radius[i], spheres.z[i] + spheres.radius[i]);
+		}
+	}
+
+	void RunCulling(const Benchmark::Options& options, uint32_t threadCount)
+	{
+		const uint32_t count = options.quick ? 5000 : 200000;
+		BoundingSphereArray spheres;
+		std::vector<BoundingBox> boxes;
+		CreateObjects(count, options.quick ? 20.0f : 80.0f, spheres, boxes);
+		std::printf("\nculling: %u objects\n", count);
+
+		const XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.3f, 0.1f, -1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		const XMMATRIX projection = XMMatrixPerspectiveFovRH(60.0f * XM_PI / 180.0f, 16.0f / 9.0f, 0.1f, 60.0f);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+		const Frustum frustum = FrustumCulling::ExtractFrustum(viewProjection);
+
+		BoundingVolumeHierarchy hierarchy;
+		JobSystem jobSystem(threadCount - 1);
+		Benchmark::Section("  object BVH after objects move");
+		Benchmark::Measure("Build (serial)", options.repetitions, [&] {
+			hierarchy.Build(boxes, nullptr);
+		});
+		char name[64];
+		snprintf(name, sizeof(name), "Build (JobSystem, %u thread(s))", threadCount);
+		Benchmark::Measure(name, options.repetitions, [&] {
+			hierarchy.Build(boxes, &jobSystem);
+		});
+		Benchmark::Measure("Refit", options.repetitions, [&] {
+			hierarchy.Refit(boxes);
+		});
+
+		std::vector<uint32_t> scalarVisible;
+		std::vector<uint32_t> flatVisible(count);
+		std::vector<uint32_t> hierarchicalVisible;
+		std::vector<uint8_t> flags(count);
+		uint32_t flatCount = 0;
+		Benchmark::Section("  frustum culling");
+		const Benchmark::Timing scalar = Benchmark::Measure("IsSphereVisible per object", options.repetitions, [&] {
+			scalarVisible.clear();
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				if (FrustumCulling::IsSphereVisible(frustum, spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]))
+				{
+					scalarVisible.push_back(i);
+				}
+			}
+		});
+		const Benchmark::Timing flat = Benchmark::Measure("CullSpheres (SIMD, flat)", options.repetitions, [&] {
+			flatCount = FrustumCulling::CullSpheres(frustum, spheres, &flatVisible[0]);
+		});
+		// PolygonScene::CullHierarchical と同じく、部分的に交わる葉だけを球で判定します。
+		const Benchmark::Timing hierarchical = Benchmark::Measure("BoundingVolumeHierarchy::CullFrustum", options.repetitions, [&] {
+			std::fill(flags.begin(), flags.end(), 0);
+			hierarchy.CullFrustum(frustum, [&] (const uint32_t* objects, uint32_t objectCount, bool fullyInside) {
+				for (uint32_t i = 0; i < objectCount; ++i)
+				{
+					const uint32_t object = objects[i];
+					flags[object] = fullyInside ||
+						FrustumCulling::IsSphereVisible(frustum, spheres.x[object], spheres.y[object], spheres.z[object], spheres.radius[object]) ? 1 : 0;
+				}
+			});
+			hierarchicalVisible.clear();
+			for (uint32_t object = 0; object < count; ++object)
+			{
+				if (flags[object] != 0)
+				{
+					hierarchicalVisible.push_back(object);
+				}
+			}
+		});
+		Benchmark::PrintSpeedup("speedup (flat)", scalar, flat);
+		Benchmark::PrintSpeedup("speedup (hierarchical)", scalar, hierarchical);
+
+		flatVisible.resize(flatCount);
+		std::printf("  %-44s %u of %u\n", "visible objects", flatCount, count);
+		Benchmark::Verify(flatVisible == scalarVisible, "flat culling matches per-object tests");
+		Benchmark::Verify(hierarchicalVisible == scalarVisible, "hierarchical culling matches per-object tests");
+		Benchmark::Verify(flatCount > 0 && flatCount < count, "some objects are culled");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark::Options options;
+	if (!Benchmark::ParseOptions(argc, argv, options))
+	{
+		return 2;
+	}
+
+	// 1 コアの環境でも並列の構築を通るように、少なくとも 2 スレッドを使います。
+	const uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+	RunPicking(options, threadCount);
+	RunCulling(options, threadCount);
+	return Benchmark::Finish();
+}
@@ -0,0 +1,245 @@
+﻿#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Benchmark.h"
+#include "EntityStore.h"
+
+using namespace DirectX;
+
+// PolygonScene が EntityStore に移る前の、オブジェクトごとの構造体の配列 (AoS) と、
+// EntityStore の SoA のコンポーネントで、追加、削除と再追加、フレームごとのシステムの処理を比べます。
+// どちらにも同じ順で同じ操作をするので、dense 配列の順は一致し、システムの結果も同じになります。
+namespace
+{
+	// 従来のオブジェクト。ワールド空間の境界球も同じ構造体に持ちます。
+	struct SceneObject
+	{
+		uint32_t mesh;
+		XMFLOAT4X4 localTransform;
+		XMFLOAT4 color;
+		float angularVelocity;
+		float x, y, z, radius;
+	};
+
+	// 削除するときは末尾のオブジェクトを空いた位置に移して詰めます。EntityStore::Destroy と同じ順になります。
+	void DestroyObject(std::vector<SceneObject>& objects, uint32_t index)
+	{
+		objects[index] = objects.back();
+		objects.pop_back();
+	}
+
+	const uint32_t MeshCount = 2;
+
+	void GetMeshBounds(MeshBounds* meshBounds)
+	{
+		for (uint32_t mesh = 0; mesh < MeshCount; ++mesh)
+		{
+			meshBounds[mesh].center = XMFLOAT3(0.1f * mesh, 0.0f, 0.05f);
+			meshBounds[mesh].extents = XMFLOAT3(0.5f, 0.5f + mesh, 0.25f);
+			meshBounds[mesh].radius = 0.75f + mesh;
+		}
+	}
+
+	// number 番目に追加するオブジェクトの、ローカル変換と色、回転の速さ。
+	void GetObject(uint32_t number, XMFLOAT4X4& localTransform, XMFLOAT4& color, float& angularVelocity)
+	{
+		const uint32_t columns = 256;
+		XMStoreFloat4x4(
+			&localTransform,
+			XMMatrixMultiply(
+				XMMatrixScaling(0.01f, 0.01f, 0.01f),
+				XMMatrixTranslation((number % columns) * 0.008f - 1.0f, (number / columns % columns) * 0.008f - 1.0f, (number / (columns * columns)) * -0.05f)
+				)
+			);
+		color = XMFLOAT4((number % 5) * 0.25f, 0.5f, 1.0f, 1.0f);
+		angularVelocity = 0.5f + (number % 7) * 0.25f;
+	}
+
+	void AddObject(std::vector<SceneObject>& objects, uint32_t number)
+	{
+		SceneObject object;
+		GetObject(number, object.localTransform, object.color, object.angularVelocity);
+		object.mesh = number % MeshCount;
+		object.x = object.y = object.z = object.radius = 0.0f;
+		objects.push_back(object);
+	}
+
+	void AddObject(EntityStore& store, uint32_t number)
+	{
+		XMFLOAT4X4 localTransform;
+		XMFLOAT4 color;
+		float angularVelocity;
+		GetObject(number, localTransform, color, angularVelocity);
+		const uint32_t index = store.GetIndex(store.Create(number % MeshCount, localTransform, color));
+		store.GetAngularVelocities()[index] = angularVelocity;
+	}
+
+	// PolygonScene::UpdateObjects と同じく、回転させたワールド行列と境界球を求めます。
+	void UpdateObjects(std::vector<SceneObject>& objects, const MeshBounds* meshBounds, float time, std::vector<XMFLOAT4X4>& worlds)
+	{
+		BoundingSphereArray sphere;
+		sphere.Resize(1);
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			SceneObject& object = objects[i];
+			XMStoreFloat4x4(&worlds[i], XMMatrixMultiply(XMMatrixRotationZ(object.angularVelocity * time), XMLoadFloat4x4(&object.localTransform)));
+			sphere.Store(0, meshBounds[object.mesh], worlds[i]);
+			object.x = sphere.x[0];
+			object.y = sphere.y[0];
+			object.z = sphere.z[0];
+			object.radius = sphere.radius[0];
+		}
+	}
+
+	void UpdateObjects(EntityStore& store, const MeshBounds* meshBounds, float time, std::vector<XMFLOAT4X4>& worlds)
+	{
+		const XMFLOAT4X4* localTransforms = store.GetLocalTransforms();
+		const float* angularVelocities = store.GetAngularVelocities();
+		const uint32_t* meshes = store.GetMeshes();
+		BoundingSphereArray& spheres = store.GetBounds();
+		const uint32_t count = store.GetCount();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			XMStoreFloat4x4(&worlds[i], XMMatrixMultiply(XMMatrixRotationZ(angularVelocities[i] * time), XMLoadFloat4x4(&localTransforms[i])));
+			spheres.Store(i, meshBounds[meshes[i]], worlds[i]);
+		}
+	}
+
+	bool MatricesEqual(const std::vector<XMFLOAT4X4>& a, const std::vector<XMFLOAT4X4>& b, uint32_t count)
+	{
+		return count == 0 || memcmp(&a[0], &b[0], sizeof(XMFLOAT4X4) * count) == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark::Options options;
+	if (!Benchmark::ParseOptions(argc, argv, options))
+	{
+		return 2;
+	}
+
+	const uint32_t count = options.quick ? 10000 : 1000000;
+	const uint32_t churn = count / 2;
+	std::printf("%u entities, %u removed and added again per churn\n", count, churn);
+
+	MeshBounds meshBounds[MeshCount];
+	GetMeshBounds(meshBounds);
+
+	// 削除する位置は、そのときの数で割った余りで決めます。両方に同じ列を使います。
+	std::vector<uint32_t> removals(churn);
+	std::mt19937 random(21);
+	for (uint32_t& removal : removals)
+	{
+		removal = random();
+	}
+
+	std::vector<SceneObject> objects;
+	EntityStore store;
+	Benchmark::Section("add entities");
+	const Benchmark::Timing addObjects = Benchmark::Measure("std::vector<SceneObject>::push_back (AoS)", options.repetitions, [&] {
+		std::vector<SceneObject> added;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			AddObject(added, i);
+		}
+		objects.swap(added);
+	});
+	const Benchmark::Timing addEntities = Benchmark::Measure("EntityStore::Create (SoA)", options.repetitions, [&] {
+		EntityStore added;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			AddObject(added, i);
+		}
+		std::swap(store, added);
+	});
+	Benchmark::PrintSpeedup("speedup (EntityStore)", addObjects, addEntities);
+
+	// 削除して同じ数を追加し直すので、繰り返しても数は変わりません。EntityStore はハンドルで削除し、空いたスロットを使い回します。
+	// ハンドルを引き、配列ごとに詰めるので AoS より遅くなりますが、そのぶん削除してもハンドルは変わりません。
+	Benchmark::Section("remove and add again in random order");
+	uint32_t objectChurns = 0;
+	const Benchmark::Timing churnObjects = Benchmark::Measure("swap and pop (AoS)", options.repetitions, [&] {
+		for (uint32_t removal : removals)
+		{
+			DestroyObject(objects, removal % static_cast<uint32_t>(objects.size()));
+		}
+		for (uint32_t i = 0; i < churn; ++i)
+		{
+			AddObject(objects, count + objectChurns * churn + i);
+		}
+		++objectChurns;
+	});
+	uint32_t entityChurns = 0;
+	const Benchmark::Timing churnEntities = Benchmark::Measure("EntityStore::Destroy + Create (SoA)", options.repetitions, [&] {
+		for (uint32_t removal : removals)
+		{
+			store.Destroy(store.GetHandle(removal % store.GetCount()));
+		}
+		for (uint32_t i = 0; i < churn; ++i)
+		{
+			AddObject(store, count + entityChurns * churn + i);
+		}
+		++entityChurns;
+	});
+	Benchmark::PrintSpeedup("speedup (EntityStore)", churnObjects, churnEntities);
+
+	// 1 フレーム分のシステム。変換は行列をすべて読むので差は小さく、境界球だけを読むカリングは SoA で連続したメモリになります。
+	std::vector<XMFLOAT4X4> objectWorlds(count);
+	std::vector<XMFLOAT4X4> entityWorlds(count);
+	const float time = 1.5f;
+	Benchmark::Section("per-frame transform system");
+	const Benchmark::Timing updateObjects = Benchmark::Measure("SceneObject loop (AoS)", options.repetitions, [&] {
+		UpdateObjects(objects, meshBounds, time, objectWorlds);
+	});
+	const Benchmark::Timing updateEntities = Benchmark::Measure("component arrays (SoA)", options.repetitions, [&] {
+		UpdateObjects(store, meshBounds, time, entityWorlds);
+	});
+	Benchmark::PrintSpeedup("speedup (EntityStore)", updateObjects, updateEntities);
+
+	const XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(0.5f, -0.5f, 2.0f, 0.0f), XMVectorSet(0.5f, -0.5f, 0.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const XMMATRIX projection = XMMatrixPerspectiveFovRH(30.0f * XM_PI / 180.0f, 16.0f / 9.0f, 0.1f, 60.0f);
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+	const Frustum frustum = FrustumCulling::ExtractFrustum(viewProjection);
+
+	std::vector<uint32_t> objectVisible(count);
+	std::vector<uint32_t> entityVisible(count);
+	uint32_t objectVisibleCount = 0;
+	uint32_t entityVisibleCount = 0;
+	Benchmark::Section("per-frame culling system");
+	const Benchmark::Timing cullObjects = Benchmark::Measure("IsSphereVisible per SceneObject (AoS)", options.repetitions, [&] {
+		objectVisibleCount = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const SceneObject& object = objects[i];
+			if (FrustumCulling::IsSphereVisible(frustum, object.x, object.y, object.z, object.radius))
+			{
+				objectVisible[objectVisibleCount++] = i;
+			}
+		}
+	});
+	const Benchmark::Timing cullEntities = Benchmark::Measure("CullSpheres over the bounds (SoA)", options.repetitions, [&] {
+		entityVisibleCount = FrustumCulling::CullSpheres(frustum, store.GetBounds(), &entityVisible[0]);
+	});
+	Benchmark::PrintSpeedup("speedup (EntityStore)", cullObjects, cullEntities);
+	std::printf("  %-44s %u of %u\n", "visible entities", entityVisibleCount, count);
+
+	bool componentsEqual = objects.size() == store.GetCount();
+	for (uint32_t i = 0; componentsEqual && i < store.GetCount(); ++i)
+	{
+		const SceneObject& object = objects[i];
+		const BoundingSphereArray& spheres = store.GetBounds();
+		componentsEqual = object.mesh == store.GetMeshes()[i] &&
+			memcmp(&object.color, &store.GetColors()[i], sizeof(XMFLOAT4)) == 0 &&
+			object.x == spheres.x[i] && object.y == spheres.y[i] && object.z == spheres.z[i] && object.radius == spheres.radius[i];
+	}
+	Benchmark::Verify(componentsEqual, "both layouts hold the same entities in the same order");
+	Benchmark::Verify(MatricesEqual(objectWorlds, entityWorlds, count), "the transform systems write the same world matrices");
+	Benchmark::Verify(objectVisibleCount == entityVisibleCount &&
+		std::equal(objectVisible.begin(), objectVisible.begin() + objectVisibleCount, entityVisible.begin()), "the culling systems find the same entities");
+	return Benchmark::Finish();
+}
@@ -0,0 +1,181 @@
+﻿#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+#include "Benchmark.h"
+#include "FileChunkReader.h"
+#include "FileView.h"
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// DX::ReadDataAsync の従来の方法 (読み込んだバッファーを別の配列へコピーする) と、
+// FileView::Map でマップしたビュー、FileChunkReader でチャンクずつ読む方法で、同じファイルを読んで比べます。
+// 時間はページ キャッシュに載った状態での読み取りで、ピークの RSS はそれぞれ別の子プロセスで 1 回だけ読んで求めます。
+namespace
+{
+	const char* const FileName = "FileLoadBenchmark.tmp";
+
+	// 内容を確かめるための、バイトの合計。
+	uint64_t Checksum(const uint8_t* data, size_t size)
+	{
+		uint64_t sum = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			sum += data[i];
+		}
+		return sum;
+	}
+
+	// 乱数で埋めた size バイトのファイルを作り、内容のチェックサムを返します。
+	bool WriteTestFile(size_t size, uint64_t& checksum)
+	{
+		std::ofstream stream(FileName, std::ios::binary | std::ios::trunc);
+		std::mt19937 random(17);
+		std::vector<uint8_t> block(1024 * 1024);
+		checksum = 0;
+		for (size_t written = 0; written < size; written += block.size())
+		{
+			const size_t count = std::min(block.size(), size - written);
+			for (size_t i = 0; i < count; ++i)
+			{
+				block[i] = static_cast<uint8_t>(random());
+			}
+			checksum += Checksum(&block[0], count);
+			stream.write(reinterpret_cast<const char*>(&block[0]), count);
+		}
+		return stream.good();
+	}
+
+	// 従来の方法。ファイル全体をバッファーへ読み込んでから、別の配列へコピーします。
+	uint64_t LoadByCopy()
+	{
+		std::ifstream stream(FileName, std::ios::binary | std::ios::ate);
+		const size_t size = static_cast<size_t>(stream.tellg());
+		stream.seekg(0);
+		std::vector<uint8_t> buffer(size);
+		if (size == 0 || !stream.read(reinterpret_cast<char*>(&buffer[0]), size))
+		{
+			return 0;
+		}
+		const std::vector<uint8_t> data(buffer.begin(), buffer.end());
+		return Checksum(&data[0], data.size());
+	}
+
+	uint64_t LoadByMap()
+	{
+		const FileView view = FileView::Map(FileName);
+		return view.IsValid() ? Checksum(view.GetData(), view.GetSize()) : 0;
+	}
+
+	uint64_t LoadByChunks()
+	{
+		FileChunkReader reader(FileChunkReader::DefaultChunkSize);
+		if (!reader.Open(FileName))
+		{
+			return 0;
+		}
+		uint64_t sum = 0;
+		const uint8_t* data;
+		size_t size;
+		while (reader.ReadNext(data, size))
+		{
+			sum += Checksum(data, size);
+		}
+		return reader.HasError() ? 0 : sum;
+	}
+
+#if !defined(_WIN32)
+	// load を子プロセスで 1 回だけ実行し、そのプロセスのピークの RSS (KiB) を返します。
+	// load が nullptr なら何も読まずに終わるので、プロセスそのものの RSS になります。
+	long MeasurePeakResidentSize(uint64_t (*load)())
+	{
+		const pid_t child = fork();
+		if (child == 0)
+		{
+			_exit(load == nullptr || load() != 0 ? 0 : 1);
+		}
+		int status = 0;
+		struct rusage usage;
+		if (child < 0 || wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			return -1;
+		}
+		return usage.ru_maxrss;
+	}
+#endif
+
+	void PrintPeakResidentSize(const char* name, uint64_t (*load)(), long baseline)
+	{
+#if !defined(_WIN32)
+		const long peak = MeasurePeakResidentSize(load);
+		std::printf("  %-44s %8ld KiB (+%ld KiB)\n", name, peak, peak - baseline);
+		Benchmark::Verify(peak >= 0, "the child process loaded the file");
+#else
+		(void)name;
+		(void)load;
+		(void)baseline;
+#endif
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark::Options options;
+	if (!Benchmark::ParseOptions(argc, argv, options))
+	{
+		return 2;
+	}
+
+	// チャンクの大きさで割り切れない大きさにして、最後の半端なチャンクも含めます。
+	const size_t fileSize = (options.quick ? 4u : 256u) * 1024 * 1024 + 123;
+	uint64_t expected = 0;
+	if (!Benchmark::Verify(WriteTestFile(fileSize, expected), "the test file was written"))
+	{
+		std::remove(FileName);
+		return Benchmark::Finish();
+	}
+	std::printf("%llu bytes, %llu byte chunks\n", static_cast<unsigned long long>(fileSize), static_cast<unsigned long long>(FileChunkReader::DefaultChunkSize));
+
+	// 子プロセスは親の RSS を引き継ぐので、大きなバッファーを確保する前に測り、何も読まない子プロセスとの差も表示します。
+	// マップしたページは触れた分だけ RSS に数えますが、ページ キャッシュと共有するのでコピーは作りません。
+#if !defined(_WIN32)
+	Benchmark::Section("peak resident set size (one load per child process)");
+	const long baseline = MeasurePeakResidentSize(nullptr);
+	std::printf("  %-44s %8ld KiB\n", "no load", baseline);
+#else
+	const long baseline = 0;
+#endif
+	PrintPeakResidentSize("read + copy (previous ReadDataAsync)", LoadByCopy, baseline);
+	PrintPeakResidentSize("FileView::Map", LoadByMap, baseline);
+	PrintPeakResidentSize("FileChunkReader", LoadByChunks, baseline);
+
+	uint64_t copied = 0;
+	uint64_t mapped = 0;
+	uint64_t streamed = 0;
+	Benchmark::Section("load and checksum (warm page cache)");
+	LoadByCopy();
+	const Benchmark::Timing copy = Benchmark::Measure("read + copy (previous ReadDataAsync)", options.repetitions, [&] {
+		copied = LoadByCopy();
+	});
+	const Benchmark::Timing map = Benchmark::Measure("FileView::Map", options.repetitions, [&] {
+		mapped = LoadByMap();
+	});
+	const Benchmark::Timing chunks = Benchmark::Measure("FileChunkReader", options.repetitions, [&] {
+		streamed = LoadByChunks();
+	});
+	Benchmark::PrintSpeedup("speedup (FileView::Map)", copy, map);
+	Benchmark::PrintSpeedup("speedup (FileChunkReader)", copy, chunks);
+
+	Benchmark::Verify(copied == expected, "read + copy returns the written bytes");
+	Benchmark::Verify(mapped == expected, "FileView::Map returns the written bytes");
+	Benchmark::Verify(streamed == expected, "FileChunkReader returns the written bytes");
+	std::remove(FileName);
+	return Benchmark::Finish();
+}
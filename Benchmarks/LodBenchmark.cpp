@@ -0,0 +1,211 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Benchmark.h"
+#include "BoundingVolumeHierarchy.h"
+#include "LodSelection.h"
+#include "MeshSimplifier.h"
+
+using namespace DirectX;
+
+// MeshSimplifier::BuildLods で作った段ごとに、減らした三角形の数と、それで生じた誤差を比べます。
+// 誤差は簡略化が推定した値と、同じレイを 0 番の段とその段に当てて測った交点の距離の差の両方を表示します。
+// 最後に、LodSelection が距離ごとに選ぶ段と、その段で描画する三角形の数を表示します。
+namespace
+{
+	// 表面を波打たせた球。経線 segments 本、緯線 rings 本で、三角形は 2 * segments * rings 個です。
+	MeshData CreateBumpySphere(uint32_t segments, uint32_t rings)
+	{
+		MeshData mesh;
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = ring * XM_PI / rings;
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = segment * XM_2PI / segments;
+				const float radius = 1.0f + 0.05f * std::sin(theta * 11.0f) * std::cos(phi * 7.0f);
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(radius * std::sin(theta) * std::cos(phi), radius * std::cos(theta), radius * std::sin(theta) * std::sin(phi));
+				vertex.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segments; ++segment)
+			{
+				const uint32_t a = ring * (segments + 1) + segment;
+				const uint32_t b = a + segments + 1;
+				const uint32_t quad[] = { a, b, a + 1, a + 1, b, b + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// [-1, 1] の正方形の高さ場。開いた境界を持ちます。
+	MeshData CreateTerrain(uint32_t size)
+	{
+		MeshData mesh;
+		for (uint32_t row = 0; row <= size; ++row)
+		{
+			for (uint32_t column = 0; column <= size; ++column)
+			{
+				const float x = column * 2.0f / size - 1.0f;
+				const float y = row * 2.0f / size - 1.0f;
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(x, y, 0.1f * std::sin(x * 3.0f) * std::cos(y * 2.0f) + 0.02f * std::sin(x * 17.0f + y * 13.0f));
+				vertex.color = XMFLOAT3(0.4f, 0.6f, 0.3f);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t row = 0; row < size; ++row)
+		{
+			for (uint32_t column = 0; column < size; ++column)
+			{
+				const uint32_t a = row * (size + 1) + column;
+				const uint32_t quad[] = { a, a + 1, a + size + 2, a, a + size + 2, a + size + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// 球には中心から外向きに、高さ場には上から下向きにレイを当てます。どちらの面にもレイは 1 回だけ当たります。
+	std::vector<PickRay> CreateSphereRays(uint32_t count)
+	{
+		std::mt19937 random(20);
+		std::normal_distribution<float> distribution(0.0f, 1.0f);
+		std::vector<PickRay> rays(count);
+		for (PickRay& ray : rays)
+		{
+			XMFLOAT3 direction(distribution(random), distribution(random), distribution(random));
+			XMStoreFloat3(&ray.direction, XMVector3Normalize(XMLoadFloat3(&direction)));
+			ray.origin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		}
+		return rays;
+	}
+
+	std::vector<PickRay> CreateTerrainRays(uint32_t count)
+	{
+		std::mt19937 random(20);
+		std::uniform_real_distribution<float> distribution(-0.99f, 0.99f);
+		std::vector<PickRay> rays(count);
+		for (PickRay& ray : rays)
+		{
+			ray.origin = XMFLOAT3(distribution(random), distribution(random), 1.0f);
+			ray.direction = XMFLOAT3(0.0f, 0.0f, -1.0f);
+		}
+		return rays;
+	}
+
+	// レイの交点までの距離。当たらなければ負の値にします。
+	std::vector<float> CastRays(const MeshData& mesh, const std::vector<PickRay>& rays)
+	{
+		TriangleMeshBvh hierarchy;
+		hierarchy.Build(mesh, nullptr);
+		std::vector<float> distances(rays.size());
+		for (size_t i = 0; i < rays.size(); ++i)
+		{
+			float distance = 10.0f;
+			uint32_t triangle;
+			distances[i] = hierarchy.Raycast(rays[i], distance, triangle) ? distance : -1.0f;
+		}
+		return distances;
+	}
+
+	void Run(const char* title, const MeshData& source, const std::vector<PickRay>& rays, const Benchmark::Options& options)
+	{
+		std::printf("\n%s: %u vertices, %u triangles, %u rays\n",
+			title, static_cast<uint32_t>(source.vertices.size()), static_cast<uint32_t>(source.indices.size() / 3), static_cast<uint32_t>(rays.size()));
+
+		LodBuildSettings settings;
+		MeshData mesh;
+		std::vector<MeshFileLod> lods;
+		Benchmark::Measure("MeshSimplifier::BuildLods", options.repetitions, [&] {
+			mesh = source;
+			MeshSimplifier::BuildLods(mesh, settings, lods);
+		});
+
+		const uint32_t fullTriangles = lods[0].indexCount / 3;
+		std::vector<float> reference;
+		bool allHit = true;
+		bool fewerTriangles = true;
+		bool increasingError = true;
+		for (size_t level = 0; level < lods.size(); ++level)
+		{
+			MeshData levelMesh;
+			MeshSimplifier::ExtractLod(mesh, lods[level], levelMesh);
+			const std::vector<float> distances = CastRays(levelMesh, rays);
+			if (level == 0)
+			{
+				reference = distances;
+			}
+
+			double maxError = 0.0;
+			double sumError = 0.0;
+			for (size_t i = 0; i < rays.size(); ++i)
+			{
+				allHit = allHit && distances[i] >= 0.0f;
+				const double error = std::fabs(static_cast<double>(distances[i]) - reference[i]);
+				maxError = std::max(maxError, error);
+				sumError += error;
+			}
+
+			const uint32_t triangles = lods[level].indexCount / 3;
+			char name[64];
+			snprintf(name, sizeof(name), "level %u: %u triangles (%.1f%% saved)", static_cast<uint32_t>(level), triangles, 100.0 * (fullTriangles - triangles) / fullTriangles);
+			std::printf("  %-44s estimated %.5f   measured max %.5f   mean %.5f\n", name, lods[level].maxError, maxError, sumError / rays.size());
+
+			if (level > 0)
+			{
+				fewerTriangles = fewerTriangles && triangles < lods[level - 1].indexCount / 3;
+				increasingError = increasingError && lods[level].maxError >= lods[level - 1].maxError;
+			}
+		}
+
+		// 1080p、垂直の画角 60 度で、オブジェクトを遠ざけたときに選ぶ段。距離ごとに前の段から選び直します。
+		LodSettings lodSettings;
+		lodSettings.viewportWidth = 1920.0f;
+		lodSettings.viewportHeight = 1080.0f;
+		XMFLOAT4X4 projection;
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovRH(60.0f * XM_PI / 180.0f, 16.0f / 9.0f, 0.1f, 1000.0f));
+		const float pixelsPerUnit = LodSelection::ComputePixelsPerUnit(projection, lodSettings.viewportWidth, lodSettings.viewportHeight);
+		std::vector<float> errors;
+		for (const MeshFileLod& lod : lods)
+		{
+			errors.push_back(lod.maxError);
+		}
+		uint32_t selected = 0;
+		for (float distance = 2.0f; distance <= 256.0f; distance *= 2.0f)
+		{
+			const float errorScale = pixelsPerUnit / distance;
+			selected = LodSelection::SelectLevel(&errors[0], static_cast<uint32_t>(errors.size()), selected, errorScale, lodSettings);
+			char name[64];
+			snprintf(name, sizeof(name), "at distance %.0f: level %u", distance, selected);
+			std::printf("  %-44s %8u triangles   %.3f px\n", name, lods[selected].indexCount / 3, errors[selected] * errorScale);
+		}
+
+		Benchmark::Verify(lods.size() > 1, "BuildLods creates coarser levels");
+		Benchmark::Verify(fewerTriangles, "each level has fewer triangles than the previous one");
+		Benchmark::Verify(increasingError, "the estimated error does not decrease with the level");
+		Benchmark::Verify(allHit, "every ray hits every level");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark::Options options;
+	if (!Benchmark::ParseOptions(argc, argv, options))
+	{
+		return 2;
+	}
+
+	const uint32_t rayCount = options.quick ? 1000 : 20000;
+	Run("bumpy sphere", options.quick ? CreateBumpySphere(64, 32) : CreateBumpySphere(256, 128), CreateSphereRays(rayCount), options);
+	Run("terrain", CreateTerrain(options.quick ? 48 : 256), CreateTerrainRays(rayCount), options);
+	return Benchmark::Finish();
+}
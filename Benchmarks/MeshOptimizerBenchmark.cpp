@@ -0,0 +1,185 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Benchmark.h"
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+
+// 生成した順のままのインデックス (従来の方法) と、MeshOptimizer::Optimize で並べ替えたものを、
+// 合成したメッシュごとに頂点キャッシュの効率で比べ、最適化にかかる時間を計測します。
+namespace
+{
+	// size x size の格子を、行ごとに生成した順の三角形で作ります。shuffle なら三角形の順を乱します。
+	MeshData CreateGrid(uint32_t size, bool shuffle)
+	{
+		MeshData mesh;
+		for (uint32_t row = 0; row <= size; ++row)
+		{
+			for (uint32_t column = 0; column <= size; ++column)
+			{
+				const float u = static_cast<float>(column) / size;
+				const float v = static_cast<float>(row) / size;
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.1f * std::sin(u * 12.0f) * std::cos(v * 9.0f));
+				vertex.color = XMFLOAT3(u, v, 0.5f);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t row = 0; row < size; ++row)
+		{
+			for (uint32_t column = 0; column < size; ++column)
+			{
+				const uint32_t a = row * (size + 1) + column;
+				const uint32_t quad[] = { a, a + 1, a + size + 2, a, a + size + 2, a + size + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+
+		if (shuffle)
+		{
+			const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+			std::vector<uint32_t> order(triangleCount);
+			for (uint32_t i = 0; i < triangleCount; ++i)
+			{
+				order[i] = i;
+			}
+			std::mt19937 random(7);
+			std::shuffle(order.begin(), order.end(), random);
+			std::vector<uint32_t> shuffled;
+			shuffled.reserve(mesh.indices.size());
+			for (uint32_t triangle : order)
+			{
+				shuffled.insert(shuffled.end(), mesh.indices.begin() + triangle * 3, mesh.indices.begin() + triangle * 3 + 3);
+			}
+			mesh.indices.swap(shuffled);
+		}
+		return mesh;
+	}
+
+	// 経線 segments 本、緯線 rings 本の球。閉じたメッシュなので、オーバードローの並べ替えが効きます。
+	MeshData CreateSphere(uint32_t segments, uint32_t rings)
+	{
+		MeshData mesh;
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = ring * XM_PI / rings;
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = segment * XM_2PI / segments;
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				vertex.color = XMFLOAT3(0.8f, 0.8f, 0.8f);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segments; ++segment)
+			{
+				const uint32_t a = ring * (segments + 1) + segment;
+				const uint32_t b = a + segments + 1;
+				const uint32_t quad[] = { a, b, a + 1, a + 1, b, b + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// 三角形を頂点の位置の組で表し、巻き順を保ったまま回して並べ替えたもの。並べ替えの前後で同じになります。
+	struct TriangleKey
+	{
+		float values[9];
+
+		bool operator<(const TriangleKey& other) const
+		{
+			return std::lexicographical_compare(values, values + 9, other.values, other.values + 9);
+		}
+
+		bool operator==(const TriangleKey& other) const
+		{
+			return std::equal(values, values + 9, other.values);
+		}
+	};
+
+	std::vector<TriangleKey> GetTriangleKeys(const MeshData& mesh)
+	{
+		std::vector<TriangleKey> keys;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			TriangleKey rotations[3];
+			for (uint32_t r = 0; r < 3; ++r)
+			{
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					const XMFLOAT3& pos = mesh.vertices[mesh.indices[i + (r + corner) % 3]].pos;
+					rotations[r].values[corner * 3 + 0] = pos.x;
+					rotations[r].values[corner * 3 + 1] = pos.y;
+					rotations[r].values[corner * 3 + 2] = pos.z;
+				}
+			}
+			keys.push_back(*std::min_element(rotations, rotations + 3));
+		}
+		std::sort(keys.begin(), keys.end());
+		return keys;
+	}
+
+	void PrintStatistics(const char* name, const VertexCacheStatistics& statistics)
+	{
+		std::printf("  %-44s ACMR %5.3f   ATVR %5.3f\n", name, statistics.acmr, statistics.atvr);
+	}
+
+	void Run(const char* title, const MeshData& source, const Benchmark::Options& options)
+	{
+		const uint32_t vertexCount = static_cast<uint32_t>(source.vertices.size());
+		const uint32_t indexCount = static_cast<uint32_t>(source.indices.size());
+		std::printf("\n%s: %u vertices, %u triangles\n", title, vertexCount, indexCount / 3);
+
+		MeshData cacheOnly;
+		Benchmark::Measure("Optimize (vertex cache + fetch)", options.repetitions, [&] {
+			cacheOnly = source;
+			MeshOptimizer::Optimize(cacheOnly, false);
+		});
+		MeshData overdraw;
+		MeshOptimizationReport report;
+		Benchmark::Measure("Optimize (vertex cache + overdraw + fetch)", options.repetitions, [&] {
+			overdraw = source;
+			report = MeshOptimizer::Optimize(overdraw, true);
+		});
+
+		const uint32_t cacheSizes[] = { MeshOptimizer::DefaultCacheSize, 32 };
+		for (uint32_t cacheSize : cacheSizes)
+		{
+			std::printf("  FIFO cache of %u vertices\n", cacheSize);
+			PrintStatistics("as generated", MeshOptimizer::AnalyzeVertexCache(&source.indices[0], indexCount, vertexCount, cacheSize));
+			PrintStatistics("optimized (vertex cache)", MeshOptimizer::AnalyzeVertexCache(&cacheOnly.indices[0], indexCount, vertexCount, cacheSize));
+			PrintStatistics("optimized (with overdraw)", MeshOptimizer::AnalyzeVertexCache(&overdraw.indices[0], indexCount, vertexCount, cacheSize));
+		}
+		std::printf("  %-44s %u\n", "overdraw clusters", report.clusterCount);
+
+		// 並べ替えても三角形の集合は変わらず、キャッシュの効率は下がりません。
+		const std::vector<TriangleKey> expected = GetTriangleKeys(source);
+		Benchmark::Verify(GetTriangleKeys(cacheOnly) == expected, "vertex cache optimization keeps the triangles");
+		Benchmark::Verify(GetTriangleKeys(overdraw) == expected, "overdraw optimization keeps the triangles");
+		Benchmark::Verify(report.after.acmr <= report.before.acmr, "optimization does not increase ACMR");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark::Options options;
+	if (!Benchmark::ParseOptions(argc, argv, options))
+	{
+		return 2;
+	}
+
+	const uint32_t gridSize = options.quick ? 32 : 300;
+	Run("grid, generated order", CreateGrid(gridSize, false), options);
+	Run("grid, shuffled triangles", CreateGrid(gridSize, true), options);
+	Run("sphere", options.quick ? CreateSphere(32, 16) : CreateSphere(512, 256), options);
+	return Benchmark::Finish();
+}
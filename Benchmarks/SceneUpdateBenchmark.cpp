@@ -0,0 +1,96 @@
+﻿#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "PolygonScene.h"
+#include "SoftwareRenderDevice.h"
+
+using namespace DirectX;
+
+// PolygonScene::Update を、ジョブ システムなしで直列に処理する従来の方法と、
+// JobSystem で 1 ～ N スレッドに分ける方法で比べます。どのスレッド数でも直列と同じインスタンス データになります。
+namespace
+{
+	void AddObjects(PolygonScene& scene, uint32_t count)
+	{
+		const uint32_t columns = 256;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			XMFLOAT4X4 transform;
+			XMStoreFloat4x4(
+				&transform,
+				XMMatrixMultiply(
+					XMMatrixScaling(0.01f, 0.01f, 0.01f),
+					XMMatrixTranslation((i % columns) * 0.008f - 1.0f, (i / columns % columns) * 0.008f - 1.0f, (i / (columns * columns)) * 0.05f)
+					)
+				);
+			const EntityHandle object = scene.AddObject(0, transform, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+			scene.SetAngularVelocity(object, 0.5f + (i % 7) * 0.25f);
+		}
+	}
+
+	bool InstancesEqual(const std::vector<InstanceData>& a, const std::vector<InstanceData>& b)
+	{
+		return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], sizeof(InstanceData) * a.size()) == 0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark::Options options;
+	if (!Benchmark::ParseOptions(argc, argv, options))
+	{
+		return 2;
+	}
+
+	// 1 コアの環境でも並列の経路を通るように、スレッド数は少なくとも 4 まで試します。
+	const uint32_t objectCount = options.quick ? 4000 : 200000;
+	const uint32_t maxThreads = std::max(4u, std::thread::hardware_concurrency());
+	std::printf("%u objects, %u hardware threads\n", objectCount, std::thread::hardware_concurrency());
+
+	SoftwareRenderDevice device(16, 16, 1);
+	PolygonScene scene;
+	scene.CreateDeviceResources(device);
+	AddObjects(scene, objectCount);
+
+	SceneSnapshot expected;
+	SceneSnapshot snapshot;
+	uint32_t frame = 0;
+	auto update = [&] {
+		++frame;
+		scene.Update(frame / 60.0f, 1.0f / 60.0f);
+	};
+
+	// 最初の Update はオブジェクトの BVH を作るので、計測に含めません。
+	Benchmark::Section("PolygonScene::Update");
+	scene.SetJobSystem(nullptr);
+	update();
+	const Benchmark::Timing serial = Benchmark::Measure("serial (no job system)", options.repetitions, update);
+	scene.CaptureSnapshot(expected);
+	const float expectedTime = expected.time;
+
+	for (uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		JobSystem jobSystem(threads - 1);
+		scene.SetJobSystem(&jobSystem);
+
+		char name[64];
+		snprintf(name, sizeof(name), "JobSystem, %u thread(s)", threads);
+		const Benchmark::Timing parallel = Benchmark::Measure(name, options.repetitions, update);
+		snprintf(name, sizeof(name), "speedup (%u thread(s))", threads);
+		Benchmark::PrintSpeedup(name, serial, parallel);
+
+		// 同じ時刻で更新し直して、直列の結果と比べます。
+		scene.Update(expectedTime, 1.0f / 60.0f);
+		scene.CaptureSnapshot(snapshot);
+		snprintf(name, sizeof(name), "%u thread(s) match the serial update", threads);
+		Benchmark::Verify(InstancesEqual(snapshot.instances, expected.instances), name);
+		scene.SetJobSystem(nullptr);
+	}
+	return Benchmark::Finish();
+}
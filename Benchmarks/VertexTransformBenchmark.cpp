@@ -0,0 +1,126 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Benchmark.h"
+#include "VertexTransform.h"
+
+using namespace DirectX;
+
+// SimpleVertexShader.hlsl と同じく頂点ごとに model, view, projection を順に掛ける従来の方法と、
+// 1 つにまとめた行列で SoA のストリームを SIMD で変換する VertexTransform::TransformPositions を比べます。
+// どちらもクリップ コードまで求めます。
+namespace
+{
+	uint8_t ComputeClipCode(const XMFLOAT4& clip)
+	{
+		uint8_t code = 0;
+		code |= clip.x < -clip.w ? ClipLeft : 0;
+		code |= clip.x > clip.w ? ClipRight : 0;
+		code |= clip.y < -clip.w ? ClipBottom : 0;
+		code |= clip.y > clip.w ? ClipTop : 0;
+		code |= clip.z < 0.0f ? ClipNear : 0;
+		code |= clip.z > clip.w ? ClipFar : 0;
+		return code;
+	}
+
+	ModelViewProjectionConstantBuffer CreateConstants()
+	{
+		const XMVECTOR eye = XMVectorSet(0.0f, 0.7f, 1.5f, 0.0f);
+		const XMVECTOR at = XMVectorSet(0.0f, -0.1f, 0.0f, 0.0f);
+		const XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+		ModelViewProjectionConstantBuffer constants;
+		XMStoreFloat4x4(&constants.model, XMMatrixTranspose(XMMatrixRotationY(0.6f)));
+		XMStoreFloat4x4(&constants.view, XMMatrixTranspose(XMMatrixLookAtRH(eye, at, up)));
+		XMStoreFloat4x4(&constants.projection, XMMatrixTranspose(XMMatrixPerspectiveFovRH(70.0f * XM_PI / 180.0f, 16.0f / 9.0f, 0.01f, 100.0f)));
+		return constants;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark::Options options;
+	if (!Benchmark::ParseOptions(argc, argv, options))
+	{
+		return 2;
+	}
+
+	// SIMD の幅で割り切れない数にして、末尾の処理も含めます。
+	const uint32_t count = (options.quick ? 4096u : 1u << 20) + 3;
+	std::printf("%u vertices, %s kernel\n", count, VertexTransform::GetImplementationName());
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-2.0f, 2.0f);
+	std::vector<XMFLOAT3> positions(count);
+	std::vector<float> x(count), y(count), z(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		positions[i] = XMFLOAT3(distribution(random), distribution(random), distribution(random));
+		x[i] = positions[i].x;
+		y[i] = positions[i].y;
+		z[i] = positions[i].z;
+	}
+
+	const ModelViewProjectionConstantBuffer constants = CreateConstants();
+	const XMMATRIX model = XMMatrixTranspose(XMLoadFloat4x4(&constants.model));
+	const XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&constants.view));
+	const XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&constants.projection));
+
+	std::vector<XMFLOAT4> scalarOutput(count);
+	std::vector<uint8_t> scalarCodes(count);
+	std::vector<float> cx(count), cy(count), cz(count), cw(count);
+	std::vector<uint8_t> codes(count);
+	const ClipSpaceStream output = { &cx[0], &cy[0], &cz[0], &cw[0], &codes[0] };
+	const PositionStream input = { &x[0], &y[0], &z[0] };
+	ClipCodeSummary summary = { 0, 0 };
+
+	Benchmark::Section("model/view/projection transform with clip codes");
+	const Benchmark::Timing perMatrix = Benchmark::Measure("XMVector3Transform x3 per vertex (AoS)", options.repetitions, [&] {
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			XMVECTOR position = XMVector3Transform(XMLoadFloat3(&positions[i]), model);
+			position = XMVector4Transform(position, view);
+			position = XMVector4Transform(position, projection);
+			XMStoreFloat4(&scalarOutput[i], position);
+			scalarCodes[i] = ComputeClipCode(scalarOutput[i]);
+		}
+	});
+	const Benchmark::Timing composed = Benchmark::Measure("XMVector3Transform, composed (AoS)", options.repetitions, [&] {
+		const XMMATRIX modelViewProjection = XMMatrixMultiply(XMMatrixMultiply(model, view), projection);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			XMStoreFloat4(&scalarOutput[i], XMVector3Transform(XMLoadFloat3(&positions[i]), modelViewProjection));
+			scalarCodes[i] = ComputeClipCode(scalarOutput[i]);
+		}
+	});
+	const Benchmark::Timing kernel = Benchmark::Measure("VertexTransform::TransformPositions (SoA)", options.repetitions, [&] {
+		const XMFLOAT4X4 modelViewProjection = VertexTransform::ComposeModelViewProjection(constants);
+		summary = VertexTransform::TransformPositions(modelViewProjection, input, count, output);
+	});
+	Benchmark::PrintSpeedup("speedup (composed)", perMatrix, composed);
+	Benchmark::PrintSpeedup("speedup (TransformPositions)", perMatrix, kernel);
+
+	// 行列をまとめると丸めが変わるので、位置は w に比例した誤差まで許し、クリップ コードは平面の上の頂点だけ違ってかまいません。
+	uint32_t positionMismatches = 0;
+	uint32_t codeMismatches = 0;
+	uint8_t andCodes = 0xFF;
+	uint8_t orCodes = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const XMFLOAT4& expected = scalarOutput[i];
+		const float tolerance = 1e-4f * std::max(1.0f, std::fabs(expected.w));
+		positionMismatches += std::fabs(cx[i] - expected.x) > tolerance || std::fabs(cy[i] - expected.y) > tolerance ||
+			std::fabs(cz[i] - expected.z) > tolerance || std::fabs(cw[i] - expected.w) > tolerance ? 1 : 0;
+		codeMismatches += codes[i] != scalarCodes[i] ? 1 : 0;
+		andCodes &= codes[i];
+		orCodes |= codes[i];
+	}
+	std::printf("  clip code differences: %u of %u\n", codeMismatches, count);
+	Benchmark::Verify(positionMismatches == 0, "clip-space positions match the scalar transform");
+	Benchmark::Verify(codeMismatches <= count / 1000, "clip codes match the scalar transform");
+	Benchmark::Verify(summary.andCodes == andCodes && summary.orCodes == orCodes, "clip code summary matches the per-vertex codes");
+	return Benchmark::Finish();
+}
@@ -0,0 +1,588 @@
+﻿#include "BoundingVolumeHierarchy.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// SAH で分割位置を探すときのビンの数。
+static const int BinCount = 12;
+
+// これより基本図形が少ないときは、並列に構築しても分割の手間の方が大きくなります。
+static const uint32_t MinParallelSubtreeSize = 1024;
+
+static inline XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+static inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline float GetComponent(const XMFLOAT3& v, int axis)
+{
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static inline BoundingBox EmptyBox()
+{
+	BoundingBox box;
+	box.minimum = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	box.maximum = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	return box;
+}
+
+static inline void GrowBox(BoundingBox& box, const XMFLOAT3& minimum, const XMFLOAT3& maximum)
+{
+	box.minimum.x = std::min(box.minimum.x, minimum.x);
+	box.minimum.y = std::min(box.minimum.y, minimum.y);
+	box.minimum.z = std::min(box.minimum.z, minimum.z);
+	box.maximum.x = std::max(box.maximum.x, maximum.x);
+	box.maximum.y = std::max(box.maximum.y, maximum.y);
+	box.maximum.z = std::max(box.maximum.z, maximum.z);
+}
+
+static inline float SurfaceArea(const XMFLOAT3& minimum, const XMFLOAT3& maximum)
+{
+	const float dx = maximum.x - minimum.x;
+	const float dy = maximum.y - minimum.y;
+	const float dz = maximum.z - minimum.z;
+	if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+	{
+		return 0.0f;
+	}
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+// スラブ法でレイとノードの箱の交差を求め、[0, maxDistance] で交わるなら入る位置を entry に返します。
+static inline bool IntersectBox(
+	const BvhNode& node,
+	const XMFLOAT3& origin,
+	const XMFLOAT3& inverseDirection,
+	float maxDistance,
+	float& entry
+	)
+{
+	const float tx1 = (node.minimum.x - origin.x) * inverseDirection.x;
+	const float tx2 = (node.maximum.x - origin.x) * inverseDirection.x;
+	float tmin = std::min(tx1, tx2);
+	float tmax = std::max(tx1, tx2);
+
+	const float ty1 = (node.minimum.y - origin.y) * inverseDirection.y;
+	const float ty2 = (node.maximum.y - origin.y) * inverseDirection.y;
+	tmin = std::max(tmin, std::min(ty1, ty2));
+	tmax = std::min(tmax, std::max(ty1, ty2));
+
+	const float tz1 = (node.minimum.z - origin.z) * inverseDirection.z;
+	const float tz2 = (node.maximum.z - origin.z) * inverseDirection.z;
+	tmin = std::max(tmin, std::min(tz1, tz2));
+	tmax = std::min(tmax, std::max(tz1, tz2));
+
+	tmin = std::max(tmin, 0.0f);
+	entry = tmin;
+	return tmin <= tmax && tmin <= maxDistance;
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<BoundingBox>& primitiveBounds, JobSystem* jobSystem)
+{
+	const uint32_t primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+	m_nodes.clear();
+	m_primitiveIndices.resize(primitiveCount);
+	if (primitiveCount == 0)
+	{
+		return;
+	}
+
+	std::vector<XMFLOAT3> centroids(primitiveCount);
+	for (uint32_t i = 0; i < primitiveCount; ++i)
+	{
+		const BoundingBox& box = primitiveBounds[i];
+		centroids[i] = XMFLOAT3(
+			(box.minimum.x + box.maximum.x) * 0.5f,
+			(box.minimum.y + box.maximum.y) * 0.5f,
+			(box.minimum.z + box.maximum.z) * 0.5f
+			);
+		m_primitiveIndices[i] = i;
+	}
+
+	// ノードの数は葉の数の 2 倍未満です。
+	m_nodes.reserve(2 * primitiveCount);
+	m_nodes.resize(1);
+
+	BuildRange root;
+	root.node = 0;
+	root.first = 0;
+	root.count = primitiveCount;
+
+	const uint32_t threadCount = jobSystem != nullptr ? jobSystem->GetThreadCount() : 1;
+	if (threadCount <= 1 || primitiveCount < 2 * MinParallelSubtreeSize)
+	{
+		BuildNodes(m_nodes, &m_primitiveIndices[0], primitiveBounds, centroids, root, 0, nullptr);
+		return;
+	}
+
+	// 上の階層を分割して、各スレッドに数個ずつ行き渡る数の部分木を残します。
+	// 部分木は基本図形の添字の互いに重ならない範囲を並べ替えるので、並列に構築できます。
+	const uint32_t deferThreshold = std::max(primitiveCount / (threadCount * 4), MinParallelSubtreeSize);
+	std::vector<BuildRange> deferredRanges;
+	BuildNodes(m_nodes, &m_primitiveIndices[0], primitiveBounds, centroids, root, deferThreshold, &deferredRanges);
+
+	std::vector<std::vector<BvhNode>> subtrees(deferredRanges.size());
+	jobSystem->ParallelFor(static_cast<uint32_t>(deferredRanges.size()), 1, [&] (uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			BuildRange subtreeRoot = deferredRanges[i];
+			subtreeRoot.node = 0;
+			subtrees[i].reserve(2 * subtreeRoot.count);
+			subtrees[i].resize(1);
+			BuildNodes(subtrees[i], &m_primitiveIndices[0], primitiveBounds, centroids, subtreeRoot, 0, nullptr);
+		}
+	});
+
+	// 部分木の根を予約しておいたノードに置き、残りを末尾に追加して子の位置を付け替えます。
+	for (size_t i = 0; i < subtrees.size(); ++i)
+	{
+		const std::vector<BvhNode>& subtree = subtrees[i];
+		const uint32_t base = static_cast<uint32_t>(m_nodes.size()) - 1;
+		for (size_t j = 0; j < subtree.size(); ++j)
+		{
+			BvhNode node = subtree[j];
+			if (node.count == 0)
+			{
+				node.leftFirst += base;
+			}
+
+			if (j == 0)
+			{
+				m_nodes[deferredRanges[i].node] = node;
+			}
+			else
+			{
+				m_nodes.push_back(node);
+			}
+		}
+	}
+}
+
+/**
+ * root の範囲の基本図形から nodes に部分木を作ります。root.node のノードは確保済みでなければなりません。
+ * deferredRanges が nullptr でなければ、基本図形が deferThreshold 以下の範囲は分割せずに
+ * deferredRanges に追加し、そのノードは後で部分木の根に置き換えます。
+ */
+void BoundingVolumeHierarchy::BuildNodes(
+	std::vector<BvhNode>& nodes,
+	uint32_t* primitiveIndices,
+	const std::vector<BoundingBox>& primitiveBounds,
+	const std::vector<XMFLOAT3>& centroids,
+	const BuildRange& root,
+	uint32_t deferThreshold,
+	std::vector<BuildRange>* deferredRanges
+	)
+{
+	std::vector<BuildRange> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const BuildRange range = stack.back();
+		stack.pop_back();
+
+		if (deferredRanges != nullptr && range.count <= deferThreshold)
+		{
+			deferredRanges->push_back(range);
+			continue;
+		}
+
+		BoundingBox bounds = EmptyBox();
+		BoundingBox centroidBounds = EmptyBox();
+		for (uint32_t i = range.first; i < range.first + range.count; ++i)
+		{
+			const uint32_t primitive = primitiveIndices[i];
+			GrowBox(bounds, primitiveBounds[primitive].minimum, primitiveBounds[primitive].maximum);
+			GrowBox(centroidBounds, centroids[primitive], centroids[primitive]);
+		}
+		nodes[range.node].minimum = bounds.minimum;
+		nodes[range.node].maximum = bounds.maximum;
+
+		if (range.count <= MaxLeafSize)
+		{
+			nodes[range.node].leftFirst = range.first;
+			nodes[range.node].count = range.count;
+			continue;
+		}
+
+		// 各軸で重心をビンに振り分け、左右の (表面積 × 個数) の和が最小になる境界を探します。
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float axisMinimum = GetComponent(centroidBounds.minimum, axis);
+			const float extent = GetComponent(centroidBounds.maximum, axis) - axisMinimum;
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+
+			const float binScale = BinCount / extent;
+			BoundingBox binBounds[BinCount];
+			uint32_t binCounts[BinCount] = {};
+			for (int b = 0; b < BinCount; ++b)
+			{
+				binBounds[b] = EmptyBox();
+			}
+			for (uint32_t i = range.first; i < range.first + range.count; ++i)
+			{
+				const uint32_t primitive = primitiveIndices[i];
+				const int bin = std::min(static_cast<int>((GetComponent(centroids[primitive], axis) - axisMinimum) * binScale), BinCount - 1);
+				++binCounts[bin];
+				GrowBox(binBounds[bin], primitiveBounds[primitive].minimum, primitiveBounds[primitive].maximum);
+			}
+
+			// 左から累積した値を覚えておき、右から累積しながら各境界のコストを求めます。
+			float leftCosts[BinCount - 1];
+			BoundingBox leftBounds = EmptyBox();
+			uint32_t leftCount = 0;
+			for (int b = 0; b < BinCount - 1; ++b)
+			{
+				GrowBox(leftBounds, binBounds[b].minimum, binBounds[b].maximum);
+				leftCount += binCounts[b];
+				leftCosts[b] = SurfaceArea(leftBounds.minimum, leftBounds.maximum) * leftCount;
+			}
+
+			BoundingBox rightBounds = EmptyBox();
+			uint32_t rightCount = 0;
+			for (int b = BinCount - 1; b > 0; --b)
+			{
+				GrowBox(rightBounds, binBounds[b].minimum, binBounds[b].maximum);
+				rightCount += binCounts[b];
+				const float cost = leftCosts[b - 1] + SurfaceArea(rightBounds.minimum, rightBounds.maximum) * rightCount;
+				if (rightCount < range.count && rightCount > 0 && cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+
+		uint32_t middle = range.first + range.count / 2;
+		if (bestAxis >= 0)
+		{
+			const float axisMinimum = GetComponent(centroidBounds.minimum, bestAxis);
+			const float binScale = BinCount / (GetComponent(centroidBounds.maximum, bestAxis) - axisMinimum);
+			uint32_t* split = std::partition(
+				primitiveIndices + range.first,
+				primitiveIndices + range.first + range.count,
+				[&] (uint32_t primitive) {
+					const int bin = std::min(static_cast<int>((GetComponent(centroids[primitive], bestAxis) - axisMinimum) * binScale), BinCount - 1);
+					return bin < bestSplit;
+				});
+			const uint32_t splitIndex = static_cast<uint32_t>(split - primitiveIndices);
+			if (splitIndex > range.first && splitIndex < range.first + range.count)
+			{
+				middle = splitIndex;
+			}
+		}
+		// 重心がすべて重なっているときは、並びの中央で分けます。
+
+		const uint32_t left = static_cast<uint32_t>(nodes.size());
+		nodes.resize(left + 2);
+		nodes[range.node].leftFirst = left;
+		nodes[range.node].count = 0;
+
+		BuildRange leftRange;
+		leftRange.node = left;
+		leftRange.first = range.first;
+		leftRange.count = middle - range.first;
+
+		BuildRange rightRange;
+		rightRange.node = left + 1;
+		rightRange.first = middle;
+		rightRange.count = range.first + range.count - middle;
+
+		// 左の部分木を先に作り、ノードを深さ優先に近い順に並べます。
+		stack.push_back(rightRange);
+		stack.push_back(leftRange);
+	}
+}
+
+void BoundingVolumeHierarchy::Refit(const std::vector<BoundingBox>& primitiveBounds)
+{
+	// 子は親より後ろにあるので、後ろから順に更新すれば子の境界は更新済みです。
+	for (size_t n = m_nodes.size(); n-- > 0;)
+	{
+		BvhNode& node = m_nodes[n];
+		BoundingBox bounds = EmptyBox();
+		if (node.count > 0)
+		{
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+			{
+				const BoundingBox& box = primitiveBounds[m_primitiveIndices[i]];
+				GrowBox(bounds, box.minimum, box.maximum);
+			}
+		}
+		else
+		{
+			GrowBox(bounds, m_nodes[node.leftFirst].minimum, m_nodes[node.leftFirst].maximum);
+			GrowBox(bounds, m_nodes[node.leftFirst + 1].minimum, m_nodes[node.leftFirst + 1].maximum);
+		}
+		node.minimum = bounds.minimum;
+		node.maximum = bounds.maximum;
+	}
+}
+
+void BoundingVolumeHierarchy::Raycast(const PickRay& ray, float& maxDistance, const RayLeafFunction& function) const
+{
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	const XMFLOAT3 inverseDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+	struct StackEntry
+	{
+		uint32_t node;
+		float entry;
+	};
+	std::vector<StackEntry> stack;
+	stack.reserve(64);
+
+	StackEntry rootEntry;
+	rootEntry.node = 0;
+	if (!IntersectBox(m_nodes[0], ray.origin, inverseDirection, maxDistance, rootEntry.entry))
+	{
+		return;
+	}
+	stack.push_back(rootEntry);
+
+	while (!stack.empty())
+	{
+		const StackEntry current = stack.back();
+		stack.pop_back();
+
+		// 積んだ後に、より近い交差が見つかっているかもしれません。
+		if (current.entry > maxDistance)
+		{
+			continue;
+		}
+
+		const BvhNode& node = m_nodes[current.node];
+		if (node.count > 0)
+		{
+			function(&m_primitiveIndices[node.leftFirst], node.count, maxDistance);
+			continue;
+		}
+
+		StackEntry children[2];
+		children[0].node = node.leftFirst;
+		children[1].node = node.leftFirst + 1;
+		const bool hit0 = IntersectBox(m_nodes[children[0].node], ray.origin, inverseDirection, maxDistance, children[0].entry);
+		const bool hit1 = IntersectBox(m_nodes[children[1].node], ray.origin, inverseDirection, maxDistance, children[1].entry);
+
+		// 近い方の子を後に積み、先に訪れます。
+		if (hit0 && hit1)
+		{
+			const int nearChild = children[0].entry <= children[1].entry ? 0 : 1;
+			stack.push_back(children[1 - nearChild]);
+			stack.push_back(children[nearChild]);
+		}
+		else if (hit0)
+		{
+			stack.push_back(children[0]);
+		}
+		else if (hit1)
+		{
+			stack.push_back(children[1]);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::CullFrustum(const Frustum& frustum, const FrustumLeafFunction& function) const
+{
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	// planeMask は、まだ判定が必要な平面のビットです。箱が平面の内側にあれば、子孫ではその平面を判定しません。
+	struct StackEntry
+	{
+		uint32_t node;
+		uint32_t planeMask;
+	};
+	std::vector<StackEntry> stack;
+	stack.reserve(64);
+
+	StackEntry rootEntry;
+	rootEntry.node = 0;
+	rootEntry.planeMask = (1u << Frustum::PlaneCount) - 1;
+	stack.push_back(rootEntry);
+
+	while (!stack.empty())
+	{
+		StackEntry current = stack.back();
+		stack.pop_back();
+
+		const BvhNode& node = m_nodes[current.node];
+		if (current.planeMask != 0)
+		{
+			const XMFLOAT3 center(
+				(node.minimum.x + node.maximum.x) * 0.5f,
+				(node.minimum.y + node.maximum.y) * 0.5f,
+				(node.minimum.z + node.maximum.z) * 0.5f
+				);
+			const XMFLOAT3 extents(
+				(node.maximum.x - node.minimum.x) * 0.5f,
+				(node.maximum.y - node.minimum.y) * 0.5f,
+				(node.maximum.z - node.minimum.z) * 0.5f
+				);
+
+			bool outside = false;
+			for (int p = 0; p < Frustum::PlaneCount && !outside; ++p)
+			{
+				if ((current.planeMask & (1u << p)) == 0)
+				{
+					continue;
+				}
+
+				const XMFLOAT4& plane = frustum.planes[p];
+				const float distance = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+				const float radius = extents.x * std::fabs(plane.x) + extents.y * std::fabs(plane.y) + extents.z * std::fabs(plane.z);
+				if (distance + radius < 0.0f)
+				{
+					outside = true;
+				}
+				else if (distance - radius >= 0.0f)
+				{
+					current.planeMask &= ~(1u << p);
+				}
+			}
+
+			if (outside)
+			{
+				continue;
+			}
+		}
+
+		if (node.count > 0)
+		{
+			function(&m_primitiveIndices[node.leftFirst], node.count, current.planeMask == 0);
+			continue;
+		}
+
+		StackEntry child;
+		child.planeMask = current.planeMask;
+		child.node = node.leftFirst + 1;
+		stack.push_back(child);
+		child.node = node.leftFirst;
+		stack.push_back(child);
+	}
+}
+
+float BoundingVolumeHierarchy::ComputeSahCost() const
+{
+	if (m_nodes.empty())
+	{
+		return 0.0f;
+	}
+
+	const float rootArea = SurfaceArea(m_nodes[0].minimum, m_nodes[0].maximum);
+	if (rootArea <= 0.0f)
+	{
+		return static_cast<float>(m_primitiveIndices.size());
+	}
+
+	// 内部ノードは箱の判定 1 回、葉は基本図形の数だけの判定がかかるものとします。
+	float cost = 0.0f;
+	for (const BvhNode& node : m_nodes)
+	{
+		const float probability = SurfaceArea(node.minimum, node.maximum) / rootArea;
+		cost += probability * (node.count > 0 ? static_cast<float>(node.count) : 1.0f);
+	}
+	return cost;
+}
+
+void TriangleMeshBvh::Build(const MeshData& mesh, JobSystem* jobSystem)
+{
+	const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+	m_positions.resize(triangleCount * 3);
+
+	std::vector<BoundingBox> triangleBounds(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		BoundingBox box = EmptyBox();
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			const XMFLOAT3& position = mesh.vertices[mesh.indices[3 * t + k]].pos;
+			m_positions[3 * t + k] = position;
+			GrowBox(box, position, position);
+		}
+		triangleBounds[t] = box;
+	}
+
+	m_hierarchy.Build(triangleBounds, jobSystem);
+}
+
+bool TriangleMeshBvh::Raycast(const PickRay& ray, float& distance, uint32_t& triangle) const
+{
+	bool found = false;
+	float nearest = distance;
+	m_hierarchy.Raycast(ray, nearest, [&] (const uint32_t* primitives, uint32_t count, float& maxDistance) {
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			// Möller-Trumbore 法。
+			const uint32_t t = primitives[i];
+			const XMFLOAT3& v0 = m_positions[3 * t];
+			const XMFLOAT3 edge1 = Subtract(m_positions[3 * t + 1], v0);
+			const XMFLOAT3 edge2 = Subtract(m_positions[3 * t + 2], v0);
+
+			const XMFLOAT3 p = Cross(ray.direction, edge2);
+			const float determinant = Dot(edge1, p);
+			if (determinant == 0.0f)
+			{
+				continue;
+			}
+			const float inverseDeterminant = 1.0f / determinant;
+
+			const XMFLOAT3 s = Subtract(ray.origin, v0);
+			const float u = Dot(s, p) * inverseDeterminant;
+			if (u < 0.0f || u > 1.0f)
+			{
+				continue;
+			}
+
+			const XMFLOAT3 q = Cross(s, edge1);
+			const float v = Dot(ray.direction, q) * inverseDeterminant;
+			if (v < 0.0f || u + v > 1.0f)
+			{
+				continue;
+			}
+
+			const float hitDistance = Dot(edge2, q) * inverseDeterminant;
+			if (hitDistance >= 0.0f && hitDistance <= maxDistance)
+			{
+				maxDistance = hitDistance;
+				triangle = t;
+				found = true;
+			}
+		}
+	});
+
+	if (found)
+	{
+		distance = nearest;
+	}
+	return found;
+}
@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "RenderDevice.h"
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+// 軸に平行な境界ボックス。
+struct BoundingBox
+{
+	DirectX::XMFLOAT3 minimum;
+	DirectX::XMFLOAT3 maximum;
+};
+
+// 平坦化した BVH のノード (32 バイト)。2 つで 1 本のキャッシュ ラインに収まります。
+// count が 0 なら内部ノードで、2 つの子は leftFirst と leftFirst + 1 に並んでいます。
+// count が 0 以外なら葉で、基本図形の添字の並びの [leftFirst, leftFirst + count) を持ちます。
+// 子は常に親より後ろに置かれます。
+struct BvhNode
+{
+	DirectX::XMFLOAT3 minimum;
+	uint32_t leftFirst;
+	DirectX::XMFLOAT3 maximum;
+	uint32_t count;
+};
+
+// origin + t * direction (t >= 0) のレイ。direction は正規化しなくてもかまいません。
+struct PickRay
+{
+	DirectX::XMFLOAT3 origin;
+	DirectX::XMFLOAT3 direction;
+};
+
+/**
+ * 境界ボックスの集合に対する BVH。
+ * ビン分割の SAH (表面積ヒューリスティック) で構築し、ノードは深さ優先に近い順の 1 つの配列に並べます。
+ * 基本図形が動いたときは Refit で境界だけを更新し、木の形は変えません。
+ * 基本図形そのものとの交差判定は呼び出し側が葉ごとに行います。
+ */
+class BoundingVolumeHierarchy
+{
+public:
+	// 葉の基本図形を受け取る関数。レイの判定では maxDistance を縮めると、それより遠いノードを訪れません。
+	typedef std::function<void(const uint32_t* primitives, uint32_t count, float& maxDistance)> RayLeafFunction;
+
+	// 視錐台と交わる葉の基本図形を受け取る関数。fullyInside なら基本図形の判定は不要です。
+	typedef std::function<void(const uint32_t* primitives, uint32_t count, bool fullyInside)> FrustumLeafFunction;
+
+	// 葉に置く基本図形の数の上限。
+	static const uint32_t MaxLeafSize = 4;
+
+	BoundingVolumeHierarchy();
+
+	// primitiveBounds の基本図形から木を作り直します。
+	// jobSystem を指定すると、上の階層を分割したあとの部分木を並列に構築します。
+	void Build(const std::vector<BoundingBox>& primitiveBounds, JobSystem* jobSystem);
+
+	// 木の形を保ったまま、ノードの境界を primitiveBounds に合わせて更新します。
+	// 基本図形の数は Build のときと同じでなければなりません。
+	void Refit(const std::vector<BoundingBox>& primitiveBounds);
+
+	// ray の [0, maxDistance] と交わる葉を近い順に function に渡します。
+	void Raycast(const PickRay& ray, float& maxDistance, const RayLeafFunction& function) const;
+
+	// frustum と交わる葉を function に渡します。完全に内側にある部分木は、平面との判定を省きます。
+	void CullFrustum(const Frustum& frustum, const FrustumLeafFunction& function) const;
+
+	// 木の SAH コスト (根の表面積を 1 としたときの、レイ 1 本あたりの期待される判定の回数)。
+	// Refit を繰り返して木の質が落ちたかどうかを、Build の直後の値と比べて判断できます。
+	float ComputeSahCost() const;
+
+	bool IsEmpty() const { return m_nodes.empty(); }
+	const std::vector<BvhNode>& GetNodes() const { return m_nodes; }
+	const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_primitiveIndices; }
+
+private:
+	struct BuildRange
+	{
+		uint32_t node;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	static void BuildNodes(
+		std::vector<BvhNode>& nodes,
+		uint32_t* primitiveIndices,
+		const std::vector<BoundingBox>& primitiveBounds,
+		const std::vector<DirectX::XMFLOAT3>& centroids,
+		const BuildRange& root,
+		uint32_t deferThreshold,
+		std::vector<BuildRange>* deferredRanges
+		);
+
+	std::vector<BvhNode> m_nodes;
+	std::vector<uint32_t> m_primitiveIndices;
+};
+
+// メッシュの三角形に対する BVH。ローカル空間のレイと三角形の交差を求めます。
+class TriangleMeshBvh
+{
+public:
+	void Build(const MeshData& mesh, JobSystem* jobSystem);
+
+	// ray の [0, distance] で最も近い三角形を探します。見つかれば distance と triangle を書き換えて true を返します。
+	// 両面を描画するので、三角形の向きは問いません。
+	bool Raycast(const PickRay& ray, float& distance, uint32_t& triangle) const;
+
+	uint32_t GetTriangleCount() const { return static_cast<uint32_t>(m_positions.size() / 3); }
+	const BoundingVolumeHierarchy& GetHierarchy() const { return m_hierarchy; }
+
+private:
+	BoundingVolumeHierarchy m_hierarchy;
+	std::vector<DirectX::XMFLOAT3> m_positions;	// 三角形 i の頂点は 3 * i から 3 つ
+};
@@ -0,0 +1,64 @@
+// Constant buffers are split by how often they change.
+cbuffer ProjectionConstantBuffer : register(b0)
+{
+	matrix projection;
+};
+
+cbuffer ViewConstantBuffer : register(b1)
+{
+	matrix view;
+};
+
+// Dequantization of the SNORM16 positions of the current mesh.
+cbuffer PositionQuantizationConstantBuffer : register(b3)
+{
+	float4 positionScale;
+	float4 positionOffset;
+};
+
+struct VertexShaderInput
+{
+	float4 pos : POSITION;		// R16G16B16A16_SNORM
+	float4 color : COLOR0;		// R8G8B8A8_UNORM
+
+	// Per-instance data. The rows of the model matrix are stored untransposed.
+	float4 instanceModel0 : INSTANCE_MODEL0;
+	float4 instanceModel1 : INSTANCE_MODEL1;
+	float4 instanceModel2 : INSTANCE_MODEL2;
+	float4 instanceModel3 : INSTANCE_MODEL3;
+	float4 instanceColor : INSTANCE_COLOR;
+};
+
+struct VertexShaderOutput
+{
+	float4 pos : SV_POSITION;
+	float3 color : COLOR0;
+	float fade : FADE;	// LOD cross-fade value, see DitherFadePixelShader.hlsl
+};
+
+VertexShaderOutput main(VertexShaderInput input)
+{
+	VertexShaderOutput output;
+	float4 pos = float4(input.pos.xyz * positionScale.xyz + positionOffset.xyz, 1.0f);
+
+	// The per-instance matrix takes the place of the model constant buffer.
+	float4x4 instanceModel = float4x4(
+		input.instanceModel0,
+		input.instanceModel1,
+		input.instanceModel2,
+		input.instanceModel3);
+
+	// Transform the vertex position into projected space.
+	pos = mul(pos, instanceModel);
+	pos = mul(pos, view);
+	pos = mul(pos, projection);
+	output.pos = pos;
+
+	// Tint the vertex color with the instance color.
+	output.color = input.color.rgb * input.instanceColor.rgb;
+
+	// The instance alpha carries the LOD cross-fade value.
+	output.fade = input.instanceColor.a;
+
+	return output;
+}
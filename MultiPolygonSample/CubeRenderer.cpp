@@ -6,143 +6,58 @@ using namespace Microsoft::WRL;
 using namespace Windows::Foundation;
 using namespace Windows::UI::Core;
 
+// ファイルの読み取りは主に I/O を待つので、コアの数によらず少数のスレッドで行います。
+static const uint32_t MeshLoaderThreadCount = 2;
+
+// フレームの作業領域の初めの大きさ。足りなければ、あふれたフレームの使用量に合わせて広げます。
+static const size_t FrameArenaCapacity = 256 * 1024;
+
+// Direct3DBase のスワップ チェーンのバッファーの数。描き直す範囲は、この数のフレームの変更を合わせたものです。
+static const uint32_t SwapChainBufferCount = 2;
+
+// 1 回の ProcessLoadedMeshes でデバイスに作成するメッシュの数。
+// 大量のメッシュを読み込むときも、1 フレームにかかる時間をこの数で抑えます。
+static const uint32_t MaxMeshUploadsPerFrame = 16;
+
 CubeRenderer::CubeRenderer() :
 	m_loadingComplete(false),
-	m_indexCount(0)
+	m_twoSidedMode(TwoSidedMode::SinglePass),
+	m_dirtyRects(SwapChainBufferCount),
+	m_profiler(nullptr)
 {
+	// シーンの更新は、このスレッドとほかのすべてのコアで分担します。
+	m_jobSystem.reset(new JobSystem(JobSystem::GetDefaultWorkerCount()));
+	m_scene.SetJobSystem(m_jobSystem.get());
+	m_scene.SetDirtyRectTracker(&m_dirtyRects);
+	m_frameArena.reset(new FrameArena(FrameArenaCapacity));
+
+	m_meshLoader.reset(new MeshLoader(MeshLoaderThreadCount));
+
+	// 使ったパイプライン ステートのキーをローカル フォルダーに保存し、次の起動で先に作成します。
+	Platform::String^ pipelineCachePath = Windows::Storage::ApplicationData::Current->LocalFolder->Path + "\\PipelineStates.bin";
+	m_pipelineCache.reset(new D3D11PipelineStateCache(PathString(pipelineCachePath->Data(), pipelineCachePath->Length())));
 }
 
 void CubeRenderer::CreateDeviceResources()
 {
 	Direct3DBase::CreateDeviceResources();
 
-	auto loadVSTask = DX::ReadDataAsync("SimpleVertexShader.cso");
-	auto loadPSTask = DX::ReadDataAsync("SimplePixelShader.cso");
+	// デバイスが再作成された場合は、前のデバイスのリソースごと作り直します。
+	m_loadingComplete = false;
+	m_dirtyRects.Invalidate();
+	m_pipelineCache->SetDevice(m_d3dDevice, m_jobSystem.get());
+	m_renderDevice.reset(new D3D11RenderDevice(m_d3dDevice, m_d3dContext, m_featureLevel, *m_pipelineCache));
+	m_renderDevice->SetJobSystem(m_jobSystem.get());
+	m_renderDevice->SetRecordingPartitionCount(m_jobSystem->GetThreadCount());
+	m_renderDevice->SetFrameArena(m_frameArena.get());
+	m_gpuProfiler.reset(m_profiler != nullptr ? new D3D11GpuProfiler(m_d3dDevice, m_d3dContext, *m_profiler) : nullptr);
 
-	auto createVSTask = loadVSTask.then([this](Platform::Array<byte>^ fileData) {
-		DX::ThrowIfFailed(
-			m_d3dDevice->CreateVertexShader(
- 				fileData->Data,
-				fileData->Length,
-				nullptr,
-				&m_vertexShader
-				)
-			);
+	auto createPipelineTask = m_renderDevice->CreateDeviceResourcesAsync();
 
-		const D3D11_INPUT_ELEMENT_DESC vertexDesc[] = 
-		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "COLOR",    0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		};
-
-		DX::ThrowIfFailed(
-			m_d3dDevice->CreateInputLayout(
-				vertexDesc,
-				ARRAYSIZE(vertexDesc),
-				fileData->Data,
-				fileData->Length,
-				&m_inputLayout
-				)
-			);
-	});
-
-	auto createPSTask = loadPSTask.then([this](Platform::Array<byte>^ fileData) {
-		DX::ThrowIfFailed(
-			m_d3dDevice->CreatePixelShader(
-				fileData->Data,
-				fileData->Length,
-				nullptr,
-				&m_pixelShader
-				)
-			);
-
-		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-		DX::ThrowIfFailed(
-			m_d3dDevice->CreateBuffer(
-				&constantBufferDesc,
-				nullptr,
-				&m_constantBuffer
-				)
-			);
-	});
+	// シーンのポリゴンを描画するためのバッファーを用意
+	m_scene.CreateDeviceResources(*m_renderDevice);
 
-	// 2つのポリゴンを描画するためのVertexBufferを用意
-	auto createCubeTask = (createPSTask && createVSTask).then([this] () {
-		VertexPositionColor cubeVertices[] = 
-		{
-			{XMFLOAT3(0.5f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)},
-			{XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)},
-			{XMFLOAT3(0.0f, 0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)},
-		};
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = {0};
-		vertexBufferData.pSysMem = cubeVertices;
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(cubeVertices), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(
-			m_d3dDevice->CreateBuffer(
-				&vertexBufferDesc,
-				&vertexBufferData,
-				&m_vertexBuffer
-				)
-			);
-
-		VertexPositionColor cubeVertices2[] = 
-		{
-			{XMFLOAT3(-1.0f, 0.0f, 0.0f), XMFLOAT3(0.6f, 1.0f, 1.0f)},
-			{XMFLOAT3(0.0f, -0.0f, 0.0f), XMFLOAT3(0.6f, 1.0f, 1.0f)},
-			{XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(0.6f, 1.0f, 1.0f)},
-		};
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData2 = {0};
-		vertexBufferData2.pSysMem = cubeVertices2;
-		vertexBufferData2.SysMemPitch = 0;
-		vertexBufferData2.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc2(sizeof(cubeVertices2), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(
-			m_d3dDevice->CreateBuffer(
-				&vertexBufferDesc2,
-				&vertexBufferData2,
-				&m_vertexBuffer2
-				)
-			);
-
-
-		unsigned short cubeIndices[] = 
-		{
-			0,1,2
-		};
-
-		m_indexCount = ARRAYSIZE(cubeIndices);
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = {0};
-		indexBufferData.pSysMem = cubeIndices;
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(cubeIndices), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(
-			m_d3dDevice->CreateBuffer(
-				&indexBufferDesc,
-				&indexBufferData,
-				&m_indexBuffer
-				)
-			);
-
-		D3D11_RASTERIZER_DESC rdc;
-		ZeroMemory(&rdc, sizeof(rdc));
-
-		rdc.FillMode = D3D11_FILL_SOLID;
-		rdc.CullMode = D3D11_CULL_FRONT;
-		rdc.FrontCounterClockwise = true;
-
-		m_d3dDevice->CreateRasterizerState(&rdc, &m_pRasterizerState);
-
-	    rdc.CullMode = D3D11_CULL_BACK;
-		m_d3dDevice->CreateRasterizerState(&rdc, &m_pRasterizerStateBack);
-	});
-
-	createCubeTask.then([this] () {
+	createPipelineTask.then([this] () {
 		m_loadingComplete = true;
 	});
 }
@@ -152,140 +67,260 @@ void CubeRenderer::CreateWindowSizeDependentResources()
 	Direct3DBase::CreateWindowSizeDependentResources();
 
 	float aspectRatio = m_windowBounds.Width / m_windowBounds.Height;
-	float fovAngleY = 70.0f * XM_PI / 180.0f;
 
-	// m_orientationTransform3D マトリックスは、ここで事後乗算されます。
-	// それにより、シーンの方向を表示方向と正しく一致させます。
+	// m_orientationTransform3D マトリックスは、射影行列に事後乗算されます。
 	// この事後乗算ステップは、スワップ チェーンのターゲット ビットマップに対して行われるすべての
 	// 描画呼び出しで実行する必要があります。他のターゲットに対する呼び出しでは、
 	// 適用する必要はありません。
-	XMStoreFloat4x4(
-		&m_constantBufferData.projection,
-		XMMatrixTranspose(
-			XMMatrixMultiply(
-				XMMatrixPerspectiveFovRH(
-					fovAngleY,
-					aspectRatio,
-					0.01f,
-					100.0f
-					),
-				XMLoadFloat4x4(&m_orientationTransform3D)
-				)
-			)
-		);
+	m_scene.SetProjection(aspectRatio, m_orientationTransform3D);
+	m_dirtyRects.SetViewport(static_cast<uint32_t>(m_renderTargetSize.Width), static_cast<uint32_t>(m_renderTargetSize.Height));
+	UpdateLodSettings();
 }
 
 void CubeRenderer::Update(float timeTotal, float timeDelta)
 {
-	(void) timeDelta; // 未使用のパラメーター。
+	UpdateSnapshot(0, timeTotal, timeDelta);
+}
 
-	XMVECTOR eye = XMVectorSet(0.0f, 0.7f, 1.5f, 0.0f);
-	XMVECTOR at = XMVectorSet(0.0f, -0.1f, 0.0f, 0.0f);
-	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+void CubeRenderer::Render()
+{
+	RenderSnapshot(0);
+}
 
-	XMStoreFloat4x4(&m_constantBufferData.view, XMMatrixTranspose(XMMatrixLookAtRH(eye, at, up)));
-	XMStoreFloat4x4(&m_constantBufferData.model, XMMatrixTranspose(XMMatrixRotationY(timeTotal * XM_PIDIV4)));
+void CubeRenderer::Present()
+{
+	PresentDirtyRects(m_presentRects.empty() ? nullptr : &m_presentRects[0], static_cast<UINT>(m_presentRects.size()));
+	m_frameArena->Reset();
 }
 
-void CubeRenderer::Render()
+void CubeRenderer::UpdateSnapshot(uint32_t slot, float timeTotal, float timeDelta)
 {
-	const float midnightBlue[] = { 0.098f, 0.098f, 0.439f, 1.000f };
-	m_d3dContext->ClearRenderTargetView(
-		m_renderTargetView.Get(),
-		midnightBlue
-		);
+	m_scene.Update(timeTotal, timeDelta);
+	m_scene.CaptureSnapshot(m_snapshots[slot]);
+}
 
-	m_d3dContext->ClearDepthStencilView(
-		m_depthStencilView.Get(),
-		D3D11_CLEAR_DEPTH,
-		1.0f,
-		0
-		);
+void CubeRenderer::RenderSnapshot(uint32_t slot)
+{
+	if (m_gpuProfiler != nullptr)
+	{
+		m_gpuProfiler->BeginFrame();
+	}
+
+	m_renderDevice->SetRenderTargets(m_renderTargetView.Get(), m_depthStencilView.Get());
+
+	const float midnightBlue[] = { 0.098f, 0.098f, 0.439f, 1.000f };
 
 	// キューブを読み込み時に 1 度だけ描画します (読み込みは非同期です)。
+	// 読み込みが終わった最初のフレームは全体を描き直します。
 	if (!m_loadingComplete)
 	{
+		m_renderDevice->SetScissorRect(nullptr);
+		m_renderDevice->Clear(midnightBlue);
+		m_dirtyRects.Invalidate();
+		m_presentRects.clear();
+		if (m_gpuProfiler != nullptr)
+		{
+			m_gpuProfiler->EndFrame();
+		}
 		return;
 	}
 
-	m_d3dContext->OMSetRenderTargets(
-		1,
-		m_renderTargetView.GetAddressOf(),
-		m_depthStencilView.Get()
-		);
+	// 各オブジェクトをキューに積み、まとめて描画します。
+	// オブジェクトが増えても API 呼び出しの数は変わりません。
+	m_commandList.Reset();
+	m_scene.Record(m_snapshots[slot], m_drawQueue, m_twoSidedMode);
+	m_drawQueue.Flush(m_commandList);
 
-	m_d3dContext->UpdateSubresource(
-		m_constantBuffer.Get(),
-		0,
-		NULL,
-		&m_constantBufferData,
-		0,
-		0
-		);
+	m_renderDevice->SetConstants(m_scene.GetConstants(m_snapshots[slot]));
+	if (m_gpuProfiler != nullptr)
+	{
+		m_gpuProfiler->BeginZone("GPU Execute");
+	}
 
-	// 複数オブジェクトの描画に対応するためにメソッド化
-	// さらに増やしたい場合はVertexBufferを配列に格納してぐるぐる回すと良さそう
-	this->RenderObject(m_vertexBuffer);
-	this->RenderObject(m_vertexBuffer2);
+	// 前のフレームから変わった矩形だけをクリアし、シザー矩形で書き込みを限ってコマンドを 1 回だけ実行します。
+	// 何も変わらなければ何も描画しません。
+	const ScreenRect& redrawRect = m_dirtyRects.GetRedrawRect();
+	if (!redrawRect.IsEmpty())
+	{
+		m_renderDevice->SetScissorRect(&redrawRect);
+		m_renderDevice->Clear(midnightBlue);
+		m_renderDevice->Execute(m_commandList);
+		m_renderDevice->SetScissorRect(nullptr);
+	}
+
+	if (m_gpuProfiler != nullptr)
+	{
+		m_gpuProfiler->EndZone();
+		m_gpuProfiler->EndFrame();
+	}
+	UpdatePresentRects();
 }
 
-/**
- * 複数のポリゴンの描画に対応するためにメソッド抽出
- */
-void CubeRenderer::RenderObject(Microsoft::WRL::ComPtr<ID3D11Buffer> m_vertexBuffer)
+// DXGI は矩形の数が 0 なら全体が変わったものとするので、何も変わらなかったフレームは 1 ピクセルだけを伝えます。
+// そのピクセルも表示中の内容と同じなので、表示は変わりません。
+void CubeRenderer::UpdatePresentRects()
 {
+	m_presentRects.clear();
+	if (m_dirtyRects.IsFullFrame())
+	{
+		return;
+	}
 
-	UINT stride = sizeof(VertexPositionColor);
-	UINT offset = 0;
-	m_d3dContext->IASetVertexBuffers(
-		0,
-		1,
-		m_vertexBuffer.GetAddressOf(),
-		&stride,
-		&offset
-		);
+	const std::vector<ScreenRect>& rects = m_dirtyRects.GetPresentRects();
+	for (const ScreenRect& rect : rects)
+	{
+		RECT dirtyRect = { rect.left, rect.top, rect.right, rect.bottom };
+		m_presentRects.push_back(dirtyRect);
+	}
+	if (m_presentRects.empty())
+	{
+		RECT unchangedRect = { 0, 0, 1, 1 };
+		m_presentRects.push_back(unchangedRect);
+	}
+}
 
-	m_d3dContext->IASetIndexBuffer(
-		m_indexBuffer.Get(),
-		DXGI_FORMAT_R16_UINT,
-		0
-		);
+void CubeRenderer::SetTwoSidedMode(TwoSidedMode mode)
+{
+	m_twoSidedMode = mode;
+	m_dirtyRects.Invalidate();
+	UpdateLodSettings();
+}
 
-	m_d3dContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+// 詳細度の誤差は、射影行列を掛けた後のレンダー ターゲットのピクセルで測ります。
+// フェードのディザは DitherFadePixelShader だけが行うので、それを使う 1 パスの両面表示のときだけフェードします。
+void CubeRenderer::UpdateLodSettings()
+{
+	LodSettings settings;
+	settings.viewportWidth = m_renderTargetSize.Width;
+	settings.viewportHeight = m_renderTargetSize.Height;
+	if (m_featureLevel < D3D_FEATURE_LEVEL_10_0 || m_twoSidedMode != TwoSidedMode::SinglePass)
+	{
+		settings.fadeDuration = 0.0f;
+	}
+	m_scene.SetLodSettings(settings);
+}
 
-	m_d3dContext->IASetInputLayout(m_inputLayout.Get());
+void CubeRenderer::SetProfiler(Profiler* profiler)
+{
+	m_profiler = profiler;
+}
 
-	m_d3dContext->VSSetShader(
-		m_vertexShader.Get(),
-		nullptr,
-		0
+const CullingStatistics& CubeRenderer::GetCullingStatistics() const
+{
+	return m_scene.GetCullingStatistics();
+}
+
+void CubeRenderer::SetCullingMode(SceneCullingMode mode)
+{
+	m_scene.SetCullingMode(mode);
+}
+
+const DirtyRectStats& CubeRenderer::GetDirtyRectStats() const
+{
+	return m_dirtyRects.GetStats();
+}
+
+// 直前のフレームで画面が変わっていれば、フリップ モデルの残りのバッファーもそろえるために、もう 1 フレーム描画します。
+bool CubeRenderer::IsSceneChanging() const
+{
+	if (!m_loadingComplete || m_meshLoader->GetPendingCount() > 0)
+	{
+		return true;
+	}
+	if (m_scene.IsAnimated() || m_scene.GetLodStatistics().fadingObjects > 0)
+	{
+		return true;
+	}
+	return m_dirtyRects.IsFullFrame() || !m_dirtyRects.GetPresentRects().empty();
+}
+
+// バック バッファーをステージング テクスチャにコピーして読み出します。
+// スワップ チェーンは B8G8R8A8_UNORM なので、Image と同じ並びのまま行ごとにコピーできます。
+void CubeRenderer::CaptureFrame(Image& image)
+{
+	ComPtr<ID3D11Texture2D> backBuffer;
+	DX::ThrowIfFailed(
+		m_swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), &backBuffer)
 		);
 
-	m_d3dContext->VSSetConstantBuffers(
-		0,
-		1,
-		m_constantBuffer.GetAddressOf()
+	D3D11_TEXTURE2D_DESC stagingDesc;
+	backBuffer->GetDesc(&stagingDesc);
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+	stagingDesc.BindFlags = 0;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingDesc.MiscFlags = 0;
+
+	ComPtr<ID3D11Texture2D> stagingTexture;
+	DX::ThrowIfFailed(
+		m_d3dDevice->CreateTexture2D(&stagingDesc, nullptr, &stagingTexture)
 		);
+	m_d3dContext->CopyResource(stagingTexture.Get(), backBuffer.Get());
 
-	m_d3dContext->PSSetShader(
-		m_pixelShader.Get(),
-		nullptr,
-		0
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(
+		m_d3dContext->Map(stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mapped)
 		);
 
-    m_d3dContext->RSSetState(m_pRasterizerState);
+	image.width = stagingDesc.Width;
+	image.height = stagingDesc.Height;
+	image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+	for (uint32_t y = 0; y < image.height; ++y)
+	{
+		const uint8_t* row = static_cast<const uint8_t*>(mapped.pData) + static_cast<size_t>(y) * mapped.RowPitch;
+		memcpy(&image.pixels[static_cast<size_t>(y) * image.width], row, image.width * sizeof(uint32_t));
+	}
+
+	m_d3dContext->Unmap(stagingTexture.Get(), 0);
+}
 
-	m_d3dContext->DrawIndexed(
-		m_indexCount,
-		0,
-		0
-		);
+PickResult CubeRenderer::SelectObjectAt(Windows::Foundation::Point position)
+{
+	// ウィンドウの座標を、表示方向で見た正規化座標 (y は上向き) に変換します。
+	const float x = 2.0f * position.X / m_windowBounds.Width - 1.0f;
+	const float y = 1.0f - 2.0f * position.Y / m_windowBounds.Height;
 
-    m_d3dContext->RSSetState(m_pRasterizerStateBack);
+	PickResult result = m_scene.Pick(x, y);
+	m_scene.SetHighlightedObject(result.object);
+	return result;
+}
 
-	m_d3dContext->DrawIndexed(
-		m_indexCount,
-		0,
-		0
-		);
+void CubeRenderer::LoadMeshAsync(Platform::String^ filename, const XMFLOAT4X4& transform, const XMFLOAT4& color)
+{
+	Platform::String^ path = Windows::ApplicationModel::Package::Current->InstalledLocation->Path + "\\" + filename;
+
+	MeshPlacement placement;
+	placement.transform = transform;
+	placement.color = color;
+
+	const uint32_t requestId = m_meshLoader->Enqueue(PathString(path->Data(), path->Length()));
+	m_meshPlacements.resize(requestId + 1);
+	m_meshPlacements[requestId] = placement;
+}
+
+uint32_t CubeRenderer::ProcessLoadedMeshes()
+{
+	if (m_renderDevice == nullptr)
+	{
+		return 0;
+	}
+
+	m_loadedMeshes.clear();
+	m_meshLoader->TakeCompleted(m_loadedMeshes, MaxMeshUploadsPerFrame);
+	uint32_t addedCount = 0;
+	for (MeshLoadResult& result : m_loadedMeshes)
+	{
+		if (result.status != MeshFileStatus::Ok)
+		{
+			OutputDebugStringW(L"メッシュ ファイルを読み込めませんでした: ");
+			OutputDebugStringA(MeshFile::GetStatusName(result.status));
+			OutputDebugStringW(L"\n");
+			continue;
+		}
+
+		const MeshPlacement& placement = m_meshPlacements[result.requestId];
+		const uint32_t mesh = m_scene.AddMesh(*m_renderDevice, result.mesh, result.bounds, result.lods);
+		m_scene.AddObject(mesh, placement.transform, placement.color);
+		++addedCount;
+	}
+	return addedCount;
 }
\ No newline at end of file
@@ -1,21 +1,27 @@
 ﻿#pragma once
 
 #include "Direct3DBase.h"
+#include "D3D11RenderDevice.h"
+#include "D3D11GpuProfiler.h"
+#include "PolygonScene.h"
+#include "MeshLoader.h"
+#include "FramePipeline.h"
+#include "DrawQueue.h"
+#include "RenderCommandList.h"
+#include "PipelineStates.h"
+#include "FrameArena.h"
+#include "DirtyRectTracker.h"
+#include "ImageFile.h"
 
-struct ModelViewProjectionConstantBuffer
+// 読み込んだメッシュを置く位置と色。
+struct MeshPlacement
 {
-	DirectX::XMFLOAT4X4 model;
-	DirectX::XMFLOAT4X4 view;
-	DirectX::XMFLOAT4X4 projection;
-};
-
-struct VertexPositionColor
-{
-	DirectX::XMFLOAT3 pos;
-	DirectX::XMFLOAT3 color;
+	DirectX::XMFLOAT4X4 transform;
+	DirectX::XMFLOAT4 color;
 };
 
 // このクラスは、スピンしている立方体を描画します。
+// シーンの内容は PolygonScene が保持し、描画は D3D11RenderDevice を通して行います。
 ref class CubeRenderer sealed : public Direct3DBase
 {
 public:
@@ -26,26 +32,82 @@ public:
 	virtual void CreateWindowSizeDependentResources() override;
 	virtual void Render() override;
 
+	// 前のフレームから変わった矩形だけを伝えて表示し、そのフレームの作業領域を捨てます。
+	virtual void Present() override;
 
 	// 時間に依存するオブジェクトを更新するメソッドです。
+	// Update と Render は 0 番のスナップショットを使います。
 	void Update(float timeTotal, float timeDelta);
 
+internal:
+	// 両面表示の方法を切り替えます。既定値は TwoSidedMode::SinglePass です。
+	void SetTwoSidedMode(TwoSidedMode mode);
+
+	// シーンを更新して、結果を slot 番のスナップショットに書き込みます。
+	// RenderSnapshot とは別のスレッドから、別のスロットに対して呼び出せます。
+	void UpdateSnapshot(uint32_t slot, float timeTotal, float timeDelta);
+
+	// slot 番のスナップショットを描画します。
+	void RenderSnapshot(uint32_t slot);
+
+	// GPU の処理時間を profiler に記録します。デバイスを作成する前に呼び出してください。
+	void SetProfiler(Profiler* profiler);
+
+	// 直前の描画で視錐台カリングしたオブジェクトと描画したオブジェクトの数。
+	const CullingStatistics& GetCullingStatistics() const;
+
+	// 描画の前のカリングの方法を切り替えます。既定値は SceneCullingMode::Flat です。
+	void SetCullingMode(SceneCullingMode mode);
+
+	// 変わった範囲だけを描き直したピクセル数の累計。
+	const DirtyRectStats& GetDirtyRectStats() const;
+
+	// 次のフレームを描画すると画面が変わるかもしれないかどうか。
+	// 読み込み中、アニメーションやフェードの途中、直前のフレームで画面が変わったときは true です。
+	// false なら、入力などでシーンを変えるまで描画を止めてかまいません。
+	bool IsSceneChanging() const;
+
+	// 直前に描画したバック バッファーの内容を image に読み出します。Present の前に呼び出してください。
+	// GPU の処理が終わるまで待つので、テストの OffscreenRenderer (Tests/) の画像と見比べるときなど、確かめるときだけ使ってください。
+	void CaptureFrame(Image& image);
+
+	// ウィンドウ上の位置 (DIP) にあるオブジェクトを選び、強調して表示します。何もなければ強調を解除します。
+	// フレームの更新と並行しない、イベントの処理の中から呼び出してください。
+	PickResult SelectObjectAt(Windows::Foundation::Point position);
+
+	// パッケージ内の filename のメッシュ ファイルをバックグラウンドで読み込みます。
+	// 読み込めたら transform と color のオブジェクトとしてシーンに追加します。
+	void LoadMeshAsync(Platform::String^ filename, const DirectX::XMFLOAT4X4& transform, const DirectX::XMFLOAT4& color);
+
+	// 読み込みが終わったメッシュをデバイスに作成し、シーンに追加します。1 回に追加する数は抑えます。
+	// シーンを変更するので、フレームの更新と並行しない、イベントの処理の後などに呼び出してください。
+	// シーンに追加したオブジェクトの数を返します。
+	uint32_t ProcessLoadedMeshes();
+
 private:
-	void CubeRenderer::RenderObject(Microsoft::WRL::ComPtr<ID3D11Buffer> m_vertexBuffer);
+	void UpdateLodSettings();
+	void UpdatePresentRects();
 
 	bool m_loadingComplete;
 
-	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_inputLayout;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_vertexBuffer2;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_indexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pixelShader;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_constantBuffer;
+	// デバイスが失われても破棄せず、新しいデバイスのパイプライン ステートをここから作り直します。
+	std::unique_ptr<D3D11PipelineStateCache> m_pipelineCache;
+	std::unique_ptr<D3D11RenderDevice> m_renderDevice;
+	PolygonScene m_scene;
+	SceneSnapshot m_snapshots[FramePipeline::SnapshotCount];
+	DrawQueue m_drawQueue;
+	RenderCommandList m_commandList;
+	TwoSidedMode m_twoSidedMode;
 
-    ID3D11RasterizerState* m_pRasterizerState;
-	ID3D11RasterizerState* m_pRasterizerStateBack;
+	// 前のフレームから変わった範囲。描き直す矩形と Present に渡す矩形を求めます。
+	DirtyRectTracker m_dirtyRects;
+	std::vector<RECT> m_presentRects;	// 空なら全体を表示します
 
-	uint32 m_indexCount;
-	ModelViewProjectionConstantBuffer m_constantBufferData;
-};
+	std::unique_ptr<JobSystem> m_jobSystem;
+	std::unique_ptr<FrameArena> m_frameArena;	// 描画するスレッドのフレームごとの作業領域。Present の後に Reset します
+	std::unique_ptr<MeshLoader> m_meshLoader;
+	std::vector<MeshPlacement> m_meshPlacements;	// 読み込みの要求の番号ごとの置き方
+	std::vector<MeshLoadResult> m_loadedMeshes;
+	Profiler* m_profiler;
+	std::unique_ptr<D3D11GpuProfiler> m_gpuProfiler;
+};
\ No newline at end of file
@@ -0,0 +1,102 @@
+﻿#include "pch.h"
+#include "D3D11DynamicBuffer.h"
+
+using namespace Microsoft::WRL;
+
+D3D11DynamicBuffer::D3D11DynamicBuffer(
+	const ComPtr<ID3D11Device1>& device,
+	const ComPtr<ID3D11DeviceContext1>& context,
+	uint32 capacity,
+	UINT bindFlags
+	) :
+	m_d3dDevice(device),
+	m_d3dContext(context),
+	m_capacity(capacity),
+	m_lastFence(0),
+	m_completedFence(0)
+{
+	CD3D11_BUFFER_DESC bufferDesc(
+		capacity,
+		bindFlags,
+		D3D11_USAGE_DYNAMIC,
+		D3D11_CPU_ACCESS_WRITE
+		);
+	DX::ThrowIfFailed(
+		m_d3dDevice->CreateBuffer(
+			&bufferDesc,
+			nullptr,
+			&m_buffer
+			)
+		);
+}
+
+uint32_t D3D11DynamicBuffer::GetCapacity() const
+{
+	return m_capacity;
+}
+
+// D3D11 の Map はバッファー全体をマップするので、offset と size は使いません。
+uint8_t* D3D11DynamicBuffer::Map(BufferMapMode mode, uint32_t offset, uint32_t size)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	DX::ThrowIfFailed(
+		m_d3dContext->Map(
+			m_buffer.Get(),
+			0,
+			mode == BufferMapMode::Discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+			0,
+			&mappedResource
+			)
+		);
+	return static_cast<uint8_t*>(mappedResource.pData);
+}
+
+void D3D11DynamicBuffer::Unmap()
+{
+	m_d3dContext->Unmap(m_buffer.Get(), 0);
+}
+
+uint64_t D3D11DynamicBuffer::InsertFence()
+{
+	Fence fence;
+	fence.value = ++m_lastFence;
+
+	// 完了したクエリは再利用します。
+	if (!m_freeQueries.empty())
+	{
+		fence.query = m_freeQueries.back();
+		m_freeQueries.pop_back();
+	}
+	else
+	{
+		CD3D11_QUERY_DESC queryDesc(D3D11_QUERY_EVENT);
+		DX::ThrowIfFailed(
+			m_d3dDevice->CreateQuery(
+				&queryDesc,
+				&fence.query
+				)
+			);
+	}
+
+	m_d3dContext->End(fence.query.Get());
+	m_pendingFences.push_back(fence);
+	return fence.value;
+}
+
+uint64_t D3D11DynamicBuffer::GetCompletedFence()
+{
+	// クエリは発行した順に完了するので、先頭から確認します。
+	while (!m_pendingFences.empty())
+	{
+		const Fence& fence = m_pendingFences.front();
+		if (m_d3dContext->GetData(fence.query.Get(), nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		{
+			break;
+		}
+
+		m_completedFence = fence.value;
+		m_freeQueries.push_back(fence.query);
+		m_pendingFences.pop_front();
+	}
+	return m_completedFence;
+}
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <deque>
+#include "DirectXHelper.h"
+#include "DynamicBufferDevice.h"
+
+// D3D11_USAGE_DYNAMIC のバッファーによる DynamicBufferDevice の実装。
+// フェンスは D3D11_QUERY_EVENT のクエリで表し、GetData でフラッシュせずに完了を確認します。
+class D3D11DynamicBuffer : public DynamicBufferDevice
+{
+public:
+	D3D11DynamicBuffer(
+		const Microsoft::WRL::ComPtr<ID3D11Device1>& device,
+		const Microsoft::WRL::ComPtr<ID3D11DeviceContext1>& context,
+		uint32 capacity,
+		UINT bindFlags
+		);
+
+	ID3D11Buffer* GetBuffer() const { return m_buffer.Get(); }
+
+	// DynamicBufferDevice メソッド。
+	virtual uint32_t GetCapacity() const override;
+	virtual uint8_t* Map(BufferMapMode mode, uint32_t offset, uint32_t size) override;
+	virtual void Unmap() override;
+	virtual uint64_t InsertFence() override;
+	virtual uint64_t GetCompletedFence() override;
+
+private:
+	struct Fence
+	{
+		uint64_t value;
+		Microsoft::WRL::ComPtr<ID3D11Query> query;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device1> m_d3dDevice;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_d3dContext;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_buffer;
+	uint32 m_capacity;
+
+	std::deque<Fence> m_pendingFences;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> m_freeQueries;
+	uint64_t m_lastFence;
+	uint64_t m_completedFence;
+};
@@ -0,0 +1,165 @@
+﻿#include "pch.h"
+#include "D3D11GpuProfiler.h"
+
+using namespace Microsoft::WRL;
+
+D3D11GpuProfiler::D3D11GpuProfiler(
+	const ComPtr<ID3D11Device1>& device,
+	const ComPtr<ID3D11DeviceContext1>& context,
+	Profiler& profiler
+	) :
+	m_d3dDevice(device),
+	m_d3dContext(context),
+	m_profiler(profiler),
+	m_supported(true),
+	m_currentFrame(0),
+	m_recording(false),
+	m_openZoneCount(0)
+{
+	// クエリはすべて最初に作成しておきます。1 つでも作成できなければ計測しません。
+	for (uint32 i = 0; i < FrameLatency && m_supported; ++i)
+	{
+		Frame& frame = m_frames[i];
+		frame.zoneCount = 0;
+		frame.cpuBegin = 0;
+		frame.pending = false;
+
+		CD3D11_QUERY_DESC disjointDesc(D3D11_QUERY_TIMESTAMP_DISJOINT);
+		m_supported = SUCCEEDED(m_d3dDevice->CreateQuery(&disjointDesc, &frame.disjoint)) &&
+			CreateTimestampQuery(frame.frameZone.begin) &&
+			CreateTimestampQuery(frame.frameZone.end);
+		frame.frameZone.name = "GPU Frame";
+
+		for (uint32 j = 0; j < MaxZonesPerFrame && m_supported; ++j)
+		{
+			m_supported = CreateTimestampQuery(frame.zones[j].begin) && CreateTimestampQuery(frame.zones[j].end);
+		}
+	}
+}
+
+bool D3D11GpuProfiler::CreateTimestampQuery(ComPtr<ID3D11Query>& query)
+{
+	CD3D11_QUERY_DESC queryDesc(D3D11_QUERY_TIMESTAMP);
+	return SUCCEEDED(m_d3dDevice->CreateQuery(&queryDesc, &query));
+}
+
+void D3D11GpuProfiler::BeginFrame()
+{
+	if (!m_supported)
+	{
+		return;
+	}
+
+	// このスロットの前回の結果がまだ届いていなければ、今回のフレームは計測しません。
+	Frame& frame = m_frames[m_currentFrame];
+	if (frame.pending && !TryResolve(frame))
+	{
+		m_recording = false;
+		return;
+	}
+
+	m_recording = true;
+	frame.zoneCount = 0;
+	frame.cpuBegin = ProfilerClock::Now();
+	m_openZoneCount = 0;
+	m_d3dContext->Begin(frame.disjoint.Get());
+	m_d3dContext->End(frame.frameZone.begin.Get());
+}
+
+void D3D11GpuProfiler::EndFrame()
+{
+	if (m_recording)
+	{
+		Frame& frame = m_frames[m_currentFrame];
+		while (m_openZoneCount > 0)
+		{
+			EndZone();
+		}
+		m_d3dContext->End(frame.frameZone.end.Get());
+		m_d3dContext->End(frame.disjoint.Get());
+		frame.pending = true;
+		m_recording = false;
+	}
+
+	m_currentFrame = (m_currentFrame + 1) % FrameLatency;
+}
+
+void D3D11GpuProfiler::BeginZone(const char* name)
+{
+	Frame& frame = m_frames[m_currentFrame];
+	if (!m_recording || frame.zoneCount == MaxZonesPerFrame)
+	{
+		return;
+	}
+
+	Zone& zone = frame.zones[frame.zoneCount];
+	zone.name = name;
+	m_d3dContext->End(zone.begin.Get());
+	m_openZones[m_openZoneCount++] = frame.zoneCount++;
+}
+
+void D3D11GpuProfiler::EndZone()
+{
+	if (!m_recording || m_openZoneCount == 0)
+	{
+		return;
+	}
+
+	Frame& frame = m_frames[m_currentFrame];
+	m_d3dContext->End(frame.zones[m_openZones[--m_openZoneCount]].end.Get());
+}
+
+/**
+ * GPU のタイムスタンプを、フレームの開始時の CPU の時刻を基準にして ProfilerClock のティックに直します。
+ * GPU は CPU より遅れて処理するので、トレース上の位置は実際より早くなりますが、長さは正確です。
+ */
+bool D3D11GpuProfiler::TryResolve(Frame& frame)
+{
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData;
+	if (m_d3dContext->GetData(frame.disjoint.Get(), &disjointData, sizeof(disjointData), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+	{
+		return false;
+	}
+
+	UINT64 frameBegin;
+	UINT64 frameEnd;
+	if (m_d3dContext->GetData(frame.frameZone.begin.Get(), &frameBegin, sizeof(frameBegin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+		m_d3dContext->GetData(frame.frameZone.end.Get(), &frameEnd, sizeof(frameEnd), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+	{
+		return false;
+	}
+
+	frame.pending = false;
+
+	// 周波数が変わったフレームの値は信頼できないので捨てます。
+	if (disjointData.Disjoint || disjointData.Frequency == 0)
+	{
+		return true;
+	}
+
+	const double ticksPerGpuTick = static_cast<double>(ProfilerClock::GetFrequency()) / disjointData.Frequency;
+	m_profiler.Record(
+		frame.frameZone.name,
+		frame.cpuBegin,
+		frame.cpuBegin + static_cast<uint64_t>((frameEnd - frameBegin) * ticksPerGpuTick),
+		Profiler::GpuThreadId
+		);
+
+	for (uint32 i = 0; i < frame.zoneCount; ++i)
+	{
+		UINT64 zoneBegin;
+		UINT64 zoneEnd;
+		if (m_d3dContext->GetData(frame.zones[i].begin.Get(), &zoneBegin, sizeof(zoneBegin), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+			m_d3dContext->GetData(frame.zones[i].end.Get(), &zoneEnd, sizeof(zoneEnd), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+			zoneBegin >= frameBegin && zoneEnd >= zoneBegin)
+		{
+			m_profiler.Record(
+				frame.zones[i].name,
+				frame.cpuBegin + static_cast<uint64_t>((zoneBegin - frameBegin) * ticksPerGpuTick),
+				frame.cpuBegin + static_cast<uint64_t>((zoneEnd - frameBegin) * ticksPerGpuTick),
+				Profiler::GpuThreadId
+				);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include "DirectXHelper.h"
+#include "Profiler.h"
+
+/**
+ * D3D11 のタイムスタンプ クエリで GPU の処理時間を測り、Profiler に GPU の区間として記録します。
+ * 結果は数フレーム遅れて届くので、BeginFrame のたびにフラッシュせずに確認し、
+ * 届いていなければそのフレームの計測を飛ばして CPU を待たせないようにします。
+ * タイムスタンプ クエリを作成できないデバイス (機能レベル 9_x など) では何もしません。
+ */
+class D3D11GpuProfiler
+{
+public:
+	D3D11GpuProfiler(
+		const Microsoft::WRL::ComPtr<ID3D11Device1>& device,
+		const Microsoft::WRL::ComPtr<ID3D11DeviceContext1>& context,
+		Profiler& profiler
+		);
+
+	bool IsSupported() const { return m_supported; }
+
+	// フレーム全体を "GPU Frame" として計測します。
+	void BeginFrame();
+	void EndFrame();
+
+	// BeginFrame と EndFrame の間の区間を計測します。入れ子にできます。
+	void BeginZone(const char* name);
+	void EndZone();
+
+private:
+	static const uint32 FrameLatency = 4;
+	static const uint32 MaxZonesPerFrame = 16;
+
+	struct Zone
+	{
+		const char* name;
+		Microsoft::WRL::ComPtr<ID3D11Query> begin;
+		Microsoft::WRL::ComPtr<ID3D11Query> end;
+	};
+
+	struct Frame
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+		Zone frameZone;
+		Zone zones[MaxZonesPerFrame];
+		uint32 zoneCount;
+		uint64_t cpuBegin;
+		bool pending;
+	};
+
+	bool CreateTimestampQuery(Microsoft::WRL::ComPtr<ID3D11Query>& query);
+	bool TryResolve(Frame& frame);
+
+	Microsoft::WRL::ComPtr<ID3D11Device1> m_d3dDevice;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_d3dContext;
+	Profiler& m_profiler;
+	bool m_supported;
+
+	Frame m_frames[FrameLatency];
+	uint32 m_currentFrame;
+	bool m_recording;
+	uint32 m_openZones[MaxZonesPerFrame];
+	uint32 m_openZoneCount;
+};
@@ -0,0 +1,531 @@
+﻿#include "pch.h"
+#include "D3D11PipelineStateCache.h"
+#include <set>
+
+using namespace Microsoft::WRL;
+using namespace Concurrency;
+
+// 頂点の形式に対応する入力レイアウトを返します。
+// instanced が true のときは、スロット 1 の InstanceData の要素も追加します。
+static std::vector<D3D11_INPUT_ELEMENT_DESC> GetInputElements(VertexFormat format, bool instanced)
+{
+	static const D3D11_INPUT_ELEMENT_DESC positionColorDesc[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "COLOR",    0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	static const D3D11_INPUT_ELEMENT_DESC compactDesc[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "COLOR",    0, DXGI_FORMAT_R8G8B8A8_UNORM,     0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	static const D3D11_INPUT_ELEMENT_DESC instanceDesc[] =
+	{
+		{ "INSTANCE_MODEL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCE_MODEL", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCE_MODEL", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCE_MODEL", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCE_COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
+
+	std::vector<D3D11_INPUT_ELEMENT_DESC> elements;
+	if (format == VertexFormat::Compact)
+	{
+		elements.assign(compactDesc, compactDesc + ARRAYSIZE(compactDesc));
+	}
+	else
+	{
+		elements.assign(positionColorDesc, positionColorDesc + ARRAYSIZE(positionColorDesc));
+	}
+
+	if (instanced)
+	{
+		elements.insert(elements.end(), instanceDesc, instanceDesc + ARRAYSIZE(instanceDesc));
+	}
+	return elements;
+}
+
+static D3D11_CULL_MODE GetD3D11CullMode(CullMode mode)
+{
+	switch (mode)
+	{
+	case CullMode::Front:
+		return D3D11_CULL_FRONT;
+	case CullMode::Back:
+		return D3D11_CULL_BACK;
+	default:
+		return D3D11_CULL_NONE;
+	}
+}
+
+D3D11PipelineStateCache::D3D11PipelineStateCache(const PathString& storagePath) :
+	m_storagePath(storagePath),
+	m_storedRecordsLoaded(false),
+	m_recordsChanged(false),
+	m_jobSystem(nullptr),
+	m_createdObjectCount(0)
+{
+}
+
+void D3D11PipelineStateCache::SetDevice(const ComPtr<ID3D11Device1>& device, JobSystem* jobSystem)
+{
+	m_jobSystem = jobSystem;
+	if (m_d3dDevice == device)
+	{
+		return;
+	}
+
+	// 前のデバイスのオブジェクトは使えないので、記述とバイトコードだけを残します。
+	m_d3dDevice = device;
+	m_vertexShaders.clear();
+	m_pixelShaders.clear();
+	m_inputLayouts.clear();
+	m_rasterizerStates.clear();
+	m_blendStates.clear();
+	m_depthStencilStates.clear();
+	for (Entry& entry : m_entries)
+	{
+		entry.state = D3D11PipelineState();
+		entry.created = false;
+		entry.failed = false;
+	}
+}
+
+task<std::vector<uint32>> D3D11PipelineStateCache::PrepareAsync(const std::vector<PipelineStateDesc>& descs)
+{
+	LoadStoredRecords();
+
+	for (const PipelineStateDesc& desc : descs)
+	{
+		AddShader(desc.vertexShader);
+		AddShader(desc.pixelShader);
+	}
+
+	// まだ読み込んでいないシェーダーだけを読み込みます。デバイスが失われた後の作り直しでは何も読みません。
+	std::vector<task<void>> loadTasks;
+	for (auto& pair : m_shaders)
+	{
+		if (pair.second.loaded)
+		{
+			continue;
+		}
+
+		Shader* shader = &pair.second;
+		const std::wstring name(pair.first.begin(), pair.first.end());
+		loadTasks.push_back(DX::ReadDataAsync(ref new Platform::String(name.c_str())).then([shader] (task<FileView> readTask) {
+			// 保存されていた記述のシェーダーは更新で無くなっていることもあるので、読めなくても続けます。
+			// 要求された記述のシェーダーが無いときは ResolveEntries で例外を投げます。
+			try
+			{
+				shader->bytecode = readTask.get();
+			}
+			catch (Platform::Exception^)
+			{
+				shader->bytecode.Reset();
+			}
+			shader->hash = PipelineStateKey::HashBytes(shader->bytecode.GetData(), shader->bytecode.GetSize());
+			shader->loaded = true;
+		}));
+	}
+
+	auto loadTask = loadTasks.empty() ? create_task([] {}) : when_all(loadTasks.begin(), loadTasks.end());
+
+	return loadTask.then([this, descs] () -> std::vector<uint32> {
+		std::vector<uint32> handles;
+		ResolveEntries(descs, handles);
+		CreateObjects();
+
+		for (uint32 handle : handles)
+		{
+			if (m_entries[handle].failed)
+			{
+				DX::ThrowIfFailed(E_FAIL);
+			}
+		}
+
+		if (m_recordsChanged)
+		{
+			SaveRecords();
+			m_recordsChanged = false;
+		}
+		return handles;
+	});
+}
+
+const D3D11PipelineState& D3D11PipelineStateCache::GetState(uint32 handle) const
+{
+	return m_entries[handle].state;
+}
+
+// 前回の起動で保存した記述を読み取り、そのシェーダーも読み込む対象に加えます。最初の PrepareAsync でだけ行います。
+void D3D11PipelineStateCache::LoadStoredRecords()
+{
+	if (m_storedRecordsLoaded || m_storagePath.empty())
+	{
+		m_storedRecordsLoaded = true;
+		return;
+	}
+	m_storedRecordsLoaded = true;
+
+	FileView file = FileView::Map(m_storagePath);
+	if (!file.IsValid())
+	{
+		return;
+	}
+
+	if (!PipelineStateKey::Parse(file.GetData(), file.GetSize(), m_storedRecords))
+	{
+		// 壊れているか古い形式のファイルは、次に保存するときに書き直します。
+		m_recordsChanged = true;
+		return;
+	}
+
+	for (const PipelineStateRecord& record : m_storedRecords)
+	{
+		AddShader(record.desc.vertexShader);
+		AddShader(record.desc.pixelShader);
+	}
+}
+
+// name のシェーダーを、まだ無ければ読み込む対象に加えます。
+void D3D11PipelineStateCache::AddShader(const char* name)
+{
+	if (m_shaders.find(name) == m_shaders.end())
+	{
+		Shader shader;
+		shader.hash = 0;
+		shader.loaded = false;
+		m_shaders[name] = shader;
+	}
+}
+
+/**
+ * 読み込んだバイトコードでキーを計算し、同じキーの記述を 1 つのエントリーにまとめます。
+ * 保存されていた記述は、シェーダーが変わってキーが一致しなければ捨てます。
+ */
+void D3D11PipelineStateCache::ResolveEntries(const std::vector<PipelineStateDesc>& descs, std::vector<uint32>& handles)
+{
+	auto addEntry = [this] (const PipelineStateDesc& desc, uint64_t key) -> uint32 {
+		auto found = m_entryByKey.find(key);
+		if (found != m_entryByKey.end())
+		{
+			return found->second;
+		}
+
+		Entry entry;
+		entry.record.key = key;
+		entry.record.desc = desc;
+		entry.created = false;
+		entry.failed = false;
+		m_entries.push_back(entry);
+
+		const uint32 handle = static_cast<uint32>(m_entries.size() - 1);
+		m_entryByKey[key] = handle;
+		return handle;
+	};
+
+	for (const PipelineStateRecord& record : m_storedRecords)
+	{
+		const Shader& vertexShader = m_shaders[record.desc.vertexShader];
+		const Shader& pixelShader = m_shaders[record.desc.pixelShader];
+		if (vertexShader.bytecode.GetSize() == 0 || pixelShader.bytecode.GetSize() == 0 ||
+			PipelineStateKey::Compute(record.desc, vertexShader.hash, pixelShader.hash) != record.key)
+		{
+			m_recordsChanged = true;
+			continue;
+		}
+		addEntry(record.desc, record.key);
+	}
+	m_storedRecords.clear();
+
+	for (const PipelineStateDesc& desc : descs)
+	{
+		const Shader& vertexShader = m_shaders[desc.vertexShader];
+		const Shader& pixelShader = m_shaders[desc.pixelShader];
+		if (vertexShader.bytecode.GetSize() == 0 || pixelShader.bytecode.GetSize() == 0)
+		{
+			DX::ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+		}
+
+		const uint64_t key = PipelineStateKey::Compute(desc, vertexShader.hash, pixelShader.hash);
+		const size_t entryCount = m_entries.size();
+		handles.push_back(addEntry(desc, key));
+		if (m_entries.size() != entryCount)
+		{
+			m_recordsChanged = true;
+		}
+	}
+}
+
+/**
+ * 未作成のエントリーが使うオブジェクトのうち、まだ無いものを重複なく集めて並列に作成し、
+ * エントリーごとにパイプライン ステートを組み立てます。デバイスのオブジェクトの作成はスレッド セーフです。
+ */
+void D3D11PipelineStateCache::CreateObjects()
+{
+	std::vector<ObjectJob> jobs;
+	std::set<std::pair<uint32, uint64_t>> queued;
+	auto addJob = [&] (ObjectJob::Type type, uint64_t key, bool exists, const Shader* shader, const PipelineStateDesc* desc) {
+		if (exists || !queued.insert(std::make_pair(static_cast<uint32>(type), key)).second)
+		{
+			return;
+		}
+
+		ObjectJob job;
+		job.type = type;
+		job.key = key;
+		job.shader = shader;
+		job.desc = desc;
+		job.result = S_OK;
+		jobs.push_back(job);
+	};
+
+	for (const Entry& entry : m_entries)
+	{
+		if (entry.created || entry.failed)
+		{
+			continue;
+		}
+
+		const PipelineStateDesc& desc = entry.record.desc;
+		const Shader* vertexShader = &m_shaders[desc.vertexShader];
+		const Shader* pixelShader = &m_shaders[desc.pixelShader];
+		const uint64_t inputLayoutKey = GetInputLayoutKey(desc);
+
+		addJob(ObjectJob::VertexShader, vertexShader->hash, m_vertexShaders.count(vertexShader->hash) != 0, vertexShader, &desc);
+		addJob(ObjectJob::PixelShader, pixelShader->hash, m_pixelShaders.count(pixelShader->hash) != 0, pixelShader, &desc);
+		addJob(ObjectJob::InputLayout, inputLayoutKey, m_inputLayouts.count(inputLayoutKey) != 0, vertexShader, &desc);
+		addJob(ObjectJob::RasterizerState, desc.cullMode, m_rasterizerStates.count(desc.cullMode) != 0, nullptr, &desc);
+		addJob(ObjectJob::BlendState, desc.blendMode, m_blendStates.count(desc.blendMode) != 0, nullptr, &desc);
+		addJob(ObjectJob::DepthStencilState, desc.depthMode, m_depthStencilStates.count(desc.depthMode) != 0, nullptr, &desc);
+	}
+
+	const uint32 jobCount = static_cast<uint32>(jobs.size());
+	if (m_jobSystem != nullptr)
+	{
+		m_jobSystem->ParallelFor(jobCount, 1, [&] (uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				CreateObject(jobs[i]);
+			}
+		});
+	}
+	else
+	{
+		for (ObjectJob& job : jobs)
+		{
+			CreateObject(job);
+		}
+	}
+
+	// 失敗したオブジェクトは登録しないので、それを使うエントリーは組み立てられずに失敗になります。
+	m_createdObjectCount = 0;
+	for (const ObjectJob& job : jobs)
+	{
+		if (FAILED(job.result))
+		{
+			continue;
+		}
+
+		ID3D11DeviceChild* object = job.object.Get();
+		switch (job.type)
+		{
+		case ObjectJob::VertexShader:
+			m_vertexShaders[job.key] = static_cast<ID3D11VertexShader*>(object);
+			break;
+		case ObjectJob::PixelShader:
+			m_pixelShaders[job.key] = static_cast<ID3D11PixelShader*>(object);
+			break;
+		case ObjectJob::InputLayout:
+			m_inputLayouts[job.key] = static_cast<ID3D11InputLayout*>(object);
+			break;
+		case ObjectJob::RasterizerState:
+			m_rasterizerStates[job.key] = static_cast<ID3D11RasterizerState*>(object);
+			break;
+		case ObjectJob::BlendState:
+			m_blendStates[job.key] = static_cast<ID3D11BlendState*>(object);
+			break;
+		case ObjectJob::DepthStencilState:
+			m_depthStencilStates[job.key] = static_cast<ID3D11DepthStencilState*>(object);
+			break;
+		}
+		++m_createdObjectCount;
+	}
+
+	for (Entry& entry : m_entries)
+	{
+		if (entry.created || entry.failed)
+		{
+			continue;
+		}
+
+		const PipelineStateDesc& desc = entry.record.desc;
+		const uint64_t vertexShaderHash = m_shaders[desc.vertexShader].hash;
+		const uint64_t pixelShaderHash = m_shaders[desc.pixelShader].hash;
+		const uint64_t inputLayoutKey = GetInputLayoutKey(desc);
+		if (m_vertexShaders.count(vertexShaderHash) == 0 ||
+			m_pixelShaders.count(pixelShaderHash) == 0 ||
+			m_inputLayouts.count(inputLayoutKey) == 0 ||
+			m_rasterizerStates.count(desc.cullMode) == 0 ||
+			m_blendStates.count(desc.blendMode) == 0 ||
+			m_depthStencilStates.count(desc.depthMode) == 0)
+		{
+			entry.failed = true;
+			continue;
+		}
+
+		entry.state.vertexShader = m_vertexShaders[vertexShaderHash];
+		entry.state.inputLayout = m_inputLayouts[inputLayoutKey];
+		entry.state.pixelShader = m_pixelShaders[pixelShaderHash];
+		entry.state.rasterizerState = m_rasterizerStates[desc.cullMode];
+		entry.state.blendState = m_blendStates[desc.blendMode];
+		entry.state.depthStencilState = m_depthStencilStates[desc.depthMode];
+		entry.created = true;
+	}
+}
+
+// ワーカー スレッドで呼び出されるので、例外を投げずに結果を job.result に返します。
+void D3D11PipelineStateCache::CreateObject(ObjectJob& job) const
+{
+	const PipelineStateDesc& desc = *job.desc;
+	switch (job.type)
+	{
+	case ObjectJob::VertexShader:
+		{
+			ComPtr<ID3D11VertexShader> vertexShader;
+			job.result = m_d3dDevice->CreateVertexShader(
+				job.shader->bytecode.GetData(),
+				job.shader->bytecode.GetSize(),
+				nullptr,
+				&vertexShader
+				);
+			job.object = vertexShader;
+		}
+		break;
+
+	case ObjectJob::PixelShader:
+		{
+			ComPtr<ID3D11PixelShader> pixelShader;
+			job.result = m_d3dDevice->CreatePixelShader(
+				job.shader->bytecode.GetData(),
+				job.shader->bytecode.GetSize(),
+				nullptr,
+				&pixelShader
+				);
+			job.object = pixelShader;
+		}
+		break;
+
+	case ObjectJob::InputLayout:
+		{
+			std::vector<D3D11_INPUT_ELEMENT_DESC> elements = GetInputElements(static_cast<VertexFormat>(desc.vertexFormat), desc.instanced != 0);
+			ComPtr<ID3D11InputLayout> inputLayout;
+			job.result = m_d3dDevice->CreateInputLayout(
+				&elements[0],
+				static_cast<UINT>(elements.size()),
+				job.shader->bytecode.GetData(),
+				job.shader->bytecode.GetSize(),
+				&inputLayout
+				);
+			job.object = inputLayout;
+		}
+		break;
+
+	case ObjectJob::RasterizerState:
+		{
+			D3D11_RASTERIZER_DESC rdc;
+			ZeroMemory(&rdc, sizeof(rdc));
+			rdc.FillMode = D3D11_FILL_SOLID;
+			rdc.CullMode = GetD3D11CullMode(static_cast<CullMode>(desc.cullMode));
+			rdc.FrontCounterClockwise = true;
+			rdc.DepthClipEnable = true;
+			rdc.ScissorEnable = true;	// 描き直す矩形の外側に書き込まないように、シザー矩形は D3D11RenderDevice が常に設定します
+
+			ComPtr<ID3D11RasterizerState> rasterizerState;
+			job.result = m_d3dDevice->CreateRasterizerState(&rdc, &rasterizerState);
+			job.object = rasterizerState;
+		}
+		break;
+
+	case ObjectJob::BlendState:
+		{
+			CD3D11_BLEND_DESC blendDesc(D3D11_DEFAULT);
+			if (static_cast<BlendMode>(desc.blendMode) == BlendMode::AlphaBlend)
+			{
+				D3D11_RENDER_TARGET_BLEND_DESC& target = blendDesc.RenderTarget[0];
+				target.BlendEnable = TRUE;
+				target.SrcBlend = D3D11_BLEND_SRC_ALPHA;
+				target.DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+				target.SrcBlendAlpha = D3D11_BLEND_ONE;
+				target.DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+			}
+			else if (static_cast<BlendMode>(desc.blendMode) == BlendMode::NoColor)
+			{
+				blendDesc.RenderTarget[0].RenderTargetWriteMask = 0;
+			}
+
+			ComPtr<ID3D11BlendState> blendState;
+			job.result = m_d3dDevice->CreateBlendState(&blendDesc, &blendState);
+			job.object = blendState;
+		}
+		break;
+
+	case ObjectJob::DepthStencilState:
+		{
+			CD3D11_DEPTH_STENCIL_DESC depthStencilDesc(D3D11_DEFAULT);
+			if (static_cast<DepthMode>(desc.depthMode) == DepthMode::ReadOnly)
+			{
+				depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+			}
+			else if (static_cast<DepthMode>(desc.depthMode) == DepthMode::Overwrite)
+			{
+				depthStencilDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+			}
+
+			ComPtr<ID3D11DepthStencilState> depthStencilState;
+			job.result = m_d3dDevice->CreateDepthStencilState(&depthStencilDesc, &depthStencilState);
+			job.object = depthStencilState;
+		}
+		break;
+	}
+}
+
+// 作成できたエントリーのキーと記述を保存します。キャッシュは高速化のためだけのものなので、書き込めなくても続けます。
+void D3D11PipelineStateCache::SaveRecords() const
+{
+	if (m_storagePath.empty())
+	{
+		return;
+	}
+
+	std::vector<PipelineStateRecord> records;
+	for (const Entry& entry : m_entries)
+	{
+		if (entry.created)
+		{
+			records.push_back(entry.record);
+		}
+	}
+
+	std::vector<uint8_t> data;
+	PipelineStateKey::Write(records, data);
+
+	HANDLE file = CreateFile2(m_storagePath.c_str(), GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	DWORD written = 0;
+	WriteFile(file, &data[0], static_cast<DWORD>(data.size()), &written, nullptr);
+	CloseHandle(file);
+}
+
+// 入力レイアウトは頂点シェーダーの入力シグネチャに対して検証されるので、頂点シェーダーごとに作成します。
+uint64_t D3D11PipelineStateCache::GetInputLayoutKey(const PipelineStateDesc& desc) const
+{
+	const uint32_t layout[] = { desc.vertexFormat, desc.instanced };
+	return PipelineStateKey::HashBytes(layout, sizeof(layout), m_shaders.find(desc.vertexShader)->second.hash);
+}
@@ -0,0 +1,127 @@
+﻿#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "DirectXHelper.h"
+#include "FileView.h"
+#include "JobSystem.h"
+#include "PipelineStateKey.h"
+
+// デバイス上のパイプライン ステート。同じ内容のオブジェクトは、パイプライン ステートの間で共有します。
+struct D3D11PipelineState
+{
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> pixelShader;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterizerState;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> blendState;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthStencilState;
+};
+
+/**
+ * シェーダーのバイトコードと各ステートのハッシュをキーにした、パイプライン ステートのキャッシュ。
+ * キーが同じ記述は 1 つにまとめ、シェーダーやステートのオブジェクトも内容ごとに 1 つだけ作成します。
+ *
+ * 読み込んだバイトコードと記述はデバイスをまたいで保持するので、デバイスが失われたときは
+ * ファイルを読み直さずに、このキャッシュだけからすべてのオブジェクトを作り直せます。
+ * 使ったキーは記述とともにファイルに保存し、次の起動では要求される前に作成しておきます。
+ */
+class D3D11PipelineStateCache
+{
+public:
+	static const uint32 InvalidHandle = UINT_MAX;
+
+	// storagePath にキーを保存します。空なら保存しません。
+	explicit D3D11PipelineStateCache(const PathString& storagePath);
+
+	/**
+	 * オブジェクトを作成するデバイスを設定します。デバイスが変わったら、作成済みのオブジェクトをすべて破棄します。
+	 * jobSystem があれば、PrepareAsync はオブジェクトの作成をそのスレッドに分担させます。
+	 */
+	void SetDevice(const Microsoft::WRL::ComPtr<ID3D11Device1>& device, JobSystem* jobSystem);
+
+	/**
+	 * descs のパイプライン ステートと、保存されていたパイプライン ステートを作成し、descs と同じ順にハンドルを返します。
+	 * まだ読み込んでいないシェーダーだけを並行して読み込み、未作成のオブジェクトをまとめて並列に作成します。
+	 * descs の作成に失敗したときは例外を投げます。保存されていただけの記述は、作成できなければ捨てます。
+	 * 同時に 2 つ以上実行しないでください。
+	 */
+	Concurrency::task<std::vector<uint32>> PrepareAsync(const std::vector<PipelineStateDesc>& descs);
+
+	// PrepareAsync が返したハンドルのパイプライン ステート。次にデバイスを設定するまで有効です。
+	const D3D11PipelineState& GetState(uint32 handle) const;
+
+	// 記録しているパイプライン ステートの数と、直前の PrepareAsync で作成したオブジェクトの数。
+	uint32 GetPipelineCount() const { return static_cast<uint32>(m_entries.size()); }
+	uint32 GetCreatedObjectCount() const { return m_createdObjectCount; }
+
+private:
+	D3D11PipelineStateCache(const D3D11PipelineStateCache&);
+	D3D11PipelineStateCache& operator=(const D3D11PipelineStateCache&);
+
+	struct Shader
+	{
+		FileView bytecode;
+		uint64_t hash;
+		bool loaded;
+	};
+
+	struct Entry
+	{
+		PipelineStateRecord record;
+		D3D11PipelineState state;
+		bool created;
+		bool failed;
+	};
+
+	// 並列に作成する 1 つのオブジェクト。
+	struct ObjectJob
+	{
+		enum Type
+		{
+			VertexShader,
+			PixelShader,
+			InputLayout,
+			RasterizerState,
+			BlendState,
+			DepthStencilState
+		};
+
+		Type type;
+		uint64_t key;
+		const Shader* shader;
+		const PipelineStateDesc* desc;
+		Microsoft::WRL::ComPtr<ID3D11DeviceChild> object;
+		HRESULT result;
+	};
+
+	void LoadStoredRecords();
+	void AddShader(const char* name);
+	void ResolveEntries(const std::vector<PipelineStateDesc>& descs, std::vector<uint32>& handles);
+	void CreateObjects();
+	void CreateObject(ObjectJob& job) const;
+	void SaveRecords() const;
+	uint64_t GetInputLayoutKey(const PipelineStateDesc& desc) const;
+
+	PathString m_storagePath;
+	bool m_storedRecordsLoaded;
+	bool m_recordsChanged;
+	std::vector<PipelineStateRecord> m_storedRecords;
+
+	Microsoft::WRL::ComPtr<ID3D11Device1> m_d3dDevice;
+	JobSystem* m_jobSystem;
+
+	std::map<std::string, Shader> m_shaders;
+	std::vector<Entry> m_entries;
+	std::map<uint64_t, uint32> m_entryByKey;
+	uint32 m_createdObjectCount;
+
+	// 内容ごとのオブジェクト。キーはバイトコードのハッシュか、ステートの値です。
+	std::map<uint64_t, Microsoft::WRL::ComPtr<ID3D11VertexShader>> m_vertexShaders;
+	std::map<uint64_t, Microsoft::WRL::ComPtr<ID3D11PixelShader>> m_pixelShaders;
+	std::map<uint64_t, Microsoft::WRL::ComPtr<ID3D11InputLayout>> m_inputLayouts;
+	std::map<uint64_t, Microsoft::WRL::ComPtr<ID3D11RasterizerState>> m_rasterizerStates;
+	std::map<uint64_t, Microsoft::WRL::ComPtr<ID3D11BlendState>> m_blendStates;
+	std::map<uint64_t, Microsoft::WRL::ComPtr<ID3D11DepthStencilState>> m_depthStencilStates;
+};
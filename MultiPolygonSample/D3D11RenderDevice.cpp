@@ -0,0 +1,1121 @@
+﻿#include "pch.h"
+#include "D3D11RenderDevice.h"
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
+using namespace Concurrency;
+
+// 頂点ステージごとの頂点シェーダーと入力レイアウト。
+// VertexFormat::Compact のメッシュはインスタンス描画でのみ使います。
+// エミュレーションでは CPU で頂点を展開するので、元の形式のまま扱います。
+static const char* const VertexStageShaders[] =
+{
+	"SimpleVertexShader.cso",
+	"InstancedVertexShader.cso",
+	"CompactInstancedVertexShader.cso"
+};
+static const VertexFormat VertexStageFormats[] = { VertexFormat::PositionColor, VertexFormat::PositionColor, VertexFormat::Compact };
+static const bool VertexStageInstanced[] = { false, true, true };
+
+// 動的頂点のリング バッファーの初期容量 (バイト)。足りなければ 2 倍にして作り直します。
+static const uint32 InitialDynamicVertexBufferSize = 1024 * 1024;
+
+// オブジェクトごとの定数の 1 つ分の大きさ。VSSetConstantBuffers1 のオフセットと数は 16 定数 (256 バイト) の倍数です。
+static const uint32 ObjectConstantSlotConstants = 16;
+
+// 1 つのバッファーの変わった部分を書き込むときの、UpdateSubresource1 の最大の呼び出し回数。
+// 変わった範囲がこれより多いときは、間の短いものからつなげて書き込みます。
+static const uint32 MaxUploadRanges = 16;
+
+// 遅延コンテキストに分けて記録する範囲の、最小の描画コマンド数。
+// これより少ないと、コマンド リストを作る手間の方が大きくなります。
+static const uint32_t MinDrawsPerPartition = 128;
+
+D3D11RenderDevice::D3D11RenderDevice(
+	const ComPtr<ID3D11Device1>& device,
+	const ComPtr<ID3D11DeviceContext1>& context,
+	D3D_FEATURE_LEVEL featureLevel,
+	D3D11PipelineStateCache& pipelineCache
+	) :
+	m_d3dDevice(device),
+	m_d3dContext(context),
+	m_featureLevel(featureLevel),
+	m_instancingSupported(featureLevel >= D3D_FEATURE_LEVEL_9_3),
+	m_renderTargetView(nullptr),
+	m_depthStencilView(nullptr),
+	m_scissorEnabled(false),
+	m_pipelineCache(&pipelineCache),
+	m_depthClearHandle(D3D11PipelineStateCache::InvalidHandle),
+	m_constantBufferOffsetting(false),
+	m_objectConstantCapacity(0),
+	m_instanceCapacity(0),
+	m_emulationVertexCapacity(0),
+	m_dynamicBaseVertex(0),
+	m_jobSystem(nullptr),
+	m_recordingPartitionCount(1),
+	m_ownedFrameArena(0),
+	m_frameArena(nullptr)
+{
+	m_frameArena = &m_ownedFrameArena;
+	SetScissorRect(nullptr);
+
+	// 定数バッファーの一部を更新し、オフセットを指定してバインドできるか。D3D11.1 のランタイムとドライバーによります。
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	ZeroMemory(&options, sizeof(options));
+	if (SUCCEEDED(m_d3dDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+	{
+		m_constantBufferOffsetting = options.ConstantBufferOffsetting && options.ConstantBufferPartialUpdate;
+	}
+
+	for (uint32 stage = 0; stage < VertexStageCount; ++stage)
+	{
+		for (uint32 pipelineId = 0; pipelineId < PipelineCount; ++pipelineId)
+		{
+			m_pipelineHandles[stage][pipelineId] = D3D11PipelineStateCache::InvalidHandle;
+		}
+	}
+}
+
+D3D11RenderDevice::BoundPipelineState::BoundPipelineState(VertexStage stage, uint32 pipelineId) :
+	stage(stage),
+	pipelineId(pipelineId),
+	inputLayout(nullptr),
+	vertexShader(nullptr),
+	pixelShader(nullptr),
+	rasterizerState(nullptr),
+	blendState(nullptr),
+	depthStencilState(nullptr)
+{
+}
+
+task<void> D3D11RenderDevice::CreateDeviceResourcesAsync()
+{
+	// CULL_NONE では両面とも頂点の色で描くので、面の向きを調べるシェーダーは要りません。
+	// LOD のフェードをディザで行うシェーダーは整数演算を使うので、機能レベル 10_0 以上でのみ作成できます。
+	// それ以下ではフェードしない SimplePixelShader をそのまま使います。
+	const char* cullNonePixelShader = m_featureLevel >= D3D_FEATURE_LEVEL_10_0 ? "DitherFadePixelShader.cso" : "SimplePixelShader.cso";
+
+	// インスタンス描画をサポートする機能レベルではエミュレーション用のステージを、しなければインスタンス描画のステージを使いません。
+	std::vector<PipelineStateDesc> descs;
+	std::vector<std::pair<uint32, uint32>> slots;
+	for (uint32 stage = 0; stage < VertexStageCount; ++stage)
+	{
+		if ((stage != VertexStageSimple) != m_instancingSupported)
+		{
+			continue;
+		}
+
+		for (uint32 pipelineId = 0; pipelineId < PipelineCount; ++pipelineId)
+		{
+			const CullMode cullMode = GetPipelineCullMode(pipelineId);
+			descs.push_back(
+				PipelineStateKey::MakeDesc(
+					VertexStageShaders[stage],
+					cullMode == CullMode::None ? cullNonePixelShader : "SimplePixelShader.cso",
+					VertexStageFormats[stage],
+					VertexStageInstanced[stage],
+					cullMode,
+					BlendMode::Opaque,
+					DepthMode::ReadWrite
+					)
+				);
+			slots.push_back(std::make_pair(stage, pipelineId));
+		}
+	}
+
+	// シザー矩形の内側の深度をクリアするステート。色は ClearView でクリアするので書き込みません。
+	// 機能レベル 9_x はピクセル シェーダーを省略できないので、SimplePixelShader を設定しておきます。
+	descs.push_back(
+		PipelineStateKey::MakeDesc(
+			"DepthClearVertexShader.cso",
+			"SimplePixelShader.cso",
+			VertexFormat::PositionColor,
+			false,
+			CullMode::None,
+			BlendMode::NoColor,
+			DepthMode::Overwrite
+			)
+		);
+
+	return m_pipelineCache->PrepareAsync(descs).then([this, slots] (std::vector<uint32> handles) {
+		for (size_t i = 0; i < slots.size(); ++i)
+		{
+			m_pipelineHandles[slots[i].first][slots[i].second] = handles[i];
+		}
+		m_depthClearHandle = handles.back();
+
+		// 描画先全体を覆う三角形。頂点シェーダーが z を 1.0 にします。
+		const VertexPositionColor depthClearVertices[] =
+		{
+			{ XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) },
+			{ XMFLOAT3(-1.0f, 3.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) },
+			{ XMFLOAT3(3.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) }
+		};
+		D3D11_SUBRESOURCE_DATA depthClearVertexData = { 0 };
+		depthClearVertexData.pSysMem = depthClearVertices;
+		CD3D11_BUFFER_DESC depthClearVertexBufferDesc(sizeof(depthClearVertices), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+		DX::ThrowIfFailed(
+			m_d3dDevice->CreateBuffer(
+				&depthClearVertexBufferDesc,
+				&depthClearVertexData,
+				&m_depthClearVertexBuffer
+				)
+			);
+
+		CD3D11_BUFFER_DESC projectionBufferDesc(sizeof(ProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+		DX::ThrowIfFailed(
+			m_d3dDevice->CreateBuffer(
+				&projectionBufferDesc,
+				nullptr,
+				&m_projectionConstantBuffer
+				)
+			);
+
+		CD3D11_BUFFER_DESC viewBufferDesc(sizeof(ViewConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+		DX::ThrowIfFailed(
+			m_d3dDevice->CreateBuffer(
+				&viewBufferDesc,
+				nullptr,
+				&m_viewConstantBuffer
+				)
+			);
+
+		// オフセットでバインドできなければ、オブジェクトごとの定数は 1 つ分のバッファーを書き換えて使います。
+		if (!m_instancingSupported && !m_constantBufferOffsetting)
+		{
+			CD3D11_BUFFER_DESC modelBufferDesc(sizeof(ModelConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+			DX::ThrowIfFailed(
+				m_d3dDevice->CreateBuffer(
+					&modelBufferDesc,
+					nullptr,
+					&m_modelConstantBuffer
+					)
+				);
+		}
+
+		if (m_instancingSupported)
+		{
+			CD3D11_BUFFER_DESC quantizationBufferDesc(sizeof(PositionQuantizationConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+			DX::ThrowIfFailed(
+				m_d3dDevice->CreateBuffer(
+					&quantizationBufferDesc,
+					nullptr,
+					&m_quantizationConstantBuffer
+					)
+				);
+		}
+	});
+}
+
+void D3D11RenderDevice::SetRenderTargets(ID3D11RenderTargetView* renderTargetView, ID3D11DepthStencilView* depthStencilView)
+{
+	m_renderTargetView = renderTargetView;
+	m_depthStencilView = depthStencilView;
+}
+
+uint32_t D3D11RenderDevice::CreateMesh(const MeshData& meshData)
+{
+	// 32 ビットのインデックスは機能レベル 10_0 以上でだけ使い、9_x では 16 ビットのチャンクに分割します。
+	// 9_1 は 1 回の描画の三角形数も制限されるので、チャンクの大きさをそれに合わせます。
+	IndexedMeshLayout layout;
+	MeshChunking::BuildLayout(
+		meshData,
+		m_featureLevel >= D3D_FEATURE_LEVEL_10_0,
+		m_featureLevel == D3D_FEATURE_LEVEL_9_1 ? MeshChunking::MaxTrianglesPerDraw9_1 : 0,
+		layout
+		);
+
+	Mesh mesh;
+	mesh.indexFormat = layout.indexFormat == IndexFormat::Uint32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+	mesh.chunks = layout.chunks;
+	mesh.format = m_instancingSupported ? meshData.format : VertexFormat::PositionColor;
+	if (!m_instancingSupported)
+	{
+		mesh.vertices = layout.vertices;
+	}
+
+	// 頂点かインデックスのないメッシュはバッファーを作らず、描画する範囲も持たせません。
+	const uint32 vertexCount = static_cast<uint32>(layout.vertices.size());
+	if (vertexCount == 0 || (layout.indices16.empty() && layout.indices32.empty()))
+	{
+		mesh.chunks.clear();
+		m_meshes.push_back(mesh);
+		return static_cast<uint32_t>(m_meshes.size() - 1);
+	}
+
+	std::vector<VertexPositionColorCompact> compactVertices;
+	D3D11_SUBRESOURCE_DATA vertexBufferData = {0};
+	vertexBufferData.pSysMem = &layout.vertices[0];
+	vertexBufferData.SysMemPitch = 0;
+	vertexBufferData.SysMemSlicePitch = 0;
+	if (mesh.format == VertexFormat::Compact)
+	{
+		mesh.quantization = CompactVertexEncoder::ComputeQuantization(&layout.vertices[0], vertexCount);
+		compactVertices.resize(vertexCount);
+		CompactVertexEncoder::Encode(&layout.vertices[0], vertexCount, mesh.quantization, &compactVertices[0], nullptr);
+		vertexBufferData.pSysMem = &compactVertices[0];
+	}
+
+	CD3D11_BUFFER_DESC vertexBufferDesc(
+		GetVertexStride(mesh.format) * vertexCount,
+		D3D11_BIND_VERTEX_BUFFER,
+		D3D11_USAGE_IMMUTABLE
+		);
+	DX::ThrowIfFailed(
+		m_d3dDevice->CreateBuffer(
+			&vertexBufferDesc,
+			&vertexBufferData,
+			&mesh.vertexBuffer
+			)
+		);
+
+	D3D11_SUBRESOURCE_DATA indexBufferData = {0};
+	UINT indexBufferSize;
+	if (layout.indexFormat == IndexFormat::Uint32)
+	{
+		indexBufferData.pSysMem = &layout.indices32[0];
+		indexBufferSize = static_cast<UINT>(sizeof(uint32_t) * layout.indices32.size());
+	}
+	else
+	{
+		indexBufferData.pSysMem = &layout.indices16[0];
+		indexBufferSize = static_cast<UINT>(sizeof(uint16_t) * layout.indices16.size());
+	}
+	indexBufferData.SysMemPitch = 0;
+	indexBufferData.SysMemSlicePitch = 0;
+	CD3D11_BUFFER_DESC indexBufferDesc(
+		indexBufferSize,
+		D3D11_BIND_INDEX_BUFFER,
+		D3D11_USAGE_IMMUTABLE
+		);
+	DX::ThrowIfFailed(
+		m_d3dDevice->CreateBuffer(
+			&indexBufferDesc,
+			&indexBufferData,
+			&mesh.indexBuffer
+			)
+		);
+
+	m_meshes.push_back(mesh);
+	return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+void D3D11RenderDevice::Clear(const float color[4])
+{
+	// ClearRenderTargetView と ClearDepthStencilView はシザー矩形によらず全体をクリアします。
+	// 矩形の内側だけをクリアするときは、色は D3D11.1 の ClearView で、深度は遠平面に三角形を描いてクリアします。
+	// 深度を全体でクリアすると、矩形の外側に残した描画の深度が失われます。
+	if (m_scissorEnabled)
+	{
+		m_d3dContext->ClearView(
+			m_renderTargetView,
+			color,
+			&m_scissorRect,
+			1
+			);
+		ClearDepthInScissorRect();
+		return;
+	}
+
+	m_d3dContext->ClearRenderTargetView(
+		m_renderTargetView,
+		color
+		);
+
+	m_d3dContext->ClearDepthStencilView(
+		m_depthStencilView,
+		D3D11_CLEAR_DEPTH,
+		1.0f,
+		0
+		);
+}
+
+/**
+ * 描画先を覆う三角形を、深度を比べずに遠平面 (1.0) で書き込みます。色は書き込みません。
+ * ここで設定したステートは、Execute がコンテキストごとに最初から設定し直します。
+ */
+void D3D11RenderDevice::ClearDepthInScissorRect()
+{
+	const D3D11PipelineState& state = m_pipelineCache->GetState(m_depthClearHandle);
+
+	m_d3dContext->OMSetRenderTargets(
+		1,
+		&m_renderTargetView,
+		m_depthStencilView
+		);
+	m_d3dContext->RSSetScissorRects(1, &m_scissorRect);
+
+	const UINT stride = sizeof(VertexPositionColor);
+	const UINT offset = 0;
+	m_d3dContext->IASetVertexBuffers(
+		0,
+		1,
+		m_depthClearVertexBuffer.GetAddressOf(),
+		&stride,
+		&offset
+		);
+	m_d3dContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_d3dContext->IASetInputLayout(state.inputLayout.Get());
+
+	m_d3dContext->VSSetShader(
+		state.vertexShader.Get(),
+		nullptr,
+		0
+		);
+	m_d3dContext->PSSetShader(
+		state.pixelShader.Get(),
+		nullptr,
+		0
+		);
+	m_d3dContext->RSSetState(state.rasterizerState.Get());
+	m_d3dContext->OMSetBlendState(state.blendState.Get(), nullptr, 0xFFFFFFFF);
+	m_d3dContext->OMSetDepthStencilState(state.depthStencilState.Get(), 0);
+
+	m_d3dContext->Draw(3, 0);
+}
+
+void D3D11RenderDevice::SetScissorRect(const ScreenRect* rect)
+{
+	m_scissorEnabled = rect != nullptr;
+	if (rect != nullptr)
+	{
+		m_scissorRect.left = rect->left;
+		m_scissorRect.top = rect->top;
+		m_scissorRect.right = rect->right;
+		m_scissorRect.bottom = rect->bottom;
+	}
+	else
+	{
+		m_scissorRect.left = 0;
+		m_scissorRect.top = 0;
+		m_scissorRect.right = D3D11_VIEWPORT_BOUNDS_MAX;
+		m_scissorRect.bottom = D3D11_VIEWPORT_BOUNDS_MAX;
+	}
+}
+
+void D3D11RenderDevice::SetJobSystem(JobSystem* jobSystem)
+{
+	m_jobSystem = jobSystem;
+}
+
+void D3D11RenderDevice::SetRecordingPartitionCount(uint32_t partitionCount)
+{
+	m_recordingPartitionCount = std::max(partitionCount, 1u);
+}
+
+void D3D11RenderDevice::SetConstants(const ModelViewProjectionConstantBuffer& constants)
+{
+	m_constantBufferData = constants;
+}
+
+uint32_t D3D11RenderDevice::AppendDynamicVertices(const VertexPositionColor* vertices, uint32_t count)
+{
+	const uint32_t firstVertex = static_cast<uint32_t>(m_dynamicVertices.size());
+	m_dynamicVertices.insert(m_dynamicVertices.end(), vertices, vertices + count);
+	return firstVertex;
+}
+
+void D3D11RenderDevice::SetFrameArena(FrameArena* arena)
+{
+	m_frameArena = arena != nullptr ? arena : &m_ownedFrameArena;
+}
+
+void D3D11RenderDevice::Execute(const RenderCommandList& commandList)
+{
+	if (m_frameArena == &m_ownedFrameArena)
+	{
+		m_ownedFrameArena.Reset();
+	}
+
+	if (commandList.GetInstances().empty())
+	{
+		m_dynamicVertices.clear();
+		return;
+	}
+
+	UploadFrameConstants();
+
+	SetCommonState(m_d3dContext.Get());
+
+	UploadDynamicVertices();
+
+	if (m_instancingSupported)
+	{
+		ExecuteInstanced(commandList);
+	}
+	else
+	{
+		ExecuteEmulated(commandList);
+	}
+
+	// 動的頂点を参照する描画をすべて発行したので、書き込んだ領域をフェンスで保護します。
+	if (m_dynamicVertexRing != nullptr)
+	{
+		m_dynamicVertexRing->Submit();
+	}
+	m_dynamicVertices.clear();
+}
+
+// すべてのパイプラインで共通のステートは、コンテキストごとに最初に 1 度だけ設定します。
+void D3D11RenderDevice::SetCommonState(ID3D11DeviceContext1* context)
+{
+	context->OMSetRenderTargets(
+		1,
+		&m_renderTargetView,
+		m_depthStencilView
+		);
+
+	context->RSSetScissorRects(1, &m_scissorRect);
+
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	ID3D11Buffer* constantBuffers[] = { m_projectionConstantBuffer.Get(), m_viewConstantBuffer.Get() };
+	context->VSSetConstantBuffers(
+		0,
+		ARRAYSIZE(constantBuffers),
+		constantBuffers
+		);
+
+	// オフセットでバインドできないときの、オブジェクトごとの定数。
+	if (m_modelConstantBuffer != nullptr)
+	{
+		context->VSSetConstantBuffers(
+			2,
+			1,
+			m_modelConstantBuffer.GetAddressOf()
+			);
+	}
+
+	// 量子化の定数は CompactInstancedVertexShader だけが使います。ほかのシェーダーはスロット 3 を参照しません。
+	if (m_quantizationConstantBuffer != nullptr)
+	{
+		context->VSSetConstantBuffers(
+			3,
+			1,
+			m_quantizationConstantBuffer.GetAddressOf()
+			);
+	}
+}
+
+// 射影行列とビュー行列は、前回書き込んだ内容から変わったときだけ書き込みます。
+// 射影行列はウィンドウの大きさが変わったときにしか変わらず、ビュー行列もカメラが動かなければ変わりません。
+void D3D11RenderDevice::UploadFrameConstants()
+{
+	ProjectionConstantBuffer projection;
+	projection.projection = m_constantBufferData.projection;
+	UploadIfChanged(m_projectionConstantBuffer.Get(), m_projectionTracker, &projection, sizeof(projection));
+
+	ViewConstantBuffer view;
+	view.view = m_constantBufferData.view;
+	UploadIfChanged(m_viewConstantBuffer.Get(), m_viewTracker, &view, sizeof(view));
+}
+
+// バッファー全体を 1 つの値として扱い、前回から変わったときだけ書き込みます。
+void D3D11RenderDevice::UploadIfChanged(ID3D11Buffer* buffer, DirtyRangeTracker& tracker, const void* data, uint32 size)
+{
+	tracker.Update(data, size, size, 1, m_dirtyRanges);
+	if (m_dirtyRanges.empty())
+	{
+		return;
+	}
+
+	m_d3dContext->UpdateSubresource(
+		buffer,
+		0,
+		NULL,
+		data,
+		0,
+		0
+		);
+}
+
+// 前回から変わった要素の範囲だけを書き込みます。
+// 定数バッファーに使うときは、一部の更新がサポートされていなければなりません。
+void D3D11RenderDevice::UploadChangedRanges(ID3D11Buffer* buffer, DirtyRangeTracker& tracker, const void* data, uint32 size, uint32 elementSize)
+{
+	tracker.Update(data, size, elementSize, MaxUploadRanges, m_dirtyRanges);
+	for (const DirtyRange& range : m_dirtyRanges)
+	{
+		D3D11_BOX box = { range.begin, 0, 0, range.end, 1, 1 };
+		m_d3dContext->UpdateSubresource1(
+			buffer,
+			0,
+			&box,
+			static_cast<const uint8*>(data) + range.begin,
+			0,
+			0,
+			0
+			);
+	}
+}
+
+/**
+ * このフレームの動的頂点を 1 回の Write でリング バッファーに書き込みます。
+ * 通常は NO_OVERWRITE で追記し、GPU が使用中の領域と重なるときだけ DISCARD になります。
+ */
+void D3D11RenderDevice::UploadDynamicVertices()
+{
+	if (m_dynamicVertices.empty())
+	{
+		return;
+	}
+
+	const uint32 size = static_cast<uint32>(sizeof(VertexPositionColor) * m_dynamicVertices.size());
+	if (m_dynamicVertexBuffer == nullptr || size > m_dynamicVertexBuffer->GetCapacity())
+	{
+		uint32 capacity = m_dynamicVertexBuffer != nullptr ? m_dynamicVertexBuffer->GetCapacity() : InitialDynamicVertexBufferSize;
+		while (capacity < size)
+		{
+			capacity *= 2;
+		}
+
+		m_dynamicVertexRing.reset();
+		m_dynamicVertexBuffer.reset(new D3D11DynamicBuffer(m_d3dDevice, m_d3dContext, capacity, D3D11_BIND_VERTEX_BUFFER));
+		m_dynamicVertexRing.reset(new VertexRingBuffer(*m_dynamicVertexBuffer));
+	}
+
+	uint32_t offset = 0;
+	m_dynamicVertexRing->Write(&m_dynamicVertices[0], size, sizeof(VertexPositionColor), &offset);
+	m_dynamicBaseVertex = offset / sizeof(VertexPositionColor);
+}
+
+/**
+ * インスタンス データをまとめてアップロードし、
+ * グループごとに 1 回の DrawIndexedInstanced で描画します。
+ */
+void D3D11RenderDevice::ExecuteInstanced(const RenderCommandList& commandList)
+{
+	const std::vector<InstanceData>& instances = commandList.GetInstances();
+
+	// 動かないオブジェクトのインスタンス データは前のフレームと同じなので、変わった範囲だけを書き込みます。
+	if (EnsureBufferCapacity(
+		m_instanceBuffer,
+		m_instanceCapacity,
+		sizeof(InstanceData),
+		static_cast<uint32>(instances.size()),
+		D3D11_BIND_VERTEX_BUFFER,
+		false
+		))
+	{
+		m_instanceTracker.Invalidate();
+	}
+
+	UploadChangedRanges(
+		m_instanceBuffer.Get(),
+		m_instanceTracker,
+		&instances[0],
+		static_cast<uint32>(sizeof(InstanceData) * instances.size()),
+		sizeof(InstanceData)
+		);
+
+	// 範囲が 1 つなら、イミディエイト コンテキストに直接記録します。
+	RenderCommandPartitioner::Partition(
+		commandList,
+		m_jobSystem != nullptr ? m_recordingPartitionCount : 1,
+		MinDrawsPerPartition,
+		m_partitions
+		);
+	if (m_partitions.size() == 1)
+	{
+		RecordInstancedCommands(m_d3dContext.Get(), commandList, m_partitions[0]);
+		return;
+	}
+
+	const uint32 partitionCount = static_cast<uint32>(m_partitions.size());
+	while (m_deferredContexts.size() < partitionCount)
+	{
+		ComPtr<ID3D11DeviceContext1> deferredContext;
+		DX::ThrowIfFailed(
+			m_d3dDevice->CreateDeferredContext1(0, &deferredContext)
+			);
+		m_deferredContexts.push_back(deferredContext);
+	}
+	m_commandLists.resize(partitionCount);
+
+	// 遅延コンテキストはステートを引き継がないので、イミディエイト コンテキストと同じ共通のステートから始めます。
+	D3D11_VIEWPORT viewport;
+	UINT viewportCount = 1;
+	m_d3dContext->RSGetViewports(&viewportCount, &viewport);
+
+	// ワーカー スレッドでは例外を投げずに結果だけを返し、このスレッドで確認します。
+	HRESULT* results = m_frameArena->AllocateArray<HRESULT>(partitionCount);
+	std::fill(results, results + partitionCount, S_OK);
+	m_jobSystem->ParallelFor(partitionCount, 1, [&] (uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			ID3D11DeviceContext1* deferredContext = m_deferredContexts[i].Get();
+			SetCommonState(deferredContext);
+			deferredContext->RSSetViewports(viewportCount, &viewport);
+			RecordInstancedCommands(deferredContext, commandList, m_partitions[i]);
+			results[i] = deferredContext->FinishCommandList(FALSE, &m_commandLists[i]);
+		}
+	});
+
+	for (uint32 i = 0; i < partitionCount; ++i)
+	{
+		DX::ThrowIfFailed(results[i]);
+		m_d3dContext->ExecuteCommandList(m_commandLists[i].Get(), TRUE);
+		m_commandLists[i] = nullptr;
+	}
+}
+
+// partition の範囲のコマンドを context に記録します。
+// 範囲の先頭で有効なパイプラインとメッシュを設定してから始めるので、どのコンテキストにも同じ結果が記録されます。
+void D3D11RenderDevice::RecordInstancedCommands(
+	ID3D11DeviceContext1* context,
+	const RenderCommandList& commandList,
+	const RenderCommandPartition& partition
+	)
+{
+	// 範囲より前に SetPipelineState がなければ、PipelineDefault から始めます。
+	BoundPipelineState bound(
+		VertexStageInstanced,
+		partition.pipelineId != RenderCommandPartition::NoState ? partition.pipelineId : PipelineDefault
+		);
+	ApplyPipelineState(context, bound);
+
+	// DrawDynamic はスロット 0 を差し替えるので、その後の DrawInstanced ではメッシュを設定し直します。
+	uint32 boundMesh = UINT_MAX;
+	if (partition.meshId != RenderCommandPartition::NoState)
+	{
+		BindInstancedMesh(context, partition.meshId, bound);
+		boundMesh = partition.meshId;
+	}
+
+	const std::vector<RenderCommand>& commands = commandList.GetCommands();
+	for (uint32 c = partition.firstCommand; c < partition.firstCommand + partition.commandCount; ++c)
+	{
+		const RenderCommand& command = commands[c];
+		switch (command.type)
+		{
+		case RenderCommandType::SetPipelineState:
+			SetPipelineState(context, command.arg0, bound);
+			break;
+
+		case RenderCommandType::SetMesh:
+			BindInstancedMesh(context, command.arg0, bound);
+			boundMesh = command.arg0;
+			break;
+
+		case RenderCommandType::DrawInstanced:
+			if (boundMesh != command.arg0)
+			{
+				BindInstancedMesh(context, command.arg0, bound);
+				boundMesh = command.arg0;
+			}
+
+			for (const MeshChunk& chunk : m_meshes[command.arg0].chunks)
+			{
+				context->DrawIndexedInstanced(
+					chunk.indexCount,
+					command.arg2,
+					chunk.startIndex,
+					chunk.baseVertex,
+					command.arg1
+					);
+			}
+			break;
+
+		case RenderCommandType::DrawDynamic:
+			{
+				SetVertexStage(context, VertexStageInstanced, bound);
+
+				ID3D11Buffer* vertexBuffers[] = { m_dynamicVertexBuffer->GetBuffer(), m_instanceBuffer.Get() };
+				UINT strides[] = { sizeof(VertexPositionColor), sizeof(InstanceData) };
+				UINT offsets[] = { 0, 0 };
+				context->IASetVertexBuffers(
+					0,
+					ARRAYSIZE(vertexBuffers),
+					vertexBuffers,
+					strides,
+					offsets
+					);
+				boundMesh = UINT_MAX;
+
+				context->DrawInstanced(
+					command.arg1,
+					1,
+					m_dynamicBaseVertex + command.arg0,
+					command.arg2
+					);
+			}
+			break;
+		}
+	}
+}
+
+// メッシュの頂点をスロット 0 に、インスタンス データをスロット 1 に設定します。
+// 頂点の形式が変わるときはシェーダーと入力レイアウトも切り替えます。
+void D3D11RenderDevice::BindInstancedMesh(ID3D11DeviceContext1* context, uint32 meshId, BoundPipelineState& bound)
+{
+	const Mesh& mesh = m_meshes[meshId];
+	SetVertexStage(context, mesh.format == VertexFormat::Compact ? VertexStageCompact : VertexStageInstanced, bound);
+
+	if (mesh.format == VertexFormat::Compact)
+	{
+		context->UpdateSubresource(
+			m_quantizationConstantBuffer.Get(),
+			0,
+			NULL,
+			&mesh.quantization,
+			0,
+			0
+			);
+	}
+
+	ID3D11Buffer* vertexBuffers[] = { mesh.vertexBuffer.Get(), m_instanceBuffer.Get() };
+	UINT strides[] = { GetVertexStride(mesh.format), sizeof(InstanceData) };
+	UINT offsets[] = { 0, 0 };
+	context->IASetVertexBuffers(
+		0,
+		ARRAYSIZE(vertexBuffers),
+		vertexBuffers,
+		strides,
+		offsets
+		);
+
+	context->IASetIndexBuffer(
+		mesh.indexBuffer.Get(),
+		mesh.indexFormat,
+		0
+		);
+}
+
+/**
+ * インスタンス描画をサポートしない機能レベル (9_1, 9_2) 用の実行パスです。
+ * インスタンスの色を適用した頂点を 1 つの動的バッファーに展開し、
+ * インスタンスごとにオブジェクトの定数を差し替えて SimpleVertexShader で描画します。
+ */
+void D3D11RenderDevice::ExecuteEmulated(const RenderCommandList& commandList)
+{
+	const std::vector<InstanceData>& instances = commandList.GetInstances();
+
+	uint32 vertexCount = 0;
+	for (const RenderCommand& command : commandList.GetCommands())
+	{
+		if (command.type == RenderCommandType::DrawInstanced)
+		{
+			vertexCount += static_cast<uint32>(m_meshes[command.arg0].vertices.size()) * command.arg2;
+		}
+	}
+
+	EnsureBufferCapacity(
+		m_emulationVertexBuffer,
+		m_emulationVertexCapacity,
+		sizeof(VertexPositionColor),
+		vertexCount,
+		D3D11_BIND_VERTEX_BUFFER,
+		true
+		);
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	DX::ThrowIfFailed(
+		m_d3dContext->Map(
+			m_emulationVertexBuffer.Get(),
+			0,
+			D3D11_MAP_WRITE_DISCARD,
+			0,
+			&mappedResource
+			)
+		);
+	VertexPositionColor* vertices = static_cast<VertexPositionColor*>(mappedResource.pData);
+	for (const RenderCommand& command : commandList.GetCommands())
+	{
+		if (command.type != RenderCommandType::DrawInstanced)
+		{
+			continue;
+		}
+
+		const Mesh& mesh = m_meshes[command.arg0];
+		for (uint32 i = 0; i < command.arg2; ++i)
+		{
+			const XMFLOAT4& color = instances[command.arg1 + i].color;
+			for (const VertexPositionColor& vertex : mesh.vertices)
+			{
+				vertices->pos = vertex.pos;
+				vertices->color = XMFLOAT3(vertex.color.x * color.x, vertex.color.y * color.y, vertex.color.z * color.z);
+				++vertices;
+			}
+		}
+	}
+	m_d3dContext->Unmap(m_emulationVertexBuffer.Get(), 0);
+
+	UploadObjectConstants(commandList);
+
+	BoundPipelineState bound(VertexStageSimple, PipelineDefault);
+	ApplyPipelineState(m_d3dContext.Get(), bound);
+
+	UINT stride = sizeof(VertexPositionColor);
+	UINT offset = 0;
+	bool emulationBufferBound = false;
+
+	uint32 baseVertex = 0;
+	uint32 objectSlot = 0;
+	for (const RenderCommand& command : commandList.GetCommands())
+	{
+		if (command.type == RenderCommandType::DrawInstanced && !emulationBufferBound)
+		{
+			m_d3dContext->IASetVertexBuffers(
+				0,
+				1,
+				m_emulationVertexBuffer.GetAddressOf(),
+				&stride,
+				&offset
+				);
+			emulationBufferBound = true;
+		}
+
+		switch (command.type)
+		{
+		case RenderCommandType::SetPipelineState:
+			SetPipelineState(m_d3dContext.Get(), command.arg0, bound);
+			break;
+
+		case RenderCommandType::SetMesh:
+			m_d3dContext->IASetIndexBuffer(
+				m_meshes[command.arg0].indexBuffer.Get(),
+				m_meshes[command.arg0].indexFormat,
+				0
+				);
+			break;
+
+		case RenderCommandType::DrawInstanced:
+			{
+				const Mesh& mesh = m_meshes[command.arg0];
+				for (uint32 i = 0; i < command.arg2; ++i)
+				{
+					BindObjectConstants(objectSlot++, instances[command.arg1 + i].model);
+
+					for (const MeshChunk& chunk : mesh.chunks)
+					{
+						m_d3dContext->DrawIndexed(
+							chunk.indexCount,
+							chunk.startIndex,
+							baseVertex + chunk.baseVertex
+							);
+					}
+					baseVertex += static_cast<uint32>(mesh.vertices.size());
+				}
+			}
+			break;
+
+		case RenderCommandType::DrawDynamic:
+			{
+				BindObjectConstants(objectSlot++, instances[command.arg2].model);
+
+				ID3D11Buffer* dynamicVertexBuffer = m_dynamicVertexBuffer->GetBuffer();
+				m_d3dContext->IASetVertexBuffers(
+					0,
+					1,
+					&dynamicVertexBuffer,
+					&stride,
+					&offset
+					);
+				emulationBufferBound = false;
+
+				m_d3dContext->Draw(
+					command.arg1,
+					m_dynamicBaseVertex + command.arg0
+					);
+			}
+			break;
+		}
+	}
+}
+
+/**
+ * エミュレーションで描画するオブジェクトの定数を、描画の順に 1 つの大きなバッファーに並べて書き込みます。
+ * 前のフレームから変わった範囲だけを書き込み、描画ごとにオフセットを指定してバインドします。
+ * オフセットでのバインドがサポートされていなければ、BindObjectConstants が描画ごとに書き込みます。
+ */
+void D3D11RenderDevice::UploadObjectConstants(const RenderCommandList& commandList)
+{
+	if (!m_constantBufferOffsetting)
+	{
+		return;
+	}
+
+	const std::vector<InstanceData>& instances = commandList.GetInstances();
+	m_objectConstants.clear();
+	for (const RenderCommand& command : commandList.GetCommands())
+	{
+		uint32 first = 0;
+		uint32 count = 0;
+		if (command.type == RenderCommandType::DrawInstanced)
+		{
+			first = command.arg1;
+			count = command.arg2;
+		}
+		else if (command.type == RenderCommandType::DrawDynamic)
+		{
+			first = command.arg2;
+			count = 1;
+		}
+
+		for (uint32 i = first; i < first + count; ++i)
+		{
+			ObjectConstantSlot slot;
+			ZeroMemory(&slot, sizeof(slot));
+			XMStoreFloat4x4(&slot.constants.model, XMMatrixTranspose(XMLoadFloat4x4(&instances[i].model)));
+			m_objectConstants.push_back(slot);
+		}
+	}
+
+	if (m_objectConstants.empty())
+	{
+		return;
+	}
+
+	if (EnsureBufferCapacity(
+		m_objectConstantBuffer,
+		m_objectConstantCapacity,
+		sizeof(ObjectConstantSlot),
+		static_cast<uint32>(m_objectConstants.size()),
+		D3D11_BIND_CONSTANT_BUFFER,
+		false
+		))
+	{
+		m_objectConstantTracker.Invalidate();
+	}
+
+	UploadChangedRanges(
+		m_objectConstantBuffer.Get(),
+		m_objectConstantTracker,
+		&m_objectConstants[0],
+		static_cast<uint32>(sizeof(ObjectConstantSlot) * m_objectConstants.size()),
+		sizeof(ObjectConstantSlot)
+		);
+}
+
+// slot 番目の描画のオブジェクトの定数をスロット 2 に設定します。
+void D3D11RenderDevice::BindObjectConstants(uint32 slot, const XMFLOAT4X4& model)
+{
+	if (m_constantBufferOffsetting)
+	{
+		const UINT firstConstant = slot * ObjectConstantSlotConstants;
+		const UINT constantCount = ObjectConstantSlotConstants;
+		m_d3dContext->VSSetConstantBuffers1(
+			2,
+			1,
+			m_objectConstantBuffer.GetAddressOf(),
+			&firstConstant,
+			&constantCount
+			);
+		return;
+	}
+
+	// 同じバッファーを書き換えるので、続けて同じ行列を使う描画では書き込みを省けます。
+	ModelConstantBuffer constants;
+	XMStoreFloat4x4(&constants.model, XMMatrixTranspose(XMLoadFloat4x4(&model)));
+	UploadIfChanged(m_modelConstantBuffer.Get(), m_modelTracker, &constants, sizeof(constants));
+}
+
+void D3D11RenderDevice::SetVertexStage(ID3D11DeviceContext1* context, VertexStage stage, BoundPipelineState& bound)
+{
+	if (bound.stage != stage)
+	{
+		bound.stage = stage;
+		ApplyPipelineState(context, bound);
+	}
+}
+
+void D3D11RenderDevice::SetPipelineState(ID3D11DeviceContext1* context, uint32 pipelineId, BoundPipelineState& bound)
+{
+	if (bound.pipelineId != pipelineId)
+	{
+		bound.pipelineId = pipelineId;
+		ApplyPipelineState(context, bound);
+	}
+}
+
+/**
+ * 頂点ステージとパイプライン ID に対応するパイプライン ステートを設定します。
+ * キャッシュは同じ内容のオブジェクトを共有するので、ポインターを比べて変わったものだけを設定します。
+ */
+void D3D11RenderDevice::ApplyPipelineState(ID3D11DeviceContext1* context, BoundPipelineState& bound)
+{
+	const D3D11PipelineState& state = m_pipelineCache->GetState(m_pipelineHandles[bound.stage][bound.pipelineId]);
+
+	if (bound.inputLayout != state.inputLayout.Get())
+	{
+		bound.inputLayout = state.inputLayout.Get();
+		context->IASetInputLayout(bound.inputLayout);
+	}
+
+	if (bound.vertexShader != state.vertexShader.Get())
+	{
+		bound.vertexShader = state.vertexShader.Get();
+		context->VSSetShader(
+			bound.vertexShader,
+			nullptr,
+			0
+			);
+	}
+
+	if (bound.pixelShader != state.pixelShader.Get())
+	{
+		bound.pixelShader = state.pixelShader.Get();
+		context->PSSetShader(
+			bound.pixelShader,
+			nullptr,
+			0
+			);
+	}
+
+	if (bound.rasterizerState != state.rasterizerState.Get())
+	{
+		bound.rasterizerState = state.rasterizerState.Get();
+		context->RSSetState(bound.rasterizerState);
+	}
+
+	if (bound.blendState != state.blendState.Get())
+	{
+		bound.blendState = state.blendState.Get();
+		context->OMSetBlendState(bound.blendState, nullptr, 0xFFFFFFFF);
+	}
+
+	if (bound.depthStencilState != state.depthStencilState.Get())
+	{
+		bound.depthStencilState = state.depthStencilState.Get();
+		context->OMSetDepthStencilState(bound.depthStencilState, 0);
+	}
+}
+
+// 必要に応じてバッファーを拡張し、作り直したら true を返します。再作成は容量が足りないときだけ行います。
+// dynamic なら Map で書き込む D3D11_USAGE_DYNAMIC の、そうでなければ UpdateSubresource で書き込む D3D11_USAGE_DEFAULT のバッファーを作ります。
+bool D3D11RenderDevice::EnsureBufferCapacity(
+	ComPtr<ID3D11Buffer>& buffer,
+	uint32& capacity,
+	uint32 elementSize,
+	uint32 elementCount,
+	UINT bindFlags,
+	bool dynamic
+	)
+{
+	if (buffer != nullptr && elementCount <= capacity)
+	{
+		return false;
+	}
+
+	uint32 newCapacity = capacity > 0 ? capacity : 64;
+	while (newCapacity < elementCount)
+	{
+		newCapacity *= 2;
+	}
+
+	CD3D11_BUFFER_DESC bufferDesc(
+		elementSize * newCapacity,
+		bindFlags,
+		dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT,
+		dynamic ? D3D11_CPU_ACCESS_WRITE : 0
+		);
+	DX::ThrowIfFailed(
+		m_d3dDevice->CreateBuffer(
+			&bufferDesc,
+			nullptr,
+			&buffer
+			)
+		);
+	capacity = newCapacity;
+	return true;
+}
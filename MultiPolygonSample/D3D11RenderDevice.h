@@ -0,0 +1,188 @@
+﻿#pragma once
+
+#include <memory>
+#include "DirectXHelper.h"
+#include "RenderDevice.h"
+#include "MeshChunking.h"
+#include "RenderCommandPartition.h"
+#include "JobSystem.h"
+#include "PipelineStates.h"
+#include "D3D11PipelineStateCache.h"
+#include "D3D11DynamicBuffer.h"
+#include "VertexRingBuffer.h"
+#include "DirtyRangeTracker.h"
+#include "FrameArena.h"
+
+// Direct3D 11 による RenderDevice の実装。
+// デバイスとイミディエイト コンテキストは Direct3DBase が作成したものを使い、
+// パイプライン ステートは、デバイスをまたいで使う D3D11PipelineStateCache から受け取り、
+// 定数バッファーとメッシュのバッファーをこのクラスが保持します。
+class D3D11RenderDevice : public RenderDevice
+{
+public:
+	// pipelineCache には、あらかじめ device を設定しておいてください。
+	D3D11RenderDevice(
+		const Microsoft::WRL::ComPtr<ID3D11Device1>& device,
+		const Microsoft::WRL::ComPtr<ID3D11DeviceContext1>& context,
+		D3D_FEATURE_LEVEL featureLevel,
+		D3D11PipelineStateCache& pipelineCache
+		);
+
+	// 使うパイプライン ステートをキャッシュに用意させ、定数バッファーを作成します。
+	Concurrency::task<void> CreateDeviceResourcesAsync();
+
+	// 描画先を設定します。参照は保持しないので、毎フレーム描画の前に呼び出してください。
+	void SetRenderTargets(ID3D11RenderTargetView* renderTargetView, ID3D11DepthStencilView* depthStencilView);
+
+	// コマンドを遅延コンテキストに並列に記録するときに使います。nullptr なら常にイミディエイト コンテキストに記録します。
+	// インスタンス描画をエミュレートする機能レベルでは使いません。
+	void SetJobSystem(JobSystem* jobSystem);
+
+	// RenderDevice メソッド。
+	virtual uint32_t CreateMesh(const MeshData& mesh) override;
+	virtual void Clear(const float color[4]) override;
+	virtual void SetScissorRect(const ScreenRect* rect) override;
+	virtual void SetConstants(const ModelViewProjectionConstantBuffer& constants) override;
+	virtual uint32_t AppendDynamicVertices(const VertexPositionColor* vertices, uint32_t count) override;
+	virtual void Execute(const RenderCommandList& commandList) override;
+	virtual void SetRecordingPartitionCount(uint32_t partitionCount) override;
+	virtual void SetFrameArena(FrameArena* arena) override;
+
+private:
+	// 頂点の形式とインスタンス描画の有無で決まる、頂点シェーダーと入力レイアウトの組み合わせ。
+	enum VertexStage
+	{
+		VertexStageSimple,		// エミュレーション用の SimpleVertexShader
+		VertexStageInstanced,
+		VertexStageCompact,
+		VertexStageCount
+	};
+
+	// コンテキストに設定したパイプライン ステート。前回と同じオブジェクトを設定し直さないために使います。
+	struct BoundPipelineState
+	{
+		BoundPipelineState(VertexStage stage, uint32 pipelineId);
+
+		VertexStage stage;
+		uint32 pipelineId;
+		ID3D11InputLayout* inputLayout;
+		ID3D11VertexShader* vertexShader;
+		ID3D11PixelShader* pixelShader;
+		ID3D11RasterizerState* rasterizerState;
+		ID3D11BlendState* blendState;
+		ID3D11DepthStencilState* depthStencilState;
+	};
+
+	// オフセットでバインドするオブジェクトごとの定数。オフセットの単位に合わせて 256 バイトにします。
+	struct ObjectConstantSlot
+	{
+		ModelConstantBuffer constants;
+		DirectX::XMFLOAT4X4 padding[3];
+	};
+
+	struct Mesh
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+		DXGI_FORMAT indexFormat;
+		std::vector<MeshChunk> chunks;	// 16 ビットのインデックスに収まらないメッシュは複数のチャンクに分けて描画します
+		VertexFormat format;
+		PositionQuantizationConstantBuffer quantization;	// VertexFormat::Compact のときだけ使います
+		std::vector<VertexPositionColor> vertices;	// インスタンス描画をエミュレートするときに使います
+	};
+
+	void ClearDepthInScissorRect();
+	void ExecuteInstanced(const RenderCommandList& commandList);
+	void RecordInstancedCommands(
+		ID3D11DeviceContext1* context,
+		const RenderCommandList& commandList,
+		const RenderCommandPartition& partition
+		);
+	void ExecuteEmulated(const RenderCommandList& commandList);
+	void SetCommonState(ID3D11DeviceContext1* context);
+	void BindInstancedMesh(ID3D11DeviceContext1* context, uint32 meshId, BoundPipelineState& bound);
+	void UploadDynamicVertices();
+	void UploadFrameConstants();
+	void UploadObjectConstants(const RenderCommandList& commandList);
+	void BindObjectConstants(uint32 slot, const DirectX::XMFLOAT4X4& model);
+	void UploadIfChanged(ID3D11Buffer* buffer, DirtyRangeTracker& tracker, const void* data, uint32 size);
+	void UploadChangedRanges(ID3D11Buffer* buffer, DirtyRangeTracker& tracker, const void* data, uint32 size, uint32 elementSize);
+	void SetVertexStage(ID3D11DeviceContext1* context, VertexStage stage, BoundPipelineState& bound);
+	void SetPipelineState(ID3D11DeviceContext1* context, uint32 pipelineId, BoundPipelineState& bound);
+	void ApplyPipelineState(ID3D11DeviceContext1* context, BoundPipelineState& bound);
+	bool EnsureBufferCapacity(
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+		uint32& capacity,
+		uint32 elementSize,
+		uint32 elementCount,
+		UINT bindFlags,
+		bool dynamic
+		);
+
+	Microsoft::WRL::ComPtr<ID3D11Device1> m_d3dDevice;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_d3dContext;
+	D3D_FEATURE_LEVEL m_featureLevel;
+
+	// インスタンス描画は機能レベル 9_3 以上でのみサポートされます。
+	bool m_instancingSupported;
+
+	ID3D11RenderTargetView* m_renderTargetView;
+	ID3D11DepthStencilView* m_depthStencilView;
+
+	// ラスタライザー ステートはシザー テストを常に有効にし、描画先全体を描くときは十分に大きな矩形を設定します。
+	D3D11_RECT m_scissorRect;
+	bool m_scissorEnabled;
+
+	// 頂点ステージとパイプライン ID ごとの、キャッシュのハンドル。
+	D3D11PipelineStateCache* m_pipelineCache;
+	uint32 m_pipelineHandles[VertexStageCount][PipelineCount];
+
+	// シザー矩形の内側の深度だけをクリアするために、描画先を覆う三角形を遠平面に描くパイプライン ステートと頂点。
+	uint32 m_depthClearHandle;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_depthClearVertexBuffer;
+
+	// 定数バッファーは更新の頻度ごとに分け、それぞれ前回書き込んだ内容から変わったときだけ書き込みます。
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_projectionConstantBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_viewConstantBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_quantizationConstantBuffer;
+	DirtyRangeTracker m_projectionTracker;
+	DirtyRangeTracker m_viewTracker;
+	std::vector<DirtyRange> m_dirtyRanges;
+
+	// エミュレーションで使うオブジェクトごとの定数。オフセットでバインドできれば 1 つの大きなバッファーに並べ、
+	// できなければ 1 つ分のバッファーを書き換えます。
+	bool m_constantBufferOffsetting;
+	std::vector<ObjectConstantSlot> m_objectConstants;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_objectConstantBuffer;
+	uint32 m_objectConstantCapacity;
+	DirtyRangeTracker m_objectConstantTracker;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_modelConstantBuffer;
+	DirtyRangeTracker m_modelTracker;
+
+	std::vector<Mesh> m_meshes;
+
+	// インスタンス描画では InstanceData を、エミュレーションでは展開した頂点を格納します。
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_instanceBuffer;
+	uint32 m_instanceCapacity;
+	DirtyRangeTracker m_instanceTracker;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_emulationVertexBuffer;
+	uint32 m_emulationVertexCapacity;
+
+	// AppendDynamicVertices で追加された頂点。Execute でリング バッファーにまとめて書き込みます。
+	std::vector<VertexPositionColor> m_dynamicVertices;
+	std::unique_ptr<D3D11DynamicBuffer> m_dynamicVertexBuffer;
+	std::unique_ptr<VertexRingBuffer> m_dynamicVertexRing;
+	uint32 m_dynamicBaseVertex;
+
+	ModelViewProjectionConstantBuffer m_constantBufferData;
+
+	// 並列に記録するための範囲と、範囲ごとの遅延コンテキスト。
+	JobSystem* m_jobSystem;
+	uint32 m_recordingPartitionCount;
+	std::vector<RenderCommandPartition> m_partitions;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceContext1>> m_deferredContexts;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11CommandList>> m_commandLists;
+
+	FrameArena m_ownedFrameArena;	// SetFrameArena で指定されていないときに使うアロケーター
+	FrameArena* m_frameArena;
+};
@@ -0,0 +1,22 @@
+struct VertexShaderInput
+{
+	float3 pos : POSITION;
+	float3 color : COLOR0;
+};
+
+struct VertexShaderOutput
+{
+	float4 pos : SV_POSITION;
+	float3 color : COLOR0;
+};
+
+// Places the vertex on the far plane without any transform. D3D11RenderDevice::Clear draws a triangle
+// covering the render target with this shader to reset the depth buffer inside the scissor rectangle only,
+// which ClearDepthStencilView cannot do.
+VertexShaderOutput main(VertexShaderInput input)
+{
+	VertexShaderOutput output;
+	output.pos = float4(input.pos.xy, 1.0f, 1.0f);
+	output.color = input.color;
+	return output;
+}
@@ -1,6 +1,6 @@
 ﻿#include "pch.h"
 #include "Direct3DApp1.h"
-#include "BasicTimer.h"
+#include <fstream>
 
 using namespace Windows::ApplicationModel;
 using namespace Windows::ApplicationModel::Core;
@@ -11,9 +11,28 @@ using namespace Windows::Foundation;
 using namespace Windows::Graphics::Display;
 using namespace concurrency;
 
+namespace
+{
+	// Pipelined では描画するのが 1 フレーム前に更新したスナップショットなので、変更を表示するには 2 フレーム描画します。
+	FrameSchedulerSettings GetFrameSchedulerSettings(FramePipelineMode mode)
+	{
+		FrameSchedulerSettings settings;
+		settings.redrawFrameCount = mode == FramePipelineMode::Pipelined ? 2 : 1;
+		return settings;
+	}
+
+	double GetSeconds()
+	{
+		return static_cast<double>(ProfilerClock::Now()) / static_cast<double>(ProfilerClock::GetFrequency());
+	}
+}
+
 Direct3DApp1::Direct3DApp1() :
 	m_windowClosed(false),
-	m_windowVisible(true)
+	m_windowVisible(true),
+	m_framePipelineMode(FramePipelineMode::Serial),
+	m_maximumFrameLatency(1),
+	m_frameScheduler(GetFrameSchedulerSettings(m_framePipelineMode))
 {
 }
 
@@ -29,6 +48,11 @@ void Direct3DApp1::Initialize(CoreApplicationView^ applicationView)
         ref new EventHandler<Platform::Object^>(this, &Direct3DApp1::OnResuming);
 
 	m_renderer = ref new CubeRenderer();
+	m_renderer->SetProfiler(&m_profiler);
+
+	// Pipelined にすると更新と描画が重なり、表示は 1 フレーム遅れます。
+	// フレーム レイテンシを 2 以上にすると、Present で待つ代わりに次のフレームの処理を始められます。
+	m_renderer->SetMaximumFrameLatency(m_maximumFrameLatency);
 }
 
 void Direct3DApp1::SetWindow(CoreWindow^ window)
@@ -55,21 +79,73 @@ void Direct3DApp1::SetWindow(CoreWindow^ window)
 
 void Direct3DApp1::Load(Platform::String^ entryPoint)
 {
+	// パッケージに含めたメッシュを、既定のポリゴンの上に置きます。
+	// 読み込みはワーカー スレッドで進み、終わったものから Run のループで ProcessLoadedMeshes がシーンに追加します。
+	DirectX::XMFLOAT4X4 transform;
+	DirectX::XMStoreFloat4x4(&transform, DirectX::XMMatrixMultiply(DirectX::XMMatrixScaling(0.3f, 0.3f, 0.3f), DirectX::XMMatrixTranslation(0.0f, 0.5f, 0.0f)));
+	m_renderer->LoadMeshAsync("Assets\\Torus.pmsh", transform, DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
 }
 
 void Direct3DApp1::Run()
 {
-	BasicTimer^ timer = ref new BasicTimer();
+	FramePipeline pipeline(m_framePipelineMode);
+	FrameDecision decision;
+	double frameBegin = 0.0;
+	double workSeconds = 0.0;
+
+	// Pipelined では更新がワーカー スレッドで実行されますが、イベントの処理とは重なりません。
+	// 時刻はスケジューラーが固定の刻みで進め、刻みの間を補間したものです。
+	FramePipeline::StageFunction update = [this, &decision] (uint32_t slot)
+	{
+		ProfileZone zone(&m_profiler, "Update");
+		m_renderer->UpdateSnapshot(slot, static_cast<float>(decision.renderTime), static_cast<float>(decision.renderDelta));
+	};
+
+	FramePipeline::StageFunction render = [this, &frameBegin, &workSeconds] (uint32_t slot)
+	{
+		{
+			ProfileZone zone(&m_profiler, "Render");
+			m_renderer->RenderSnapshot(slot);
+		}
+		// 垂直同期を待つ前までを、このフレームの処理時間とします。
+		workSeconds = GetSeconds() - frameBegin;
+		{
+			ProfileZone zone(&m_profiler, "Present");
+			m_renderer->Present(); // この呼び出しは、表示フレーム レートに同期されます。
+		}
+	};
 
 	while (!m_windowClosed)
 	{
 		if (m_windowVisible)
 		{
-			timer->Update();
-			CoreWindow::GetForCurrentThread()->Dispatcher->ProcessEvents(CoreProcessEventsOption::ProcessAllIfPresent);
-			m_renderer->Update(timer->Total, timer->Delta);
-			m_renderer->Render();
-			m_renderer->Present(); // この呼び出しは、表示フレーム レートに同期されます。
+			{
+				ProfileZone zone(&m_profiler, "ProcessEvents");
+				CoreWindow::GetForCurrentThread()->Dispatcher->ProcessEvents(CoreProcessEventsOption::ProcessAllIfPresent);
+			}
+			{
+				ProfileZone zone(&m_profiler, "LoadMeshes");
+				if (m_renderer->ProcessLoadedMeshes() > 0)
+				{
+					m_frameScheduler.RequestRedraw();
+				}
+			}
+
+			frameBegin = GetSeconds();
+			decision = m_frameScheduler.BeginFrame(frameBegin);
+			if (decision.render)
+			{
+				m_profiler.BeginFrame();
+				m_renderer->SetSyncInterval(decision.syncInterval);
+				pipeline.RunFrame(update, render);
+				m_frameScheduler.EndFrame(workSeconds, m_renderer->IsSceneChanging());
+				m_profiler.EndFrame();
+			}
+			else
+			{
+				// 画面が変わらない間は描画せず、入力などのイベントが届くまでスレッドを止めます。
+				CoreWindow::GetForCurrentThread()->Dispatcher->ProcessEvents(CoreProcessEventsOption::ProcessOneAndAllPending);
+			}
 		}
 		else
 		{
@@ -85,11 +161,13 @@ void Direct3DApp1::Uninitialize()
 void Direct3DApp1::OnWindowSizeChanged(CoreWindow^ sender, WindowSizeChangedEventArgs^ args)
 {
 	m_renderer->UpdateForWindowSizeChange();
+	m_frameScheduler.RequestRedraw();
 }
 
 void Direct3DApp1::OnVisibilityChanged(CoreWindow^ sender, VisibilityChangedEventArgs^ args)
 {
 	m_windowVisible = args->Visible;
+	m_frameScheduler.RequestRedraw();
 }
 
 void Direct3DApp1::OnWindowClosed(CoreWindow^ sender, CoreWindowEventArgs^ args)
@@ -99,12 +177,20 @@ void Direct3DApp1::OnWindowClosed(CoreWindow^ sender, CoreWindowEventArgs^ args)
 
 void Direct3DApp1::OnPointerPressed(CoreWindow^ sender, PointerEventArgs^ args)
 {
-	// ここにコードを挿入します。
+	ProfileZone zone(&m_profiler, "Pick");
+	m_renderer->SelectObjectAt(args->CurrentPoint->Position);
+	m_frameScheduler.RequestRedraw();
 }
 
 void Direct3DApp1::OnPointerMoved(CoreWindow^ sender, PointerEventArgs^ args)
 {
-	// ここにコードを挿入します。
+	// 押したまま動かしている間は、ポインターの下のオブジェクトを選び直します。
+	if (args->CurrentPoint->IsInContact)
+	{
+		ProfileZone zone(&m_profiler, "Pick");
+		m_renderer->SelectObjectAt(args->CurrentPoint->Position);
+		m_frameScheduler.RequestRedraw();
+	}
 }
 
 void Direct3DApp1::OnActivated(CoreApplicationView^ applicationView, IActivatedEventArgs^ args)
@@ -120,9 +206,17 @@ void Direct3DApp1::OnSuspending(Platform::Object^ sender, SuspendingEventArgs^ a
 	// アプリケーションは強制終了されます。
 	SuspendingDeferral^ deferral = args->SuspendingOperation->GetDeferral();
 
-	create_task([this, deferral]()
+	// 中断する前に、直近の計測結果を Chrome のトレース形式でローカル フォルダーに保存します。
+	// chrome://tracing で読み込めます。
+	Platform::String^ tracePath = Windows::Storage::ApplicationData::Current->LocalFolder->Path + L"\\trace.json";
+
+	create_task([this, deferral, tracePath]()
 	{
-		// ここにコードを挿入します。
+		std::ofstream traceFile(tracePath->Data());
+		if (traceFile)
+		{
+			m_profiler.WriteChromeTrace(traceFile);
+		}
 
 		deferral->Complete();
 	});
@@ -133,6 +227,7 @@ void Direct3DApp1::OnResuming(Platform::Object^ sender, Platform::Object^ args)
 	// 中断時にアンロードされたデータまたは状態を復元します。既定では、データと状態は
 	// 中断から再開するときに保持されます。このイベントは、アプリが既に終了されている場合は
 	// 発生しません。
+	m_frameScheduler.RequestRedraw();
 }
 
 IFrameworkView^ Direct3DApplicationSource::CreateView()
@@ -2,6 +2,9 @@
 
 #include "pch.h"
 #include "CubeRenderer.h"
+#include "Profiler.h"
+#include "FramePipeline.h"
+#include "FrameScheduler.h"
 
 ref class Direct3DApp1 sealed : public Windows::ApplicationModel::Core::IFrameworkView
 {
@@ -31,6 +34,10 @@ private:
 	CubeRenderer^ m_renderer;
 	bool m_windowClosed;
 	bool m_windowVisible;
+	Profiler m_profiler;
+	FramePipelineMode m_framePipelineMode;
+	UINT m_maximumFrameLatency;
+	FrameScheduler m_frameScheduler;
 };
 
 ref class Direct3DApplicationSource sealed : Windows::ApplicationModel::Core::IFrameworkViewSource
@@ -8,7 +8,9 @@ using namespace Windows::Foundation;
 using namespace Windows::Graphics::Display;
 
 // コンストラクター。
-Direct3DBase::Direct3DBase()
+Direct3DBase::Direct3DBase() :
+	m_maximumFrameLatency(1),
+	m_syncInterval(1)
 {
 }
 
@@ -167,10 +169,10 @@ void Direct3DBase::CreateWindowSizeDependentResources()
 				)
 			);
 			
-		// DXGI が 1 度に複数のフレームをキュー処理していないことを確認します。これにより、遅延が減少し、
+		// 既定では DXGI が 1 度に複数のフレームをキュー処理しないようにします。これにより、遅延が減少し、
 		// アプリケーションが各 VSync の後でのみレンダリングすることが保証され、消費電力が最小限に抑えられます。
 		DX::ThrowIfFailed(
-			dxgiDevice->SetMaximumFrameLatency(1)
+			dxgiDevice->SetMaximumFrameLatency(m_maximumFrameLatency)
 			);
 	}
 	
@@ -311,10 +313,10 @@ void Direct3DBase::Present()
 	parameters.pScrollRect = nullptr;
 	parameters.pScrollOffset = nullptr;
 	
-	// 最初の引数は、DXGI に VSync までブロックするよう指示し、アプリケーションを次の VSync まで
+	// 最初の引数は、DXGI に m_syncInterval 回目の VSync までブロックするよう指示し、アプリケーションをその VSync まで
 	// スリープさせます。これにより、画面に表示されることのないフレームをレンダリングする
 	// サイクルに時間を費やすことがなくなります。
-	HRESULT hr = m_swapChain->Present1(1, 0, &parameters);
+	HRESULT hr = m_swapChain->Present1(m_syncInterval, 0, &parameters);
 
 	// レンダリング ターゲットのコンテンツを破棄します。
 	// この操作は、既存のコンテンツ全体が上書きされる場合のみ有効です。
@@ -324,6 +326,27 @@ void Direct3DBase::Present()
 	// 深度ステンシルのコンテンツを破棄します。
 	m_d3dContext->DiscardView(m_depthStencilView.Get());
 
+	HandlePresentResult(hr);
+}
+
+void Direct3DBase::PresentDirtyRects(const RECT* dirtyRects, UINT dirtyRectCount)
+{
+	DXGI_PRESENT_PARAMETERS parameters = {0};
+	parameters.DirtyRectsCount = dirtyRectCount;
+	parameters.pDirtyRects = const_cast<RECT*>(dirtyRects);
+	parameters.pScrollRect = nullptr;
+	parameters.pScrollOffset = nullptr;
+
+	HRESULT hr = m_swapChain->Present1(m_syncInterval, 0, &parameters);
+
+	// 深度は毎フレーム全体をクリアするので、深度ステンシルのコンテンツだけは破棄できます。
+	m_d3dContext->DiscardView(m_depthStencilView.Get());
+
+	HandlePresentResult(hr);
+}
+
+void Direct3DBase::HandlePresentResult(HRESULT hr)
+{
 	// デバイスが切断またはドライバーの更新によって削除された場合は、
 	// すべてのデバイス リソースを再作成する必要があります。
 	if (hr == DXGI_ERROR_DEVICE_REMOVED)
@@ -336,6 +359,29 @@ void Direct3DBase::Present()
 	}
 }
 
+void Direct3DBase::SetMaximumFrameLatency(UINT maximumFrameLatency)
+{
+	m_maximumFrameLatency = maximumFrameLatency;
+
+	// デバイスを作成済みであればすぐに反映します。まだなら、スワップ チェーンを作成するときに設定します。
+	if (m_d3dDevice != nullptr)
+	{
+		ComPtr<IDXGIDevice1> dxgiDevice;
+		DX::ThrowIfFailed(
+			m_d3dDevice.As(&dxgiDevice)
+			);
+		DX::ThrowIfFailed(
+			dxgiDevice->SetMaximumFrameLatency(m_maximumFrameLatency)
+			);
+	}
+}
+
+void Direct3DBase::SetSyncInterval(UINT syncInterval)
+{
+	// DXGI が受け付ける間隔は 0 ～ 4 です。0 は垂直同期を待たないので、ここでは使いません。
+	m_syncInterval = syncInterval < 1 ? 1 : (syncInterval > 4 ? 4 : syncInterval);
+}
+
 // デバイスに依存しないピクセル単位 (DIP) の長さを物理的なピクセルの長さに変換するメソッド。
 float Direct3DBase::ConvertDipsToPixels(float dips)
 {
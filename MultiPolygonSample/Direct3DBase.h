@@ -18,7 +18,20 @@ public:
 	virtual void Present();
 	virtual float ConvertDipsToPixels(float dips);
 
+internal:
+	// DXGI がキューに入れるフレームの最大数を設定します。既定値は 1 です。
+	// 大きくすると Present で CPU が待つことが減りますが、表示までの遅延が増えます。
+	void SetMaximumFrameLatency(UINT maximumFrameLatency);
+
+	// Present で待つ垂直同期の数 (1 ～ 4) を設定します。既定値は 1 で、2 なら表示の頻度が半分になります。
+	void SetSyncInterval(UINT syncInterval);
+
 protected private:
+	// dirtyRects の矩形の外側は前のフレームと同じものとして表示します。dirtyRectCount が 0 なら全体が変わったものとします。
+	// バック バッファーの内容を次に同じバッファーを描くときにも使うので、Present と違ってレンダー ターゲットを破棄しません。
+	void PresentDirtyRects(const RECT* dirtyRects, UINT dirtyRectCount);
+	void HandlePresentResult(HRESULT hr);
+
 	// Direct3D オブジェクト。
 	Microsoft::WRL::ComPtr<ID3D11Device1> m_d3dDevice;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_d3dContext;
@@ -28,6 +41,8 @@ protected private:
 
 	// キャッシュされたレンダリング プロパティ。
 	D3D_FEATURE_LEVEL m_featureLevel;
+	UINT m_maximumFrameLatency;
+	UINT m_syncInterval;
 	Windows::Foundation::Size m_renderTargetSize;
 	Windows::Foundation::Rect m_windowBounds;
 	Platform::Agile<Windows::UI::Core::CoreWindow> m_window;
@@ -3,6 +3,9 @@
 #include <wrl/client.h>
 #include <ppl.h>
 #include <ppltasks.h>
+#include <robuffer.h>
+#include <memory>
+#include "FileView.h"
 
 namespace DX
 {
@@ -15,8 +18,32 @@ namespace DX
 		}
 	}
 
+	// IBuffer を持ち続けて、FileView が指すメモリを生かしておくための持ち主。
+	struct BufferOwner
+	{
+		Windows::Storage::Streams::IBuffer^ buffer;
+	};
+
+	// IBuffer の中身を、コピーせずに指す FileView を作ります。
+	inline FileView CreateBufferView(Windows::Storage::Streams::IBuffer^ buffer)
+	{
+		Microsoft::WRL::ComPtr<Windows::Storage::Streams::IBufferByteAccess> byteAccess;
+		ThrowIfFailed(
+			reinterpret_cast<IInspectable*>(buffer)->QueryInterface(IID_PPV_ARGS(&byteAccess))
+			);
+
+		byte* data = nullptr;
+		ThrowIfFailed(byteAccess->Buffer(&data));
+
+		auto owner = std::make_shared<BufferOwner>();
+		owner->buffer = buffer;
+		return FileView(owner, data, buffer->Length);
+	}
+
 	// バイナリ ファイルから非同期に読み取る関数。
-	inline Concurrency::task<Platform::Array<byte>^> ReadDataAsync(Platform::String^ filename)
+	// 読み取ったバッファーを Platform::Array へコピーせず、そのまま指すビューを返します。
+	// バッファーは返したビュー (とそのコピー) がすべて破棄されたときに解放されます。
+	inline Concurrency::task<FileView> ReadDataAsync(Platform::String^ filename)
 	{
 		using namespace Windows::Storage;
 		using namespace Concurrency;
@@ -26,11 +53,9 @@ namespace DX
 		return create_task(folder->GetFileAsync(filename)).then([] (StorageFile^ file) 
 		{
 			return FileIO::ReadBufferAsync(file);
-		}).then([] (Streams::IBuffer^ fileBuffer) -> Platform::Array<byte>^ 
+		}).then([] (Streams::IBuffer^ fileBuffer) -> FileView 
 		{
-			auto fileData = ref new Platform::Array<byte>(fileBuffer->Length);
-			Streams::DataReader::FromBuffer(fileBuffer)->ReadBytes(fileData);
-			return fileData;
+			return CreateBufferView(fileBuffer);
 		});
 	}
 }
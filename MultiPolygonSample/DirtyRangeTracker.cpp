@@ -0,0 +1,120 @@
+﻿#include "DirtyRangeTracker.h"
+#include <algorithm>
+#include <cstring>
+
+DirtyRangeTracker::DirtyRangeTracker() :
+	m_valid(false)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void DirtyRangeTracker::Update(const void* data, uint32_t size, uint32_t elementSize, uint32_t maxRanges, std::vector<DirtyRange>& ranges)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	elementSize = std::max(elementSize, 1u);
+	maxRanges = std::max(maxRanges, 1u);
+	ranges.clear();
+
+	// 前回と重なる部分だけを比べ、はみ出した部分は変更として扱います。
+	const uint32_t comparedSize = m_valid ? std::min(size, static_cast<uint32_t>(m_shadow.size())) : 0;
+	for (uint32_t offset = 0; offset < comparedSize; offset += elementSize)
+	{
+		const uint32_t length = std::min(elementSize, comparedSize - offset);
+		if (memcmp(bytes + offset, &m_shadow[offset], length) == 0)
+		{
+			continue;
+		}
+
+		if (!ranges.empty() && ranges.back().end == offset)
+		{
+			ranges.back().end = offset + length;
+		}
+		else
+		{
+			DirtyRange range = { offset, offset + length };
+			ranges.push_back(range);
+		}
+	}
+
+	if (size > comparedSize)
+	{
+		if (!ranges.empty() && ranges.back().end == comparedSize)
+		{
+			ranges.back().end = size;
+		}
+		else
+		{
+			DirtyRange range = { comparedSize, size };
+			ranges.push_back(range);
+		}
+	}
+
+	// 範囲が多すぎるときは、間の短いものから (ranges.size() - maxRanges) 個をつなげます。
+	if (ranges.size() > maxRanges)
+	{
+		m_gaps.clear();
+		for (size_t i = 1; i < ranges.size(); ++i)
+		{
+			m_gaps.push_back(ranges[i].begin - ranges[i - 1].end);
+		}
+
+		const size_t mergeCount = ranges.size() - maxRanges;
+		std::nth_element(m_gaps.begin(), m_gaps.begin() + (mergeCount - 1), m_gaps.end());
+		const uint32_t threshold = m_gaps[mergeCount - 1];
+
+		// しきい値と同じ長さの間は、必要な数だけつなげます。
+		size_t equalToMerge = mergeCount;
+		for (size_t i = 0; i < mergeCount; ++i)
+		{
+			if (m_gaps[i] < threshold)
+			{
+				--equalToMerge;
+			}
+		}
+
+		size_t count = 1;
+		for (size_t i = 1; i < ranges.size(); ++i)
+		{
+			const uint32_t gap = ranges[i].begin - ranges[count - 1].end;
+			bool merge = gap < threshold;
+			if (gap == threshold && equalToMerge > 0)
+			{
+				merge = true;
+				--equalToMerge;
+			}
+
+			if (merge)
+			{
+				ranges[count - 1].end = ranges[i].end;
+			}
+			else
+			{
+				ranges[count++] = ranges[i];
+			}
+		}
+		ranges.resize(count);
+	}
+
+	uint32_t changed = 0;
+	m_shadow.resize(std::max<size_t>(m_shadow.size(), size));
+	for (const DirtyRange& range : ranges)
+	{
+		memcpy(&m_shadow[range.begin], bytes + range.begin, range.end - range.begin);
+		changed += range.end - range.begin;
+	}
+	m_shadow.resize(size);
+	m_valid = true;
+
+	++m_stats.updates;
+	if (ranges.empty())
+	{
+		++m_stats.unchangedUpdates;
+	}
+	m_stats.bytesChanged += changed;
+	m_stats.bytesSkipped += size - changed;
+}
+
+void DirtyRangeTracker::Invalidate()
+{
+	m_valid = false;
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 変更されたバイトの範囲 [begin, end)。
+struct DirtyRange
+{
+	uint32_t begin;
+	uint32_t end;
+};
+
+struct DirtyRangeStats
+{
+	uint64_t bytesChanged;	// Update が返した範囲の合計 (まとめたときに含めた、変わっていない部分も数えます)
+	uint64_t bytesSkipped;	// 前回と同じだったので書き込まずに済んだバイト数
+	uint32_t updates;
+	uint32_t unchangedUpdates;	// 変更がまったくなかった Update の回数
+};
+
+/**
+ * GPU のバッファーに最後に書き込んだ内容を CPU 側に持ち、新しい内容と比べて変わった範囲を求めます。
+ * 比較は elementSize 単位で行い、変わった要素の連続した範囲を返すので、
+ * 変わらなかったオブジェクトの定数やインスタンス データを書き込まずに済みます。
+ * 書き込みの呼び出しが増えすぎないように、範囲が maxRanges 個を超えるときは間の短いものからつなげます。
+ */
+class DirtyRangeTracker
+{
+public:
+	DirtyRangeTracker();
+
+	// data を前回の内容と比べて変わった範囲を先頭から順に ranges に返し、data を新しい内容として記録します。
+	// 変わっていなければ ranges は空です。前回より大きくなった部分と、Invalidate の後は、すべて変わったものとします。
+	void Update(const void* data, uint32_t size, uint32_t elementSize, uint32_t maxRanges, std::vector<DirtyRange>& ranges);
+
+	// バッファーを作り直したときなど、GPU 側の内容が失われたときに呼び出します。
+	void Invalidate();
+
+	const DirtyRangeStats& GetStats() const { return m_stats; }
+
+private:
+	std::vector<uint8_t> m_shadow;
+	std::vector<uint32_t> m_gaps;
+	bool m_valid;
+	DirtyRangeStats m_stats;
+};
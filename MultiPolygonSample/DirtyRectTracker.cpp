@@ -0,0 +1,329 @@
+﻿#include "DirtyRectTracker.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// Present に渡す、まとめた後の矩形の数の上限。
+static const uint32_t MaxRects = 8;
+
+// 別々に描き直すより、この数までピクセルが増えるだけなら 1 つの矩形にまとめます。
+static const uint64_t MergeSlackPixels = 64 * 64;
+
+// 1 フレームの変更の矩形がこの数に達したら、まとめる計算が増えすぎないように、それまでの矩形を 1 つに包みます。
+static const size_t MaxDamageRects = 64;
+
+// 描画先のこの割合 (4 分の 3) 以上を描き直すときは、全体を描き直します。
+static const uint64_t FullFrameNumerator = 3;
+static const uint64_t FullFrameDenominator = 4;
+
+// 投影した矩形を広げる量。ラスタライズの丸めで端のピクセルが外れないようにします。
+static const int32_t RectMargin = 1;
+
+// クリップ空間の w がこれより小さい点はカメラの手前にかかるので、投影しません。
+static const float MinClipW = 1.0e-4f;
+
+static const uint64_t SignatureSeed = 14695981039346656037ULL;
+static const uint64_t SignaturePrime = 1099511628211ULL;
+
+const uint32_t DirtyRectTracker::NoMesh;
+
+static uint64_t SumAreas(const std::vector<ScreenRect>& rects)
+{
+	uint64_t area = 0;
+	for (const ScreenRect& rect : rects)
+	{
+		area += rect.GetArea();
+	}
+	return area;
+}
+
+DirtyRectTracker::DirtyRectTracker(uint32_t bufferCount) :
+	m_bufferCount(std::max(bufferCount, 1u)),
+	m_width(0),
+	m_height(0),
+	m_recordsValid(false),
+	m_contentValid(false),
+	m_trackingObjects(false),
+	m_fullFrame(true),
+	m_frame(0),
+	m_history(m_bufferCount - 1)
+{
+	const ScreenRect empty = { 0, 0, 0, 0 };
+	m_redrawRect = empty;
+	XMStoreFloat4x4(&m_viewProjection, XMMatrixIdentity());
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void DirtyRectTracker::SetViewport(uint32_t width, uint32_t height)
+{
+	m_width = width;
+	m_height = height;
+
+	// 記録した矩形は前の大きさのピクセルなので、オブジェクトの状態も記録し直します。
+	m_recordsValid = false;
+	m_contentValid = false;
+}
+
+void DirtyRectTracker::Invalidate()
+{
+	m_contentValid = false;
+}
+
+bool DirtyRectTracker::BeginFrame(const XMFLOAT4X4& viewProjection)
+{
+	++m_frame;
+	m_damage.clear();
+
+	// カメラが変わったフレームは全体を描き直すので、オブジェクトごとには比べません。
+	// その次のフレームは前のフレームの状態がないので、全体を描き直しながら状態を記録し直します。
+	const bool cameraChanged = memcmp(&viewProjection, &m_viewProjection, sizeof(viewProjection)) != 0;
+	m_viewProjection = viewProjection;
+	m_fullFrame = cameraChanged || !m_recordsValid || !m_contentValid;
+	m_trackingObjects = !cameraChanged;
+	m_contentValid = true;
+	return m_trackingObjects;
+}
+
+void DirtyRectTracker::AddObject(EntityHandle entity, uint64_t signature, float x, float y, float z, float radius)
+{
+	if (entity.index >= m_records.size())
+	{
+		ObjectRecord empty;
+		memset(&empty, 0, sizeof(empty));
+		m_records.resize(entity.index + 1, empty);
+	}
+	m_currentSlots.push_back(entity.index);
+
+	ObjectRecord& record = m_records[entity.index];
+	const bool drawnLastFrame = m_recordsValid && record.generation != 0 && record.frame + 1 == m_frame;
+	if (drawnLastFrame && record.generation == entity.generation && record.signature == signature)
+	{
+		record.frame = m_frame;
+		return;
+	}
+
+	// 変わったオブジェクトは、前の位置と新しい位置の両方を描き直します。
+	// スロットを使い回した別のエンティティに変わったときも同じです。
+	const ScreenRect rect = ProjectSphere(m_viewProjection, x, y, z, radius, m_width, m_height);
+	if (!m_fullFrame)
+	{
+		if (drawnLastFrame)
+		{
+			AddDamage(record.rect);
+		}
+		AddDamage(rect);
+	}
+	record.generation = entity.generation;
+	record.frame = m_frame;
+	record.signature = signature;
+	record.rect = rect;
+}
+
+void DirtyRectTracker::EndFrame()
+{
+	if (m_trackingObjects)
+	{
+		// 前のフレームに描画して、このフレームに追加されなかったオブジェクトは消えた跡を描き直します。
+		if (m_recordsValid && !m_fullFrame)
+		{
+			for (uint32_t slot : m_previousSlots)
+			{
+				const ObjectRecord& record = m_records[slot];
+				if (record.frame != m_frame)
+				{
+					AddDamage(record.rect);
+				}
+			}
+		}
+		m_previousSlots.swap(m_currentSlots);
+	}
+	else
+	{
+		m_previousSlots.clear();
+	}
+	m_currentSlots.clear();
+	m_recordsValid = m_trackingObjects;
+
+	const ScreenRect viewportRect = GetViewportRect();
+	const uint64_t viewportArea = viewportRect.GetArea();
+
+	m_presentRects.swap(m_damage);
+	m_damage.clear();
+	MergeRects(m_presentRects, MaxRects, MergeSlackPixels);
+	if (!m_fullFrame && SumAreas(m_presentRects) * FullFrameDenominator >= viewportArea * FullFrameNumerator && !m_presentRects.empty())
+	{
+		m_fullFrame = true;
+	}
+	if (m_fullFrame)
+	{
+		m_presentRects.assign(1, viewportRect);
+	}
+
+	// このバック バッファーを最後に描いた後の各フレームの変更も、描き直す必要があります。
+	// 矩形ごとにコマンドを実行し直すと描画もクリアも矩形の数だけ繰り返すので、すべてを含む 1 つの矩形にします。
+	ScreenRect redrawRect = { 0, 0, 0, 0 };
+	for (const ScreenRect& rect : m_presentRects)
+	{
+		redrawRect = UnionRects(redrawRect, rect);
+	}
+	for (const std::vector<ScreenRect>& rects : m_history)
+	{
+		for (const ScreenRect& rect : rects)
+		{
+			redrawRect = UnionRects(redrawRect, rect);
+		}
+	}
+	const bool fullRedraw = !redrawRect.IsEmpty() && redrawRect.GetArea() * FullFrameDenominator >= viewportArea * FullFrameNumerator;
+	m_redrawRect = fullRedraw ? viewportRect : redrawRect;
+
+	if (!m_history.empty())
+	{
+		std::rotate(m_history.begin(), m_history.begin() + 1, m_history.end());
+		m_history.back() = m_presentRects;
+	}
+
+	++m_stats.frames;
+	m_stats.pixelsTotal += viewportArea;
+	m_stats.pixelsRedrawn += m_redrawRect.GetArea();
+	m_stats.fullFrames += fullRedraw ? 1 : 0;
+	m_stats.unchangedFrames += m_redrawRect.IsEmpty() ? 1 : 0;
+}
+
+uint64_t DirtyRectTracker::ComputeSignature(const InstanceData& instance, uint32_t meshId, uint32_t fadingMeshId)
+{
+	static_assert(sizeof(InstanceData) % sizeof(uint64_t) == 0, "InstanceData is hashed as 64-bit words.");
+
+	// FNV-1a を 64 ビット単位で適用します。乗算の連鎖がバイト単位の 8 分の 1 になり、変更の検出にはこれで足ります。
+	const uint32_t wordCount = sizeof(InstanceData) / sizeof(uint64_t);
+	uint64_t words[wordCount + 1];
+	memcpy(words, &instance, sizeof(InstanceData));
+	words[wordCount] = (static_cast<uint64_t>(fadingMeshId) << 32) | meshId;
+
+	uint64_t hash = SignatureSeed;
+	for (uint64_t word : words)
+	{
+		hash ^= word;
+		hash *= SignaturePrime;
+	}
+	return hash;
+}
+
+// 境界球を包む立方体の 8 つの頂点を投影し、その範囲を描画先のピクセルに換算します。
+ScreenRect DirtyRectTracker::ProjectSphere(const XMFLOAT4X4& viewProjection, float x, float y, float z, float radius, uint32_t width, uint32_t height)
+{
+	const ScreenRect viewportRect = { 0, 0, static_cast<int32_t>(width), static_cast<int32_t>(height) };
+	const XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+	const XMVECTOR center = XMVector4Transform(XMVectorSet(x, y, z, 1.0f), matrix);
+	const XMVECTOR axisX = XMVectorScale(matrix.r[0], radius);
+	const XMVECTOR axisY = XMVectorScale(matrix.r[1], radius);
+	const XMVECTOR axisZ = XMVectorScale(matrix.r[2], radius);
+
+	float minX = 1.0f;
+	float minY = 1.0f;
+	float maxX = -1.0f;
+	float maxY = -1.0f;
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		XMVECTOR position = center;
+		position = (corner & 1) != 0 ? XMVectorAdd(position, axisX) : XMVectorSubtract(position, axisX);
+		position = (corner & 2) != 0 ? XMVectorAdd(position, axisY) : XMVectorSubtract(position, axisY);
+		position = (corner & 4) != 0 ? XMVectorAdd(position, axisZ) : XMVectorSubtract(position, axisZ);
+
+		const float w = XMVectorGetW(position);
+		if (w < MinClipW)
+		{
+			return viewportRect;
+		}
+		const float ndcX = XMVectorGetX(position) / w;
+		const float ndcY = XMVectorGetY(position) / w;
+		minX = corner == 0 ? ndcX : std::min(minX, ndcX);
+		minY = corner == 0 ? ndcY : std::min(minY, ndcY);
+		maxX = corner == 0 ? ndcX : std::max(maxX, ndcX);
+		maxY = corner == 0 ? ndcY : std::max(maxY, ndcY);
+	}
+
+	// 描画先から大きく外れた座標は、整数に変換する前に少し外側で切り取ります。
+	const float left = std::max((minX * 0.5f + 0.5f) * width, -1.0f);
+	const float right = std::min((maxX * 0.5f + 0.5f) * width, width + 1.0f);
+	const float top = std::max((0.5f - maxY * 0.5f) * height, -1.0f);
+	const float bottom = std::min((0.5f - minY * 0.5f) * height, height + 1.0f);
+	const ScreenRect rect =
+	{
+		static_cast<int32_t>(std::floor(left)) - RectMargin,
+		static_cast<int32_t>(std::floor(top)) - RectMargin,
+		static_cast<int32_t>(std::ceil(right)) + RectMargin,
+		static_cast<int32_t>(std::ceil(bottom)) + RectMargin
+	};
+	const ScreenRect clipped = IntersectRects(rect, viewportRect);
+	if (clipped.IsEmpty())
+	{
+		const ScreenRect empty = { 0, 0, 0, 0 };
+		return empty;
+	}
+	return clipped;
+}
+
+void DirtyRectTracker::MergeRects(std::vector<ScreenRect>& rects, uint32_t maxRects, uint64_t mergeSlack)
+{
+	rects.erase(std::remove_if(rects.begin(), rects.end(), [] (const ScreenRect& rect) { return rect.IsEmpty(); }), rects.end());
+	maxRects = std::max(maxRects, 1u);
+
+	// まとめて増えるピクセルが最も少ない組を探してまとめることを繰り返します。
+	// 重なった部分は別々に描くと 2 回描くので、重なりが大きい組は増える数が負になります。
+	while (rects.size() > 1)
+	{
+		size_t bestFirst = 0;
+		size_t bestSecond = 0;
+		int64_t bestCost = 0;
+		for (size_t i = 0; i < rects.size(); ++i)
+		{
+			for (size_t j = i + 1; j < rects.size(); ++j)
+			{
+				const int64_t cost =
+					static_cast<int64_t>(UnionRects(rects[i], rects[j]).GetArea()) -
+					static_cast<int64_t>(rects[i].GetArea()) -
+					static_cast<int64_t>(rects[j].GetArea());
+				if ((i == 0 && j == 1) || cost < bestCost)
+				{
+					bestFirst = i;
+					bestSecond = j;
+					bestCost = cost;
+				}
+			}
+		}
+
+		if (bestCost > static_cast<int64_t>(mergeSlack) && rects.size() <= maxRects)
+		{
+			break;
+		}
+		rects[bestFirst] = UnionRects(rects[bestFirst], rects[bestSecond]);
+		rects[bestSecond] = rects.back();
+		rects.pop_back();
+	}
+}
+
+void DirtyRectTracker::AddDamage(const ScreenRect& rect)
+{
+	if (rect.IsEmpty())
+	{
+		return;
+	}
+	if (m_damage.size() >= MaxDamageRects)
+	{
+		ScreenRect bounds = m_damage[0];
+		for (const ScreenRect& damage : m_damage)
+		{
+			bounds = UnionRects(bounds, damage);
+		}
+		m_damage.assign(1, bounds);
+	}
+	m_damage.push_back(rect);
+}
+
+ScreenRect DirtyRectTracker::GetViewportRect() const
+{
+	const ScreenRect rect = { 0, 0, static_cast<int32_t>(m_width), static_cast<int32_t>(m_height) };
+	return rect;
+}
@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "ScreenRect.h"
+#include "ShaderStructures.h"
+#include "EntityStore.h"
+
+struct DirtyRectStats
+{
+	uint64_t pixelsRedrawn;	// 描き直したピクセル数の累計
+	uint64_t pixelsTotal;	// 毎フレーム全体を描き直したときのピクセル数の累計
+	uint32_t frames;
+	uint32_t fullFrames;		// 全体を描き直したフレームの数
+	uint32_t unchangedFrames;	// 何も変わらず、描き直さずに済んだフレームの数
+};
+
+/**
+ * 前のフレームから変わったオブジェクトの画面上の範囲を求め、描き直す矩形にまとめます。
+ * Record は描画するオブジェクトごとに、描画に使う内容 (インスタンス データとメッシュ) のシグネチャを渡します。
+ * シグネチャが変わったオブジェクトと、増えたオブジェクトや消えたオブジェクトの、前後の境界球を画面に投影した矩形が変更になります。
+ * カメラや射影が変わったフレームは、オブジェクトごとに比べずに全体を変更とします。
+ *
+ * フリップ モデルのスワップ チェーンでは、次に描くバック バッファーは bufferCount フレーム前の内容を持っています。
+ * そのため描き直す矩形 (GetRedrawRect) は、このフレームの変更に、その間のフレームの変更を加えたものです。
+ * 描き直すときはコマンド リストを 1 回だけ実行するので、それらを 1 つの矩形に包みます。
+ * Present に渡す矩形 (GetPresentRects) は、このフレームの変更だけです。
+ */
+class DirtyRectTracker
+{
+public:
+	// bufferCount はスワップ チェーンのバッファーの数です。
+	explicit DirtyRectTracker(uint32_t bufferCount);
+
+	// 描画先の大きさを設定します。次のフレームは全体を描き直します。
+	void SetViewport(uint32_t width, uint32_t height);
+
+	// デバイスやスワップ チェーンを作り直したときなど、バック バッファーの内容が失われたときに呼び出します。
+	void Invalidate();
+
+	// フレームの変更の記録を始めます。viewProjection は境界球を画面に投影する行列 (転置していないもの) です。
+	// オブジェクトごとに比べる必要がなければ false を返し、そのフレームは AddObject を呼び出さなくてかまいません。
+	bool BeginFrame(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// このフレームに描画するオブジェクトを追加します。(x, y, z, radius) はワールド空間の境界球です。
+	void AddObject(EntityHandle entity, uint64_t signature, float x, float y, float z, float radius);
+
+	// 前のフレームにあって追加されなかったオブジェクトを変更に加え、矩形をまとめます。
+	void EndFrame();
+
+	// Present に渡す矩形。変更がなければ空です。IsFullFrame なら描画先全体の 1 つの矩形です。
+	const std::vector<ScreenRect>& GetPresentRects() const { return m_presentRects; }
+
+	// クリアして描き直す矩形。空なら何も描き直さずに済みます。
+	const ScreenRect& GetRedrawRect() const { return m_redrawRect; }
+
+	// このフレームの変更が描画先全体に及ぶかどうか。
+	bool IsFullFrame() const { return m_fullFrame; }
+
+	const DirtyRectStats& GetStats() const { return m_stats; }
+
+	static const uint32_t NoMesh = 0xFFFFFFFF;
+
+	// インスタンス データと、それを描画するメッシュから、変更を調べるシグネチャを求めます。
+	// fadingMeshId はフェード中に一緒に描画する前の段のメッシュで、フェード中でなければ NoMesh です。
+	static uint64_t ComputeSignature(const InstanceData& instance, uint32_t meshId, uint32_t fadingMeshId);
+
+	// 境界球を viewProjection で描画先に投影した矩形。描画先の外側は切り取ります。
+	// カメラより手前にかかる球は、描画先全体とします。
+	static ScreenRect ProjectSphere(const DirectX::XMFLOAT4X4& viewProjection, float x, float y, float z, float radius, uint32_t width, uint32_t height);
+
+	// まとめても描き直すピクセル (重なった部分は重ねて数えます) が mergeSlack 以下しか増えない組をまとめます。
+	// maxRects 個を超えるときは、さらに増えるピクセルの少ない組からまとめます。空の矩形は取り除きます。
+	static void MergeRects(std::vector<ScreenRect>& rects, uint32_t maxRects, uint64_t mergeSlack);
+
+private:
+	// エンティティのスロットごとの、最後に追加されたときの状態。
+	struct ObjectRecord
+	{
+		uint32_t generation;
+		uint32_t frame;		// 最後に追加されたフレーム
+		uint64_t signature;
+		ScreenRect rect;
+	};
+
+	void AddDamage(const ScreenRect& rect);
+	ScreenRect GetViewportRect() const;
+
+	uint32_t m_bufferCount;
+	uint32_t m_width;
+	uint32_t m_height;
+	DirectX::XMFLOAT4X4 m_viewProjection;
+	bool m_recordsValid;	// m_records が前のフレームの状態かどうか
+	bool m_contentValid;	// バック バッファーが前のフレームまでの内容を保っているかどうか
+	bool m_trackingObjects;	// このフレームでオブジェクトごとに比べているかどうか
+	bool m_fullFrame;
+	uint32_t m_frame;
+
+	std::vector<ObjectRecord> m_records;
+	std::vector<uint32_t> m_previousSlots;	// 前のフレームに追加されたスロット
+	std::vector<uint32_t> m_currentSlots;
+	std::vector<ScreenRect> m_damage;
+	std::vector<std::vector<ScreenRect> > m_history;	// 直前の (bufferCount - 1) フレームの変更。古いものから順に並びます
+	std::vector<ScreenRect> m_presentRects;
+	ScreenRect m_redrawRect;
+	DirtyRectStats m_stats;
+};
@@ -0,0 +1,30 @@
+struct PixelShaderInput
+{
+	float4 pos : SV_POSITION;
+	float3 color : COLOR0;
+	float fade : FADE;
+};
+
+// 4x4 Bayer matrix used to dither LOD cross-fades (LodSelection::GetDitherThreshold).
+static const float ditherPattern[16] =
+{
+	0.0f, 8.0f, 2.0f, 10.0f,
+	12.0f, 4.0f, 14.0f, 6.0f,
+	3.0f, 11.0f, 1.0f, 9.0f,
+	15.0f, 7.0f, 13.0f, 5.0f
+};
+
+// SimplePixelShader with LOD cross-fade dithering, used for CULL_NONE rendering.
+// Both faces use the vertex color, so CULL_NONE alone matches the two-pass output and no facing test is needed.
+// The integer pixel math requires shader model 4.0, so this is only used on feature level 10_0 and above.
+float4 main(PixelShaderInput input) : SV_TARGET
+{
+	// While an object switches LOD, both levels are drawn and keep complementary pixels:
+	// a positive fade keeps pixels below the threshold, zero or negative keeps pixels at or above 1 + fade.
+	// Fully faded-in objects have a fade of 1 and keep every pixel.
+	uint2 pixel = uint2(input.pos.xy) % 4;
+	float threshold = (ditherPattern[pixel.y * 4 + pixel.x] + 0.5f) / 16.0f;
+	clip(input.fade > 0.0f ? input.fade - threshold - 1.0e-6f : threshold - (1.0f + input.fade));
+
+	return float4(input.color, 1.0f);
+}
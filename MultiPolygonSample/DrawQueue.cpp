@@ -0,0 +1,93 @@
+﻿#include "DrawQueue.h"
+#include <algorithm>
+
+// 1 つのチャンクは 1024 個 (約 100 KB) の要素を持ちます。
+static const uint32_t ItemsPerChunk = 1024;
+
+DrawQueue::DrawQueue() :
+	m_itemPool(ItemsPerChunk, MemoryCategory::DrawItems)
+{
+}
+
+DrawQueue::~DrawQueue()
+{
+	Clear();
+}
+
+// 配列の後ろから返すので、次のフレームはこの配列の順にスロットを使います。
+// Flush の後は並べ替えた順になるので、並びが前のフレームと変わらなければ、Flush はメモリを先頭から順に読めます。
+void DrawQueue::Clear()
+{
+	for (size_t i = m_items.size(); i > 0; --i)
+	{
+		m_itemPool.Destroy(m_items[i - 1]);
+	}
+	m_items.clear();
+}
+
+void DrawQueue::Submit(uint32_t pipelineId, uint32_t meshId, const InstanceData& instance)
+{
+	DrawItem* item = m_itemPool.Create();
+	item->sortKey = (static_cast<uint64_t>(pipelineId) << 32) | meshId;
+	item->sequence = static_cast<uint32_t>(m_items.size());
+	item->instance = instance;
+	m_items.push_back(item);
+}
+
+// 投入順を最後のキーにしているので、結果は常に決定的です。
+bool DrawQueue::CompareItems(const DrawItem* a, const DrawItem* b)
+{
+	if (a->sortKey != b->sortKey)
+	{
+		return a->sortKey < b->sortKey;
+	}
+	return a->sequence < b->sequence;
+}
+
+void DrawQueue::Flush(RenderCommandList& commandList)
+{
+	// InstanceData は 80 バイトあるので、並べ替えはポインターに対して行います。
+	std::sort(m_items.begin(), m_items.end(), CompareItems);
+
+	bool hasState = false;
+	uint32_t currentPipeline = 0;
+	uint32_t currentMesh = 0;
+
+	size_t groupBegin = 0;
+	while (groupBegin < m_items.size())
+	{
+		const uint64_t key = m_items[groupBegin]->sortKey;
+		const uint32_t pipelineId = static_cast<uint32_t>(key >> 32);
+		const uint32_t meshId = static_cast<uint32_t>(key & 0xFFFFFFFF);
+
+		// 直前のグループと異なるステートだけを設定します。
+		if (!hasState || pipelineId != currentPipeline)
+		{
+			commandList.SetPipelineState(pipelineId);
+			currentPipeline = pipelineId;
+		}
+		if (!hasState || meshId != currentMesh)
+		{
+			commandList.SetMesh(meshId);
+			currentMesh = meshId;
+		}
+		hasState = true;
+
+		size_t groupEnd = groupBegin;
+		uint32_t startInstance = 0;
+		while (groupEnd < m_items.size() && m_items[groupEnd]->sortKey == key)
+		{
+			uint32_t index = commandList.AppendInstance(m_items[groupEnd]->instance);
+			if (groupEnd == groupBegin)
+			{
+				startInstance = index;
+			}
+			++groupEnd;
+		}
+
+		commandList.DrawInstanced(meshId, startInstance, static_cast<uint32_t>(groupEnd - groupBegin));
+		groupBegin = groupEnd;
+	}
+
+	Clear();
+}
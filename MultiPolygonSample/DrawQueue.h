@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderCommandList.h"
+#include "ObjectPool.h"
+
+// 1 フレーム分の描画要求を集め、パイプライン ステート → メッシュの順に並べ替えてから
+// インスタンス描画のコマンドに変換するキュー。
+// 同じパイプラインとメッシュを使うオブジェクトは 1 回の DrawInstanced にまとめられるため、
+// オブジェクト数 N に対して API 呼び出しの数は (パイプライン数 + メッシュ数 + グループ数) に抑えられます。
+// 要素は ObjectPool から確保するので、オブジェクトが増えても既存の要素をコピーし直すことはありません。
+class DrawQueue
+{
+public:
+	DrawQueue();
+	~DrawQueue();
+
+	void Clear();
+
+	// オブジェクトを 1 つ描画キューに追加します。
+	void Submit(uint32_t pipelineId, uint32_t meshId, const InstanceData& instance);
+
+	// キューの内容を並べ替えてコマンド リストへ書き出します。キューは空になります。
+	void Flush(RenderCommandList& commandList);
+
+	uint32_t GetItemCount() const { return static_cast<uint32_t>(m_items.size()); }
+
+private:
+	struct DrawItem
+	{
+		uint64_t sortKey;	// 上位 32 ビット = パイプライン ID, 下位 32 ビット = メッシュ ID
+		uint32_t sequence;	// 同じキー内で投入順を保つための通し番号
+		InstanceData instance;
+	};
+
+	static bool CompareItems(const DrawItem* a, const DrawItem* b);
+
+	DrawQueue(const DrawQueue&);
+	DrawQueue& operator=(const DrawQueue&);
+
+	ObjectPool<DrawItem> m_itemPool;
+	std::vector<DrawItem*> m_items;	// 投入順の要素。Flush ではこの配列を並べ替えます
+};
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// 動的バッファーをマップするときの方法。D3D11_MAP_WRITE_NO_OVERWRITE と D3D11_MAP_WRITE_DISCARD に対応します。
+enum class BufferMapMode
+{
+	NoOverwrite,	// GPU が使用中の領域には書き込まないことを約束してマップします
+	Discard			// バッファー全体を破棄して新しいメモリをマップします
+};
+
+// VertexRingBuffer が使う動的バッファーと GPU の進行状況の抽象化。
+// D3D11 の実装 (D3D11DynamicBuffer) と、テスト用に CPU だけで動くモック (Tests/SystemMemoryDynamicBuffer) があります。
+class DynamicBufferDevice
+{
+public:
+	virtual ~DynamicBufferDevice() {}
+
+	virtual uint32_t GetCapacity() const = 0;
+
+	// バッファーをマップし、先頭のアドレスを返します。
+	// offset と size は書き込む範囲で、検証や部分的な更新のために使われます。
+	virtual uint8_t* Map(BufferMapMode mode, uint32_t offset, uint32_t size) = 0;
+	virtual void Unmap() = 0;
+
+	// これまでに発行した描画が完了したことを示すフェンスを発行し、その値を返します。値は 1 から単調に増加します。
+	virtual uint64_t InsertFence() = 0;
+
+	// GPU が完了した最新のフェンスの値を返します。
+	virtual uint64_t GetCompletedFence() = 0;
+};
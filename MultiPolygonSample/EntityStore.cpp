@@ -0,0 +1,151 @@
+﻿#include "EntityStore.h"
+
+using namespace DirectX;
+
+// 世代を 1 つ進めます。一周したときは無効なハンドルを表す 0 を飛ばします。
+static uint32_t NextGeneration(uint32_t generation)
+{
+	++generation;
+	return generation == 0 ? 1 : generation;
+}
+
+const uint32_t EntityStore::NoIndex;
+
+EntityStore::EntityStore()
+{
+}
+
+void EntityStore::Reserve(uint32_t count)
+{
+	m_localTransforms.reserve(count);
+	m_angularVelocities.reserve(count);
+	m_meshes.reserve(count);
+	m_colors.reserve(count);
+	m_bounds.x.reserve(count);
+	m_bounds.y.reserve(count);
+	m_bounds.z.reserve(count);
+	m_bounds.radius.reserve(count);
+	m_slots.reserve(count);
+	m_generations.reserve(count);
+	m_indices.reserve(count);
+}
+
+EntityHandle EntityStore::Create(uint32_t mesh, const XMFLOAT4X4& localTransform, const XMFLOAT4& color)
+{
+	// 最後に空いたスロットから使うので、削除と追加を繰り返してもスロットの数は増えません。
+	uint32_t slot;
+	if (m_freeSlots.empty())
+	{
+		slot = static_cast<uint32_t>(m_generations.size());
+		m_generations.push_back(1);
+		m_indices.push_back(NoIndex);
+	}
+	else
+	{
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+
+	const uint32_t index = GetCount();
+	m_localTransforms.push_back(localTransform);
+	m_angularVelocities.push_back(0.0f);
+	m_meshes.push_back(mesh);
+	m_colors.push_back(color);
+	m_bounds.x.push_back(0.0f);
+	m_bounds.y.push_back(0.0f);
+	m_bounds.z.push_back(0.0f);
+	m_bounds.radius.push_back(0.0f);
+	m_slots.push_back(slot);
+	m_indices[slot] = index;
+
+	EntityHandle entity;
+	entity.index = slot;
+	entity.generation = m_generations[slot];
+	return entity;
+}
+
+bool EntityStore::Destroy(EntityHandle entity)
+{
+	const uint32_t index = GetIndex(entity);
+	if (index == NoIndex)
+	{
+		return false;
+	}
+
+	// 末尾のエンティティを空いた位置に移し、dense 配列を詰めたままにします。
+	const uint32_t last = GetCount() - 1;
+	if (index != last)
+	{
+		m_localTransforms[index] = m_localTransforms[last];
+		m_angularVelocities[index] = m_angularVelocities[last];
+		m_meshes[index] = m_meshes[last];
+		m_colors[index] = m_colors[last];
+		m_bounds.x[index] = m_bounds.x[last];
+		m_bounds.y[index] = m_bounds.y[last];
+		m_bounds.z[index] = m_bounds.z[last];
+		m_bounds.radius[index] = m_bounds.radius[last];
+		m_slots[index] = m_slots[last];
+		m_indices[m_slots[index]] = index;
+	}
+
+	m_localTransforms.pop_back();
+	m_angularVelocities.pop_back();
+	m_meshes.pop_back();
+	m_colors.pop_back();
+	m_bounds.Resize(last);
+	m_slots.pop_back();
+
+	m_indices[entity.index] = NoIndex;
+	m_generations[entity.index] = NextGeneration(m_generations[entity.index]);
+	m_freeSlots.push_back(entity.index);
+	return true;
+}
+
+void EntityStore::Clear()
+{
+	for (uint32_t slot : m_slots)
+	{
+		m_indices[slot] = NoIndex;
+		m_generations[slot] = NextGeneration(m_generations[slot]);
+		m_freeSlots.push_back(slot);
+	}
+
+	m_localTransforms.clear();
+	m_angularVelocities.clear();
+	m_meshes.clear();
+	m_colors.clear();
+	m_bounds.Resize(0);
+	m_slots.clear();
+}
+
+bool EntityStore::IsAlive(EntityHandle entity) const
+{
+	return GetIndex(entity) != NoIndex;
+}
+
+uint32_t EntityStore::GetIndex(EntityHandle entity) const
+{
+	if (entity.index >= m_generations.size() || m_generations[entity.index] != entity.generation)
+	{
+		return NoIndex;
+	}
+	return m_indices[entity.index];
+}
+
+EntityHandle EntityStore::GetHandle(uint32_t index) const
+{
+	EntityHandle entity;
+	entity.index = m_slots[index];
+	entity.generation = m_generations[entity.index];
+	return entity;
+}
+
+void EntityStore::CopyHandles(std::vector<EntityHandle>& entities) const
+{
+	entities.resize(m_slots.size());
+	for (size_t i = 0; i < m_slots.size(); ++i)
+	{
+		entities[i].index = m_slots[i];
+		entities[i].generation = m_generations[m_slots[i]];
+	}
+}
@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "FrustumCulling.h"
+
+// EntityStore のエンティティを指すハンドル。
+// スロットを使い回しても世代が変わるので、削除したエンティティのハンドルは無効になります。
+struct EntityHandle
+{
+	uint32_t index;			// スロットの番号
+	uint32_t generation;	// 0 は無効なハンドルを表します
+
+	bool IsValid() const { return generation != 0; }
+};
+
+inline bool operator==(const EntityHandle& a, const EntityHandle& b)
+{
+	return a.index == b.index && a.generation == b.generation;
+}
+
+inline bool operator!=(const EntityHandle& a, const EntityHandle& b)
+{
+	return !(a == b);
+}
+
+/**
+ * シーンのエンティティと、そのコンポーネントを SoA 形式で持つストア。
+ * コンポーネントは生きているエンティティだけを [0, GetCount()) の連続した配列 (dense 配列) に詰めて並べるので、
+ * システムは添字の順に連続したメモリを読み書きできます。
+ * 削除は末尾のエンティティを空いた位置に移して詰めるので O(1) ですが、dense 配列の順はそのたびに変わります。
+ * 描画のように順に依存する処理をまたいでエンティティを覚えておくときは、添字ではなくハンドルを使ってください。
+ */
+class EntityStore
+{
+public:
+	static const uint32_t NoIndex = 0xFFFFFFFF;
+
+	EntityStore();
+
+	// count 個のエンティティを追加してもメモリを確保し直さないようにします。
+	void Reserve(uint32_t count);
+
+	// エンティティを追加し、そのハンドルを返します。ワールド空間の境界球は 0 で初期化します。
+	EntityHandle Create(uint32_t mesh, const DirectX::XMFLOAT4X4& localTransform, const DirectX::XMFLOAT4& color);
+
+	// エンティティを削除します。ハンドルが無効なら何もせずに false を返します。
+	bool Destroy(EntityHandle entity);
+
+	// すべてのエンティティを削除します。それまでのハンドルはすべて無効になります。
+	void Clear();
+
+	bool IsAlive(EntityHandle entity) const;
+
+	// エンティティの dense 配列での位置。ハンドルが無効なら NoIndex を返します。
+	uint32_t GetIndex(EntityHandle entity) const;
+
+	// dense 配列の index 番目のエンティティのハンドル。
+	EntityHandle GetHandle(uint32_t index) const;
+
+	uint32_t GetCount() const { return static_cast<uint32_t>(m_meshes.size()); }
+
+	// dense 配列の順のコンポーネント。要素の数は GetCount() です。
+	DirectX::XMFLOAT4X4* GetLocalTransforms() { return m_localTransforms.empty() ? nullptr : &m_localTransforms[0]; }
+	const DirectX::XMFLOAT4X4* GetLocalTransforms() const { return m_localTransforms.empty() ? nullptr : &m_localTransforms[0]; }
+	float* GetAngularVelocities() { return m_angularVelocities.empty() ? nullptr : &m_angularVelocities[0]; }
+	const float* GetAngularVelocities() const { return m_angularVelocities.empty() ? nullptr : &m_angularVelocities[0]; }
+	uint32_t* GetMeshes() { return m_meshes.empty() ? nullptr : &m_meshes[0]; }
+	const uint32_t* GetMeshes() const { return m_meshes.empty() ? nullptr : &m_meshes[0]; }
+	DirectX::XMFLOAT4* GetColors() { return m_colors.empty() ? nullptr : &m_colors[0]; }
+	const DirectX::XMFLOAT4* GetColors() const { return m_colors.empty() ? nullptr : &m_colors[0]; }
+
+	// ワールド空間の境界球。値は書き換えてかまいませんが、要素の数は変えないでください。
+	BoundingSphereArray& GetBounds() { return m_bounds; }
+	const BoundingSphereArray& GetBounds() const { return m_bounds; }
+
+	// dense 配列の順のハンドルとメッシュの番号をコピーします。描画のスナップショットに使います。
+	void CopyHandles(std::vector<EntityHandle>& entities) const;
+	void CopyMeshes(std::vector<uint32_t>& meshes) const { meshes = m_meshes; }
+
+private:
+	// dense 配列のコンポーネント
+	std::vector<DirectX::XMFLOAT4X4> m_localTransforms;
+	std::vector<float> m_angularVelocities;	// ローカル座標の z 軸まわりの回転の速さ (ラジアン/秒)
+	std::vector<uint32_t> m_meshes;
+	std::vector<DirectX::XMFLOAT4> m_colors;
+	BoundingSphereArray m_bounds;
+	std::vector<uint32_t> m_slots;			// dense 配列の位置ごとのスロットの番号
+
+	// スロットごとの状態
+	std::vector<uint32_t> m_generations;	// 生きているスロットは現在の世代、空いているスロットは次に使う世代
+	std::vector<uint32_t> m_indices;		// スロットのエンティティの dense 配列での位置。空いていれば NoIndex
+	std::vector<uint32_t> m_freeSlots;
+};
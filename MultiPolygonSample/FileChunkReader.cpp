@@ -0,0 +1,168 @@
+﻿#include "FileChunkReader.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileChunkReader::FileChunkReader(size_t chunkSize) :
+	m_buffer(std::max<size_t>(chunkSize, 1)),
+	m_fileSize(0),
+	m_position(0),
+	m_error(false),
+#if defined(_WIN32)
+	m_file(INVALID_HANDLE_VALUE)
+#else
+	m_descriptor(-1)
+#endif
+{
+}
+
+FileChunkReader::~FileChunkReader()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+bool FileChunkReader::Open(const PathString& path)
+{
+	Close();
+
+	CREATEFILE2_EXTENDED_PARAMETERS parameters = {0};
+	parameters.dwSize = sizeof(parameters);
+	parameters.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+	parameters.dwFileFlags = FILE_FLAG_SEQUENTIAL_SCAN;
+	m_file = CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, &parameters);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_file, &fileSize))
+	{
+		Close();
+		return false;
+	}
+	m_fileSize = static_cast<uint64_t>(fileSize.QuadPart);
+	return true;
+}
+
+void FileChunkReader::Close()
+{
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_fileSize = 0;
+	m_position = 0;
+	m_error = false;
+}
+
+bool FileChunkReader::IsOpen() const
+{
+	return m_file != INVALID_HANDLE_VALUE;
+}
+
+bool FileChunkReader::ReadNext(const uint8_t*& data, size_t& size)
+{
+	if (!IsOpen() || m_error || m_position >= m_fileSize)
+	{
+		return false;
+	}
+
+	const DWORD requested = static_cast<DWORD>(std::min<uint64_t>(m_buffer.size(), m_fileSize - m_position));
+	DWORD read = 0;
+	if (!ReadFile(m_file, &m_buffer[0], requested, &read, nullptr) || read == 0)
+	{
+		m_error = true;
+		return false;
+	}
+
+	m_position += read;
+	data = &m_buffer[0];
+	size = read;
+	return true;
+}
+#else
+bool FileChunkReader::Open(const PathString& path)
+{
+	Close();
+
+	m_descriptor = open(path.c_str(), O_RDONLY);
+	if (m_descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(m_descriptor, &status) != 0)
+	{
+		Close();
+		return false;
+	}
+	m_fileSize = static_cast<uint64_t>(status.st_size);
+
+	posix_fadvise(m_descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+	return true;
+}
+
+void FileChunkReader::Close()
+{
+	if (m_descriptor >= 0)
+	{
+		close(m_descriptor);
+		m_descriptor = -1;
+	}
+	m_fileSize = 0;
+	m_position = 0;
+	m_error = false;
+}
+
+bool FileChunkReader::IsOpen() const
+{
+	return m_descriptor >= 0;
+}
+
+bool FileChunkReader::ReadNext(const uint8_t*& data, size_t& size)
+{
+	if (!IsOpen() || m_error || m_position >= m_fileSize)
+	{
+		return false;
+	}
+
+	// read は要求より少なく返すことがあるので、チャンクが埋まるかファイルの終わりまで繰り返します。
+	const size_t requested = static_cast<size_t>(std::min<uint64_t>(m_buffer.size(), m_fileSize - m_position));
+	size_t filled = 0;
+	while (filled < requested)
+	{
+		const ssize_t read = ::read(m_descriptor, &m_buffer[filled], requested - filled);
+		if (read < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (read <= 0)
+		{
+			break;
+		}
+		filled += static_cast<size_t>(read);
+	}
+
+	if (filled == 0)
+	{
+		m_error = true;
+		return false;
+	}
+
+	m_position += filled;
+	data = &m_buffer[0];
+	size = filled;
+	return true;
+}
+#endif
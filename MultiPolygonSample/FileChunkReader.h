@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MappedFile.h"
+
+/**
+ * 大きなファイルを先頭から決まった大きさのチャンクずつ読み取ります。
+ * 1 つのバッファーを使い回すので、ファイル全体をマップしたり読み込んだりするのと違い、
+ * ファイルの大きさによらずメモリの使用量はチャンク 1 つ分で済みます。
+ * 先頭から順に読むことを OS に伝えるので、次のチャンクは先読みされます。
+ */
+class FileChunkReader
+{
+public:
+	// 既定のチャンクの大きさ (1 MiB)。
+	static const size_t DefaultChunkSize = 1024 * 1024;
+
+	explicit FileChunkReader(size_t chunkSize);
+	~FileChunkReader();
+
+	// path を開きます。失敗したら false を返します。開いていたファイルは先に閉じます。
+	bool Open(const PathString& path);
+	void Close();
+
+	// 次のチャンクを読み取り、data と size に設定します。ファイルの終わりか読み取りに失敗したら false を返します。
+	// data は次に ReadNext か Close を呼び出すまで有効です。
+	bool ReadNext(const uint8_t*& data, size_t& size);
+
+	bool IsOpen() const;
+	uint64_t GetFileSize() const { return m_fileSize; }
+	uint64_t GetPosition() const { return m_position; }
+
+	// 直前の ReadNext が読み取りの失敗で false を返したかどうか。
+	bool HasError() const { return m_error; }
+
+private:
+	FileChunkReader(const FileChunkReader&);
+	FileChunkReader& operator=(const FileChunkReader&);
+
+	std::vector<uint8_t> m_buffer;
+	uint64_t m_fileSize;
+	uint64_t m_position;
+	bool m_error;
+#if defined(_WIN32)
+	void* m_file;
+#else
+	int m_descriptor;
+#endif
+};
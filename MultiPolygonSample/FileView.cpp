@@ -0,0 +1,39 @@
+﻿#include "FileView.h"
+#include <algorithm>
+
+FileView::FileView() :
+	m_data(nullptr),
+	m_size(0)
+{
+}
+
+FileView::FileView(const std::shared_ptr<const void>& owner, const uint8_t* data, size_t size) :
+	m_owner(owner),
+	m_data(data),
+	m_size(size)
+{
+}
+
+FileView FileView::Map(const PathString& path)
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(path))
+	{
+		return FileView();
+	}
+	return FileView(file, file->GetData(), file->GetSize());
+}
+
+FileView FileView::Slice(size_t offset, size_t size) const
+{
+	offset = std::min(offset, m_size);
+	size = std::min(size, m_size - offset);
+	return FileView(m_owner, m_data + offset, size);
+}
+
+void FileView::Reset()
+{
+	m_owner.reset();
+	m_data = nullptr;
+	m_size = 0;
+}
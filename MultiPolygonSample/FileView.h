@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "MappedFile.h"
+
+/**
+ * ファイルの内容への読み取り専用のビュー。
+ * 中身は持ち主 (マップしたファイルや、読み取りに使ったバッファー) のメモリをそのまま指し、コピーしません。
+ * 持ち主はビューのコピーどうしで共有し、最後のビューを Reset するか破棄したときに解放されます。
+ */
+class FileView
+{
+public:
+	FileView();
+
+	// owner が保持している [data, data + size) を指すビューを作ります。
+	FileView(const std::shared_ptr<const void>& owner, const uint8_t* data, size_t size);
+
+	// path をマップしたビューを作ります。開けなければ空のビューを返します。
+	static FileView Map(const PathString& path);
+
+	bool IsValid() const { return m_owner != nullptr; }
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+	// [offset, offset + size) を指す、持ち主を共有するビューを返します。範囲はビューの中に切り詰めます。
+	FileView Slice(size_t offset, size_t size) const;
+
+	// 持ち主への参照を手放します。
+	void Reset();
+
+private:
+	std::shared_ptr<const void> m_owner;
+	const uint8_t* m_data;
+	size_t m_size;
+};
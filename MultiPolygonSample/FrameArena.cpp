@@ -0,0 +1,128 @@
+﻿#include "FrameArena.h"
+#include <algorithm>
+#include <new>
+
+static uintptr_t AlignUp(uintptr_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+}
+
+FrameArena::FrameArena(size_t initialCapacity) :
+	m_allocation(nullptr),
+	m_block(nullptr),
+	m_capacity(0),
+	m_offset(0),
+	m_allocationCount(0),
+	m_overflowBytes(0),
+	m_lastFrameBytes(0)
+{
+	AllocateBlock(initialCapacity);
+}
+
+FrameArena::~FrameArena()
+{
+	RecordFrame();
+	FreeOverflowBlocks();
+	FreeBlock();
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	const uintptr_t base = reinterpret_cast<uintptr_t>(m_block);
+	m_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	size_t offset = m_offset.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		const size_t begin = static_cast<size_t>(AlignUp(base + offset, alignment) - base);
+		const size_t end = begin + size;
+		if (end > m_capacity)
+		{
+			return AllocateOverflow(size, alignment);
+		}
+
+		// 失敗したときは offset が現在の値に更新されるので、その位置から揃え直します。
+		if (m_offset.compare_exchange_weak(offset, end, std::memory_order_relaxed))
+		{
+			return m_block + begin;
+		}
+	}
+}
+
+// ブロックに収まらない確保は、ヒープから個別に確保して Reset まで保持します。
+void* FrameArena::AllocateOverflow(size_t size, size_t alignment)
+{
+	const size_t bytes = size + alignment;
+	void* allocation = ::operator new(bytes);
+	MemoryTracker::RecordHeapAllocation(MemoryCategory::FrameArena, bytes);
+
+	std::lock_guard<std::mutex> lock(m_overflowMutex);
+	m_overflowBlocks.push_back(allocation);
+	m_overflowBytes += bytes;
+	return reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(allocation), alignment));
+}
+
+void FrameArena::Reset()
+{
+	const size_t used = RecordFrame();
+	m_lastFrameBytes = used;
+
+	// ブロックからあふれたフレームがあれば、次からはそのフレームの使用量が 1 つのブロックに収まるようにします。
+	if (!m_overflowBlocks.empty())
+	{
+		FreeOverflowBlocks();
+		const size_t capacity = std::max(m_capacity * 2, used);
+		FreeBlock();
+		AllocateBlock(capacity);
+	}
+	m_offset.store(0, std::memory_order_relaxed);
+}
+
+void FrameArena::AllocateBlock(size_t capacity)
+{
+	if (capacity == 0)
+	{
+		return;
+	}
+	const size_t bytes = capacity + BlockAlignment;
+	m_allocation = ::operator new(bytes);
+	m_block = reinterpret_cast<uint8_t*>(AlignUp(reinterpret_cast<uintptr_t>(m_allocation), BlockAlignment));
+	m_capacity = capacity;
+	MemoryTracker::RecordHeapAllocation(MemoryCategory::FrameArena, bytes);
+}
+
+void FrameArena::FreeBlock()
+{
+	if (m_allocation == nullptr)
+	{
+		return;
+	}
+	::operator delete(m_allocation);
+	MemoryTracker::RecordHeapFree(MemoryCategory::FrameArena, m_capacity + BlockAlignment);
+	m_allocation = nullptr;
+	m_block = nullptr;
+	m_capacity = 0;
+}
+
+void FrameArena::FreeOverflowBlocks()
+{
+	for (void* allocation : m_overflowBlocks)
+	{
+		::operator delete(allocation);
+	}
+	MemoryTracker::RecordHeapFree(MemoryCategory::FrameArena, m_overflowBytes);
+	m_overflowBlocks.clear();
+	m_overflowBytes = 0;
+}
+
+// 前の Reset からの確保をまとめて記録し、その使用量を返します。
+size_t FrameArena::RecordFrame()
+{
+	const size_t used = m_offset.load(std::memory_order_relaxed) + m_overflowBytes;
+	const uint32_t count = m_allocationCount.exchange(0, std::memory_order_relaxed);
+	if (count > 0)
+	{
+		MemoryTracker::RecordAllocation(MemoryCategory::FrameArena, used, count);
+		MemoryTracker::RecordFree(MemoryCategory::FrameArena, used);
+	}
+	return used;
+}
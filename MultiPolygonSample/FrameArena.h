@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include "MemoryTracker.h"
+
+/**
+ * 1 フレームの間だけ使う作業領域を、先頭から順に切り出して貸し出すアロケーター (線形アロケーター)。
+ * 個別の解放はなく、フレームの終わり (Present の後) に Reset でまとめて捨てます。
+ *
+ * Allocate は複数のスレッドから同時に呼び出せます。ブロックの空きは compare_exchange で確保するので、ロックは取りません。
+ * ブロックに収まらない確保はヒープから個別に確保し、Reset でそのフレームの使用量が収まる大きさにブロックを広げます。
+ * そのため、使用量が前のフレームと変わらなければ、ヒープからの確保は起こりません。
+ * MemoryTracker には、Reset のときにそのフレームの確保をまとめて記録します。
+ * 確保したメモリは初期化せず、コンストラクターやデストラクターも呼び出しません。
+ */
+class FrameArena
+{
+public:
+	// initialCapacity バイトのブロックを確保します。0 なら最初のフレームの使用量に合わせて確保します。
+	explicit FrameArena(size_t initialCapacity);
+	~FrameArena();
+
+	// alignment (2 のべき乗) に揃えた size バイトの領域を返します。Reset まで有効です。
+	void* Allocate(size_t size, size_t alignment);
+
+	// T の配列の領域を返します。コンストラクターもデストラクターも呼び出さないので、T は POD に限ります。
+	template <typename T>
+	T* AllocateArray(size_t count)
+	{
+		static_assert(std::is_pod<T>::value, "FrameArena does not run constructors or destructors.");
+		return static_cast<T*>(Allocate(sizeof(T) * count, std::alignment_of<T>::value));
+	}
+
+	// 貸し出したすべての領域を捨てます。Allocate と並行して呼び出さないでください。
+	void Reset();
+
+	size_t GetCapacity() const { return m_capacity; }
+
+	// 直前の Reset までのフレームで使った量 (揃えるための余白を含みます)。
+	size_t GetLastFrameBytes() const { return m_lastFrameBytes; }
+
+private:
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+
+	void* AllocateOverflow(size_t size, size_t alignment);
+	void AllocateBlock(size_t capacity);
+	void FreeBlock();
+	void FreeOverflowBlocks();
+	size_t RecordFrame();
+
+	static const size_t BlockAlignment = 64;
+
+	void* m_allocation;		// ヒープから確保したブロック
+	uint8_t* m_block;		// m_allocation を BlockAlignment に揃えた先頭
+	size_t m_capacity;
+	std::atomic<size_t> m_offset;
+	std::atomic<uint32_t> m_allocationCount;	// 前の Reset からの確保の回数
+
+	std::mutex m_overflowMutex;
+	std::vector<void*> m_overflowBlocks;
+	size_t m_overflowBytes;
+	size_t m_lastFrameBytes;
+};
@@ -0,0 +1,136 @@
+﻿#include "FramePipeline.h"
+
+FramePipeline::FramePipeline(FramePipelineMode mode) :
+	m_mode(mode),
+	m_primed(false),
+	m_renderSlot(0),
+	m_frameCount(0),
+	m_pendingUpdate(nullptr),
+	m_pendingSlot(0),
+	m_updateRunning(false),
+	m_quit(false)
+{
+	m_worker = std::thread(&FramePipeline::WorkerMain, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_condition.notify_all();
+	m_worker.join();
+}
+
+void FramePipeline::SetMode(FramePipelineMode mode)
+{
+	if (mode != m_mode)
+	{
+		m_mode = mode;
+		m_primed = false;
+	}
+}
+
+void FramePipeline::RunFrame(const StageFunction& update, const StageFunction& render)
+{
+	++m_frameCount;
+
+	if (m_mode == FramePipelineMode::Serial)
+	{
+		m_renderSlot = 0;
+		update(m_renderSlot);
+		render(m_renderSlot);
+		return;
+	}
+
+	// 最初のフレームは描画するスナップショットがないので、このスレッドで更新します。
+	if (!m_primed)
+	{
+		update(m_renderSlot);
+		m_primed = true;
+	}
+
+	const uint32_t updateSlot = (m_renderSlot + 1) % SnapshotCount;
+	StartUpdate(update, updateSlot);
+	try
+	{
+		render(m_renderSlot);
+	}
+	catch (...)
+	{
+		WaitForUpdate();
+		throw;
+	}
+	WaitForUpdate();
+
+	m_renderSlot = updateSlot;
+}
+
+void FramePipeline::StartUpdate(const StageFunction& update, uint32_t slot)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingUpdate = &update;
+		m_pendingSlot = slot;
+		m_updateRunning = true;
+	}
+	m_condition.notify_all();
+}
+
+void FramePipeline::WaitForUpdate()
+{
+	std::exception_ptr exception;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_updateRunning)
+		{
+			m_condition.wait(lock);
+		}
+		exception = m_updateException;
+		m_updateException = nullptr;
+	}
+
+	if (exception != nullptr)
+	{
+		// 更新が途中で終わったスナップショットは描画できないので、次のフレームで作り直します。
+		m_primed = false;
+		std::rethrow_exception(exception);
+	}
+}
+
+void FramePipeline::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		while (m_pendingUpdate == nullptr && !m_quit)
+		{
+			m_condition.wait(lock);
+		}
+		if (m_quit)
+		{
+			return;
+		}
+
+		const StageFunction* update = m_pendingUpdate;
+		const uint32_t slot = m_pendingSlot;
+		m_pendingUpdate = nullptr;
+
+		lock.unlock();
+		std::exception_ptr exception;
+		try
+		{
+			(*update)(slot);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+		lock.lock();
+
+		m_updateException = exception;
+		m_updateRunning = false;
+		m_condition.notify_all();
+	}
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// フレームの更新と描画の進め方。
+enum class FramePipelineMode : uint32_t
+{
+	Serial,		// 更新、描画、表示を順に行います。入力から表示までの遅延が最も小さくなります。
+	Pipelined	// 次のフレームの更新をワーカー スレッドで行い、現在のフレームの描画と表示に重ねます。
+};
+
+/**
+ * フレームの更新と描画を、スナップショットのダブル バッファーを介して分けて実行します。
+ * 更新はスナップショットのスロットに結果を書き込み、描画は別のスロットを読み取るだけにします。
+ *
+ * Pipelined では、フレーム N を描画している間にフレーム N+1 の更新を進め、
+ * RunFrame の終わりで必ず合流します。そのため、RunFrame の外 (イベントの処理など) で
+ * シーンを変更しても更新と競合しません。スループットと引き換えに、表示は 1 フレーム遅れます。
+ */
+class FramePipeline
+{
+public:
+	static const uint32_t SnapshotCount = 2;
+
+	// slot は書き込みまたは読み取りに使うスナップショットの番号です。
+	typedef std::function<void(uint32_t slot)> StageFunction;
+
+	explicit FramePipeline(FramePipelineMode mode);
+	~FramePipeline();
+
+	// 次の RunFrame から適用します。
+	void SetMode(FramePipelineMode mode);
+	FramePipelineMode GetMode() const { return m_mode; }
+
+	// 1 フレームを実行します。render には表示までを含めてください。
+	// Pipelined で update が例外を投げた場合は、合流したときにこのスレッドで投げ直します。
+	void RunFrame(const StageFunction& update, const StageFunction& render);
+
+	uint64_t GetFrameCount() const { return m_frameCount; }
+
+private:
+	FramePipeline(const FramePipeline&);
+	FramePipeline& operator=(const FramePipeline&);
+
+	void WorkerMain();
+	void StartUpdate(const StageFunction& update, uint32_t slot);
+	void WaitForUpdate();
+
+	FramePipelineMode m_mode;
+	bool m_primed;			// m_renderSlot に描画できるスナップショットがあるかどうか
+	uint32_t m_renderSlot;
+	uint64_t m_frameCount;
+
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	const StageFunction* m_pendingUpdate;
+	uint32_t m_pendingSlot;
+	bool m_updateRunning;
+	bool m_quit;
+	std::exception_ptr m_updateException;
+};
@@ -0,0 +1,160 @@
+﻿#include "FrameScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+FrameSchedulerSettings::FrameSchedulerSettings() :
+	refreshRate(60.0),
+	fixedTimeStep(1.0 / 60.0),
+	maxStepsPerFrame(4),
+	maxSyncInterval(4),
+	adaptationFrames(30),
+	missesToSlowDown(3),
+	speedUpHeadroom(0.75),
+	redrawFrameCount(1)
+{
+}
+
+FrameScheduler::FrameScheduler(const FrameSchedulerSettings& settings) :
+	m_settings(settings),
+	m_started(false),
+	m_idle(false),
+	m_redrawFrames(0),
+	m_lastTime(0.0),
+	m_accumulator(0.0),
+	m_simulationTime(0.0),
+	m_lastRenderTime(0.0),
+	m_idleRefreshes(0.0),
+	m_syncInterval(1)
+{
+	m_settings.maxStepsPerFrame = std::max(m_settings.maxStepsPerFrame, 1u);
+	m_settings.maxSyncInterval = std::max(m_settings.maxSyncInterval, 1u);
+	m_settings.redrawFrameCount = std::max(m_settings.redrawFrameCount, 1u);
+	memset(&m_stats, 0, sizeof(m_stats));
+	ResetAdaptation();
+}
+
+void FrameScheduler::RequestRedraw()
+{
+	m_redrawFrames = m_settings.redrawFrameCount;
+}
+
+FrameDecision FrameScheduler::BeginFrame(double now)
+{
+	double elapsed = m_started ? std::max(now - m_lastTime, 0.0) : 0.0;
+	m_started = true;
+	m_lastTime = now;
+
+	// 止まっている間の時間は、イベントで起きたフレームの分も含めて待っていた時間とし、シミュレーションには加えません。
+	if (m_idle)
+	{
+		m_stats.idleSeconds += elapsed;
+		m_idleRefreshes += elapsed * m_settings.refreshRate;
+		const double refreshes = std::floor(m_idleRefreshes);
+		m_stats.skippedFrames += static_cast<uint64_t>(refreshes);
+		m_idleRefreshes -= refreshes;
+		elapsed = 0.0;
+	}
+
+	FrameDecision decision;
+	decision.syncInterval = m_syncInterval;
+
+	if (m_idle && m_redrawFrames == 0)
+	{
+		++m_stats.idleWakeups;
+		decision.render = false;
+		decision.simulationSteps = 0;
+		decision.simulationTime = m_simulationTime;
+		decision.renderTime = m_lastRenderTime;
+		decision.renderDelta = 0.0;
+		decision.interpolation = 0.0f;
+		return decision;
+	}
+	m_idle = false;
+
+	const double step = m_settings.fixedTimeStep;
+	m_accumulator += elapsed;
+	uint32_t steps = static_cast<uint32_t>(std::min(std::floor(m_accumulator / step), static_cast<double>(UINT32_MAX)));
+	if (steps > m_settings.maxStepsPerFrame)
+	{
+		// 長く止まったときに刻みをまとめて進めると、それでまた遅れるので、追いつけない分は捨てます。
+		m_stats.droppedSteps += steps - m_settings.maxStepsPerFrame;
+		steps = m_settings.maxStepsPerFrame;
+		m_accumulator = std::fmod(m_accumulator, step);
+	}
+	else
+	{
+		m_accumulator -= steps * step;
+	}
+	m_simulationTime += steps * step;
+	m_stats.simulationSteps += steps;
+
+	// 最後の刻みの状態と、その 1 つ前の刻みの状態の間を補間して描画するので、描画する時刻は 1 刻み遅れます。
+	const double alpha = std::min(std::max(m_accumulator / step, 0.0), 1.0);
+	const double renderTime = std::max(m_simulationTime - step + alpha * step, m_lastRenderTime);
+
+	decision.render = true;
+	decision.simulationSteps = steps;
+	decision.simulationTime = m_simulationTime;
+	decision.renderTime = renderTime;
+	decision.renderDelta = renderTime - m_lastRenderTime;
+	decision.interpolation = static_cast<float>(alpha);
+	m_lastRenderTime = renderTime;
+	return decision;
+}
+
+void FrameScheduler::EndFrame(double workSeconds, bool sceneChanging)
+{
+	++m_stats.renderedFrames;
+	if (m_redrawFrames > 0)
+	{
+		--m_redrawFrames;
+	}
+
+	const double deadline = m_syncInterval / m_settings.refreshRate;
+	++m_windowFrames;
+	m_windowMaxWork = std::max(m_windowMaxWork, workSeconds);
+	m_windowWorkSum += workSeconds;
+	if (workSeconds > deadline)
+	{
+		++m_stats.deadlineMisses;
+		++m_windowMisses;
+	}
+
+	if (m_windowMisses >= m_settings.missesToSlowDown)
+	{
+		// 平均の処理時間が収まる間隔まで、少なくとも 1 つ広げます。
+		const double meanWork = m_windowWorkSum / m_windowFrames;
+		const double required = std::ceil(meanWork * m_settings.refreshRate);
+		const uint32_t syncInterval = static_cast<uint32_t>(std::min(std::max(required, m_syncInterval + 1.0), static_cast<double>(m_settings.maxSyncInterval)));
+		ChangeSyncInterval(syncInterval);
+		ResetAdaptation();
+	}
+	else if (m_windowFrames >= m_settings.adaptationFrames)
+	{
+		if (m_syncInterval > 1 && m_windowMaxWork <= m_settings.speedUpHeadroom * (m_syncInterval - 1) / m_settings.refreshRate)
+		{
+			ChangeSyncInterval(m_syncInterval - 1);
+		}
+		ResetAdaptation();
+	}
+
+	m_idle = !sceneChanging && m_redrawFrames == 0;
+}
+
+void FrameScheduler::ChangeSyncInterval(uint32_t syncInterval)
+{
+	if (syncInterval != m_syncInterval)
+	{
+		m_syncInterval = syncInterval;
+		++m_stats.syncIntervalChanges;
+	}
+}
+
+void FrameScheduler::ResetAdaptation()
+{
+	m_windowFrames = 0;
+	m_windowMisses = 0;
+	m_windowMaxWork = 0.0;
+	m_windowWorkSum = 0.0;
+}
@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include <cstdint>
+
+struct FrameSchedulerSettings
+{
+	FrameSchedulerSettings();
+
+	double refreshRate;			// 表示の垂直同期の頻度 (Hz)
+	double fixedTimeStep;		// シミュレーションを進める固定の刻み (秒)
+	uint32_t maxStepsPerFrame;	// 1 フレームで進める刻みの上限。それを超えて遅れた分の時間は捨てます
+	uint32_t maxSyncInterval;	// 表示の頻度を下げるときの、垂直同期の間隔の上限
+	uint32_t adaptationFrames;	// 表示の頻度を上げてよいか判断するまでに計るフレームの数
+	uint32_t missesToSlowDown;	// adaptationFrames の間にこの回数だけ締め切りに遅れたら、表示の頻度を下げます
+	double speedUpHeadroom;		// 計ったすべてのフレームが、1 つ短い間隔のこの割合に収まっていれば表示の頻度を上げます
+	uint32_t redrawFrameCount;	// RequestRedraw 1 回につき描画するフレームの数。更新と描画を重ねるときは、表示が遅れる分だけ増やします
+};
+
+// BeginFrame が決めた、このフレームの処理。
+struct FrameDecision
+{
+	bool render;				// false ならこのフレームは何もせず、イベントが届くまで待ちます
+	uint32_t simulationSteps;	// このフレームで進めた固定の刻みの数
+	double simulationTime;		// 刻みを進めたあとのシミュレーションの時刻 (秒)
+	double renderTime;			// 描画する時刻。直前の 2 つの刻みの間を interpolation で補間した時刻です
+	double renderDelta;			// 前に描画したフレームからの renderTime の進み
+	float interpolation;		// 最後の刻みからの経過の、刻みに対する割合 (0 ～ 1)
+	uint32_t syncInterval;		// Present に渡す垂直同期の間隔
+};
+
+struct FrameSchedulerStats
+{
+	uint64_t renderedFrames;
+	uint64_t skippedFrames;		// シーンが変わらないので描画しなかった垂直同期の数 (待っていた時間から求めます)
+	uint64_t idleWakeups;		// 描画を止めている間に、イベントで起きたが描画しなかった回数
+	uint64_t deadlineMisses;	// 処理が垂直同期の間隔に収まらなかったフレームの数
+	uint64_t simulationSteps;
+	uint64_t droppedSteps;		// maxStepsPerFrame を超えたので捨てた刻みの数
+	uint32_t syncIntervalChanges;
+	double idleSeconds;			// 描画を止めていた時間の合計
+};
+
+/**
+ * 描画するかどうかと、表示の頻度を決めるスケジューラー。
+ * シーンが止まっていて再描画の要求もなければ描画をやめ、呼び出し側はイベントが届くまでスレッドを止めます。
+ * 止めている間はシミュレーションの時刻を進めないので、再開したときに刻みがたまることはありません。
+ *
+ * 描画したフレームの処理時間から、締め切り (垂直同期の間隔) に遅れるフレームが続けば Present の間隔を広げ、
+ * 十分な余裕が続けば狭めます。間隔が一定になるので、毎フレーム遅れてがたつくよりも表示が滑らかになります。
+ *
+ * 時刻はすべて呼び出し側が秒で渡すので、実時間の代わりに仮想の時計で動かして確かめられます。
+ */
+class FrameScheduler
+{
+public:
+	explicit FrameScheduler(const FrameSchedulerSettings& settings);
+
+	// 入力やウィンドウの変更、読み込みの完了などでシーンが変わったときに呼び出します。
+	// 描画を止めていれば、次の BeginFrame から settings.redrawFrameCount フレームを描画します。
+	void RequestRedraw();
+
+	// now の時点でフレームを始めます。描画するなら、経過時間に応じた固定の刻みの数と補間の割合を返します。
+	FrameDecision BeginFrame(double now);
+
+	// 描画したフレームの、BeginFrame から表示の直前までにかかった時間を渡します。
+	// sceneChanging が false で再描画の要求も残っていなければ、次の BeginFrame から描画を止めます。
+	void EndFrame(double workSeconds, bool sceneChanging);
+
+	// 描画を止めているかどうか。
+	bool IsIdle() const { return m_idle; }
+
+	uint32_t GetSyncInterval() const { return m_syncInterval; }
+
+	const FrameSchedulerStats& GetStats() const { return m_stats; }
+
+private:
+	void ChangeSyncInterval(uint32_t syncInterval);
+	void ResetAdaptation();
+
+	FrameSchedulerSettings m_settings;
+	bool m_started;				// BeginFrame を呼び出したことがあるかどうか
+	bool m_idle;
+	uint32_t m_redrawFrames;	// 要求されたうち、まだ描画していないフレームの数
+	double m_lastTime;
+	double m_accumulator;		// まだ刻みとして進めていない時間
+	double m_simulationTime;
+	double m_lastRenderTime;
+	double m_idleRefreshes;		// 描画を止めていた時間を垂直同期の数に直したものの、まだ数えていない端数
+	uint32_t m_syncInterval;
+	uint32_t m_windowFrames;	// 表示の頻度を見直してから計ったフレームの数
+	uint32_t m_windowMisses;
+	double m_windowMaxWork;
+	double m_windowWorkSum;
+	FrameSchedulerStats m_stats;
+};
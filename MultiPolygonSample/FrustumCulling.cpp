@@ -0,0 +1,256 @@
+﻿#include "FrustumCulling.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULLING_AVX
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRUSTUM_CULLING_SSE2
+#elif defined(_M_ARM) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FRUSTUM_CULLING_NEON
+#endif
+
+using namespace DirectX;
+
+void BoundingSphereArray::Resize(uint32_t count)
+{
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	radius.resize(count);
+}
+
+void BoundingSphereArray::Store(uint32_t index, const MeshBounds& bounds, const XMFLOAT4X4& m)
+{
+	const XMFLOAT3& c = bounds.center;
+	x[index] = c.x * m._11 + c.y * m._21 + c.z * m._31 + m._41;
+	y[index] = c.x * m._12 + c.y * m._22 + c.z * m._32 + m._42;
+	z[index] = c.x * m._13 + c.y * m._23 + c.z * m._33 + m._43;
+
+	const float scaleX = m._11 * m._11 + m._12 * m._12 + m._13 * m._13;
+	const float scaleY = m._21 * m._21 + m._22 * m._22 + m._23 * m._23;
+	const float scaleZ = m._31 * m._31 + m._32 * m._32 + m._33 * m._33;
+	radius[index] = bounds.radius * std::sqrt(std::max(scaleX, std::max(scaleY, scaleZ)));
+}
+
+MeshBounds FrustumCulling::ComputeMeshBounds(const MeshData& mesh)
+{
+	MeshBounds bounds;
+	bounds.center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bounds.extents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bounds.radius = 0.0f;
+	if (mesh.vertices.empty())
+	{
+		return bounds;
+	}
+
+	XMFLOAT3 minimum = mesh.vertices[0].pos;
+	XMFLOAT3 maximum = mesh.vertices[0].pos;
+	for (const VertexPositionColor& vertex : mesh.vertices)
+	{
+		minimum.x = std::min(minimum.x, vertex.pos.x);
+		minimum.y = std::min(minimum.y, vertex.pos.y);
+		minimum.z = std::min(minimum.z, vertex.pos.z);
+		maximum.x = std::max(maximum.x, vertex.pos.x);
+		maximum.y = std::max(maximum.y, vertex.pos.y);
+		maximum.z = std::max(maximum.z, vertex.pos.z);
+	}
+
+	bounds.center = XMFLOAT3((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+	bounds.extents = XMFLOAT3((maximum.x - minimum.x) * 0.5f, (maximum.y - minimum.y) * 0.5f, (maximum.z - minimum.z) * 0.5f);
+
+	// AABB の対角線の半分より、中心から最も遠い頂点までの距離の方が小さくなります。
+	float radiusSquared = 0.0f;
+	for (const VertexPositionColor& vertex : mesh.vertices)
+	{
+		const float dx = vertex.pos.x - bounds.center.x;
+		const float dy = vertex.pos.y - bounds.center.y;
+		const float dz = vertex.pos.z - bounds.center.z;
+		radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+	}
+	bounds.radius = std::sqrt(radiusSquared);
+	return bounds;
+}
+
+// 平面を法線の長さで割って正規化します。
+static XMFLOAT4 NormalizePlane(float a, float b, float c, float d)
+{
+	const float length = std::sqrt(a * a + b * b + c * c);
+	const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+	return XMFLOAT4(a * scale, b * scale, c * scale, d * scale);
+}
+
+Frustum FrustumCulling::ExtractFrustum(const XMFLOAT4X4& m)
+{
+	// 行ベクトルに右から掛けるので、クリップ座標の各成分は行列の列との内積になります。
+	Frustum frustum;
+	frustum.planes[0] = NormalizePlane(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);	// 左: -w <= x
+	frustum.planes[1] = NormalizePlane(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);	// 右: x <= w
+	frustum.planes[2] = NormalizePlane(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);	// 下: -w <= y
+	frustum.planes[3] = NormalizePlane(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);	// 上: y <= w
+	frustum.planes[4] = NormalizePlane(m._13, m._23, m._33, m._43);									// 手前: 0 <= z
+	frustum.planes[5] = NormalizePlane(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);	// 奥: z <= w
+	return frustum;
+}
+
+bool FrustumCulling::IsSphereVisible(const Frustum& frustum, float x, float y, float z, float radius)
+{
+	bool visible = true;
+	for (int p = 0; p < Frustum::PlaneCount; ++p)
+	{
+		const XMFLOAT4& plane = frustum.planes[p];
+		visible = visible && x * plane.x + y * plane.y + z * plane.z + plane.w >= -radius;
+	}
+	return visible;
+}
+
+// SIMD の幅に満たない末尾と、SIMD が使えない環境のための実装です。
+static uint32_t CullSpheresScalar(
+	const Frustum& frustum,
+	const BoundingSphereArray& spheres,
+	uint32_t begin,
+	uint32_t end,
+	uint32_t* visibleIndices,
+	uint32_t visibleCount
+	)
+{
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		const bool visible = FrustumCulling::IsSphereVisible(frustum, spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]);
+
+		// 分岐せずに詰めて書き込みます。見えない球の添字は次の書き込みで上書きされます。
+		visibleIndices[visibleCount] = i;
+		visibleCount += visible ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+uint32_t FrustumCulling::CullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t* visibleIndices)
+{
+	const uint32_t count = spheres.GetCount();
+	uint32_t visibleCount = 0;
+	uint32_t i = 0;
+
+#if defined(FRUSTUM_CULLING_AVX)
+	// 8 個ずつ処理します。
+	__m256 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount], planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+	for (int p = 0; p < Frustum::PlaneCount; ++p)
+	{
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+		const __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+		const __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+		const __m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(&spheres.radius[i]));
+
+		__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+		for (int p = 0; p < Frustum::PlaneCount; ++p)
+		{
+			const __m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(x, planeX[p]), _mm256_mul_ps(y, planeY[p])),
+				_mm256_add_ps(_mm256_mul_ps(z, planeZ[p]), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+		}
+
+		const int mask = _mm256_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			visibleIndices[visibleCount] = i + lane;
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#elif defined(FRUSTUM_CULLING_SSE2)
+	// 4 個ずつ処理します。
+	__m128 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount], planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+	for (int p = 0; p < Frustum::PlaneCount; ++p)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+		const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+		const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+		const __m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&spheres.radius[i]));
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < Frustum::PlaneCount; ++p)
+		{
+			const __m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])),
+				_mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			visibleIndices[visibleCount] = i + lane;
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#elif defined(FRUSTUM_CULLING_NEON)
+	// 4 個ずつ処理します。
+	float32x4_t planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount], planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+	for (int p = 0; p < Frustum::PlaneCount; ++p)
+	{
+		planeX[p] = vdupq_n_f32(frustum.planes[p].x);
+		planeY[p] = vdupq_n_f32(frustum.planes[p].y);
+		planeZ[p] = vdupq_n_f32(frustum.planes[p].z);
+		planeW[p] = vdupq_n_f32(frustum.planes[p].w);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const float32x4_t x = vld1q_f32(&spheres.x[i]);
+		const float32x4_t y = vld1q_f32(&spheres.y[i]);
+		const float32x4_t z = vld1q_f32(&spheres.z[i]);
+		const float32x4_t negRadius = vnegq_f32(vld1q_f32(&spheres.radius[i]));
+
+		uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+		for (int p = 0; p < Frustum::PlaneCount; ++p)
+		{
+			const float32x4_t distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(planeW[p], x, planeX[p]), y, planeY[p]), z, planeZ[p]);
+			inside = vandq_u32(inside, vcgeq_f32(distance, negRadius));
+		}
+
+		uint32_t lanes[4];
+		vst1q_u32(lanes, inside);
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			visibleIndices[visibleCount] = i + lane;
+			visibleCount += lanes[lane] & 1;
+		}
+	}
+#endif
+
+	return CullSpheresScalar(frustum, spheres, i, count, visibleIndices, visibleCount);
+}
+
+const char* FrustumCulling::GetImplementationName()
+{
+#if defined(FRUSTUM_CULLING_AVX)
+	return "AVX";
+#elif defined(FRUSTUM_CULLING_SSE2)
+	return "SSE2";
+#elif defined(FRUSTUM_CULLING_NEON)
+	return "NEON";
+#else
+	return "Scalar";
+#endif
+}
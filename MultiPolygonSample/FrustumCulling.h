@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+
+// ローカル空間でのメッシュの境界。
+// center を中心とする半径 extents の AABB と、同じ中心で全頂点を含む半径 radius の球です。
+struct MeshBounds
+{
+	DirectX::XMFLOAT3 center;
+	DirectX::XMFLOAT3 extents;
+	float radius;
+};
+
+// 視錐台の 6 平面。各平面 (x, y, z, w) は正規化されていて、
+// x * px + y * py + z * pz + w >= 0 となる点 p が内側です。
+struct Frustum
+{
+	enum { PlaneCount = 6 };
+	DirectX::XMFLOAT4 planes[PlaneCount];
+};
+
+// ワールド空間の境界球を SoA 形式で並べた配列。
+// 成分ごとに連続しているので、カリングでは 4 個 (AVX なら 8 個) ずつまとめて判定できます。
+struct BoundingSphereArray
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+
+	void Resize(uint32_t count);
+	uint32_t GetCount() const { return static_cast<uint32_t>(radius.size()); }
+
+	// bounds を world (転置なし) で変換した境界球を index 番目に書き込みます。
+	// 拡大縮小が軸ごとに違うときは、最も大きい倍率で半径を広げます。
+	void Store(uint32_t index, const MeshBounds& bounds, const DirectX::XMFLOAT4X4& world);
+};
+
+// カリングの結果の集計。
+struct CullingStatistics
+{
+	uint32_t testedCount;
+	uint32_t visibleCount;
+	uint32_t culledCount;
+};
+
+// 境界球と視錐台の判定を SIMD (SSE2 / AVX / NEON) で一括して行うカーネル。
+namespace FrustumCulling
+{
+	// メッシュの全頂点を含む AABB と境界球を求めます。
+	MeshBounds ComputeMeshBounds(const MeshData& mesh);
+
+	// 転置されていないビュー射影行列から視錐台を求めます。
+	// 判定は D3D11 の可視範囲 (-w <= x <= w, -w <= y <= w, 0 <= z <= w) に従います。
+	Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// spheres のうち視錐台と交わる (または内側にある) ものの添字を、小さい順に visibleIndices に書き込みます。
+	// visibleIndices には spheres.GetCount() 個分の領域が必要です。見える球の数を返します。
+	uint32_t CullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t* visibleIndices);
+
+	// 1 つの球を判定します。少数の球を個別に判定するときに使います。
+	bool IsSphereVisible(const Frustum& frustum, float x, float y, float z, float radius);
+
+	// コンパイル時に選択された SIMD の実装名 ("AVX", "SSE2", "NEON", "Scalar")。
+	const char* GetImplementationName();
+}
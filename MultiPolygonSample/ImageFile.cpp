@@ -0,0 +1,234 @@
+﻿#include "ImageFile.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+	// PNG のチャンクの CRC-32 (多項式 0xEDB88320) の表。
+	struct CrcTable
+	{
+		CrcTable()
+		{
+			for (uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k)
+				{
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				values[n] = c;
+			}
+		}
+
+		uint32_t values[256];
+	};
+
+	const CrcTable g_crcTable;
+
+	uint32_t UpdateCrc(uint32_t crc, const uint8_t* data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			crc = g_crcTable.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return crc;
+	}
+
+	void AppendBigEndian(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		bytes.push_back(static_cast<uint8_t>(value >> 24));
+		bytes.push_back(static_cast<uint8_t>(value >> 16));
+		bytes.push_back(static_cast<uint8_t>(value >> 8));
+		bytes.push_back(static_cast<uint8_t>(value));
+	}
+
+	void WriteChunk(std::ostream& stream, const char type[4], const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> chunk;
+		chunk.reserve(data.size() + 12);
+		AppendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		const uint32_t crc = UpdateCrc(0xFFFFFFFFu, &chunk[4], data.size() + 4) ^ 0xFFFFFFFFu;
+		AppendBigEndian(chunk, crc);
+		stream.write(reinterpret_cast<const char*>(&chunk[0]), chunk.size());
+	}
+
+	// 空白と # から行末までのコメントを読みとばし、10 進数を 1 つ読みます。
+	bool ReadHeaderValue(std::istream& stream, uint32_t& value)
+	{
+		int c = stream.get();
+		while (c != EOF && (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#'))
+		{
+			if (c == '#')
+			{
+				while (c != EOF && c != '\n')
+				{
+					c = stream.get();
+				}
+			}
+			c = stream.get();
+		}
+		if (c < '0' || c > '9')
+		{
+			return false;
+		}
+		uint64_t result = 0;
+		while (c >= '0' && c <= '9')
+		{
+			result = result * 10 + static_cast<uint32_t>(c - '0');
+			if (result > 0xFFFFFFFFu)
+			{
+				return false;
+			}
+			c = stream.get();
+		}
+		value = static_cast<uint32_t>(result);
+		// 最後の値のあとの 1 文字の空白がヘッダーの終わりで、その次から画素が始まります。
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	bool HasValidSize(const Image& image)
+	{
+		return image.width > 0 && image.height > 0 && image.pixels.size() == static_cast<size_t>(image.width) * image.height;
+	}
+}
+
+bool ImageFile::WritePpm(std::ostream& stream, const Image& image)
+{
+	if (!HasValidSize(image))
+	{
+		return false;
+	}
+
+	stream << "P6\n" << image.width << " " << image.height << "\n255\n";
+	std::vector<uint8_t> row(image.width * 3);
+	for (uint32_t y = 0; y < image.height; ++y)
+	{
+		const uint32_t* pixels = &image.pixels[static_cast<size_t>(y) * image.width];
+		for (uint32_t x = 0; x < image.width; ++x)
+		{
+			row[x * 3 + 0] = static_cast<uint8_t>(pixels[x] >> 16);
+			row[x * 3 + 1] = static_cast<uint8_t>(pixels[x] >> 8);
+			row[x * 3 + 2] = static_cast<uint8_t>(pixels[x]);
+		}
+		stream.write(reinterpret_cast<const char*>(&row[0]), row.size());
+	}
+	return !stream.fail();
+}
+
+// zlib のストリームには、各行の先頭にフィルターの種類 (0 = なし) を付けた画素を、64 KB 未満の非圧縮ブロックに分けて格納します。
+bool ImageFile::WritePng(std::ostream& stream, const Image& image)
+{
+	if (!HasValidSize(image))
+	{
+		return false;
+	}
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	stream.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<uint8_t> header;
+	AppendBigEndian(header, image.width);
+	AppendBigEndian(header, image.height);
+	header.push_back(8);	// ビット深度
+	header.push_back(2);	// カラー タイプ (RGB)
+	header.push_back(0);	// 圧縮方法
+	header.push_back(0);	// フィルター方法
+	header.push_back(0);	// インターレースなし
+	WriteChunk(stream, "IHDR", header);
+
+	const size_t rowSize = static_cast<size_t>(image.width) * 3 + 1;
+	std::vector<uint8_t> raw(rowSize * image.height);
+	for (uint32_t y = 0; y < image.height; ++y)
+	{
+		uint8_t* row = &raw[rowSize * y];
+		const uint32_t* pixels = &image.pixels[static_cast<size_t>(y) * image.width];
+		row[0] = 0;
+		for (uint32_t x = 0; x < image.width; ++x)
+		{
+			row[1 + x * 3 + 0] = static_cast<uint8_t>(pixels[x] >> 16);
+			row[1 + x * 3 + 1] = static_cast<uint8_t>(pixels[x] >> 8);
+			row[1 + x * 3 + 2] = static_cast<uint8_t>(pixels[x]);
+		}
+	}
+
+	static const size_t MaxStoredBlockSize = 65535;
+	std::vector<uint8_t> compressed;
+	compressed.reserve(raw.size() + (raw.size() / MaxStoredBlockSize + 1) * 5 + 6);
+	compressed.push_back(0x78);	// deflate、32 KB のウィンドウ
+	compressed.push_back(0x01);
+	size_t offset = 0;
+	do
+	{
+		const size_t blockSize = std::min(raw.size() - offset, MaxStoredBlockSize);
+		const bool last = offset + blockSize == raw.size();
+		compressed.push_back(last ? 1 : 0);
+		compressed.push_back(static_cast<uint8_t>(blockSize));
+		compressed.push_back(static_cast<uint8_t>(blockSize >> 8));
+		compressed.push_back(static_cast<uint8_t>(~blockSize));
+		compressed.push_back(static_cast<uint8_t>(~blockSize >> 8));
+		compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+		offset += blockSize;
+	}
+	while (offset < raw.size());
+
+	// Adler-32。5552 バイトごとに剰余を取れば 32 ビットであふれません。
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (size_t i = 0; i < raw.size(); )
+	{
+		const size_t end = std::min(raw.size(), i + 5552);
+		for (; i < end; ++i)
+		{
+			a += raw[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	AppendBigEndian(compressed, (b << 16) | a);
+
+	WriteChunk(stream, "IDAT", compressed);
+	WriteChunk(stream, "IEND", std::vector<uint8_t>());
+	return !stream.fail();
+}
+
+bool ImageFile::ReadPpm(std::istream& stream, Image& image)
+{
+	char magic[2];
+	if (!stream.read(magic, 2) || magic[0] != 'P' || magic[1] != '6')
+	{
+		return false;
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t maxValue = 0;
+	if (!ReadHeaderValue(stream, width) || !ReadHeaderValue(stream, height) || !ReadHeaderValue(stream, maxValue))
+	{
+		return false;
+	}
+	if (width == 0 || height == 0 || maxValue != 255 || static_cast<uint64_t>(width) * height > 0x10000000u)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> row(width * 3);
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(static_cast<size_t>(width) * height);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		if (!stream.read(reinterpret_cast<char*>(&row[0]), row.size()))
+		{
+			return false;
+		}
+		uint32_t* pixels = &image.pixels[static_cast<size_t>(y) * width];
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			pixels[x] = 0xFF000000u | (static_cast<uint32_t>(row[x * 3]) << 16) | (static_cast<uint32_t>(row[x * 3 + 1]) << 8) | row[x * 3 + 2];
+		}
+	}
+	return true;
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// メモリ上の BGRA8 の画像。SoftwareRenderDevice のカラー バッファーや、スワップ チェーンのバック バッファーと同じ並びです。
+struct Image
+{
+	Image() : width(0), height(0) {}
+
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint32_t> pixels;	// 上の行から順に並べた、メモリ上のバイト順が B, G, R, A のピクセル
+};
+
+// 画像ファイルの読み書き。アルファは捨てて RGB の 8 ビットで書き出します。
+// ストリームはバイナリ モードで開いてください。
+namespace ImageFile
+{
+	// バイナリ形式の PPM (P6) を書き出します。
+	bool WritePpm(std::ostream& stream, const Image& image);
+
+	// 8 ビット RGB の PNG を書き出します。圧縮はせず、deflate の非圧縮ブロックに格納します。
+	bool WritePng(std::ostream& stream, const Image& image);
+
+	// 最大値 255 のバイナリ形式の PPM (P6) を読み込みます。アルファは 255 にします。形式が違えば false を返します。
+	bool ReadPpm(std::istream& stream, Image& image);
+}
@@ -0,0 +1,57 @@
+// Constant buffers are split by how often they change.
+cbuffer ProjectionConstantBuffer : register(b0)
+{
+	matrix projection;
+};
+
+cbuffer ViewConstantBuffer : register(b1)
+{
+	matrix view;
+};
+
+struct VertexShaderInput
+{
+	float3 pos : POSITION;
+	float3 color : COLOR0;
+
+	// Per-instance data. The rows of the model matrix are stored untransposed.
+	float4 instanceModel0 : INSTANCE_MODEL0;
+	float4 instanceModel1 : INSTANCE_MODEL1;
+	float4 instanceModel2 : INSTANCE_MODEL2;
+	float4 instanceModel3 : INSTANCE_MODEL3;
+	float4 instanceColor : INSTANCE_COLOR;
+};
+
+struct VertexShaderOutput
+{
+	float4 pos : SV_POSITION;
+	float3 color : COLOR0;
+	float fade : FADE;	// LOD cross-fade value, see DitherFadePixelShader.hlsl
+};
+
+VertexShaderOutput main(VertexShaderInput input)
+{
+	VertexShaderOutput output;
+	float4 pos = float4(input.pos, 1.0f);
+
+	// The per-instance matrix takes the place of the model constant buffer.
+	float4x4 instanceModel = float4x4(
+		input.instanceModel0,
+		input.instanceModel1,
+		input.instanceModel2,
+		input.instanceModel3);
+
+	// Transform the vertex position into projected space.
+	pos = mul(pos, instanceModel);
+	pos = mul(pos, view);
+	pos = mul(pos, projection);
+	output.pos = pos;
+
+	// Tint the vertex color with the instance color.
+	output.color = input.color * input.instanceColor.rgb;
+
+	// The instance alpha carries the LOD cross-fade value.
+	output.fade = input.instanceColor.a;
+
+	return output;
+}
@@ -0,0 +1,241 @@
+﻿#include "JobSystem.h"
+#include <algorithm>
+
+WorkStealingDeque::WorkStealingDeque() :
+	m_top(0),
+	m_bottom(0)
+{
+	for (uint32_t i = 0; i < Capacity; ++i)
+	{
+		m_jobs[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+bool WorkStealingDeque::Push(JobRange* job)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const int64_t top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= static_cast<int64_t>(Capacity))
+	{
+		return false;
+	}
+
+	m_jobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	m_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+JobRange* WorkStealingDeque::Pop()
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// 空でした。
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	JobRange* job = m_jobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// 最後の 1 つは Steal と取り合うので、先頭を進めて確保します。
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			job = nullptr;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+JobRange* WorkStealingDeque::Steal()
+{
+	int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+	{
+		return nullptr;
+	}
+
+	JobRange* job = m_jobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+	return job;
+}
+
+JobSystem::JobSystem(uint32_t workerCount) :
+	m_task(nullptr),
+	m_active(false),
+	m_quit(false)
+{
+	for (uint32_t i = 0; i <= workerCount; ++i)
+	{
+		m_deques.push_back(std::unique_ptr<WorkStealingDeque>(new WorkStealingDeque()));
+	}
+	for (uint32_t i = 1; i <= workerCount; ++i)
+	{
+		m_workers.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t JobSystem::GetDefaultWorkerCount()
+{
+	const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& function)
+{
+	grainSize = std::max(grainSize, 1u);
+	// 別のスレッドの ParallelFor の実行中は try_lock に失敗します。呼び出し元のスレッドからの入れ子の呼び出しは
+	// ロックを取り直せるので、実行中のタスクがあることで見分けます。どちらも直列に処理します。
+	std::unique_lock<std::recursive_mutex> callLock(m_callMutex, std::defer_lock);
+	if (count <= grainSize || m_workers.empty() || !callLock.try_lock() || m_task.load(std::memory_order_acquire) != nullptr)
+	{
+		if (count > 0)
+		{
+			function(0, count);
+		}
+		return;
+	}
+
+	// 範囲を二分していくと、分割で作られるジョブは葉の数の 2 倍未満に収まります。
+	ParallelForTask task;
+	task.function = &function;
+	task.grainSize = grainSize;
+	task.jobs.resize(2 * ((count + grainSize - 1) / grainSize));
+	task.nextJob.store(1, std::memory_order_relaxed);
+	task.remaining.store(count, std::memory_order_relaxed);
+	task.jobs[0].begin = 0;
+	task.jobs[0].end = count;
+	m_task.store(&task, std::memory_order_release);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_active = true;
+	}
+	m_wake.notify_all();
+
+	uint32_t randomState = 0x9E3779B9;
+	Execute(0, &task.jobs[0]);
+	while (task.remaining.load(std::memory_order_acquire) > 0)
+	{
+		if (!RunOneJob(0, randomState))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_active = false;
+	}
+	m_task.store(nullptr, std::memory_order_release);
+}
+
+void JobSystem::WorkerMain(uint32_t threadIndex)
+{
+	uint32_t randomState = 0x9E3779B9 * (threadIndex + 1);
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_active && !m_quit)
+			{
+				m_wake.wait(lock);
+			}
+			if (m_quit)
+			{
+				return;
+			}
+		}
+
+		// ParallelFor が終わるまで、自分のキューとほかのスレッドのキューからジョブを探します。
+		uint32_t idleSpins = 0;
+		while (idleSpins < 64)
+		{
+			if (RunOneJob(threadIndex, randomState))
+			{
+				idleSpins = 0;
+			}
+			else
+			{
+				++idleSpins;
+				std::this_thread::yield();
+			}
+		}
+	}
+}
+
+bool JobSystem::RunOneJob(uint32_t threadIndex, uint32_t& randomState)
+{
+	JobRange* job = m_deques[threadIndex]->Pop();
+	if (job == nullptr)
+	{
+		// 盗む相手は xorshift で選び、同じ相手に集中しないようにします。
+		const uint32_t threadCount = static_cast<uint32_t>(m_deques.size());
+		for (uint32_t attempt = 0; attempt < threadCount && job == nullptr; ++attempt)
+		{
+			randomState ^= randomState << 13;
+			randomState ^= randomState >> 17;
+			randomState ^= randomState << 5;
+			const uint32_t victim = randomState % threadCount;
+			if (victim != threadIndex)
+			{
+				job = m_deques[victim]->Steal();
+			}
+		}
+	}
+
+	if (job == nullptr)
+	{
+		return false;
+	}
+	Execute(threadIndex, job);
+	return true;
+}
+
+// 範囲が grainSize より大きい間は後ろ半分を自分のキューに積み、前半分を処理し続けます。
+void JobSystem::Execute(uint32_t threadIndex, JobRange* job)
+{
+	ParallelForTask* task = m_task.load(std::memory_order_acquire);
+	uint32_t begin = job->begin;
+	uint32_t end = job->end;
+
+	while (end - begin > task->grainSize)
+	{
+		const uint32_t middle = begin + (end - begin) / 2;
+		JobRange* half = &task->jobs[task->nextJob.fetch_add(1, std::memory_order_relaxed)];
+		half->begin = middle;
+		half->end = end;
+		if (!m_deques[threadIndex]->Push(half))
+		{
+			break;
+		}
+		end = middle;
+	}
+
+	(*task->function)(begin, end);
+	task->remaining.fetch_sub(end - begin, std::memory_order_release);
+}
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ParallelFor が分割する範囲 [begin, end)。
+struct JobRange
+{
+	uint32_t begin;
+	uint32_t end;
+};
+
+/**
+ * 1 つのスレッドだけが末尾で Push と Pop を行い、ほかのスレッドが先頭から Steal する両端キュー。
+ * Chase と Lev のアルゴリズムを C++11 のメモリ モデルに合わせた Lê らの版です。
+ * 容量は固定で、満杯のときは Push が false を返します。
+ */
+class WorkStealingDeque
+{
+public:
+	static const uint32_t Capacity = 64;
+
+	WorkStealingDeque();
+
+	bool Push(JobRange* job);
+	JobRange* Pop();
+	JobRange* Steal();
+
+private:
+	std::atomic<int64_t> m_top;
+	std::atomic<int64_t> m_bottom;
+	std::atomic<JobRange*> m_jobs[Capacity];
+};
+
+/**
+ * ワーカー スレッドごとに WorkStealingDeque を持つジョブ スケジューラー。
+ * ParallelFor は範囲を半分ずつに分けて自分のキューに積み、手の空いたスレッドが
+ * ほかのキューの先頭から大きい範囲を盗んでさらに分割します。
+ *
+ * 結果はスレッド数や実行順によらず同じになります。各インデックスは 1 回だけ処理され、
+ * function がインデックスごとに別の出力だけを書き込む限り、直列に処理した場合と一致します。
+ */
+class JobSystem
+{
+public:
+	// workerCount は呼び出し元のスレッドを除いたワーカーの数です。0 なら ParallelFor は直列に処理します。
+	explicit JobSystem(uint32_t workerCount);
+	~JobSystem();
+
+	static uint32_t GetDefaultWorkerCount();
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_deques.size()); }
+
+	// [0, count) を grainSize 以下の範囲に分けて function を並列に呼び出し、すべて終わるまで待ちます。
+	// 呼び出し元のスレッドも処理に加わります。ほかの ParallelFor の実行中に呼び出されたとき (入れ子や別のスレッドから) は、
+	// 呼び出し元のスレッドだけで直列に処理します。
+	void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	struct ParallelForTask
+	{
+		const std::function<void(uint32_t, uint32_t)>* function;
+		uint32_t grainSize;
+		std::vector<JobRange> jobs;
+		std::atomic<uint32_t> nextJob;
+		std::atomic<uint32_t> remaining;
+	};
+
+	void WorkerMain(uint32_t threadIndex);
+	bool RunOneJob(uint32_t threadIndex, uint32_t& randomState);
+	void Execute(uint32_t threadIndex, JobRange* job);
+
+	std::vector<std::unique_ptr<WorkStealingDeque>> m_deques;	// 0 は呼び出し元のスレッド用
+	std::vector<std::thread> m_workers;
+
+	// 実行中の ParallelFor を 1 つに限ります。入れ子の呼び出しは同じスレッドで取り直すので、再帰的なミューテックスにします
+	std::recursive_mutex m_callMutex;
+	std::atomic<ParallelForTask*> m_task;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_active;
+	bool m_quit;
+};
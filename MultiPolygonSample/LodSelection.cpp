@@ -0,0 +1,101 @@
+﻿#include "LodSelection.h"
+#include <algorithm>
+#include <cmath>
+
+LodSettings::LodSettings() :
+	pixelError(1.0f),
+	hysteresis(0.25f),
+	fadeDuration(0.25f),
+	viewportWidth(1.0f),
+	viewportHeight(1.0f)
+{
+}
+
+// 行ベクトルの規約では、ビュー空間の (x, y) の変位は NDC の x に (m[0][0], m[1][0])、y に (m[0][1], m[1][1]) で伝わります。
+// 表示方向の回転が 90 度単位なので、画面の軸ごとの倍率の大きい方を使えば十分です。
+float LodSelection::ComputePixelsPerUnit(const DirectX::XMFLOAT4X4& projection, float viewportWidth, float viewportHeight)
+{
+	const float scaleX = std::sqrt(projection._11 * projection._11 + projection._21 * projection._21) * viewportWidth * 0.5f;
+	const float scaleY = std::sqrt(projection._12 * projection._12 + projection._22 * projection._22) * viewportHeight * 0.5f;
+	return std::max(scaleX, scaleY);
+}
+
+uint32_t LodSelection::SelectLevel(const float* errors, uint32_t levelCount, uint32_t currentLevel, float errorScale, const LodSettings& settings)
+{
+	uint32_t level = 0;
+	while (level + 1 < levelCount && errors[level + 1] * errorScale <= settings.pixelError)
+	{
+		++level;
+	}
+
+	// 細かい段へはすぐに戻し、粗い段へは境目で行き来しないように余裕をもって切り替えます。
+	if (level <= currentLevel)
+	{
+		return level;
+	}
+
+	const float coarsenError = settings.pixelError * (1.0f - settings.hysteresis);
+	uint32_t coarser = currentLevel;
+	while (coarser < level && errors[coarser + 1] * errorScale <= coarsenError)
+	{
+		++coarser;
+	}
+	return coarser;
+}
+
+void LodSelection::Advance(LodState& state, uint32_t level, uint32_t frame, float time, const LodSettings& settings)
+{
+	const bool drawnLastFrame = state.lastFrame != 0 && state.lastFrame + 1 == frame;
+	state.lastFrame = frame;
+
+	// 見えていなかったオブジェクトは、切り替えが見えないのでフェードしません。
+	if (!drawnLastFrame)
+	{
+		state.level = level;
+		state.fading = false;
+		return;
+	}
+
+	if (state.fading && time - state.fadeStart >= settings.fadeDuration)
+	{
+		state.fading = false;
+	}
+
+	// フェード中の切り替えは、今のフェードが終わるまで待ちます。
+	if (level == state.level || state.fading)
+	{
+		return;
+	}
+
+	state.previousLevel = state.level;
+	state.level = level;
+	state.fadeStart = time;
+	state.fading = settings.fadeDuration > 0.0f;
+}
+
+float LodSelection::GetFadeProgress(const LodState& state, float time, const LodSettings& settings)
+{
+	if (!state.fading || settings.fadeDuration <= 0.0f)
+	{
+		return 1.0f;
+	}
+	return std::min(std::max((time - state.fadeStart) / settings.fadeDuration, 0.0f), 1.0f);
+}
+
+float LodSelection::GetDitherThreshold(uint32_t x, uint32_t y)
+{
+	static const uint8_t bayer[16] =
+	{
+		0, 8, 2, 10,
+		12, 4, 14, 6,
+		3, 11, 1, 9,
+		15, 7, 13, 5
+	};
+	return (bayer[(y & 3) * 4 + (x & 3)] + 0.5f) / 16.0f;
+}
+
+bool LodSelection::IsFadeVisible(float fade, uint32_t x, uint32_t y)
+{
+	const float threshold = GetDitherThreshold(x, y);
+	return fade > 0.0f ? threshold < fade : threshold >= 1.0f + fade;
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+// 詳細度 (LOD) の選び方と切り替え方。
+struct LodSettings
+{
+	LodSettings();
+
+	float pixelError;		// 画面上で許す誤差 (ピクセル)。誤差がこれ以下になる最も粗い段を選びます
+	float hysteresis;		// 粗い段へは、誤差が pixelError * (1 - hysteresis) 以下になってから切り替えます
+	float fadeDuration;		// 段を切り替えるときのクロスフェードの時間 (秒)。0 ならすぐに切り替えます
+	float viewportWidth;	// 描画先の大きさ (ピクセル)
+	float viewportHeight;
+};
+
+// オブジェクトごとの詳細度の状態。0 で初期化したものは、まだ描画していないオブジェクトを表します。
+struct LodState
+{
+	uint32_t level;			// 描画する段
+	uint32_t previousLevel;	// フェード中のときの、切り替える前の段
+	float fadeStart;		// フェードを始めた時刻 (秒)
+	uint32_t lastFrame;		// 最後に描画したフレームの番号
+	bool fading;
+};
+
+// 直前のフレームで描画した三角形の数。
+struct LodStatistics
+{
+	uint64_t fullDetailTriangles;	// すべてのオブジェクトを 0 番の段で描画したときの数
+	uint64_t submittedTriangles;	// 実際に描画した数 (フェード中は前後の両方の段を数えます)
+	uint32_t fadingObjects;
+};
+
+/**
+ * 画面上の誤差による詳細度の選択と、段を切り替えるときのディザによるクロスフェード。
+ * フェード中は前後の段を両方描画し、InstanceData::color.w のフェード値で、互いに補い合うピクセルだけを残します。
+ * フェード値 a が正なら、ディザのしきい値が a 未満のピクセルを、0 以下なら 1 + a 以上のピクセルを描画します。
+ * 通常のオブジェクトは a = 1 なので、すべてのピクセルを描画します。
+ */
+namespace LodSelection
+{
+	// ビュー空間で距離 1 の位置にある長さ 1 の線分が、画面上で最大何ピクセルになるか。
+	// projection は転置していない透視射影行列で、表示方向の回転を含んでいてもかまいません。
+	float ComputePixelsPerUnit(const DirectX::XMFLOAT4X4& projection, float viewportWidth, float viewportHeight);
+
+	/**
+	 * errors[0] から errors[levelCount - 1] までの、単調に増える段ごとの誤差のうち、
+	 * errorScale を掛けたピクセル数が settings.pixelError 以下になる最も粗い段を選びます。
+	 * currentLevel より粗い段へは、hysteresis の分だけ余裕ができるまで切り替えません。
+	 */
+	uint32_t SelectLevel(const float* errors, uint32_t levelCount, uint32_t currentLevel, float errorScale, const LodSettings& settings);
+
+	// frame 番目のフレーム (1 から数えます) の段を level にします。
+	// 前のフレームでも描画していて、フェード中でなければ、前の段からフェードを始めます。
+	void Advance(LodState& state, uint32_t level, uint32_t frame, float time, const LodSettings& settings);
+
+	// フェードの進み具合 (0 ～ 1)。新しい段のフェード値はこの値、前の段は (この値 - 1) です。
+	float GetFadeProgress(const LodState& state, float time, const LodSettings& settings);
+
+	// 4x4 の Bayer 行列による、ピクセル (x, y) のディザのしきい値 (0 ～ 1)。
+	float GetDitherThreshold(uint32_t x, uint32_t y);
+
+	// フェード値 fade のオブジェクトで、ピクセル (x, y) を描画するかどうか。DitherFadePixelShader.hlsl と同じ判定です。
+	bool IsFadeVisible(float fade, uint32_t x, uint32_t y);
+}
@@ -0,0 +1,149 @@
+﻿#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+	m_data(nullptr),
+	m_size(0),
+	m_isOpenEmpty(false),
+#if defined(_WIN32)
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr)
+#else
+	m_descriptor(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+bool MappedFile::Open(const PathString& path)
+{
+	Close();
+
+	// ストア アプリでは CreateFile2 と、FromApp の付いたマッピング関数だけが使えます。
+	CREATEFILE2_EXTENDED_PARAMETERS parameters = {0};
+	parameters.dwSize = sizeof(parameters);
+	parameters.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+	parameters.dwFileFlags = FILE_FLAG_SEQUENTIAL_SCAN;
+	m_file = CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, &parameters);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_file, &fileSize) || static_cast<ULONGLONG>(fileSize.QuadPart) > static_cast<ULONGLONG>(SIZE_MAX))
+	{
+		Close();
+		return false;
+	}
+
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+	if (m_size == 0)
+	{
+		m_isOpenEmpty = true;
+		return true;
+	}
+
+	m_mapping = CreateFileMappingFromApp(m_file, nullptr, PAGE_READONLY, 0, nullptr);
+	if (m_mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFileFromApp(m_mapping, FILE_MAP_READ, 0, 0));
+	if (m_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+	if (m_mapping != nullptr)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_size = 0;
+	m_isOpenEmpty = false;
+}
+#else
+bool MappedFile::Open(const PathString& path)
+{
+	Close();
+
+	m_descriptor = open(path.c_str(), O_RDONLY);
+	if (m_descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(m_descriptor, &status) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = static_cast<size_t>(status.st_size);
+	if (m_size == 0)
+	{
+		m_isOpenEmpty = true;
+		return true;
+	}
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_descriptor, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_data = static_cast<const uint8_t*>(data);
+
+	// 先頭から順に読むことを伝え、先読みを促します。
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+	{
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+		m_data = nullptr;
+	}
+	if (m_descriptor >= 0)
+	{
+		close(m_descriptor);
+		m_descriptor = -1;
+	}
+	m_size = 0;
+	m_isOpenEmpty = false;
+}
+#endif
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ファイルのパス。Windows では UTF-16、それ以外ではマルチバイト文字列です。
+#if defined(_WIN32)
+typedef wchar_t PathChar;
+#else
+typedef char PathChar;
+#endif
+typedef std::basic_string<PathChar> PathString;
+
+/**
+ * ファイル全体を読み取り専用でメモリにマップします。
+ * Windows ではファイル マッピング、それ以外では mmap を使うので、読み取りのためのバッファーを確保しません。
+ * GetData のポインターは Close するかオブジェクトを破棄するまで有効です。
+ */
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// path を開いてマップします。失敗したら false を返します。開いていたファイルは先に閉じます。
+	bool Open(const PathString& path);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr || m_isOpenEmpty; }
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const uint8_t* m_data;
+	size_t m_size;
+	bool m_isOpenEmpty;	// 大きさ 0 のファイルはマップできないので、開いたことだけを覚えます
+#if defined(_WIN32)
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_descriptor;
+#endif
+};
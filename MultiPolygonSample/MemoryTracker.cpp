@@ -0,0 +1,88 @@
+﻿#include "MemoryTracker.h"
+#include <atomic>
+
+namespace
+{
+	struct CategoryCounters
+	{
+		std::atomic<uint64_t> allocationCount;
+		std::atomic<uint64_t> heapAllocationCount;
+		std::atomic<uint64_t> bytesInUse;
+		std::atomic<uint64_t> peakBytesInUse;
+		std::atomic<uint64_t> bytesReserved;
+	};
+
+	// 静的記憶域の atomic は 0 で初期化されます。
+	CategoryCounters g_counters[static_cast<uint32_t>(MemoryCategory::CategoryCount)];
+
+	CategoryCounters& GetCounters(MemoryCategory category)
+	{
+		return g_counters[static_cast<uint32_t>(category)];
+	}
+}
+
+void MemoryTracker::RecordAllocation(MemoryCategory category, size_t bytes, uint32_t count)
+{
+	CategoryCounters& counters = GetCounters(category);
+	counters.allocationCount.fetch_add(count, std::memory_order_relaxed);
+	const uint64_t inUse = counters.bytesInUse.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+	uint64_t peak = counters.peakBytesInUse.load(std::memory_order_relaxed);
+	while (inUse > peak && !counters.peakBytesInUse.compare_exchange_weak(peak, inUse, std::memory_order_relaxed))
+	{
+	}
+}
+
+void MemoryTracker::RecordFree(MemoryCategory category, size_t bytes)
+{
+	GetCounters(category).bytesInUse.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemoryTracker::RecordHeapAllocation(MemoryCategory category, size_t bytes)
+{
+	CategoryCounters& counters = GetCounters(category);
+	counters.heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	counters.bytesReserved.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryTracker::RecordHeapFree(MemoryCategory category, size_t bytes)
+{
+	GetCounters(category).bytesReserved.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryCategoryStatistics MemoryTracker::GetStatistics(MemoryCategory category)
+{
+	const CategoryCounters& counters = GetCounters(category);
+	MemoryCategoryStatistics statistics;
+	statistics.allocationCount = counters.allocationCount.load(std::memory_order_relaxed);
+	statistics.heapAllocationCount = counters.heapAllocationCount.load(std::memory_order_relaxed);
+	statistics.bytesInUse = counters.bytesInUse.load(std::memory_order_relaxed);
+	statistics.peakBytesInUse = counters.peakBytesInUse.load(std::memory_order_relaxed);
+	statistics.bytesReserved = counters.bytesReserved.load(std::memory_order_relaxed);
+	return statistics;
+}
+
+void MemoryTracker::ResetCounters()
+{
+	for (CategoryCounters& counters : g_counters)
+	{
+		counters.allocationCount.store(0, std::memory_order_relaxed);
+		counters.heapAllocationCount.store(0, std::memory_order_relaxed);
+		counters.peakBytesInUse.store(counters.bytesInUse.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+}
+
+const char* MemoryTracker::GetCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::FrameArena:
+		return "FrameArena";
+	case MemoryCategory::DrawItems:
+		return "DrawItems";
+	case MemoryCategory::MeshRecords:
+		return "MeshRecords";
+	default:
+		return "Unknown";
+	}
+}
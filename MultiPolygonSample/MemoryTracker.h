@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// メモリの用途。FrameArena と ObjectPool は、作るときに指定した用途で集計します。
+enum class MemoryCategory : uint32_t
+{
+	FrameArena,		// フレームごとに捨てる作業領域
+	DrawItems,		// 描画キューの要素
+	MeshRecords,	// 読み込んだメッシュの受け渡し
+	CategoryCount
+};
+
+// 用途ごとのメモリの集計。
+// allocationCount はアロケーターが応じた確保の回数、heapAllocationCount はそのためにヒープから確保した回数です。
+// 定常状態ではアロケーターがメモリを再利用するので、heapAllocationCount は増えなくなります。
+struct MemoryCategoryStatistics
+{
+	uint64_t allocationCount;
+	uint64_t heapAllocationCount;
+	uint64_t bytesInUse;		// アロケーターが貸し出している量
+	uint64_t peakBytesInUse;
+	uint64_t bytesReserved;		// アロケーターがヒープから確保して保持している量
+};
+
+/**
+ * アロケーターの確保と解放を用途ごとに数える集計。
+ * どのスレッドから呼び出してもかまいません。カウンターは atomic で、ロックは取りません。
+ */
+namespace MemoryTracker
+{
+	// count 回の確保 (合計 bytes バイト) を記録します。確保の多いアロケーターは、まとめて記録してかまいません。
+	void RecordAllocation(MemoryCategory category, size_t bytes, uint32_t count);
+	void RecordFree(MemoryCategory category, size_t bytes);
+	void RecordHeapAllocation(MemoryCategory category, size_t bytes);
+	void RecordHeapFree(MemoryCategory category, size_t bytes);
+
+	MemoryCategoryStatistics GetStatistics(MemoryCategory category);
+
+	// 累計の回数を 0 にし、最大値を現在の使用量に戻します。使用中の量と保持している量はそのままです。
+	void ResetCounters();
+
+	const char* GetCategoryName(MemoryCategory category);
+}
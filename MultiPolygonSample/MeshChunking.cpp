@@ -0,0 +1,105 @@
+﻿#include "MeshChunking.h"
+
+IndexFormat MeshChunking::SelectIndexFormat(uint32_t vertexCount)
+{
+	return vertexCount <= MaxIndex16VertexCount ? IndexFormat::Uint16 : IndexFormat::Uint32;
+}
+
+void MeshChunking::BuildLayout(
+	const MeshData& mesh,
+	bool allow32BitIndices,
+	uint32_t maxTrianglesPerChunk,
+	IndexedMeshLayout& layout
+	)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	const uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+	const uint32_t triangleCount = indexCount / 3;
+	if (maxTrianglesPerChunk == 0)
+	{
+		maxTrianglesPerChunk = UINT32_MAX;
+	}
+
+	layout.vertices.clear();
+	layout.indices16.clear();
+	layout.indices32.clear();
+	layout.chunks.clear();
+	layout.indexFormat = SelectIndexFormat(vertexCount);
+
+	// 16 ビットに収まるか 32 ビットを使える場合は、そのまま 1 つの範囲で描画します。
+	// 空のメッシュも 1 つの空の範囲として扱います。
+	bool singleRange = vertexCount == 0;
+	if (layout.indexFormat == IndexFormat::Uint32 && allow32BitIndices)
+	{
+		layout.vertices = mesh.vertices;
+		layout.indices32 = mesh.indices;
+		singleRange = true;
+	}
+	else if (layout.indexFormat == IndexFormat::Uint16 && triangleCount <= maxTrianglesPerChunk)
+	{
+		layout.vertices = mesh.vertices;
+		layout.indices16.assign(mesh.indices.begin(), mesh.indices.end());
+		singleRange = true;
+	}
+
+	if (singleRange)
+	{
+		MeshChunk chunk = { 0, static_cast<uint32_t>(layout.indices16.size() + layout.indices32.size()), 0 };
+		layout.chunks.push_back(chunk);
+		return;
+	}
+
+	// 三角形を順に詰め、頂点数か三角形数が上限を超える前に次のチャンクを始めます。
+	// 頂点はチャンクごとに番号を振り直し、チャンクの間で共有される頂点は複製します。
+	layout.indexFormat = IndexFormat::Uint16;
+	layout.indices16.reserve(indexCount);
+
+	const uint32_t NotMapped = UINT32_MAX;
+	std::vector<uint32_t> remap(vertexCount, NotMapped);
+	std::vector<uint32_t> chunkVertices;
+	MeshChunk chunk = { 0, 0, 0 };
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* triangle = &mesh.indices[t * 3];
+		uint32_t newVertices = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (remap[triangle[k]] == NotMapped)
+			{
+				++newVertices;
+			}
+		}
+
+		if (chunkVertices.size() + newVertices > MaxIndex16VertexCount || chunk.indexCount / 3 >= maxTrianglesPerChunk)
+		{
+			layout.chunks.push_back(chunk);
+			for (uint32_t vertex : chunkVertices)
+			{
+				remap[vertex] = NotMapped;
+			}
+			chunkVertices.clear();
+
+			chunk.startIndex += chunk.indexCount;
+			chunk.indexCount = 0;
+			chunk.baseVertex = static_cast<uint32_t>(layout.vertices.size());
+		}
+
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t vertex = triangle[k];
+			if (remap[vertex] == NotMapped)
+			{
+				remap[vertex] = static_cast<uint32_t>(chunkVertices.size());
+				chunkVertices.push_back(vertex);
+				layout.vertices.push_back(mesh.vertices[vertex]);
+			}
+			layout.indices16.push_back(static_cast<uint16_t>(remap[vertex]));
+		}
+		chunk.indexCount += 3;
+	}
+
+	if (chunk.indexCount > 0)
+	{
+		layout.chunks.push_back(chunk);
+	}
+}
@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+
+// インデックス バッファーの形式。
+enum class IndexFormat : uint32_t
+{
+	Uint16,
+	Uint32
+};
+
+// 1 回の DrawIndexed で描画する範囲。
+struct MeshChunk
+{
+	uint32_t startIndex;
+	uint32_t indexCount;
+	uint32_t baseVertex;
+};
+
+// デバイスのバッファーに格納する形に並べ替えたメッシュ。
+// インデックスは indexFormat に応じて indices16 か indices32 のどちらかに入ります。
+struct IndexedMeshLayout
+{
+	IndexFormat indexFormat;
+	std::vector<VertexPositionColor> vertices;	// チャンクに分けた場合は、チャンクの境界の頂点を複製して含みます
+	std::vector<uint16_t> indices16;
+	std::vector<uint32_t> indices32;
+	std::vector<MeshChunk> chunks;
+};
+
+// メッシュのインデックスの幅を頂点数から選び、必要なら 16 ビットのチャンクに分割します。
+namespace MeshChunking
+{
+	// 機能レベル 9_1 の最大の頂点インデックスは 65534 なので、16 ビットの範囲をそれに合わせます。
+	static const uint32_t MaxIndex16VertexCount = 65535;
+
+	// 機能レベル 9_1 で 1 回の描画に使える三角形の最大数。
+	static const uint32_t MaxTrianglesPerDraw9_1 = 65535;
+
+	IndexFormat SelectIndexFormat(uint32_t vertexCount);
+
+	// allow32BitIndices が false のときは、16 ビットに収まらないメッシュを
+	// 頂点数 MaxIndex16VertexCount 以下、三角形数 maxTrianglesPerChunk 以下のチャンクに分割します。
+	// maxTrianglesPerChunk に 0 を指定すると三角形数は制限しません。
+	void BuildLayout(
+		const MeshData& mesh,
+		bool allow32BitIndices,
+		uint32_t maxTrianglesPerChunk,
+		IndexedMeshLayout& layout
+		);
+}
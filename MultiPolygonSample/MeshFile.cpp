@@ -0,0 +1,170 @@
+﻿#include "MeshFile.h"
+#include <cstring>
+
+using namespace DirectX;
+
+// ブロックの先頭をそろえる境界。
+static const uint32_t BlockAlignment = 16;
+
+static inline uint32_t AlignOffset(uint32_t offset)
+{
+	return (offset + BlockAlignment - 1) & ~(BlockAlignment - 1);
+}
+
+// [offset, offset + count * stride) がファイルに収まるかを、桁あふれしないように 64 ビットで調べます。
+static inline bool IsBlockInside(uint32_t offset, uint32_t count, uint32_t stride, size_t size)
+{
+	return offset % 4 == 0 && static_cast<uint64_t>(offset) + static_cast<uint64_t>(count) * stride <= static_cast<uint64_t>(size);
+}
+
+void MeshFile::Write(const MeshData& mesh, const MeshBounds& bounds, const std::vector<MeshFileLod>& lods, std::vector<uint8_t>& output)
+{
+	std::vector<MeshFileLod> lodTable(lods);
+	if (lodTable.empty())
+	{
+		MeshFileLod lod;
+		lod.firstIndex = 0;
+		lod.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		lod.maxError = 0.0f;
+		lod.reserved = 0;
+		lodTable.push_back(lod);
+	}
+
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = MeshFileMagic;
+	header.version = MeshFileVersion;
+	header.headerSize = sizeof(MeshFileHeader);
+	header.vertexFormat = static_cast<uint32_t>(mesh.format);
+	header.vertexStride = sizeof(VertexPositionColor);
+	header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	header.lodCount = static_cast<uint32_t>(lodTable.size());
+	header.vertexOffset = AlignOffset(sizeof(MeshFileHeader));
+	header.indexOffset = AlignOffset(header.vertexOffset + header.vertexCount * header.vertexStride);
+	header.lodOffset = AlignOffset(header.indexOffset + header.indexCount * sizeof(uint32_t));
+	header.boundsCenter[0] = bounds.center.x;
+	header.boundsCenter[1] = bounds.center.y;
+	header.boundsCenter[2] = bounds.center.z;
+	header.boundsExtents[0] = bounds.extents.x;
+	header.boundsExtents[1] = bounds.extents.y;
+	header.boundsExtents[2] = bounds.extents.z;
+	header.boundsRadius = bounds.radius;
+	header.fileSize = header.lodOffset + header.lodCount * sizeof(MeshFileLod);
+
+	// 境界をそろえるための隙間は 0 で埋めます。
+	output.assign(header.fileSize, 0);
+	memcpy(&output[0], &header, sizeof(header));
+	if (!mesh.vertices.empty())
+	{
+		memcpy(&output[header.vertexOffset], &mesh.vertices[0], header.vertexCount * header.vertexStride);
+	}
+	if (!mesh.indices.empty())
+	{
+		memcpy(&output[header.indexOffset], &mesh.indices[0], header.indexCount * sizeof(uint32_t));
+	}
+	memcpy(&output[header.lodOffset], &lodTable[0], header.lodCount * sizeof(MeshFileLod));
+}
+
+MeshFileStatus MeshFile::Parse(const uint8_t* data, size_t size, MeshFileView& view)
+{
+	if (size < sizeof(MeshFileHeader))
+	{
+		return MeshFileStatus::InvalidHeader;
+	}
+
+	const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(data);
+	if (header->magic != MeshFileMagic || header->headerSize != sizeof(MeshFileHeader))
+	{
+		return MeshFileStatus::InvalidHeader;
+	}
+	if (header->version != MeshFileVersion)
+	{
+		return MeshFileStatus::UnsupportedVersion;
+	}
+	if (header->vertexStride != sizeof(VertexPositionColor) || header->vertexFormat > static_cast<uint32_t>(VertexFormat::Compact))
+	{
+		return MeshFileStatus::InvalidHeader;
+	}
+	if (header->fileSize > size
+		|| !IsBlockInside(header->vertexOffset, header->vertexCount, header->vertexStride, size)
+		|| !IsBlockInside(header->indexOffset, header->indexCount, sizeof(uint32_t), size)
+		|| !IsBlockInside(header->lodOffset, header->lodCount, sizeof(MeshFileLod), size))
+	{
+		return MeshFileStatus::Truncated;
+	}
+
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>(data + header->indexOffset);
+	if (header->indexCount % 3 != 0)
+	{
+		return MeshFileStatus::InvalidIndices;
+	}
+
+	// 範囲外のインデックスは GPU では未定義の読み取りになるので、1 つずつ確かめます。
+	uint32_t maxIndex = 0;
+	for (uint32_t i = 0; i < header->indexCount; ++i)
+	{
+		maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+	}
+	if (header->indexCount > 0 && maxIndex >= header->vertexCount)
+	{
+		return MeshFileStatus::InvalidIndices;
+	}
+
+	const MeshFileLod* lods = reinterpret_cast<const MeshFileLod*>(data + header->lodOffset);
+	if (header->lodCount == 0)
+	{
+		return MeshFileStatus::InvalidLods;
+	}
+	for (uint32_t i = 0; i < header->lodCount; ++i)
+	{
+		if (lods[i].indexCount % 3 != 0
+			|| static_cast<uint64_t>(lods[i].firstIndex) + lods[i].indexCount > header->indexCount)
+		{
+			return MeshFileStatus::InvalidLods;
+		}
+	}
+
+	view.header = header;
+	view.vertices = reinterpret_cast<const VertexPositionColor*>(data + header->vertexOffset);
+	view.indices = indices;
+	view.lods = lods;
+	return MeshFileStatus::Ok;
+}
+
+void MeshFile::Decode(const MeshFileView& view, MeshData& mesh, MeshBounds& bounds, std::vector<MeshFileLod>& lods)
+{
+	const MeshFileHeader& header = *view.header;
+	mesh.vertices.assign(view.vertices, view.vertices + header.vertexCount);
+	mesh.indices.assign(view.indices, view.indices + header.indexCount);
+	mesh.format = static_cast<VertexFormat>(header.vertexFormat);
+
+	bounds.center = XMFLOAT3(header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2]);
+	bounds.extents = XMFLOAT3(header.boundsExtents[0], header.boundsExtents[1], header.boundsExtents[2]);
+	bounds.radius = header.boundsRadius;
+
+	lods.assign(view.lods, view.lods + header.lodCount);
+}
+
+const char* MeshFile::GetStatusName(MeshFileStatus status)
+{
+	switch (status)
+	{
+	case MeshFileStatus::Ok:
+		return "Ok";
+	case MeshFileStatus::OpenFailed:
+		return "OpenFailed";
+	case MeshFileStatus::InvalidHeader:
+		return "InvalidHeader";
+	case MeshFileStatus::UnsupportedVersion:
+		return "UnsupportedVersion";
+	case MeshFileStatus::Truncated:
+		return "Truncated";
+	case MeshFileStatus::InvalidIndices:
+		return "InvalidIndices";
+	case MeshFileStatus::InvalidLods:
+		return "InvalidLods";
+	default:
+		return "Unknown";
+	}
+}
@@ -0,0 +1,86 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+#include "FrustumCulling.h"
+
+// メッシュ ファイルの先頭の識別子 ("PMSH")。
+const uint32_t MeshFileMagic = 0x48534D50;
+
+// 現在の形式のバージョン。形式を変えたら増やし、Parse は同じバージョンだけを受け付けます。
+const uint16_t MeshFileVersion = 1;
+
+// 詳細度 (LOD) の 1 段分。インデックスの [firstIndex, firstIndex + indexCount) を描画します。
+// 0 番が最も詳細で、maxError は 0 番からの形状の誤差の上限 (ローカル空間の距離) です。
+struct MeshFileLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float maxError;
+	uint32_t reserved;
+};
+
+/**
+ * メッシュ ファイルのヘッダー。ファイルはリトル エンディアンで、次の順に並びます。
+ *   ヘッダー、頂点 (VertexPositionColor × vertexCount)、インデックス (uint32 × indexCount)、LOD 表 (MeshFileLod × lodCount)
+ * 各ブロックは 16 バイト境界から始まるので、マップしたメモリをそのまま配列として読み取れます。
+ */
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerSize;	// sizeof(MeshFileHeader)
+	uint32_t vertexFormat;	// デバイス上の頂点の形式 (VertexFormat)
+	uint32_t vertexStride;	// sizeof(VertexPositionColor)
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	uint32_t vertexOffset;	// ファイルの先頭からのバイト位置
+	uint32_t indexOffset;
+	uint32_t lodOffset;
+	float boundsCenter[3];
+	float boundsExtents[3];
+	float boundsRadius;
+	uint32_t fileSize;
+};
+
+static_assert(sizeof(MeshFileHeader) == 72, "MeshFileHeader のレイアウトはファイル形式の一部です。");
+
+// メッシュ ファイルを読み取った結果。
+enum class MeshFileStatus : uint32_t
+{
+	Ok,
+	OpenFailed,			// ファイルを開けませんでした
+	InvalidHeader,		// 識別子やヘッダーの大きさが違います
+	UnsupportedVersion,
+	Truncated,			// ヘッダーの示すブロックがファイルに収まりません
+	InvalidIndices,		// インデックスが頂点の数を超えているか、三角形の数が整数になりません
+	InvalidLods			// LOD がないか、インデックスの範囲を超えています
+};
+
+// マップしたファイルの中を直接指すメッシュの内容。ファイルを閉じるまで有効です。
+struct MeshFileView
+{
+	const MeshFileHeader* header;
+	const VertexPositionColor* vertices;
+	const uint32_t* indices;
+	const MeshFileLod* lods;
+};
+
+// バイナリのメッシュ ファイルの書き出しと検証。
+namespace MeshFile
+{
+	// mesh を書き出します。lods が空なら、メッシュ全体を 1 段の LOD とします。
+	void Write(const MeshData& mesh, const MeshBounds& bounds, const std::vector<MeshFileLod>& lods, std::vector<uint8_t>& output);
+
+	// data の内容を検証し、問題がなければ view に各ブロックの位置を設定します。
+	// data は 4 バイト境界になければなりません (マップしたメモリはページ境界にあります)。
+	MeshFileStatus Parse(const uint8_t* data, size_t size, MeshFileView& view);
+
+	// 検証済みの view を MeshData にコピーします。ファイルからメッシュへのコピーはこの 1 回だけです。
+	void Decode(const MeshFileView& view, MeshData& mesh, MeshBounds& bounds, std::vector<MeshFileLod>& lods);
+
+	const char* GetStatusName(MeshFileStatus status);
+}
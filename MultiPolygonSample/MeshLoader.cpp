@@ -0,0 +1,140 @@
+﻿#include "MeshLoader.h"
+#include <algorithm>
+#include "MeshSimplifier.h"
+
+// VS2012 は暗黙のムーブ コンストラクターを生成しないので、配列を入れ替えて移します。
+static void MoveResult(MeshLoadResult& source, MeshLoadResult& destination)
+{
+	destination.requestId = source.requestId;
+	destination.status = source.status;
+	destination.mesh.vertices.swap(source.mesh.vertices);
+	destination.mesh.indices.swap(source.mesh.indices);
+	destination.mesh.format = source.mesh.format;
+	destination.bounds = source.bounds;
+	destination.lods.swap(source.lods);
+}
+
+// 結果のレコードは、スレッドの数とフレームあたりの受け取りの数を合わせても 1 つのチャンクに収まる数ずつ確保します。
+static const uint32_t ResultsPerChunk = 64;
+
+MeshLoader::MeshLoader(uint32_t threadCount) :
+	m_resultPool(ResultsPerChunk, MemoryCategory::MeshRecords),
+	m_nextRequestId(0),
+	m_pendingCount(0),
+	m_quit(false)
+{
+	threadCount = std::max(threadCount, 1u);
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		m_workers.push_back(std::thread(&MeshLoader::WorkerMain, this));
+	}
+}
+
+MeshLoader::~MeshLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+		m_requests.clear();
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	for (MeshLoadResult* result : m_completed)
+	{
+		m_resultPool.Destroy(result);
+	}
+}
+
+uint32_t MeshLoader::Enqueue(const PathString& path)
+{
+	Request request;
+	request.path = path;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		request.id = m_nextRequestId++;
+		m_requests.push_back(request);
+	}
+	m_pendingCount.fetch_add(1, std::memory_order_acq_rel);
+	m_wake.notify_one();
+	return request.id;
+}
+
+uint32_t MeshLoader::TakeCompleted(std::vector<MeshLoadResult>& results, uint32_t maxCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32_t taken = 0;
+	while (taken < maxCount && !m_completed.empty())
+	{
+		results.push_back(MeshLoadResult());
+		MoveResult(*m_completed.front(), results.back());
+		m_resultPool.Destroy(m_completed.front());
+		m_completed.pop_front();
+		++taken;
+	}
+	m_pendingCount.fetch_sub(taken, std::memory_order_acq_rel);
+	return taken;
+}
+
+void MeshLoader::LoadFile(const PathString& path, MeshLoadResult& result)
+{
+	// 失敗したときも、空のメッシュの値にしておきます。
+	result.mesh = MeshData();
+	result.bounds = FrustumCulling::ComputeMeshBounds(result.mesh);
+	result.lods.clear();
+
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		result.status = MeshFileStatus::OpenFailed;
+		return;
+	}
+
+	MeshFileView view;
+	result.status = MeshFile::Parse(file.GetData(), file.GetSize(), view);
+	if (result.status == MeshFileStatus::Ok)
+	{
+		MeshFile::Decode(view, result.mesh, result.bounds, result.lods);
+
+		// LOD 表が全体の 1 段だけのファイルは、読み込むスレッドで簡略化した段を作ります。
+		if (result.lods.size() == 1 && result.lods[0].firstIndex == 0 && result.lods[0].indexCount == result.mesh.indices.size())
+		{
+			MeshSimplifier::BuildLods(result.mesh, LodBuildSettings(), result.lods);
+		}
+	}
+}
+
+void MeshLoader::WorkerMain()
+{
+	for (;;)
+	{
+		Request request;
+		MeshLoadResult* result;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_quit && m_requests.empty())
+			{
+				m_wake.wait(lock);
+			}
+			if (m_quit)
+			{
+				return;
+			}
+			request = m_requests.front();
+			m_requests.pop_front();
+			result = m_resultPool.Create();
+		}
+
+		// ファイルの読み取りと検証はロックの外で行い、ほかのワーカーと並行させます。
+		// レコードはプールから借りたものなので、完了したキューにはポインターを移すだけで済みます。
+		result->requestId = request.id;
+		LoadFile(request.path, *result);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_completed.push_back(result);
+	}
+}
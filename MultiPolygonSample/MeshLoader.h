@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "ObjectPool.h"
+
+// 読み込みの終わったメッシュ。status が Ok のときだけ mesh, bounds, lods が有効です。
+// lods はファイルの LOD 表で、ファイルに 1 段しかなければ読み込むときに作った段を含みます。
+struct MeshLoadResult
+{
+	uint32_t requestId;
+	MeshFileStatus status;
+	MeshData mesh;
+	MeshBounds bounds;
+	std::vector<MeshFileLod> lods;
+};
+
+/**
+ * メッシュ ファイルをワーカー スレッドで読み込むキュー。
+ * 各スレッドがファイルをマップして検証し、MeshData に展開するところまでを並列に行います。
+ * デバイスへのアップロードは描画するスレッドが TakeCompleted で受け取ってから行うので、
+ * 1 フレームにアップロードする数を抑えれば、大量のメッシュを読み込んでも最初のフレームを待たせません。
+ */
+class MeshLoader
+{
+public:
+	// threadCount 個のワーカー スレッドを起動します。0 なら 1 個にします。
+	explicit MeshLoader(uint32_t threadCount);
+
+	// 読み込み中と未着手の要求は破棄します。
+	~MeshLoader();
+
+	// path の読み込みを要求し、結果の requestId になる番号を返します。番号は 0 から順に振られます。
+	uint32_t Enqueue(const PathString& path);
+
+	// 読み込みが終わった結果を、終わった順に最大 maxCount 個 results の末尾に移し、移した数を返します。
+	uint32_t TakeCompleted(std::vector<MeshLoadResult>& results, uint32_t maxCount);
+
+	// 要求したもののうち、まだ TakeCompleted で受け取っていない数。
+	uint32_t GetPendingCount() const { return m_pendingCount.load(std::memory_order_acquire); }
+
+	// 1 つのファイルをこのスレッドで読み込みます。ワーカー スレッドもこの関数を使います。
+	static void LoadFile(const PathString& path, MeshLoadResult& result);
+
+private:
+	MeshLoader(const MeshLoader&);
+	MeshLoader& operator=(const MeshLoader&);
+
+	struct Request
+	{
+		uint32_t id;
+		PathString path;
+	};
+
+	void WorkerMain();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<Request> m_requests;
+	ObjectPool<MeshLoadResult> m_resultPool;	// ワーカーが結果を書き込むレコード。m_mutex で保護します
+	std::deque<MeshLoadResult*> m_completed;
+	uint32_t m_nextRequestId;
+	std::atomic<uint32_t> m_pendingCount;
+	bool m_quit;
+};
@@ -0,0 +1,362 @@
+﻿#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(
+	const uint32_t* indices,
+	uint32_t indexCount,
+	uint32_t vertexCount,
+	uint32_t cacheSize
+	)
+{
+	// 頂点ごとに、キャッシュに入ったときのミスの通し番号を記録します。
+	// 通し番号の差がキャッシュの大きさ以下なら、その頂点はまだキャッシュに残っています。
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t misses = 0;
+	uint32_t referencedCount = 0;
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		const uint32_t vertex = indices[i];
+		if (cacheTimestamps[vertex] == 0 || misses - cacheTimestamps[vertex] >= cacheSize)
+		{
+			++misses;
+			cacheTimestamps[vertex] = misses;
+		}
+		if (!referenced[vertex])
+		{
+			referenced[vertex] = true;
+			++referencedCount;
+		}
+	}
+
+	VertexCacheStatistics statistics;
+	statistics.acmr = indexCount > 0 ? static_cast<float>(misses) / (indexCount / 3) : 0.0f;
+	statistics.atvr = referencedCount > 0 ? static_cast<float>(misses) / referencedCount : 0.0f;
+	return statistics;
+}
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation" のスコア関数。
+namespace
+{
+	const int ScoringCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriangleScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float ComputeVertexScore(int cachePosition, uint32_t remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// 直前の三角形の頂点は、同じ三角形を続けて選びにくくするために固定の値にします。
+				score = LastTriangleScore;
+			}
+			else
+			{
+				const float scale = 1.0f / (ScoringCacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3) * scale, CacheDecayPower);
+			}
+		}
+
+		// 残りの三角形が少ない頂点を先に使い切るようにします。
+		score += ValenceBoostScale * powf(static_cast<float>(remainingTriangles), -ValenceBoostPower);
+		return score;
+	}
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// 頂点ごとの隣接する三角形のリスト。
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+	{
+		++adjacencyOffsets[indices[i] + 1];
+	}
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			adjacency[fill[indices[t * 3 + k]]++] = t;
+		}
+	}
+
+	// remainingTriangles はまだ出力していない隣接する三角形の数で、
+	// adjacency の先頭のその数の要素が未出力の三角形になるように保ちます。
+	std::vector<uint32_t> remainingTriangles(vertexCount);
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		remainingTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+		vertexScores[v] = ComputeVertexScore(-1, remainingTriangles[v]);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	uint32_t cache[ScoringCacheSize + 3];
+	uint32_t cacheCount = 0;
+	uint32_t scanCursor = 0;
+	uint32_t bestTriangle = UINT32_MAX;
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		// キャッシュの周りに候補がなければ、未出力の三角形を先頭から探します。
+		if (bestTriangle == UINT32_MAX)
+		{
+			while (emitted[scanCursor])
+			{
+				++scanCursor;
+			}
+			bestTriangle = scanCursor;
+		}
+
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		emitted[bestTriangle] = true;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		// 出力した三角形を各頂点の未出力のリストから外します。
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t vertex = triangle[k];
+			uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+			uint32_t* end = begin + remainingTriangles[vertex];
+			*std::find(begin, end, bestTriangle) = *(end - 1);
+			--remainingTriangles[vertex];
+		}
+
+		// 三角形の頂点をキャッシュの先頭に移し、押し出された頂点の位置を消します。
+		uint32_t newCache[ScoringCacheSize + 3];
+		uint32_t newCacheCount = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			newCache[newCacheCount++] = triangle[k];
+		}
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			const uint32_t vertex = cache[i];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+			{
+				newCache[newCacheCount++] = vertex;
+			}
+		}
+		for (uint32_t i = ScoringCacheSize; i < newCacheCount; ++i)
+		{
+			cachePositions[newCache[i]] = -1;
+			vertexScores[newCache[i]] = ComputeVertexScore(-1, remainingTriangles[newCache[i]]);
+		}
+		cacheCount = std::min(newCacheCount, static_cast<uint32_t>(ScoringCacheSize));
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// スコアが変わるのはキャッシュ内の頂点とその三角形だけなので、その中から次の三角形を選びます。
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			cachePositions[cache[i]] = static_cast<int>(i);
+			vertexScores[cache[i]] = ComputeVertexScore(static_cast<int>(i), remainingTriangles[cache[i]]);
+		}
+
+		bestTriangle = UINT32_MAX;
+		float bestScore = -1.0f;
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			const uint32_t vertex = cache[i];
+			const uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t j = 0; j < remainingTriangles[vertex]; ++j)
+			{
+				const uint32_t t = begin[j];
+				const uint32_t* candidate = &indices[t * 3];
+				const float score = vertexScores[candidate[0]] + vertexScores[candidate[1]] + vertexScores[candidate[2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+uint32_t MeshOptimizer::OptimizeOverdraw(
+	uint32_t* indices,
+	uint32_t indexCount,
+	const VertexPositionColor* vertices,
+	uint32_t vertexCount,
+	uint32_t cacheSize
+	)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return 0;
+	}
+
+	// 3 つの頂点がすべてキャッシュにない三角形で、新しいクラスターを始めます。
+	std::vector<uint32_t> clusterStarts;
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	uint32_t misses = 0;
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		uint32_t triangleMisses = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t vertex = indices[t * 3 + k];
+			if (cacheTimestamps[vertex] == 0 || misses - cacheTimestamps[vertex] >= cacheSize)
+			{
+				++misses;
+				++triangleMisses;
+				cacheTimestamps[vertex] = misses;
+			}
+		}
+		if (t == 0 || triangleMisses == 3)
+		{
+			clusterStarts.push_back(t);
+		}
+	}
+	const uint32_t clusterCount = static_cast<uint32_t>(clusterStarts.size());
+	clusterStarts.push_back(triangleCount);
+
+	// メッシュの中心から見てクラスターの面がどれだけ外を向いているかで並べ替えます。
+	// 外側の面ほど手前にあることが多いので、先に描画すると隠れた面が深度テストで早く棄却されます。
+	XMFLOAT3 meshCenter(0.0f, 0.0f, 0.0f);
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		const XMFLOAT3& position = vertices[indices[i]].pos;
+		meshCenter.x += position.x;
+		meshCenter.y += position.y;
+		meshCenter.z += position.z;
+	}
+	meshCenter.x /= indexCount;
+	meshCenter.y /= indexCount;
+	meshCenter.z /= indexCount;
+
+	std::vector<std::pair<float, uint32_t>> sortKeys(clusterCount);
+	for (uint32_t c = 0; c < clusterCount; ++c)
+	{
+		// 面積で重み付けした法線と重心。
+		XMFLOAT3 center(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 normal(0.0f, 0.0f, 0.0f);
+		float totalArea = 0.0f;
+		for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+		{
+			const XMFLOAT3& p0 = vertices[indices[t * 3 + 0]].pos;
+			const XMFLOAT3& p1 = vertices[indices[t * 3 + 1]].pos;
+			const XMFLOAT3& p2 = vertices[indices[t * 3 + 2]].pos;
+			const XMFLOAT3 e1(p1.x - p0.x, p1.y - p0.y, p1.z - p0.z);
+			const XMFLOAT3 e2(p2.x - p0.x, p2.y - p0.y, p2.z - p0.z);
+			const XMFLOAT3 n(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+			const float area = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+			center.x += (p0.x + p1.x + p2.x) * area / 3.0f;
+			center.y += (p0.y + p1.y + p2.y) * area / 3.0f;
+			center.z += (p0.z + p1.z + p2.z) * area / 3.0f;
+			normal.x += n.x;
+			normal.y += n.y;
+			normal.z += n.z;
+			totalArea += area;
+		}
+
+		float key = 0.0f;
+		if (totalArea > 0.0f)
+		{
+			center.x = center.x / totalArea - meshCenter.x;
+			center.y = center.y / totalArea - meshCenter.y;
+			center.z = center.z / totalArea - meshCenter.z;
+			key = (center.x * normal.x + center.y * normal.y + center.z * normal.z) / totalArea;
+		}
+		sortKeys[c] = std::make_pair(-key, c);
+	}
+	std::stable_sort(
+		sortKeys.begin(),
+		sortKeys.end(),
+		[] (const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first < b.first; }
+		);
+
+	std::vector<uint32_t> output;
+	output.reserve(indexCount);
+	for (const std::pair<float, uint32_t>& sortKey : sortKeys)
+	{
+		const uint32_t c = sortKey.second;
+		output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+	return clusterCount;
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<VertexPositionColor>& vertices, std::vector<uint32_t>& indices)
+{
+	const uint32_t NotMapped = UINT32_MAX;
+	std::vector<uint32_t> remap(vertices.size(), NotMapped);
+	std::vector<VertexPositionColor> output;
+	output.reserve(vertices.size());
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == NotMapped)
+		{
+			remap[index] = static_cast<uint32_t>(output.size());
+			output.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	for (size_t v = 0; v < vertices.size(); ++v)
+	{
+		if (remap[v] == NotMapped)
+		{
+			output.push_back(vertices[v]);
+		}
+	}
+	vertices.swap(output);
+}
+
+MeshOptimizationReport MeshOptimizer::Optimize(MeshData& mesh, bool reduceOverdraw)
+{
+	MeshOptimizationReport report;
+	report.clusterCount = 0;
+
+	const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	const uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+	if (indexCount == 0)
+	{
+		report.before = AnalyzeVertexCache(nullptr, 0, vertexCount, DefaultCacheSize);
+		report.after = report.before;
+		return report;
+	}
+
+	report.before = AnalyzeVertexCache(&mesh.indices[0], indexCount, vertexCount, DefaultCacheSize);
+
+	OptimizeVertexCache(&mesh.indices[0], indexCount, vertexCount);
+	if (reduceOverdraw)
+	{
+		report.clusterCount = OptimizeOverdraw(&mesh.indices[0], indexCount, &mesh.vertices[0], vertexCount, DefaultCacheSize);
+	}
+	OptimizeVertexFetch(mesh.vertices, mesh.indices);
+
+	report.after = AnalyzeVertexCache(&mesh.indices[0], indexCount, vertexCount, DefaultCacheSize);
+	return report;
+}
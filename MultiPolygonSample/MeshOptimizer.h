@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+
+// 頂点キャッシュの効率。
+// acmr は三角形あたり、atvr は参照される頂点あたりの頂点シェーダーの実行回数です。
+// どちらも小さいほど良く、atvr の理想値は 1 です。
+struct VertexCacheStatistics
+{
+	float acmr;
+	float atvr;
+};
+
+// MeshOptimizer::Optimize の前後の頂点キャッシュの効率。
+struct MeshOptimizationReport
+{
+	VertexCacheStatistics before;
+	VertexCacheStatistics after;
+	uint32_t clusterCount;	// オーバードローを減らすために並べ替えたクラスターの数
+};
+
+// メッシュのインデックスと頂点を GPU が処理しやすい順に並べ替えます。
+// 三角形の集合と頂点の値は変わらないので、描画結果は並べ替える前と同じです。
+namespace MeshOptimizer
+{
+	// 頂点キャッシュを評価するときの FIFO キャッシュの大きさ。
+	static const uint32_t DefaultCacheSize = 16;
+
+	// FIFO キャッシュをシミュレートして、インデックスの並びの効率を求めます。
+	VertexCacheStatistics AnalyzeVertexCache(
+		const uint32_t* indices,
+		uint32_t indexCount,
+		uint32_t vertexCount,
+		uint32_t cacheSize
+		);
+
+	// 頂点キャッシュのヒット率が上がるように三角形を並べ替えます (Forsyth の方法)。
+	void OptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+
+	/**
+	 * OptimizeVertexCache の結果を、キャッシュが入れ替わる位置でクラスターに分け、
+	 * メッシュの外側を向いたクラスターが先に描画されるように並べ替えます (Tipsify の方法)。
+	 * 境界ではどの順でもキャッシュがミスするので、ACMR はほとんど変わりません。
+	 * クラスターの数を返します。
+	 */
+	uint32_t OptimizeOverdraw(
+		uint32_t* indices,
+		uint32_t indexCount,
+		const VertexPositionColor* vertices,
+		uint32_t vertexCount,
+		uint32_t cacheSize
+		);
+
+	// 頂点をインデックスから最初に参照される順に並べ替え、インデックスを付け直します。
+	// 参照されない頂点は末尾に残します。
+	void OptimizeVertexFetch(std::vector<VertexPositionColor>& vertices, std::vector<uint32_t>& indices);
+
+	// 上の 3 つを順に適用します。
+	MeshOptimizationReport Optimize(MeshData& mesh, bool reduceOverdraw);
+}
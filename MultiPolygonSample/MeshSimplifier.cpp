@@ -0,0 +1,663 @@
+﻿#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+
+// 前の段に対する三角形の数の比がこれを超える (あまり減らない) ときは、それ以上の段を作りません。
+static const float MinLevelReduction = 0.9f;
+
+// 縮約の前後で三角形の法線のなす角の cos がこれ以下になる縮約はしません。
+// 平面のポリゴンでは、三角形の裏返りと、面積がほぼ 0 の三角形ができるのを防ぎます。
+static const double MinNormalCosine = 0.25;
+
+static const uint32_t NoVertex = 0xFFFFFFFF;
+
+LodBuildSettings::LodBuildSettings() :
+	maxLevelCount(5),
+	triangleRatio(0.5f),
+	minTriangleCount(8),
+	maxError(FLT_MAX),
+	colorTolerance(1.0f / 255.0f)
+{
+}
+
+namespace
+{
+	// 平面までの距離の 2 乗の重み付きの和。対称な 4x4 行列の上三角を保持します。
+	struct Quadric
+	{
+		double a00, a01, a02, a03;
+		double a11, a12, a13;
+		double a22, a23;
+		double a33;
+		double weight;
+	};
+
+	// 単位法線 (nx, ny, nz) と d の平面 nx * x + ny * y + nz * z + d = 0 を、weight の重みで加えます。
+	void AddPlane(Quadric& q, double nx, double ny, double nz, double d, double weight)
+	{
+		q.a00 += weight * nx * nx;
+		q.a01 += weight * nx * ny;
+		q.a02 += weight * nx * nz;
+		q.a03 += weight * nx * d;
+		q.a11 += weight * ny * ny;
+		q.a12 += weight * ny * nz;
+		q.a13 += weight * ny * d;
+		q.a22 += weight * nz * nz;
+		q.a23 += weight * nz * d;
+		q.a33 += weight * d * d;
+		q.weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00;
+		q.a01 += other.a01;
+		q.a02 += other.a02;
+		q.a03 += other.a03;
+		q.a11 += other.a11;
+		q.a12 += other.a12;
+		q.a13 += other.a13;
+		q.a22 += other.a22;
+		q.a23 += other.a23;
+		q.a33 += other.a33;
+		q.weight += other.weight;
+	}
+
+	// p から各平面までの距離の 2 乗の、重み付きの平均。
+	double EvaluateQuadric(const Quadric& q, const XMFLOAT3& p)
+	{
+		if (q.weight <= 0.0)
+		{
+			return 0.0;
+		}
+
+		const double x = p.x;
+		const double y = p.y;
+		const double z = p.z;
+		const double sum =
+			q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + q.a33 +
+			2.0 * (q.a01 * x * y + q.a02 * x * z + q.a03 * x + q.a12 * y * z + q.a13 * y + q.a23 * z);
+		return std::max(sum / q.weight, 0.0);
+	}
+
+	void Subtract(const XMFLOAT3& a, const XMFLOAT3& b, double out[3])
+	{
+		out[0] = static_cast<double>(a.x) - b.x;
+		out[1] = static_cast<double>(a.y) - b.y;
+		out[2] = static_cast<double>(a.z) - b.z;
+	}
+
+	void Cross(const double a[3], const double b[3], double out[3])
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	double Dot(const double a[3], const double b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// 三角形 (p0, p1, p2) の法線。長さは面積の 2 倍です。
+	void TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, double out[3])
+	{
+		double e1[3];
+		double e2[3];
+		Subtract(p1, p0, e1);
+		Subtract(p2, p0, e2);
+		Cross(e1, e2, out);
+	}
+
+	bool ArePositionsLess(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		if (a.x != b.x)
+		{
+			return a.x < b.x;
+		}
+		if (a.y != b.y)
+		{
+			return a.y < b.y;
+		}
+		return a.z < b.z;
+	}
+
+	enum VertexKind
+	{
+		VertexInterior,	// 周りを三角形に囲まれた頂点。どの隣の頂点にもまとめられます
+		VertexBorder,	// 開いた境界の頂点。境界の辺でつながった隣の頂点にだけまとめます
+		VertexLocked	// 色の継ぎ目や非多様体の頂点。動かしません
+	};
+
+	/**
+	 * インデックスの配列を直接書き換えて辺を縮約します。
+	 * 1 回の走査では、縮約した頂点の 1-ring に含まれる頂点をそれ以上動かさないので、
+	 * 同じ走査の中の縮約は互いの判定に影響しません。
+	 */
+	class EdgeCollapser
+	{
+	public:
+		EdgeCollapser(const VertexPositionColor* vertices, uint32_t vertexCount, std::vector<uint32_t>& indices, float colorTolerance);
+
+		// 三角形が targetTriangleCount 以下になるまで、誤差の 2 乗が maxErrorSquared 以下の縮約を行います。
+		// 行った縮約の誤差の 2 乗の最大値を errorSquared に反映し、縮約の数を返します。
+		uint32_t CollapsePass(uint32_t targetTriangleCount, double maxErrorSquared, double& errorSquared);
+
+		uint32_t GetTriangleCount() const { return static_cast<uint32_t>(m_indices.size() / 3); }
+
+	private:
+		EdgeCollapser(const EdgeCollapser&);
+		EdgeCollapser& operator=(const EdgeCollapser&);
+
+		void BuildAdjacency();
+		void ClassifyVertices();
+		void ComputeQuadrics();
+		uint32_t CountDirectedEdges(uint32_t from, uint32_t to) const;
+		void ConsiderCollapse(uint32_t from, uint32_t to);
+		bool IsCollapseValid(uint32_t from, uint32_t to);
+
+		const VertexPositionColor* m_vertices;
+		uint32_t m_vertexCount;
+		std::vector<uint32_t>& m_indices;
+		float m_colorTolerance;
+
+		std::vector<uint8_t> m_kinds;
+		std::vector<Quadric> m_surfaceQuadrics;	// 三角形の平面。面積で重み付けします
+		std::vector<Quadric> m_borderQuadrics;	// 境界の辺を含み、三角形に垂直な平面。辺の長さで重み付けします
+
+		// 頂点ごとの隣接する三角形のリスト。
+		std::vector<uint32_t> m_adjacencyOffsets;
+		std::vector<uint32_t> m_adjacency;
+
+		std::vector<uint32_t> m_targets;
+		std::vector<double> m_errors;
+		std::vector<uint32_t> m_candidates;
+		std::vector<uint8_t> m_passLocked;
+		std::vector<uint32_t> m_marks;
+		uint32_t m_markStamp;
+	};
+
+	EdgeCollapser::EdgeCollapser(const VertexPositionColor* vertices, uint32_t vertexCount, std::vector<uint32_t>& indices, float colorTolerance) :
+		m_vertices(vertices),
+		m_vertexCount(vertexCount),
+		m_indices(indices),
+		m_colorTolerance(colorTolerance),
+		m_marks(vertexCount, 0),
+		m_markStamp(0)
+	{
+		BuildAdjacency();
+		ClassifyVertices();
+		ComputeQuadrics();
+	}
+
+	void EdgeCollapser::BuildAdjacency()
+	{
+		m_adjacencyOffsets.assign(m_vertexCount + 1, 0);
+		for (size_t i = 0; i < m_indices.size(); ++i)
+		{
+			++m_adjacencyOffsets[m_indices[i] + 1];
+		}
+		for (uint32_t v = 0; v < m_vertexCount; ++v)
+		{
+			m_adjacencyOffsets[v + 1] += m_adjacencyOffsets[v];
+		}
+
+		m_adjacency.resize(m_indices.size());
+		std::vector<uint32_t> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+		const uint32_t triangleCount = GetTriangleCount();
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				m_adjacency[fill[m_indices[t * 3 + k]]++] = t;
+			}
+		}
+	}
+
+	// from → to の向きの辺を持つ三角形の数。
+	uint32_t EdgeCollapser::CountDirectedEdges(uint32_t from, uint32_t to) const
+	{
+		uint32_t count = 0;
+		for (uint32_t i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; ++i)
+		{
+			const uint32_t* triangle = &m_indices[m_adjacency[i] * 3];
+			for (int k = 0; k < 3; ++k)
+			{
+				if (triangle[k] == from && triangle[(k + 1) % 3] == to)
+				{
+					++count;
+				}
+			}
+		}
+		return count;
+	}
+
+	// 元のメッシュで頂点の種類を決めます。縮約しても境界は境界のまま残るので、最初に 1 度だけ決めます。
+	void EdgeCollapser::ClassifyVertices()
+	{
+		m_kinds.assign(m_vertexCount, VertexInterior);
+
+		// 同じ位置の頂点は色の継ぎ目なので、片側だけ動かして隙間ができないように固定します。
+		std::vector<uint32_t> order;
+		for (uint32_t v = 0; v < m_vertexCount; ++v)
+		{
+			if (m_adjacencyOffsets[v + 1] > m_adjacencyOffsets[v])
+			{
+				order.push_back(v);
+			}
+		}
+		std::sort(order.begin(), order.end(), [this] (uint32_t a, uint32_t b) {
+			return ArePositionsLess(m_vertices[a].pos, m_vertices[b].pos);
+		});
+		for (size_t i = 1; i < order.size(); ++i)
+		{
+			if (!ArePositionsLess(m_vertices[order[i - 1]].pos, m_vertices[order[i]].pos))
+			{
+				m_kinds[order[i - 1]] = VertexLocked;
+				m_kinds[order[i]] = VertexLocked;
+			}
+		}
+
+		// 逆向きの辺がない辺が開いた境界です。同じ向きの辺が 2 つ以上あるか、
+		// 境界の辺が 2 本ではない頂点 (ポリゴンどうしが 1 点で接する所など) は非多様体として固定します。
+		std::vector<uint32_t> borderEdgeCounts(m_vertexCount, 0);
+		const uint32_t triangleCount = GetTriangleCount();
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a = m_indices[t * 3 + k];
+				const uint32_t b = m_indices[t * 3 + (k + 1) % 3];
+				const uint32_t reverseCount = CountDirectedEdges(b, a);
+				if (CountDirectedEdges(a, b) > 1 || reverseCount > 1)
+				{
+					m_kinds[a] = VertexLocked;
+					m_kinds[b] = VertexLocked;
+				}
+				else if (reverseCount == 0)
+				{
+					++borderEdgeCounts[a];
+					++borderEdgeCounts[b];
+				}
+			}
+		}
+
+		for (uint32_t v = 0; v < m_vertexCount; ++v)
+		{
+			if (m_kinds[v] != VertexLocked && borderEdgeCounts[v] > 0)
+			{
+				m_kinds[v] = borderEdgeCounts[v] == 2 ? VertexBorder : VertexLocked;
+			}
+		}
+	}
+
+	void EdgeCollapser::ComputeQuadrics()
+	{
+		Quadric zero;
+		memset(&zero, 0, sizeof(zero));
+		m_surfaceQuadrics.assign(m_vertexCount, zero);
+		m_borderQuadrics.assign(m_vertexCount, zero);
+
+		const uint32_t triangleCount = GetTriangleCount();
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t* triangle = &m_indices[t * 3];
+			double normal[3];
+			TriangleNormal(m_vertices[triangle[0]].pos, m_vertices[triangle[1]].pos, m_vertices[triangle[2]].pos, normal);
+			const double length = std::sqrt(Dot(normal, normal));
+			if (length == 0.0)
+			{
+				continue;
+			}
+
+			normal[0] /= length;
+			normal[1] /= length;
+			normal[2] /= length;
+			const XMFLOAT3& origin = m_vertices[triangle[0]].pos;
+			const double d = -(normal[0] * origin.x + normal[1] * origin.y + normal[2] * origin.z);
+			for (int k = 0; k < 3; ++k)
+			{
+				AddPlane(m_surfaceQuadrics[triangle[k]], normal[0], normal[1], normal[2], d, length * 0.5);
+			}
+
+			// 境界の辺では、辺を含んで三角形に垂直な平面からの距離で、輪郭がずれた量を測ります。
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a = triangle[k];
+				const uint32_t b = triangle[(k + 1) % 3];
+				if (CountDirectedEdges(b, a) != 0)
+				{
+					continue;
+				}
+
+				double edge[3];
+				Subtract(m_vertices[b].pos, m_vertices[a].pos, edge);
+				const double edgeLength = std::sqrt(Dot(edge, edge));
+				if (edgeLength == 0.0)
+				{
+					continue;
+				}
+
+				double plane[3];
+				Cross(edge, normal, plane);
+				plane[0] /= edgeLength;
+				plane[1] /= edgeLength;
+				plane[2] /= edgeLength;
+				const XMFLOAT3& p = m_vertices[a].pos;
+				const double planeD = -(plane[0] * p.x + plane[1] * p.y + plane[2] * p.z);
+				AddPlane(m_borderQuadrics[a], plane[0], plane[1], plane[2], planeD, edgeLength);
+				AddPlane(m_borderQuadrics[b], plane[0], plane[1], plane[2], planeD, edgeLength);
+			}
+		}
+	}
+
+	// from を to にまとめる縮約を評価し、from の候補の中で誤差が最も小さければ記録します。
+	void EdgeCollapser::ConsiderCollapse(uint32_t from, uint32_t to)
+	{
+		if (m_kinds[from] == VertexLocked)
+		{
+			return;
+		}
+		if (m_kinds[from] == VertexBorder && CountDirectedEdges(from, to) + CountDirectedEdges(to, from) != 1)
+		{
+			return;
+		}
+
+		const XMFLOAT3& a = m_vertices[from].color;
+		const XMFLOAT3& b = m_vertices[to].color;
+		const float colorDifference = std::max(std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)), std::fabs(a.z - b.z));
+		if (colorDifference > m_colorTolerance)
+		{
+			return;
+		}
+
+		const XMFLOAT3& position = m_vertices[to].pos;
+		const double error = std::max(
+			EvaluateQuadric(m_surfaceQuadrics[from], position),
+			EvaluateQuadric(m_borderQuadrics[from], position)
+			);
+		if (error < m_errors[from])
+		{
+			m_errors[from] = error;
+			m_targets[from] = to;
+		}
+	}
+
+	/**
+	 * 縮約で位相や向きが壊れないかを調べます。
+	 * from と to の両方に隣接する頂点は、辺 (from, to) を含む三角形の残りの頂点だけでなければなりません (link condition)。
+	 * また、残る三角形の法線が大きく回転する縮約は、裏返りや潰れた三角形を作るので行いません。
+	 */
+	bool EdgeCollapser::IsCollapseValid(uint32_t from, uint32_t to)
+	{
+		m_markStamp += 2;
+		const uint32_t neighborMark = m_markStamp;
+		const uint32_t countedMark = m_markStamp + 1;
+
+		uint32_t sharedTriangles = 0;
+		for (uint32_t i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; ++i)
+		{
+			const uint32_t* triangle = &m_indices[m_adjacency[i] * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+			{
+				++sharedTriangles;
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				m_marks[triangle[k]] = neighborMark;
+			}
+		}
+
+		uint32_t commonNeighbors = 0;
+		for (uint32_t i = m_adjacencyOffsets[to]; i < m_adjacencyOffsets[to + 1]; ++i)
+		{
+			const uint32_t* triangle = &m_indices[m_adjacency[i] * 3];
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t w = triangle[k];
+				if (w != from && w != to && m_marks[w] == neighborMark)
+				{
+					m_marks[w] = countedMark;
+					++commonNeighbors;
+				}
+			}
+		}
+		if (commonNeighbors != sharedTriangles)
+		{
+			return false;
+		}
+
+		for (uint32_t i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; ++i)
+		{
+			const uint32_t* triangle = &m_indices[m_adjacency[i] * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+			{
+				continue;
+			}
+
+			XMFLOAT3 before[3];
+			XMFLOAT3 after[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				before[k] = m_vertices[triangle[k]].pos;
+				after[k] = m_vertices[triangle[k] == from ? to : triangle[k]].pos;
+			}
+
+			double normalBefore[3];
+			double normalAfter[3];
+			TriangleNormal(before[0], before[1], before[2], normalBefore);
+			TriangleNormal(after[0], after[1], after[2], normalAfter);
+			const double lengthBefore = std::sqrt(Dot(normalBefore, normalBefore));
+			if (lengthBefore == 0.0)
+			{
+				continue;
+			}
+			const double lengthAfter = std::sqrt(Dot(normalAfter, normalAfter));
+			if (Dot(normalBefore, normalAfter) <= MinNormalCosine * lengthBefore * lengthAfter)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t EdgeCollapser::CollapsePass(uint32_t targetTriangleCount, double maxErrorSquared, double& errorSquared)
+	{
+		BuildAdjacency();
+
+		m_targets.assign(m_vertexCount, NoVertex);
+		m_errors.assign(m_vertexCount, DBL_MAX);
+		uint32_t triangleCount = GetTriangleCount();
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a = m_indices[t * 3 + k];
+				const uint32_t b = m_indices[t * 3 + (k + 1) % 3];
+				ConsiderCollapse(a, b);
+				ConsiderCollapse(b, a);
+			}
+		}
+
+		m_candidates.clear();
+		for (uint32_t v = 0; v < m_vertexCount; ++v)
+		{
+			if (m_targets[v] != NoVertex && m_errors[v] <= maxErrorSquared)
+			{
+				m_candidates.push_back(v);
+			}
+		}
+		std::sort(m_candidates.begin(), m_candidates.end(), [this] (uint32_t a, uint32_t b) {
+			return m_errors[a] < m_errors[b] || (m_errors[a] == m_errors[b] && a < b);
+		});
+
+		m_passLocked.assign(m_vertexCount, 0);
+		uint32_t collapseCount = 0;
+		for (uint32_t from : m_candidates)
+		{
+			if (triangleCount <= targetTriangleCount)
+			{
+				break;
+			}
+
+			const uint32_t to = m_targets[from];
+			if (m_passLocked[from] || m_passLocked[to] || !IsCollapseValid(from, to))
+			{
+				continue;
+			}
+
+			// 辺を含む三角形は消え、残りの三角形は from の代わりに to を参照します。
+			// 変わった三角形の頂点は、この走査ではもう動かしません。
+			for (uint32_t i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; ++i)
+			{
+				uint32_t* triangle = &m_indices[m_adjacency[i] * 3];
+				const bool removed = triangle[0] == to || triangle[1] == to || triangle[2] == to;
+				for (int k = 0; k < 3; ++k)
+				{
+					m_passLocked[triangle[k]] = 1;
+					triangle[k] = removed ? to : (triangle[k] == from ? to : triangle[k]);
+				}
+				if (removed)
+				{
+					--triangleCount;
+				}
+			}
+
+			AddQuadric(m_surfaceQuadrics[to], m_surfaceQuadrics[from]);
+			AddQuadric(m_borderQuadrics[to], m_borderQuadrics[from]);
+			errorSquared = std::max(errorSquared, m_errors[from]);
+			++collapseCount;
+		}
+
+		// 消えた三角形 (3 頂点とも同じ) を詰めます。残りの三角形の順は変えません。
+		size_t write = 0;
+		for (size_t read = 0; read < m_indices.size(); read += 3)
+		{
+			if (m_indices[read] == m_indices[read + 1] && m_indices[read] == m_indices[read + 2])
+			{
+				continue;
+			}
+			m_indices[write++] = m_indices[read];
+			m_indices[write++] = m_indices[read + 1];
+			m_indices[write++] = m_indices[read + 2];
+		}
+		m_indices.resize(write);
+		return collapseCount;
+	}
+}
+
+float MeshSimplifier::Simplify(
+	const VertexPositionColor* vertices,
+	uint32_t vertexCount,
+	const uint32_t* indices,
+	uint32_t indexCount,
+	uint32_t targetIndexCount,
+	float maxError,
+	float colorTolerance,
+	std::vector<uint32_t>& output
+	)
+{
+	// 面積のない (同じ頂点を 2 回参照する) 三角形は、位相を調べる前に除きます。
+	output.clear();
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const uint32_t a = indices[i];
+		const uint32_t b = indices[i + 1];
+		const uint32_t c = indices[i + 2];
+		if (a != b && b != c && c != a)
+		{
+			output.push_back(a);
+			output.push_back(b);
+			output.push_back(c);
+		}
+	}
+	if (output.size() <= targetIndexCount)
+	{
+		return 0.0f;
+	}
+
+	EdgeCollapser collapser(vertices, vertexCount, output, colorTolerance);
+	const uint32_t targetTriangleCount = targetIndexCount / 3;
+	const double maxErrorSquared = static_cast<double>(maxError) * maxError;
+	double errorSquared = 0.0;
+	while (collapser.GetTriangleCount() > targetTriangleCount
+		&& collapser.CollapsePass(targetTriangleCount, maxErrorSquared, errorSquared) > 0)
+	{
+	}
+	return static_cast<float>(std::sqrt(errorSquared));
+}
+
+void MeshSimplifier::BuildLods(MeshData& mesh, const LodBuildSettings& settings, std::vector<MeshFileLod>& lods)
+{
+	lods.clear();
+	MeshFileLod lod;
+	lod.firstIndex = 0;
+	lod.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	lod.maxError = 0.0f;
+	lod.reserved = 0;
+	lods.push_back(lod);
+
+	// 各段は前の段から作るので、段の誤差は前の段の誤差に今回の誤差を足したものとします。
+	std::vector<uint32_t> previous(mesh.indices);
+	std::vector<uint32_t> simplified;
+	const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	float error = 0.0f;
+	while (lods.size() < settings.maxLevelCount && error < settings.maxError)
+	{
+		const uint32_t previousCount = static_cast<uint32_t>(previous.size());
+		const uint32_t targetTriangleCount = static_cast<uint32_t>(previousCount / 3 * settings.triangleRatio);
+		if (targetTriangleCount < settings.minTriangleCount)
+		{
+			break;
+		}
+
+		const float levelError = Simplify(
+			&mesh.vertices[0],
+			vertexCount,
+			&previous[0],
+			previousCount,
+			targetTriangleCount * 3,
+			settings.maxError - error,
+			settings.colorTolerance,
+			simplified
+			);
+		if (simplified.empty() || simplified.size() > previousCount * MinLevelReduction)
+		{
+			break;
+		}
+
+		error += levelError;
+		MeshOptimizer::OptimizeVertexCache(&simplified[0], static_cast<uint32_t>(simplified.size()), vertexCount);
+
+		lod.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+		lod.indexCount = static_cast<uint32_t>(simplified.size());
+		lod.maxError = error;
+		lods.push_back(lod);
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+		previous.swap(simplified);
+	}
+}
+
+void MeshSimplifier::ExtractLod(const MeshData& mesh, const MeshFileLod& lod, MeshData& levelMesh)
+{
+	levelMesh.format = mesh.format;
+	levelMesh.vertices.clear();
+	levelMesh.indices.resize(lod.indexCount);
+
+	std::vector<uint32_t> remap(mesh.vertices.size(), NoVertex);
+	for (uint32_t i = 0; i < lod.indexCount; ++i)
+	{
+		const uint32_t vertex = mesh.indices[lod.firstIndex + i];
+		if (remap[vertex] == NoVertex)
+		{
+			remap[vertex] = static_cast<uint32_t>(levelMesh.vertices.size());
+			levelMesh.vertices.push_back(mesh.vertices[vertex]);
+		}
+		levelMesh.indices[i] = remap[vertex];
+	}
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+#include "MeshFile.h"
+
+// MeshSimplifier::BuildLods の設定。
+struct LodBuildSettings
+{
+	LodBuildSettings();
+
+	uint32_t maxLevelCount;		// 0 番を含めた最大の段数
+	float triangleRatio;		// 前の段に対して目標とする三角形の数の比
+	uint32_t minTriangleCount;	// 目標の三角形の数がこれより少なくなる段は作りません
+	float maxError;				// 0 番からの誤差の上限 (ローカル空間の距離)
+	float colorTolerance;		// 1 つにまとめてよい頂点の色の差 (成分ごとの差の最大値)
+};
+
+// 二次誤差 (quadric error metric) による辺の縮約で、メッシュの詳細度 (LOD) の段を作ります。
+namespace MeshSimplifier
+{
+	/**
+	 * 三角形の数が targetIndexCount / 3 以下になるまで、誤差の小さい辺から縮約します。
+	 * 頂点は隣の既存の頂点にまとめる (half-edge collapse) ので、結果は元の頂点をそのまま参照します。
+	 * 開いた境界 (ポリゴンの輪郭) の頂点は境界に沿ってだけ動かし、同じ位置に別の頂点がある色の継ぎ目の頂点と、
+	 * 非多様体の頂点は動かしません。色の差が colorTolerance を超える頂点どうしもまとめません。
+	 * 推定した誤差が maxError を超える縮約はしないので、目標の数まで減らないこともあります。
+	 * 結果のインデックスを output に書き込み、推定した誤差 (ローカル空間の距離) を返します。
+	 */
+	float Simplify(
+		const VertexPositionColor* vertices,
+		uint32_t vertexCount,
+		const uint32_t* indices,
+		uint32_t indexCount,
+		uint32_t targetIndexCount,
+		float maxError,
+		float colorTolerance,
+		std::vector<uint32_t>& output
+		);
+
+	/**
+	 * mesh.indices 全体を 0 番として、前の段を簡略化した段のインデックスを mesh.indices の末尾に追加し、
+	 * lods に MeshFile と同じ形式の LOD 表を書き込みます。頂点は全段で共有します。
+	 * 三角形があまり減らなくなるか、誤差が settings.maxError に達したら、それ以上の段は作りません。
+	 */
+	void BuildLods(MeshData& mesh, const LodBuildSettings& settings, std::vector<MeshFileLod>& lods);
+
+	// lod の範囲の三角形と、それが参照する頂点だけを持つメッシュを levelMesh に作ります。頂点は最初に参照される順に並べます。
+	void ExtractLod(const MeshData& mesh, const MeshFileLod& lod, MeshData& levelMesh);
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "MemoryTracker.h"
+
+/**
+ * 同じ大きさのオブジェクトを、まとめて確保したチャンクから貸し出すプール。
+ * 空いたスロットは単方向リストでつなぎ、Create と Destroy はどちらも O(1) です。
+ * チャンクは解放せずに再利用するので、同時に使う数が前と変わらなければヒープからの確保は起こりません。
+ * 配列と違って足りなくなっても既存のオブジェクトを移動しないので、返したポインターはずっと有効です。
+ * スレッド セーフではありません。複数のスレッドで共有するときは呼び出し側でロックしてください。
+ */
+template <typename T>
+class ObjectPool
+{
+public:
+	ObjectPool(uint32_t objectsPerChunk, MemoryCategory category) :
+		m_objectsPerChunk(objectsPerChunk > 0 ? objectsPerChunk : 1),
+		m_category(category),
+		m_freeList(nullptr),
+		m_liveCount(0)
+	{
+	}
+
+	// プールを破棄する前に、すべてのオブジェクトを Destroy してください。
+	~ObjectPool()
+	{
+		for (Slot* chunk : m_chunks)
+		{
+			::operator delete(chunk);
+			MemoryTracker::RecordHeapFree(m_category, sizeof(Slot) * m_objectsPerChunk);
+		}
+	}
+
+	// 既定のコンストラクターで初期化したオブジェクトを返します。
+	T* Create()
+	{
+		if (m_freeList == nullptr)
+		{
+			AllocateChunk();
+		}
+		Slot* slot = m_freeList;
+		m_freeList = slot->next;
+		++m_liveCount;
+		MemoryTracker::RecordAllocation(m_category, sizeof(Slot), 1);
+		return new (&slot->storage) T();
+	}
+
+	void Destroy(T* object)
+	{
+		object->~T();
+		Slot* slot = reinterpret_cast<Slot*>(object);
+		slot->next = m_freeList;
+		m_freeList = slot;
+		--m_liveCount;
+		MemoryTracker::RecordFree(m_category, sizeof(Slot));
+	}
+
+	uint32_t GetLiveCount() const { return m_liveCount; }
+	uint32_t GetCapacity() const { return static_cast<uint32_t>(m_chunks.size()) * m_objectsPerChunk; }
+
+private:
+	ObjectPool(const ObjectPool&);
+	ObjectPool& operator=(const ObjectPool&);
+
+	// 空いているスロットは next を、使用中のスロットはオブジェクトを保持します。
+	union Slot
+	{
+		Slot* next;
+		typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+	};
+
+	// 新しいチャンクのスロットは先頭から順に貸し出すように、後ろからリストにつなぎます。
+	void AllocateChunk()
+	{
+		Slot* chunk = static_cast<Slot*>(::operator new(sizeof(Slot) * m_objectsPerChunk));
+		MemoryTracker::RecordHeapAllocation(m_category, sizeof(Slot) * m_objectsPerChunk);
+		m_chunks.push_back(chunk);
+		for (uint32_t i = m_objectsPerChunk; i > 0; --i)
+		{
+			chunk[i - 1].next = m_freeList;
+			m_freeList = &chunk[i - 1];
+		}
+	}
+
+	uint32_t m_objectsPerChunk;
+	MemoryCategory m_category;
+	std::vector<Slot*> m_chunks;
+	Slot* m_freeList;
+	uint32_t m_liveCount;
+};
@@ -0,0 +1,115 @@
+﻿#include "PipelineStateKey.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint64_t HashPrime = 1099511628211ULL;
+
+// 名前を終端の 0 まで含めて dest にコピーします。残りは 0 で埋めます。
+static void CopyName(char* dest, const char* source)
+{
+	memset(dest, 0, MaxShaderNameLength);
+	memcpy(dest, source, std::min<size_t>(strlen(source), MaxShaderNameLength - 1));
+}
+
+static bool IsNameTerminated(const char* name)
+{
+	return memchr(name, 0, MaxShaderNameLength) != nullptr;
+}
+
+PipelineStateDesc PipelineStateKey::MakeDesc(
+	const char* vertexShader,
+	const char* pixelShader,
+	VertexFormat vertexFormat,
+	bool instanced,
+	CullMode cullMode,
+	BlendMode blendMode,
+	DepthMode depthMode
+	)
+{
+	PipelineStateDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	CopyName(desc.vertexShader, vertexShader);
+	CopyName(desc.pixelShader, pixelShader);
+	desc.vertexFormat = static_cast<uint32_t>(vertexFormat);
+	desc.instanced = instanced ? 1 : 0;
+	desc.cullMode = static_cast<uint32_t>(cullMode);
+	desc.blendMode = static_cast<uint32_t>(blendMode);
+	desc.depthMode = static_cast<uint32_t>(depthMode);
+	return desc;
+}
+
+uint64_t PipelineStateKey::HashBytes(const void* data, size_t size, uint64_t hash)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * HashPrime;
+	}
+	return hash;
+}
+
+uint64_t PipelineStateKey::Compute(const PipelineStateDesc& desc, uint64_t vertexShaderHash, uint64_t pixelShaderHash)
+{
+	const uint32_t states[] = { desc.vertexFormat, desc.instanced, desc.cullMode, desc.blendMode, desc.depthMode };
+
+	uint64_t hash = HashBytes(&vertexShaderHash, sizeof(vertexShaderHash));
+	hash = HashBytes(&pixelShaderHash, sizeof(pixelShaderHash), hash);
+	return HashBytes(states, sizeof(states), hash);
+}
+
+bool PipelineStateKey::IsSameDesc(const PipelineStateDesc& a, const PipelineStateDesc& b)
+{
+	return memcmp(&a, &b, sizeof(PipelineStateDesc)) == 0;
+}
+
+void PipelineStateKey::Write(const std::vector<PipelineStateRecord>& records, std::vector<uint8_t>& output)
+{
+	PipelineStateFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = PipelineStateFileMagic;
+	header.version = PipelineStateFileVersion;
+	header.recordSize = sizeof(PipelineStateRecord);
+	header.recordCount = static_cast<uint32_t>(records.size());
+
+	output.resize(sizeof(header) + sizeof(PipelineStateRecord) * records.size());
+	memcpy(&output[0], &header, sizeof(header));
+	if (!records.empty())
+	{
+		memcpy(&output[sizeof(header)], &records[0], sizeof(PipelineStateRecord) * records.size());
+	}
+}
+
+bool PipelineStateKey::Parse(const uint8_t* data, size_t size, std::vector<PipelineStateRecord>& records)
+{
+	records.clear();
+	if (data == nullptr || size < sizeof(PipelineStateFileHeader))
+	{
+		return false;
+	}
+
+	PipelineStateFileHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != PipelineStateFileMagic ||
+		header.version != PipelineStateFileVersion ||
+		header.recordSize != sizeof(PipelineStateRecord) ||
+		static_cast<uint64_t>(header.recordCount) * sizeof(PipelineStateRecord) != size - sizeof(header))
+	{
+		return false;
+	}
+
+	records.resize(header.recordCount);
+	if (header.recordCount > 0)
+	{
+		memcpy(&records[0], data + sizeof(header), sizeof(PipelineStateRecord) * header.recordCount);
+	}
+
+	for (const PipelineStateRecord& record : records)
+	{
+		if (!IsNameTerminated(record.desc.vertexShader) || !IsNameTerminated(record.desc.pixelShader))
+		{
+			records.clear();
+			return false;
+		}
+	}
+	return true;
+}
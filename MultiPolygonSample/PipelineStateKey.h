@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PipelineStates.h"
+#include "VertexFormat.h"
+
+// パイプライン ステートのキーを保存するファイルの先頭の識別子 ("PSOC")。
+const uint32_t PipelineStateFileMagic = 0x434F5350;
+
+// 現在の形式のバージョン。形式を変えたら増やし、Parse は同じバージョンだけを受け付けます。
+const uint16_t PipelineStateFileVersion = 1;
+
+// シェーダー ファイル名の最大の長さ (終端の 0 を含みます)。
+const uint32_t MaxShaderNameLength = 48;
+
+// ブレンド ステート。
+enum class BlendMode : uint32_t
+{
+	Opaque,		// ブレンドしません
+	AlphaBlend,	// ソースのアルファで合成します
+	NoColor		// 色を書き込みません
+};
+
+// 深度ステンシル ステート。
+enum class DepthMode : uint32_t
+{
+	ReadWrite,	// LESS で比較して書き込みます
+	ReadOnly,	// 比較だけして書き込みません
+	Overwrite	// 比較せずに書き込みます
+};
+
+/**
+ * パイプライン ステートの記述。シェーダーはパッケージ内の .cso のファイル名で指定し、
+ * 入力レイアウトは頂点の形式とインスタンス データの有無から決まります。
+ * そのままファイルに書き出すので、固定長のメンバーだけで構成します。
+ */
+struct PipelineStateDesc
+{
+	char vertexShader[MaxShaderNameLength];
+	char pixelShader[MaxShaderNameLength];
+	uint32_t vertexFormat;	// VertexFormat
+	uint32_t instanced;		// スロット 1 に InstanceData を使うなら 1
+	uint32_t cullMode;		// CullMode
+	uint32_t blendMode;		// BlendMode
+	uint32_t depthMode;		// DepthMode
+	uint32_t reserved;
+};
+
+// 保存するパイプライン ステート。key はシェーダーのバイトコードを含めて計算したハッシュです。
+struct PipelineStateRecord
+{
+	uint64_t key;
+	PipelineStateDesc desc;
+};
+
+static_assert(sizeof(PipelineStateRecord) == 128, "PipelineStateRecord のレイアウトはファイル形式の一部です。");
+
+// ファイルのヘッダー。続けて PipelineStateRecord が recordCount 個並びます。
+struct PipelineStateFileHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recordSize;	// sizeof(PipelineStateRecord)
+	uint32_t recordCount;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(PipelineStateFileHeader) == 16, "PipelineStateFileHeader のレイアウトはファイル形式の一部です。");
+
+// パイプライン ステートのキーの計算と、キーの一覧の保存。
+namespace PipelineStateKey
+{
+	// 64 ビットの FNV-1a ハッシュの初期値。
+	const uint64_t HashSeed = 14695981039346656037ULL;
+
+	// ファイル名などから記述を作ります。名前が長すぎるときは切り詰めます。
+	PipelineStateDesc MakeDesc(
+		const char* vertexShader,
+		const char* pixelShader,
+		VertexFormat vertexFormat,
+		bool instanced,
+		CullMode cullMode,
+		BlendMode blendMode,
+		DepthMode depthMode
+		);
+
+	// data を hash に続けてハッシュします。
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash = HashSeed);
+
+	// シェーダーのバイトコードのハッシュと、入力レイアウト、ラスタライザー、ブレンド、深度ステンシルの各ステートからキーを計算します。
+	// ファイル名は含めないので、名前が違っても中身が同じなら同じキーになります。
+	uint64_t Compute(const PipelineStateDesc& desc, uint64_t vertexShaderHash, uint64_t pixelShaderHash);
+
+	// 2 つの記述が同じ内容かどうか。
+	bool IsSameDesc(const PipelineStateDesc& a, const PipelineStateDesc& b);
+
+	void Write(const std::vector<PipelineStateRecord>& records, std::vector<uint8_t>& output);
+
+	// data の内容を検証して records に読み取ります。形式が違えば false を返し、records は空にします。
+	bool Parse(const uint8_t* data, size_t size, std::vector<PipelineStateRecord>& records);
+}
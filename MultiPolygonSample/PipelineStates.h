@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// カリング モード。D3D11_CULL_MODE と同じ意味を持ちます。
+enum class CullMode
+{
+	None,
+	Front,
+	Back
+};
+
+// 薄いポリゴンを両面から見えるようにする方法。
+enum class TwoSidedMode
+{
+	TwoPass,	// CULL_FRONT と CULL_BACK で 2 回描画する従来の方法
+	SinglePass	// CULL_NONE で 1 回だけ描画する方法
+};
+
+// 描画キューで使うパイプライン ステートの ID。値の小さい順に描画されます。
+const uint32_t PipelineCullFront = 0;
+const uint32_t PipelineCullBack = 1;
+const uint32_t PipelineCullNone = 2;
+const uint32_t PipelineCount = 3;
+
+// 最初の SetPipelineState より前の描画に使うパイプライン。どのデバイスもここから始めます。
+const uint32_t PipelineDefault = PipelineCullBack;
+
+inline CullMode GetPipelineCullMode(uint32_t pipelineId)
+{
+	switch (pipelineId)
+	{
+	case PipelineCullFront:
+		return CullMode::Front;
+	case PipelineCullBack:
+		return CullMode::Back;
+	default:
+		return CullMode::None;
+	}
+}
@@ -0,0 +1,597 @@
+﻿#include "PolygonScene.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// Refit を繰り返した BVH の SAH コストが、構築した直後のこの倍数を超えたら作り直します。
+static const float RebuildSahRatio = 1.5f;
+
+// ポインターで選ばれたオブジェクトの色。
+static const XMFLOAT4 HighlightColor(1.0f, 0.8f, 0.2f, 1.0f);
+
+// 射影行列の手前のクリップ面までの距離。詳細度を選ぶときの距離の下限にも使います。
+static const float NearPlaneDistance = 0.01f;
+
+// オブジェクトを両面表示の方法に応じたパイプラインで描画キューに積みます。
+static void SubmitObject(DrawQueue& drawQueue, uint32_t meshId, const InstanceData& instance, TwoSidedMode twoSidedMode)
+{
+	if (twoSidedMode == TwoSidedMode::SinglePass)
+	{
+		drawQueue.Submit(PipelineCullNone, meshId, instance);
+	}
+	else
+	{
+		drawQueue.Submit(PipelineCullFront, meshId, instance);
+		drawQueue.Submit(PipelineCullBack, meshId, instance);
+	}
+}
+
+PolygonScene::PolygonScene() :
+	m_builtSahCost(0.0f),
+	m_objectsChanged(false),
+	m_cullingMode(SceneCullingMode::Flat),
+	m_dirtyRectTracker(nullptr),
+	m_recordedFrame(0),
+	m_time(0.0f),
+	m_sceneRotationSpeed(XM_PIDIV4),
+	m_animatedObjectCount(0),
+	m_jobSystem(nullptr)
+{
+	// すべてのポリゴンが共有する三角形のメッシュ。
+	MeshData triangle;
+	VertexPositionColor vertices[] = 
+	{
+		{XMFLOAT3(0.5f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)},
+		{XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)},
+		{XMFLOAT3(0.0f, 0.5f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)},
+	};
+	triangle.vertices.assign(vertices, vertices + 3);
+	triangle.indices.push_back(0);
+	triangle.indices.push_back(1);
+	triangle.indices.push_back(2);
+	triangle.format = VertexFormat::Compact;
+	m_meshes.push_back(triangle);
+
+	// デバイス上にバッファーを作る前に、インデックスと頂点を 1 度だけ並べ替え、詳細度の段を作っておきます。
+	for (MeshData& mesh : m_meshes)
+	{
+		m_optimizationReports.push_back(MeshOptimizer::Optimize(mesh, true));
+		m_meshBounds.push_back(FrustumCulling::ComputeMeshBounds(mesh));
+
+		std::vector<MeshFileLod> lods;
+		MeshSimplifier::BuildLods(mesh, LodBuildSettings(), lods);
+		m_meshLods.push_back(MeshLodChain());
+		SplitLods(mesh, lods, m_meshLods.back());
+	}
+
+	// ポインターで選ぶための三角形の BVH。最適化で三角形の順が変わるので、その後で作ります。
+	m_meshHierarchies.resize(m_meshes.size());
+	for (size_t i = 0; i < m_meshes.size(); ++i)
+	{
+		m_meshHierarchies[i].Build(m_meshes[i], nullptr);
+	}
+
+	// 2 つのポリゴン。2 つ目は共有メッシュを -2 倍して色を付けたものです。
+	XMFLOAT4X4 localTransform;
+	XMStoreFloat4x4(&localTransform, XMMatrixIdentity());
+	m_entities.Create(0, localTransform, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+	XMStoreFloat4x4(&localTransform, XMMatrixScaling(-2.0f, -2.0f, 1.0f));
+	m_entities.Create(0, localTransform, XMFLOAT4(0.6f, 1.0f, 1.0f, 1.0f));
+
+	m_highlightedObject.index = 0;
+	m_highlightedObject.generation = 0;
+
+	XMStoreFloat4x4(&m_constantBufferData.model, XMMatrixIdentity());
+	XMStoreFloat4x4(&m_constantBufferData.view, XMMatrixIdentity());
+	XMStoreFloat4x4(&m_constantBufferData.projection, XMMatrixIdentity());
+	XMStoreFloat4x4(&m_orientationTransform, XMMatrixIdentity());
+
+	m_cullingStatistics.testedCount = 0;
+	m_cullingStatistics.visibleCount = 0;
+	m_cullingStatistics.culledCount = 0;
+
+	m_lodStatistics.fullDetailTriangles = 0;
+	m_lodStatistics.submittedTriangles = 0;
+	m_lodStatistics.fadingObjects = 0;
+
+	m_instances.resize(m_entities.GetCount());
+	m_objectBoxes.resize(m_entities.GetCount());
+	UpdateObjects(0, m_entities.GetCount(), 0.0f, EntityStore::NoIndex);
+
+	m_objectHierarchy.Build(m_objectBoxes, nullptr);
+	m_builtSahCost = m_objectHierarchy.ComputeSahCost();
+}
+
+void PolygonScene::SetJobSystem(JobSystem* jobSystem)
+{
+	m_jobSystem = jobSystem;
+}
+
+void PolygonScene::CreateDeviceResources(RenderDevice& device)
+{
+	for (uint32_t mesh = 0; mesh < m_meshes.size(); ++mesh)
+	{
+		CreateLodMeshes(device, mesh);
+	}
+}
+
+// lods の 1 番以降の段を頂点を詰めたメッシュに分け、mesh は 0 番の段だけにします。
+void PolygonScene::SplitLods(MeshData& mesh, const std::vector<MeshFileLod>& lods, MeshLodChain& chain)
+{
+	chain.levels.clear();
+	chain.errors.clear();
+	chain.triangleCounts.clear();
+	if (lods.empty())
+	{
+		chain.errors.push_back(0.0f);
+		chain.triangleCounts.push_back(static_cast<uint32_t>(mesh.indices.size() / 3));
+		return;
+	}
+
+	chain.errors.push_back(lods[0].maxError);
+	chain.triangleCounts.push_back(lods[0].indexCount / 3);
+	for (size_t i = 1; i < lods.size(); ++i)
+	{
+		if (lods[i].indexCount == 0)
+		{
+			continue;
+		}
+		chain.levels.push_back(MeshData());
+		MeshSimplifier::ExtractLod(mesh, lods[i], chain.levels.back());
+		chain.errors.push_back(lods[i].maxError);
+		chain.triangleCounts.push_back(lods[i].indexCount / 3);
+	}
+
+	// 0 番が先頭にあれば (BuildLods の結果はそうなります)、頂点の順を変えずに後ろの段を切り捨てるだけで済みます。
+	if (lods[0].firstIndex == 0)
+	{
+		mesh.indices.resize(lods[0].indexCount);
+	}
+	else
+	{
+		MeshData level;
+		MeshSimplifier::ExtractLod(mesh, lods[0], level);
+		mesh.vertices.swap(level.vertices);
+		mesh.indices.swap(level.indices);
+	}
+}
+
+void PolygonScene::CreateLodMeshes(RenderDevice& device, uint32_t mesh)
+{
+	MeshLodChain& chain = m_meshLods[mesh];
+	chain.meshIds.clear();
+	chain.meshIds.push_back(device.CreateMesh(m_meshes[mesh]));
+	for (const MeshData& level : chain.levels)
+	{
+		chain.meshIds.push_back(device.CreateMesh(level));
+	}
+}
+
+uint32_t PolygonScene::AddMesh(RenderDevice& device, MeshData& mesh, const MeshBounds& bounds, const std::vector<MeshFileLod>& lods)
+{
+	const uint32_t meshIndex = static_cast<uint32_t>(m_meshes.size());
+	m_meshes.push_back(MeshData());
+	MeshData& added = m_meshes.back();
+	added.vertices.swap(mesh.vertices);
+	added.indices.swap(mesh.indices);
+	added.format = mesh.format;
+	m_meshLods.push_back(MeshLodChain());
+	SplitLods(added, lods, m_meshLods.back());
+
+	MeshOptimizationReport report;
+	report.before = MeshOptimizer::AnalyzeVertexCache(
+		added.indices.empty() ? nullptr : &added.indices[0],
+		static_cast<uint32_t>(added.indices.size()),
+		static_cast<uint32_t>(added.vertices.size()),
+		MeshOptimizer::DefaultCacheSize
+		);
+	report.after = report.before;
+	report.clusterCount = 0;
+	m_optimizationReports.push_back(report);
+
+	m_meshBounds.push_back(bounds);
+	m_meshHierarchies.push_back(TriangleMeshBvh());
+	m_meshHierarchies.back().Build(added, m_jobSystem);
+	CreateLodMeshes(device, meshIndex);
+	return meshIndex;
+}
+
+EntityHandle PolygonScene::AddObject(uint32_t mesh, const XMFLOAT4X4& localTransform, const XMFLOAT4& color)
+{
+	// Update は m_meshBounds をメッシュの番号で引くので、まだ追加していないメッシュは受け付けません。
+	if (mesh >= m_meshes.size())
+	{
+		EntityHandle invalid;
+		invalid.index = 0;
+		invalid.generation = 0;
+		return invalid;
+	}
+
+	const EntityHandle object = m_entities.Create(mesh, localTransform, color);
+
+	// インスタンス データと境界は次の Update で計算し、BVH もそのときに作り直します。
+	m_instances.resize(m_entities.GetCount());
+	m_objectBoxes.resize(m_entities.GetCount());
+	m_objectsChanged = true;
+	return object;
+}
+
+bool PolygonScene::RemoveObject(EntityHandle object)
+{
+	const uint32_t index = m_entities.GetIndex(object);
+	if (index == EntityStore::NoIndex)
+	{
+		return false;
+	}
+	if (m_entities.GetAngularVelocities()[index] != 0.0f)
+	{
+		--m_animatedObjectCount;
+	}
+	m_entities.Destroy(object);
+
+	// 末尾のオブジェクトが削除した位置に移るので、インスタンス データと BVH は次の Update で作り直します。
+	m_instances.resize(m_entities.GetCount());
+	m_objectBoxes.resize(m_entities.GetCount());
+	m_objectsChanged = true;
+	return true;
+}
+
+bool PolygonScene::SetAngularVelocity(EntityHandle object, float radiansPerSecond)
+{
+	const uint32_t index = m_entities.GetIndex(object);
+	if (index == EntityStore::NoIndex)
+	{
+		return false;
+	}
+	float& angularVelocity = m_entities.GetAngularVelocities()[index];
+	if (angularVelocity == 0.0f && radiansPerSecond != 0.0f)
+	{
+		++m_animatedObjectCount;
+	}
+	else if (angularVelocity != 0.0f && radiansPerSecond == 0.0f)
+	{
+		--m_animatedObjectCount;
+	}
+	angularVelocity = radiansPerSecond;
+	return true;
+}
+
+void PolygonScene::SetSceneRotationSpeed(float radiansPerSecond)
+{
+	m_sceneRotationSpeed = radiansPerSecond;
+}
+
+void PolygonScene::SetProjection(float aspectRatio, const XMFLOAT4X4& orientationTransform)
+{
+	float fovAngleY = 70.0f * XM_PI / 180.0f;
+	m_orientationTransform = orientationTransform;
+
+	// orientationTransform マトリックスは、ここで事後乗算されます。
+	// それにより、シーンの方向を表示方向と正しく一致させます。
+	XMStoreFloat4x4(
+		&m_constantBufferData.projection,
+		XMMatrixTranspose(
+			XMMatrixMultiply(
+				XMMatrixPerspectiveFovRH(
+					fovAngleY,
+					aspectRatio,
+					NearPlaneDistance,
+					100.0f
+					),
+				XMLoadFloat4x4(&orientationTransform)
+				)
+			)
+		);
+}
+
+void PolygonScene::Update(float timeTotal, float timeDelta)
+{
+	(void) timeDelta; // 未使用のパラメーター。
+	m_time = timeTotal;
+
+	XMVECTOR eye = XMVectorSet(0.0f, 0.7f, 1.5f, 0.0f);
+	XMVECTOR at = XMVectorSet(0.0f, -0.1f, 0.0f, 0.0f);
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	XMStoreFloat4x4(&m_constantBufferData.view, XMMatrixTranspose(XMMatrixLookAtRH(eye, at, up)));
+	XMStoreFloat4x4(&m_constantBufferData.model, XMMatrixTranspose(XMMatrixRotationY(timeTotal * m_sceneRotationSpeed)));
+
+	// オブジェクトごとの計算は互いに独立なので、範囲に分けて並列に処理します。
+	// 各範囲は自分の m_instances の要素だけを書き込むので、結果はスレッド数によりません。
+	const uint32_t objectCount = m_entities.GetCount();
+	const uint32_t highlightedIndex = m_entities.GetIndex(m_highlightedObject);
+	if (m_jobSystem != nullptr)
+	{
+		m_jobSystem->ParallelFor(objectCount, 256, [this, timeTotal, highlightedIndex] (uint32_t begin, uint32_t end) {
+			UpdateObjects(begin, end, timeTotal, highlightedIndex);
+		});
+	}
+	else
+	{
+		UpdateObjects(0, objectCount, timeTotal, highlightedIndex);
+	}
+
+	UpdateHierarchy();
+}
+
+// コンポーネントの配列を添字の順に読み、同じ添字のインスタンス データと境界に書き込みます。
+void PolygonScene::UpdateObjects(uint32_t begin, uint32_t end, float timeTotal, uint32_t highlightedIndex)
+{
+	XMMATRIX rotation = XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferData.model));
+	const XMFLOAT4X4* localTransforms = m_entities.GetLocalTransforms();
+	const float* angularVelocities = m_entities.GetAngularVelocities();
+	const uint32_t* meshes = m_entities.GetMeshes();
+	const XMFLOAT4* colors = m_entities.GetColors();
+	BoundingSphereArray& spheres = m_entities.GetBounds();
+
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		XMMATRIX local = XMMatrixMultiply(
+			XMMatrixRotationZ(angularVelocities[i] * timeTotal),
+			XMLoadFloat4x4(&localTransforms[i])
+			);
+
+		XMStoreFloat4x4(&m_instances[i].model, XMMatrixMultiply(local, rotation));
+		m_instances[i].color = i == highlightedIndex ? HighlightColor : colors[i];
+
+		const MeshBounds& bounds = m_meshBounds[meshes[i]];
+		const XMFLOAT4X4& world = m_instances[i].model;
+		spheres.Store(i, bounds, world);
+
+		// AABB は中心を変換し、半径は行列の各成分の絶対値で広げます。
+		const float extentX = std::fabs(world._11) * bounds.extents.x + std::fabs(world._21) * bounds.extents.y + std::fabs(world._31) * bounds.extents.z;
+		const float extentY = std::fabs(world._12) * bounds.extents.x + std::fabs(world._22) * bounds.extents.y + std::fabs(world._32) * bounds.extents.z;
+		const float extentZ = std::fabs(world._13) * bounds.extents.x + std::fabs(world._23) * bounds.extents.y + std::fabs(world._33) * bounds.extents.z;
+		BoundingBox& box = m_objectBoxes[i];
+		box.minimum = XMFLOAT3(spheres.x[i] - extentX, spheres.y[i] - extentY, spheres.z[i] - extentZ);
+		box.maximum = XMFLOAT3(spheres.x[i] + extentX, spheres.y[i] + extentY, spheres.z[i] + extentZ);
+	}
+}
+
+/**
+ * 動いたオブジェクトに合わせて BVH の境界を更新します。
+ * Refit は木の形を変えないので、オブジェクトの位置が大きく入れ替わると判定の効率が落ちます。
+ * SAH コストが構築したときの RebuildSahRatio 倍を超えたら、BVH を作り直します。
+ * オブジェクトを追加または削除したときも作り直します。
+ */
+void PolygonScene::UpdateHierarchy()
+{
+	if (!m_objectsChanged)
+	{
+		m_objectHierarchy.Refit(m_objectBoxes);
+	}
+	if (m_objectsChanged || m_objectHierarchy.ComputeSahCost() > m_builtSahCost * RebuildSahRatio)
+	{
+		m_objectsChanged = false;
+		m_objectHierarchy.Build(m_objectBoxes, m_jobSystem);
+		m_builtSahCost = m_objectHierarchy.ComputeSahCost();
+	}
+}
+
+void PolygonScene::SetCullingMode(SceneCullingMode mode)
+{
+	m_cullingMode = mode;
+}
+
+void PolygonScene::SetDirtyRectTracker(DirtyRectTracker* tracker)
+{
+	m_dirtyRectTracker = tracker;
+}
+
+void PolygonScene::SetLodSettings(const LodSettings& settings)
+{
+	m_lodSettings = settings;
+}
+
+void PolygonScene::SetHighlightedObject(EntityHandle object)
+{
+	m_highlightedObject = object;
+}
+
+PickResult PolygonScene::Pick(float x, float y) const
+{
+	PickResult result;
+	result.object.index = 0;
+	result.object.generation = 0;
+	result.triangle = 0;
+	result.distance = 1.0f;
+
+	// 射影行列には表示方向の変換が含まれているので、ポインターの位置も同じ変換で回してから、
+	// ビュー、射影、表示方向をまとめた行列の逆行列でワールド空間に戻します。
+	XMMATRIX orientation = XMLoadFloat4x4(&m_orientationTransform);
+	XMMATRIX viewProjection = XMMatrixMultiply(
+		XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferData.view)),
+		XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferData.projection))
+		);
+	XMMATRIX inverseViewProjection = XMMatrixInverse(nullptr, viewProjection);
+
+	XMFLOAT4 nearPoint;
+	XMFLOAT4 farPoint;
+	XMStoreFloat4(&nearPoint, XMVector4Transform(XMVector4Transform(XMVectorSet(x, y, 0.0f, 1.0f), orientation), inverseViewProjection));
+	XMStoreFloat4(&farPoint, XMVector4Transform(XMVector4Transform(XMVectorSet(x, y, 1.0f, 1.0f), orientation), inverseViewProjection));
+
+	// 方向を正規化しないので、距離は手前のクリップ面で 0、奥のクリップ面で 1 になります。
+	PickRay ray;
+	ray.origin = XMFLOAT3(nearPoint.x / nearPoint.w, nearPoint.y / nearPoint.w, nearPoint.z / nearPoint.w);
+	ray.direction = XMFLOAT3(
+		farPoint.x / farPoint.w - ray.origin.x,
+		farPoint.y / farPoint.w - ray.origin.y,
+		farPoint.z / farPoint.w - ray.origin.z
+		);
+
+	// オブジェクトの BVH で候補を絞り、各オブジェクトのローカル空間に移したレイでメッシュの BVH を調べます。
+	// アフィン変換ではレイの t が変わらないので、距離はオブジェクトをまたいで比べられます。
+	m_objectHierarchy.Raycast(ray, result.distance, [&] (const uint32_t* objects, uint32_t count, float& maxDistance) {
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint32_t object = objects[i];
+			XMMATRIX worldToLocal = XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_instances[object].model));
+
+			PickRay localRay;
+			XMStoreFloat3(&localRay.origin, XMVector3TransformCoord(XMLoadFloat3(&ray.origin), worldToLocal));
+			XMStoreFloat3(&localRay.direction, XMVector3TransformNormal(XMLoadFloat3(&ray.direction), worldToLocal));
+
+			uint32_t triangle;
+			if (m_meshHierarchies[m_entities.GetMeshes()[object]].Raycast(localRay, maxDistance, triangle))
+			{
+				result.object = m_entities.GetHandle(object);
+				result.triangle = triangle;
+			}
+		}
+	});
+	return result;
+}
+
+void PolygonScene::CaptureSnapshot(SceneSnapshot& snapshot) const
+{
+	snapshot.model = m_constantBufferData.model;
+	snapshot.view = m_constantBufferData.view;
+	snapshot.instances = m_instances;
+	m_entities.CopyHandles(snapshot.entities);
+	m_entities.CopyMeshes(snapshot.meshes);
+	snapshot.bounds = m_entities.GetBounds();
+	snapshot.hierarchy = m_objectHierarchy;
+	snapshot.time = m_time;
+}
+
+void PolygonScene::Record(const SceneSnapshot& snapshot, DrawQueue& drawQueue, TwoSidedMode twoSidedMode)
+{
+	// インスタンスの行列にはシーン全体の回転が含まれているので、視錐台は view と projection だけから求めます。
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(
+		&viewProjection,
+		XMMatrixMultiply(
+			XMMatrixTranspose(XMLoadFloat4x4(&snapshot.view)),
+			XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferData.projection))
+			)
+		);
+
+	const Frustum frustum = FrustumCulling::ExtractFrustum(viewProjection);
+	const bool trackDirtyRects = m_dirtyRectTracker != nullptr && m_dirtyRectTracker->BeginFrame(viewProjection);
+	const uint32_t objectCount = snapshot.bounds.GetCount();
+	m_visibleIndices.resize(objectCount);
+	const uint32_t visibleCount = m_cullingMode == SceneCullingMode::Hierarchical
+		? CullHierarchical(snapshot, frustum)
+		: FrustumCulling::CullSpheres(frustum, snapshot.bounds, objectCount > 0 ? &m_visibleIndices[0] : nullptr);
+
+	m_cullingStatistics.testedCount = objectCount;
+	m_cullingStatistics.visibleCount = visibleCount;
+	m_cullingStatistics.culledCount = objectCount - visibleCount;
+
+	// 詳細度は、各段の誤差を境界球の手前の面までのビュー空間の距離で画面上のピクセル数に換算して選びます。
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferData.projection)));
+	const float pixelsPerUnit = LodSelection::ComputePixelsPerUnit(projection, m_lodSettings.viewportWidth, m_lodSettings.viewportHeight);
+	const XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&snapshot.view));
+
+	++m_recordedFrame;
+	m_lodStatistics.fullDetailTriangles = 0;
+	m_lodStatistics.submittedTriangles = 0;
+	m_lodStatistics.fadingObjects = 0;
+
+	for (uint32_t v = 0; v < visibleCount; ++v)
+	{
+		const uint32_t i = m_visibleIndices[v];
+		const uint32_t mesh = snapshot.meshes[i];
+		const MeshLodChain& chain = m_meshLods[mesh];
+		const uint32_t levelCount = static_cast<uint32_t>(chain.meshIds.size());
+
+		float errorScale = 0.0f;
+		if (levelCount > 1)
+		{
+			const XMVECTOR center = XMVector3TransformCoord(XMVectorSet(snapshot.bounds.x[i], snapshot.bounds.y[i], snapshot.bounds.z[i], 1.0f), view);
+			const float distance = std::max(-XMVectorGetZ(center) - snapshot.bounds.radius[i], NearPlaneDistance);
+			const float meshRadius = m_meshBounds[mesh].radius;
+			const float objectScale = meshRadius > 0.0f ? snapshot.bounds.radius[i] / meshRadius : 1.0f;
+			errorScale = pixelsPerUnit * objectScale / distance;
+		}
+
+		// 詳細度の状態はスロットごとに持ち、削除して使い回されたスロットは新しいエンティティとして初めからにします。
+		// 削除で dense 配列の順が変わっても、状態は同じエンティティに付いたままになります。
+		const EntityHandle entity = snapshot.entities[i];
+		if (entity.index >= m_lodStates.size())
+		{
+			m_lodStates.resize(entity.index + 1);
+			m_lodGenerations.resize(entity.index + 1, 0);
+		}
+		LodState& state = m_lodStates[entity.index];
+		if (m_lodGenerations[entity.index] != entity.generation)
+		{
+			m_lodGenerations[entity.index] = entity.generation;
+			state = LodState();
+		}
+		const uint32_t level = LodSelection::SelectLevel(&chain.errors[0], levelCount, std::min(state.level, levelCount - 1), errorScale, m_lodSettings);
+		LodSelection::Advance(state, level, m_recordedFrame, snapshot.time, m_lodSettings);
+
+		// インスタンスの色の w はフェード値です。フェード中は前後の段を両方描画し、互いに補い合うピクセルだけを残します。
+		InstanceData instance = snapshot.instances[i];
+		instance.color.w = 1.0f;
+		if (state.fading)
+		{
+			const float progress = LodSelection::GetFadeProgress(state, snapshot.time, m_lodSettings);
+			instance.color.w = progress - 1.0f;
+			SubmitObject(drawQueue, chain.meshIds[state.previousLevel], instance, twoSidedMode);
+			m_lodStatistics.submittedTriangles += chain.triangleCounts[state.previousLevel];
+			++m_lodStatistics.fadingObjects;
+			instance.color.w = progress;
+		}
+		SubmitObject(drawQueue, chain.meshIds[state.level], instance, twoSidedMode);
+		m_lodStatistics.submittedTriangles += chain.triangleCounts[state.level];
+		m_lodStatistics.fullDetailTriangles += chain.triangleCounts[0];
+
+		// フェード値も含めて、描画した内容が前のフレームと変わったかを調べます。
+		if (trackDirtyRects)
+		{
+			const uint32_t fadingMeshId = state.fading ? chain.meshIds[state.previousLevel] : DirtyRectTracker::NoMesh;
+			m_dirtyRectTracker->AddObject(
+				entity,
+				DirtyRectTracker::ComputeSignature(instance, chain.meshIds[state.level], fadingMeshId),
+				snapshot.bounds.x[i],
+				snapshot.bounds.y[i],
+				snapshot.bounds.z[i],
+				snapshot.bounds.radius[i]
+				);
+		}
+	}
+
+	if (m_dirtyRectTracker != nullptr)
+	{
+		m_dirtyRectTracker->EndFrame();
+	}
+}
+
+// BVH で視錐台と交わるオブジェクトに印を付け、Flat と同じく添字の小さい順に m_visibleIndices に詰めます。
+// 部分木が視錐台の内側にあれば、そのオブジェクトは個別に判定しません。
+uint32_t PolygonScene::CullHierarchical(const SceneSnapshot& snapshot, const Frustum& frustum)
+{
+	const BoundingSphereArray& bounds = snapshot.bounds;
+	const uint32_t objectCount = bounds.GetCount();
+	m_visibleFlags.assign(objectCount, 0);
+	snapshot.hierarchy.CullFrustum(frustum, [&] (const uint32_t* objects, uint32_t count, bool fullyInside) {
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint32_t object = objects[i];
+			const bool visible = fullyInside
+				|| FrustumCulling::IsSphereVisible(frustum, bounds.x[object], bounds.y[object], bounds.z[object], bounds.radius[object]);
+			m_visibleFlags[object] = visible ? 1 : 0;
+		}
+	});
+
+	uint32_t visibleCount = 0;
+	for (uint32_t object = 0; object < objectCount; ++object)
+	{
+		m_visibleIndices[visibleCount] = object;
+		visibleCount += m_visibleFlags[object];
+	}
+	return visibleCount;
+}
+
+ModelViewProjectionConstantBuffer PolygonScene::GetConstants(const SceneSnapshot& snapshot) const
+{
+	ModelViewProjectionConstantBuffer constants;
+	constants.model = snapshot.model;
+	constants.view = snapshot.view;
+	constants.projection = m_constantBufferData.projection;
+	return constants;
+}
@@ -0,0 +1,176 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ShaderStructures.h"
+#include "PipelineStates.h"
+#include "RenderDevice.h"
+#include "DrawQueue.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "LodSelection.h"
+#include "EntityStore.h"
+#include "DirtyRectTracker.h"
+#include "JobSystem.h"
+#include "FrustumCulling.h"
+#include "BoundingVolumeHierarchy.h"
+
+// 描画の前に視錐台の外側のオブジェクトを除く方法。
+enum class SceneCullingMode
+{
+	Flat,			// すべてのオブジェクトの境界球を SIMD でまとめて判定します
+	Hierarchical	// オブジェクトの BVH をたどり、視錐台の外側や内側にある部分木をまとめて判定します
+};
+
+// ポインターで選んだオブジェクト。
+struct PickResult
+{
+	EntityHandle object;	// 見つからなければ無効なハンドル
+	uint32_t triangle;	// オブジェクトのメッシュの三角形の番号
+	float distance;		// 手前のクリップ面を 0、奥のクリップ面を 1 とする距離
+};
+
+// 描画に必要なシーンの状態のコピー。
+// 更新と描画を別のスレッドで行うときに、描画側はこのコピーだけを読み取ります。
+struct SceneSnapshot
+{
+	DirectX::XMFLOAT4X4 model;
+	DirectX::XMFLOAT4X4 view;
+	std::vector<InstanceData> instances;
+	std::vector<EntityHandle> entities;	// instances と同じ順のエンティティ
+	std::vector<uint32_t> meshes;		// instances と同じ順のメッシュの番号
+	BoundingSphereArray bounds;	// instances と同じ順のワールド空間の境界球
+	BoundingVolumeHierarchy hierarchy;	// bounds と同じ順のオブジェクトの BVH
+	float time;		// Update の timeTotal。LOD のフェードの進み具合に使います
+};
+
+// 描画するポリゴンとその動きを保持するシーン。
+// バックエンドに依存しないので、D3D11 と CPU のどちらのデバイスでも同じシーンを描画できます。
+class PolygonScene
+{
+public:
+	PolygonScene();
+
+	// Update でオブジェクトごとの変換を並列に計算します。nullptr なら直列に計算します。
+	void SetJobSystem(JobSystem* jobSystem);
+
+	// シーンのメッシュをデバイス上に作成します。デバイスを作り直したときにも呼び出します。
+	void CreateDeviceResources(RenderDevice& device);
+
+	// ファイルから読み込んだメッシュを追加し、デバイス上にも作成します。mesh の内容は移すので空になります。
+	// lods は MeshFile の LOD 表で、段ごとに別のメッシュとして作成します。空ならメッシュ全体を 1 段とします。
+	// メッシュは書き出すときに最適化してあるものとして、並べ替えずにそのまま使います。追加したメッシュの番号を返します。
+	// オブジェクトの追加と同じく、Update や Record と並行して呼び出さないでください。
+	uint32_t AddMesh(RenderDevice& device, MeshData& mesh, const MeshBounds& bounds, const std::vector<MeshFileLod>& lods);
+
+	// mesh 番のメッシュを描画するオブジェクトを追加し、そのハンドルを返します。次の Update から描画されます。
+	// mesh がまだ追加していないメッシュの番号なら、何もせずに無効なハンドルを返します。
+	EntityHandle AddObject(uint32_t mesh, const DirectX::XMFLOAT4X4& localTransform, const DirectX::XMFLOAT4& color);
+
+	// オブジェクトを削除します。次の Update から描画されなくなります。ハンドルが無効なら false を返します。
+	bool RemoveObject(EntityHandle object);
+
+	// オブジェクトの数。
+	uint32_t GetObjectCount() const { return m_entities.GetCount(); }
+
+	// オブジェクトをローカル座標の z 軸まわりに回転させる速さ (ラジアン/秒) を設定します。既定値は 0 です。
+	// ハンドルが無効なら false を返します。
+	bool SetAngularVelocity(EntityHandle object, float radiansPerSecond);
+
+	// シーン全体を y 軸まわりに回転させる速さ (ラジアン/秒) を設定します。既定値は π/4 です。
+	// 0 にすると、動かしたオブジェクトのほかは画面が変わらなくなります。
+	void SetSceneRotationSpeed(float radiansPerSecond);
+
+	// 時間とともに画面が変わるかどうか。シーン全体か、いずれかのオブジェクトが回転していれば true です。
+	bool IsAnimated() const { return m_sceneRotationSpeed != 0.0f || m_animatedObjectCount > 0; }
+
+	// 射影行列を設定します。orientationTransform は表示方向のための変換です。
+	// 射影行列は描画するスレッドが持つ状態で、スナップショットには含めません。
+	void SetProjection(float aspectRatio, const DirectX::XMFLOAT4X4& orientationTransform);
+
+	// カメラと全体の回転を更新し、各オブジェクトのインスタンス データを計算します。
+	void Update(float timeTotal, float timeDelta);
+
+	// 描画の前のカリングの方法を切り替えます。既定値は SceneCullingMode::Flat です。
+	void SetCullingMode(SceneCullingMode mode);
+
+	// Record で描画するオブジェクトを tracker に渡し、前のフレームから変わった範囲を求めさせます。nullptr (既定値) なら求めません。
+	// tracker は描画するスレッドの状態なので、Record と同じスレッドで使ってください。
+	void SetDirtyRectTracker(DirtyRectTracker* tracker);
+
+	// Record で詳細度を選ぶための設定です。描画先の大きさが変わったときにも呼び出してください。
+	// フェードはディザで前後の段を描き分けるので、それをサポートしないパイプラインでは fadeDuration を 0 にしてください。
+	void SetLodSettings(const LodSettings& settings);
+
+	// 表示方向で見たウィンドウの正規化座標 (-1 ～ 1、y は上向き) を通るレイで、最も手前の三角形を探します。
+	// 最後の Update の結果と現在の射影行列を使うので、Update や Record と並行して呼び出さないでください。
+	PickResult Pick(float x, float y) const;
+
+	// object を強調した色で描画します。無効なハンドルなら強調しません。次の Update から反映されます。
+	void SetHighlightedObject(EntityHandle object);
+
+	// Update の結果を snapshot にコピーします。
+	void CaptureSnapshot(SceneSnapshot& snapshot) const;
+
+	// スナップショットのオブジェクトのうち、視錐台の内側にあるものを描画キューに積みます。
+	// オブジェクトごとに、画面上の誤差が LodSettings::pixelError 以下になる最も粗い詳細度の段を選びます。
+	// 射影行列と詳細度の状態は描画するスレッドの状態なので、Update と並行して呼び出せます。
+	void Record(const SceneSnapshot& snapshot, DrawQueue& drawQueue, TwoSidedMode twoSidedMode);
+
+	// スナップショットの model と view に、現在の射影行列を組み合わせた定数を返します。
+	ModelViewProjectionConstantBuffer GetConstants(const SceneSnapshot& snapshot) const;
+
+	// メッシュごとの最適化の前後の頂点キャッシュの効率。
+	const std::vector<MeshOptimizationReport>& GetOptimizationReports() const { return m_optimizationReports; }
+
+	// 直前の Record でカリングしたオブジェクトと描画したオブジェクトの数。
+	const CullingStatistics& GetCullingStatistics() const { return m_cullingStatistics; }
+
+	// 直前の Record で描画した三角形の数と、すべて 0 番の段で描画したときの数。
+	const LodStatistics& GetLodStatistics() const { return m_lodStatistics; }
+
+private:
+	// メッシュの詳細度の段。0 番は m_meshes のメッシュそのもので、1 番以降は簡略化して頂点を詰めたメッシュです。
+	struct MeshLodChain
+	{
+		std::vector<MeshData> levels;			// 1 番以降の段
+		std::vector<float> errors;				// 0 番からの各段の誤差 (ローカル空間の距離)
+		std::vector<uint32_t> triangleCounts;
+		std::vector<uint32_t> meshIds;			// 各段のデバイス上のメッシュ
+	};
+
+	static void SplitLods(MeshData& mesh, const std::vector<MeshFileLod>& lods, MeshLodChain& chain);
+	void CreateLodMeshes(RenderDevice& device, uint32_t mesh);
+	void UpdateObjects(uint32_t begin, uint32_t end, float timeTotal, uint32_t highlightedIndex);
+	void UpdateHierarchy();
+	uint32_t CullHierarchical(const SceneSnapshot& snapshot, const Frustum& frustum);
+
+	std::vector<MeshData> m_meshes;
+	std::vector<MeshOptimizationReport> m_optimizationReports;
+	std::vector<MeshBounds> m_meshBounds;	// m_meshes と同じ順のローカル空間の境界
+	std::vector<TriangleMeshBvh> m_meshHierarchies;	// m_meshes と同じ順の三角形の BVH
+	std::vector<MeshLodChain> m_meshLods;	// m_meshes と同じ順の詳細度の段
+	EntityStore m_entities;					// オブジェクトのコンポーネント。ワールド空間の境界球もここに持ちます
+	std::vector<InstanceData> m_instances;	// m_entities と同じ順のインスタンス データ
+	std::vector<BoundingBox> m_objectBoxes;	// m_entities と同じ順のワールド空間の AABB
+	BoundingVolumeHierarchy m_objectHierarchy;
+	float m_builtSahCost;					// 最後に m_objectHierarchy を構築したときの SAH コスト
+	bool m_objectsChanged;					// m_objectHierarchy を作ったあとにオブジェクトを追加または削除したかどうか
+	EntityHandle m_highlightedObject;
+	SceneCullingMode m_cullingMode;
+	std::vector<uint8_t> m_visibleFlags;
+	std::vector<uint32_t> m_visibleIndices;
+	CullingStatistics m_cullingStatistics;
+	LodSettings m_lodSettings;
+	std::vector<LodState> m_lodStates;		// エンティティのスロットごとの、描画するスレッドの詳細度の状態
+	std::vector<uint32_t> m_lodGenerations;	// m_lodStates の各要素がどの世代のエンティティのものか
+	LodStatistics m_lodStatistics;
+	DirtyRectTracker* m_dirtyRectTracker;
+	uint32_t m_recordedFrame;
+	float m_time;
+	float m_sceneRotationSpeed;
+	uint32_t m_animatedObjectCount;			// 回転の速さが 0 でないオブジェクトの数
+	JobSystem* m_jobSystem;
+	ModelViewProjectionConstantBuffer m_constantBufferData;
+	DirectX::XMFLOAT4X4 m_orientationTransform;
+};
@@ -0,0 +1,597 @@
+﻿#include "PolygonTriangulator.h"
+#include <algorithm>
+#include <atomic>
+
+using namespace DirectX;
+
+PolygonTriangulator::PolygonTriangulator()
+{
+}
+
+bool PolygonTriangulator::Triangulate(const PolygonData& polygon, std::vector<uint32_t>& indices)
+{
+	m_x.clear();
+	m_y.clear();
+	m_sources.clear();
+	m_vertices.clear();
+
+	// 内部が常に辺の左側になるように、外周は反時計回り、穴は時計回りでたどります。
+	if (!AddRing(polygon.outer, 0, true))
+	{
+		return false;
+	}
+	uint32_t sourceOffset = static_cast<uint32_t>(polygon.outer.size());
+	for (const std::vector<XMFLOAT2>& hole : polygon.holes)
+	{
+		if (!AddRing(hole, sourceOffset, false))
+		{
+			return false;
+		}
+		sourceOffset += static_cast<uint32_t>(hole.size());
+	}
+
+	if (!PartitionMonotone())
+	{
+		return false;
+	}
+
+	// 対角線で分けられた輪を 1 つずつたどり、単調多角形として三角形に分割します。
+	m_visited.assign(m_vertices.size(), false);
+	for (uint32_t i = 0; i < m_vertices.size(); ++i)
+	{
+		if (!m_visited[i])
+		{
+			TriangulateMonotone(i, indices);
+		}
+	}
+	return true;
+}
+
+uint32_t PolygonTriangulator::TriangulateBatch(
+	const std::vector<PolygonData>& polygons,
+	std::vector<std::vector<uint32_t>>& results,
+	JobSystem* jobSystem
+	)
+{
+	const uint32_t polygonCount = static_cast<uint32_t>(polygons.size());
+	results.resize(polygonCount);
+
+	// 作業用のバッファーは範囲ごとの PolygonTriangulator で再利用します。
+	// 多角形の大きさはまちまちなので、範囲を小さくして盗み合いで負荷を分散します。
+	std::atomic<uint32_t> succeeded(0);
+	auto triangulate = [&] (uint32_t begin, uint32_t end) {
+		PolygonTriangulator triangulator;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			results[i].clear();
+			if (triangulator.Triangulate(polygons[i], results[i]))
+			{
+				succeeded.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				results[i].clear();
+			}
+		}
+	};
+
+	if (jobSystem != nullptr)
+	{
+		jobSystem->ParallelFor(polygonCount, 4, triangulate);
+	}
+	else
+	{
+		triangulate(0, polygonCount);
+	}
+	return succeeded.load(std::memory_order_relaxed);
+}
+
+void PolygonTriangulator::CreateMeshData(
+	const PolygonData& polygon,
+	const std::vector<uint32_t>& indices,
+	const XMFLOAT3& color,
+	MeshData& mesh
+	)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	size_t vertexCount = polygon.outer.size();
+	for (const std::vector<XMFLOAT2>& hole : polygon.holes)
+	{
+		vertexCount += hole.size();
+	}
+
+	mesh.vertices.reserve(vertexCount);
+	VertexPositionColor vertex;
+	vertex.color = color;
+	for (const XMFLOAT2& point : polygon.outer)
+	{
+		vertex.pos = XMFLOAT3(point.x, point.y, 0.0f);
+		mesh.vertices.push_back(vertex);
+	}
+	for (const std::vector<XMFLOAT2>& hole : polygon.holes)
+	{
+		for (const XMFLOAT2& point : hole)
+		{
+			vertex.pos = XMFLOAT3(point.x, point.y, 0.0f);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+
+	mesh.indices = indices;
+}
+
+// 走査線は上から下へ進みます。y が同じ点は x が小さい方を上とみなし、水平な辺がないものとして扱います。
+bool PolygonTriangulator::IsAbove(uint32_t a, uint32_t b) const
+{
+	if (m_y[a] != m_y[b])
+	{
+		return m_y[a] > m_y[b];
+	}
+	if (m_x[a] != m_x[b])
+	{
+		return m_x[a] < m_x[b];
+	}
+	return a < b;
+}
+
+// a → b → c が左回りなら正、右回りなら負、一直線上なら 0 を返します。
+double PolygonTriangulator::Orient(uint32_t a, uint32_t b, uint32_t c) const
+{
+	return (m_x[b] - m_x[a]) * (m_y[c] - m_y[a]) - (m_y[b] - m_y[a]) * (m_x[c] - m_x[a]);
+}
+
+// 輪の頂点を追加します。連続する同じ座標の点は 1 つにまとめます。
+bool PolygonTriangulator::AddRing(const std::vector<XMFLOAT2>& ring, uint32_t sourceOffset, bool counterClockwise)
+{
+	const uint32_t first = static_cast<uint32_t>(m_x.size());
+	for (uint32_t i = 0; i < ring.size(); ++i)
+	{
+		const XMFLOAT2& p = ring[i];
+		const uint32_t last = static_cast<uint32_t>(m_x.size()) - 1;
+		if (m_x.size() > first && m_x[last] == p.x && m_y[last] == p.y)
+		{
+			continue;
+		}
+		m_x.push_back(p.x);
+		m_y.push_back(p.y);
+		m_sources.push_back(sourceOffset + i);
+	}
+	while (m_x.size() > first + 1 && m_x.back() == m_x[first] && m_y.back() == m_y[first])
+	{
+		m_x.pop_back();
+		m_y.pop_back();
+		m_sources.pop_back();
+	}
+
+	const uint32_t count = static_cast<uint32_t>(m_x.size()) - first;
+	if (count < 3)
+	{
+		return false;
+	}
+
+	double area = 0.0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t p = first + i;
+		const uint32_t q = first + (i + 1) % count;
+		area += m_x[p] * m_y[q] - m_x[q] * m_y[p];
+	}
+
+	// 向きが逆なら、点の番号はそのままでたどる順番だけを逆にします。
+	const bool reverse = (area > 0.0) != counterClockwise;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		MonotoneVertex vertex;
+		vertex.point = first + i;
+		vertex.prev = first + (reverse ? (i + 1) % count : (i + count - 1) % count);
+		vertex.next = first + (reverse ? (i + count - 1) % count : (i + 1) % count);
+		m_vertices.push_back(vertex);
+	}
+	return true;
+}
+
+/**
+ * 走査線で多角形を y 単調な多角形に分割する対角線を求め、頂点の輪に追加します。
+ * de Berg ほか『Computational Geometry』3.2 節のアルゴリズムです。
+ * 辺 e_i は点 i から次の点への元の辺で、走査線の状態には内部が右側にある辺だけを入れます。
+ * この段階では頂点の番号と点の番号は一致しています。
+ */
+bool PolygonTriangulator::PartitionMonotone()
+{
+	const uint32_t count = static_cast<uint32_t>(m_vertices.size());
+
+	m_types.resize(count);
+	m_helpers.assign(count, 0);
+	m_edges.resize(count);
+	m_hasEdge.assign(count, false);
+	m_diagonals.clear();
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t prev = m_vertices[i].prev;
+		const uint32_t next = m_vertices[i].next;
+		const bool convex = Orient(prev, i, next) > 0.0;
+
+		if (IsAbove(i, prev) && IsAbove(i, next))
+		{
+			m_types[i] = convex ? Start : Split;
+		}
+		else if (IsAbove(prev, i) && IsAbove(next, i))
+		{
+			m_types[i] = convex ? End : Merge;
+		}
+		else
+		{
+			m_types[i] = Regular;
+		}
+	}
+
+	m_order.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		m_order[i] = i;
+	}
+	std::sort(m_order.begin(), m_order.end(), [this](uint32_t a, uint32_t b) {
+		return IsAbove(a, b);
+	});
+
+	StatusTree status((StatusEdgeLess(this)));
+	StatusTree::iterator left;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t v = m_order[i];
+		const uint32_t prev = m_vertices[v].prev;
+
+		switch (m_types[v])
+		{
+		case Start:
+			InsertEdge(status, v);
+			m_helpers[v] = v;
+			break;
+
+		case End:
+			if (!m_hasEdge[prev])
+			{
+				return false;
+			}
+			if (m_types[m_helpers[prev]] == Merge)
+			{
+				AddDiagonal(v, m_helpers[prev]);
+			}
+			RemoveEdge(status, prev);
+			break;
+
+		case Split:
+			if (!FindLeftEdge(status, v, left))
+			{
+				return false;
+			}
+			AddDiagonal(v, m_helpers[left->edge]);
+			m_helpers[left->edge] = v;
+			InsertEdge(status, v);
+			m_helpers[v] = v;
+			break;
+
+		case Merge:
+			if (!m_hasEdge[prev])
+			{
+				return false;
+			}
+			if (m_types[m_helpers[prev]] == Merge)
+			{
+				AddDiagonal(v, m_helpers[prev]);
+			}
+			RemoveEdge(status, prev);
+
+			if (!FindLeftEdge(status, v, left))
+			{
+				return false;
+			}
+			if (m_types[m_helpers[left->edge]] == Merge)
+			{
+				AddDiagonal(v, m_helpers[left->edge]);
+			}
+			m_helpers[left->edge] = v;
+			break;
+
+		case Regular:
+			// 前の点が上にあれば、内部は右側にあります。
+			if (IsAbove(prev, v))
+			{
+				if (!m_hasEdge[prev])
+				{
+					return false;
+				}
+				if (m_types[m_helpers[prev]] == Merge)
+				{
+					AddDiagonal(v, m_helpers[prev]);
+				}
+				RemoveEdge(status, prev);
+				InsertEdge(status, v);
+				m_helpers[v] = v;
+			}
+			else
+			{
+				if (!FindLeftEdge(status, v, left))
+				{
+					return false;
+				}
+				if (m_types[m_helpers[left->edge]] == Merge)
+				{
+					AddDiagonal(v, m_helpers[left->edge]);
+				}
+				m_helpers[left->edge] = v;
+			}
+			break;
+		}
+	}
+
+	// 対角線 1 本につき頂点が 2 つ増えます。
+	m_vertices.reserve(count + m_diagonals.size());
+	m_nextInstance.assign(count, UINT32_MAX);
+	m_nextInstance.reserve(count + m_diagonals.size());
+	for (size_t i = 0; i < m_diagonals.size(); i += 2)
+	{
+		SplitRing(m_diagonals[i], m_diagonals[i + 1]);
+	}
+	return true;
+}
+
+void PolygonTriangulator::AddDiagonal(uint32_t a, uint32_t b)
+{
+	m_diagonals.push_back(a);
+	m_diagonals.push_back(b);
+}
+
+/**
+ * 点 a と b を結ぶ対角線で輪を分けます。
+ * 同じ点の頂点が複数ある場合は、対角線の方向を内角に含む頂点を使います。
+ * 選んだ頂点 va, vb の複製 (va2, vb2) を作り、va → vb2 と vb → va2 を通る 2 つの輪にします。
+ * va と vb は前の辺を持ったままで、次の辺は複製が引き継ぎます。
+ */
+void PolygonTriangulator::SplitRing(uint32_t a, uint32_t b)
+{
+	const uint32_t va = FindCorner(a, b);
+	const uint32_t vb = FindCorner(b, a);
+	const uint32_t va2 = static_cast<uint32_t>(m_vertices.size());
+	const uint32_t vb2 = va2 + 1;
+
+	MonotoneVertex copyA = m_vertices[va];
+	MonotoneVertex copyB = m_vertices[vb];
+	m_vertices.push_back(copyA);
+	m_vertices.push_back(copyB);
+
+	m_vertices[m_vertices[va].next].prev = va2;
+	m_vertices[m_vertices[vb].next].prev = vb2;
+
+	m_vertices[va].next = vb2;
+	m_vertices[vb2].prev = va;
+	m_vertices[vb].next = va2;
+	m_vertices[va2].prev = vb;
+
+	// 同じ点の頂点を連結リストでつなぎます。
+	m_nextInstance.push_back(m_nextInstance[va]);
+	m_nextInstance.push_back(m_nextInstance[vb]);
+	m_nextInstance[va] = va2;
+	m_nextInstance[vb] = vb2;
+}
+
+// 点 point の頂点のうち、点 target への方向を内角に含むものを返します。
+uint32_t PolygonTriangulator::FindCorner(uint32_t point, uint32_t target) const
+{
+	for (uint32_t v = point; v != UINT32_MAX; v = m_nextInstance[v])
+	{
+		const uint32_t prev = m_vertices[m_vertices[v].prev].point;
+		const uint32_t next = m_vertices[m_vertices[v].next].point;
+
+		// 内部は前の辺と次の辺の左側にあります。
+		const bool leftOfNext = Orient(point, next, target) > 0.0;
+		const bool leftOfPrev = Orient(prev, point, target) > 0.0;
+		const bool inside = Orient(prev, point, next) > 0.0 ? (leftOfNext && leftOfPrev) : (leftOfNext || leftOfPrev);
+		if (inside)
+		{
+			return v;
+		}
+	}
+	return point;
+}
+
+void PolygonTriangulator::InsertEdge(StatusTree& status, uint32_t edge)
+{
+	const uint32_t p = edge;
+	const uint32_t q = m_vertices[edge].next;
+
+	StatusEdge statusEdge;
+	statusEdge.upper = IsAbove(p, q) ? p : q;
+	statusEdge.lower = IsAbove(p, q) ? q : p;
+	statusEdge.edge = edge;
+	m_edges[edge] = status.insert(statusEdge).first;
+	m_hasEdge[edge] = true;
+}
+
+void PolygonTriangulator::RemoveEdge(StatusTree& status, uint32_t edge)
+{
+	status.erase(m_edges[edge]);
+	m_hasEdge[edge] = false;
+}
+
+// 点のすぐ左にある辺を探します。
+bool PolygonTriangulator::FindLeftEdge(StatusTree& status, uint32_t point, StatusTree::iterator& edge)
+{
+	StatusEdge probe;
+	probe.upper = point;
+	probe.lower = point;
+	probe.edge = UINT32_MAX;
+
+	edge = status.lower_bound(probe);
+	if (edge == status.begin())
+	{
+		return false;
+	}
+	--edge;
+	return true;
+}
+
+// 走査線と交差する 2 本の辺 a と b について、a が b の左にあるかどうかを返します。
+// 後から挿入された (上端が下にある) 方の上端が、もう一方の辺のどちら側にあるかで判定します。
+// 上端が一致する場合は下端で判定します。上端と下端が同じ点の辺は、その点を探すために使います。
+bool PolygonTriangulator::StatusEdgeLess::operator()(const StatusEdge& a, const StatusEdge& b) const
+{
+	if (a.upper == b.upper && a.lower == b.lower)
+	{
+		return false;
+	}
+
+	if (!triangulator->IsAbove(a.upper, b.upper))
+	{
+		const double side = triangulator->Orient(b.upper, b.lower, a.upper);
+		if (side != 0.0)
+		{
+			return side < 0.0;
+		}
+		return triangulator->Orient(b.upper, b.lower, a.lower) < 0.0;
+	}
+	else
+	{
+		const double side = triangulator->Orient(a.upper, a.lower, b.upper);
+		if (side != 0.0)
+		{
+			return side > 0.0;
+		}
+		return triangulator->Orient(a.upper, a.lower, b.lower) > 0.0;
+	}
+}
+
+/**
+ * y 単調な多角形を三角形に分割します (de Berg ほか 3.3 節)。
+ * 頂点を上から順に左右のチェーンをマージしながら処理し、スタックに残った頂点と対角線で結びます。
+ */
+void PolygonTriangulator::TriangulateMonotone(uint32_t start, std::vector<uint32_t>& indices)
+{
+	// 一番上と一番下の頂点を探します。
+	uint32_t top = start;
+	uint32_t bottom = start;
+	uint32_t count = 0;
+	uint32_t v = start;
+	do
+	{
+		m_visited[v] = true;
+		if (IsAbove(m_vertices[v].point, m_vertices[top].point))
+		{
+			top = v;
+		}
+		if (IsAbove(m_vertices[bottom].point, m_vertices[v].point))
+		{
+			bottom = v;
+		}
+		v = m_vertices[v].next;
+		++count;
+	} while (v != start);
+
+	if (count < 3)
+	{
+		return;
+	}
+
+	// 反時計回りでは、top から next へたどると左のチェーン、prev へたどると右のチェーンになります。
+	m_order.resize(count);
+	m_chains.resize(m_vertices.size());
+	m_order[0] = top;
+	m_chains[top] = 0;
+	uint32_t left = m_vertices[top].next;
+	uint32_t right = m_vertices[top].prev;
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		bool takeLeft;
+		if (left == bottom)
+		{
+			takeLeft = right == bottom;
+		}
+		else if (right == bottom)
+		{
+			takeLeft = true;
+		}
+		else
+		{
+			takeLeft = IsAbove(m_vertices[left].point, m_vertices[right].point);
+		}
+
+		if (takeLeft)
+		{
+			m_order[i] = left;
+			m_chains[left] = 1;
+			left = m_vertices[left].next;
+		}
+		else
+		{
+			m_order[i] = right;
+			m_chains[right] = -1;
+			right = m_vertices[right].prev;
+		}
+	}
+	m_chains[bottom] = 0;
+
+	m_stack.clear();
+	m_stack.push_back(m_order[0]);
+	m_stack.push_back(m_order[1]);
+	for (uint32_t i = 2; i < count; ++i)
+	{
+		const uint32_t u = m_order[i];
+		const uint32_t up = m_vertices[u].point;
+
+		if (m_chains[u] != m_chains[m_stack.back()])
+		{
+			// 反対のチェーンの頂点なら、スタックのすべての頂点と結べます。
+			for (size_t k = 0; k + 1 < m_stack.size(); ++k)
+			{
+				uint32_t a = m_vertices[m_stack[k]].point;
+				uint32_t b = m_vertices[m_stack[k + 1]].point;
+				if (Orient(a, b, up) < 0.0)
+				{
+					std::swap(a, b);
+				}
+				indices.push_back(m_sources[a]);
+				indices.push_back(m_sources[b]);
+				indices.push_back(m_sources[up]);
+			}
+			m_stack.clear();
+			m_stack.push_back(m_order[i - 1]);
+			m_stack.push_back(u);
+		}
+		else
+		{
+			// 同じチェーンなら、多角形の内側を通る対角線を結べる間だけ取り出します。
+			uint32_t last = m_stack.back();
+			m_stack.pop_back();
+			while (!m_stack.empty())
+			{
+				const uint32_t lastPoint = m_vertices[last].point;
+				const uint32_t nextPoint = m_vertices[m_stack.back()].point;
+				const double side = m_chains[u] > 0 ? Orient(nextPoint, lastPoint, up) : Orient(up, lastPoint, nextPoint);
+				if (side <= 0.0)
+				{
+					break;
+				}
+
+				if (m_chains[u] > 0)
+				{
+					indices.push_back(m_sources[nextPoint]);
+					indices.push_back(m_sources[lastPoint]);
+					indices.push_back(m_sources[up]);
+				}
+				else
+				{
+					indices.push_back(m_sources[up]);
+					indices.push_back(m_sources[lastPoint]);
+					indices.push_back(m_sources[nextPoint]);
+				}
+				last = m_stack.back();
+				m_stack.pop_back();
+			}
+			m_stack.push_back(last);
+			m_stack.push_back(u);
+		}
+	}
+}
@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <set>
+#include <vector>
+#include "RenderDevice.h"
+#include "JobSystem.h"
+
+// 穴のある多角形。outer は外周、holes は穴の頂点列で、向きはどちらでもかまいません。
+// 辺どうしが交差したり接したりしない単純な多角形である必要があります (連続する同じ点は無視します)。
+struct PolygonData
+{
+	std::vector<DirectX::XMFLOAT2> outer;
+	std::vector<std::vector<DirectX::XMFLOAT2>> holes;
+};
+
+// 多角形を三角形に分割します。
+// 走査線で y 単調な多角形に分割し (O(n log n))、それぞれを線形時間で三角形に分割します。
+// 出力するインデックスは outer の頂点に続けて holes の頂点を順に並べたものを指し、
+// 三角形は xy 平面上で反時計回りになります。
+//
+// インスタンスは作業用のバッファーを再利用するので、スレッドごとに 1 つ使ってください。
+class PolygonTriangulator
+{
+public:
+	PolygonTriangulator();
+
+	// 三角形のインデックスを indices に追加します。多角形が不正な場合は false を返します。
+	bool Triangulate(const PolygonData& polygon, std::vector<uint32_t>& indices);
+
+	// 複数の多角形を jobSystem で並列に分割します。jobSystem が nullptr なら直列に処理します。
+	// results[i] は polygons[i] のインデックスで、失敗した多角形は空になります。成功した数を返します。
+	static uint32_t TriangulateBatch(
+		const std::vector<PolygonData>& polygons,
+		std::vector<std::vector<uint32_t>>& results,
+		JobSystem* jobSystem
+		);
+
+	// 三角形分割の結果から z = 0 のメッシュを作ります。
+	static void CreateMeshData(
+		const PolygonData& polygon,
+		const std::vector<uint32_t>& indices,
+		const DirectX::XMFLOAT3& color,
+		MeshData& mesh
+		);
+
+private:
+	enum VertexType : uint8_t
+	{
+		Start,
+		End,
+		Split,
+		Merge,
+		Regular
+	};
+
+	// 多角形の頂点。対角線で輪を分けると頂点が複製され、prev と next で各部分多角形の輪をたどれます。
+	// 複製される前の頂点の番号は点の番号と一致します。
+	struct MonotoneVertex
+	{
+		uint32_t point;
+		uint32_t prev;
+		uint32_t next;
+	};
+
+	// 走査線と交差する辺。内部が右側にある辺だけを保持し、左から右の順に並べます。
+	// upper と lower は点の番号で、edge は辺の始点の番号です。
+	struct StatusEdge
+	{
+		uint32_t upper;
+		uint32_t lower;
+		uint32_t edge;
+	};
+
+	struct StatusEdgeLess
+	{
+		explicit StatusEdgeLess(const PolygonTriangulator* triangulator) : triangulator(triangulator) {}
+		bool operator()(const StatusEdge& a, const StatusEdge& b) const;
+		const PolygonTriangulator* triangulator;
+	};
+
+	typedef std::set<StatusEdge, StatusEdgeLess> StatusTree;
+
+	bool IsAbove(uint32_t a, uint32_t b) const;
+	double Orient(uint32_t a, uint32_t b, uint32_t c) const;
+	bool AddRing(const std::vector<DirectX::XMFLOAT2>& ring, uint32_t sourceOffset, bool counterClockwise);
+	bool PartitionMonotone();
+	void AddDiagonal(uint32_t a, uint32_t b);
+	void SplitRing(uint32_t a, uint32_t b);
+	uint32_t FindCorner(uint32_t point, uint32_t target) const;
+	void InsertEdge(StatusTree& status, uint32_t edge);
+	void RemoveEdge(StatusTree& status, uint32_t edge);
+	bool FindLeftEdge(StatusTree& status, uint32_t point, StatusTree::iterator& edge);
+	void TriangulateMonotone(uint32_t start, std::vector<uint32_t>& indices);
+
+	// 点の座標と、入力での番号。方向の判定は double で行います。
+	std::vector<double> m_x;
+	std::vector<double> m_y;
+	std::vector<uint32_t> m_sources;
+
+	std::vector<MonotoneVertex> m_vertices;
+	std::vector<uint32_t> m_nextInstance;	// 同じ点の次の頂点 (なければ UINT32_MAX)
+
+	// 走査線の作業領域。点または辺の番号で参照します。
+	std::vector<VertexType> m_types;
+	std::vector<uint32_t> m_helpers;
+	std::vector<StatusTree::iterator> m_edges;
+	std::vector<bool> m_hasEdge;
+	std::vector<uint32_t> m_diagonals;	// 対角線の両端の点の組
+
+	// 単調多角形の三角形分割の作業領域。
+	std::vector<uint32_t> m_order;
+	std::vector<int8_t> m_chains;
+	std::vector<uint32_t> m_stack;
+	std::vector<bool> m_visited;
+};
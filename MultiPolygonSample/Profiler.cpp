@@ -0,0 +1,335 @@
+﻿#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <chrono>
+#endif
+
+uint64_t ProfilerClock::Now()
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return static_cast<uint64_t>(counter.QuadPart);
+#else
+	return static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+		);
+#endif
+}
+
+uint64_t ProfilerClock::GetFrequency()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return static_cast<uint64_t>(frequency.QuadPart);
+#else
+	return 1000000000;
+#endif
+}
+
+ProfileEventRing::ProfileEventRing(uint32_t capacity) :
+	m_writeIndex(0)
+{
+	uint64_t size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+	m_mask = size - 1;
+
+	m_slots.reset(new Slot[static_cast<size_t>(size)]);
+	for (uint64_t i = 0; i < size; ++i)
+	{
+		m_slots[i].sequence.store(0, std::memory_order_relaxed);
+	}
+}
+
+void ProfileEventRing::Push(const ProfileEvent& event)
+{
+	const uint64_t index = m_writeIndex.fetch_add(1, std::memory_order_relaxed);
+	Slot& slot = m_slots[index & m_mask];
+
+	slot.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name.store(event.name, std::memory_order_relaxed);
+	slot.begin.store(event.begin, std::memory_order_relaxed);
+	slot.end.store(event.end, std::memory_order_relaxed);
+	slot.threadId.store(event.threadId, std::memory_order_relaxed);
+	slot.frame.store(event.frame, std::memory_order_relaxed);
+	slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+uint64_t ProfileEventRing::Read(uint64_t firstIndex, std::vector<ProfileEvent>& events) const
+{
+	const uint64_t writeIndex = m_writeIndex.load(std::memory_order_acquire);
+	const uint64_t capacity = m_mask + 1;
+	uint64_t index = std::max(firstIndex, writeIndex > capacity ? writeIndex - capacity : 0);
+
+	for (; index < writeIndex; ++index)
+	{
+		const Slot& slot = m_slots[index & m_mask];
+		if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+		{
+			// まだ書き込み中か、すでに上書きされています。
+			continue;
+		}
+
+		ProfileEvent event;
+		event.name = slot.name.load(std::memory_order_relaxed);
+		event.begin = slot.begin.load(std::memory_order_relaxed);
+		event.end = slot.end.load(std::memory_order_relaxed);
+		event.threadId = slot.threadId.load(std::memory_order_relaxed);
+		event.frame = slot.frame.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == index + 1)
+		{
+			events.push_back(event);
+		}
+	}
+	return writeIndex;
+}
+
+FrameTimeHistogram::FrameTimeHistogram()
+{
+	Reset();
+}
+
+void FrameTimeHistogram::Reset()
+{
+	memset(m_counts, 0, sizeof(m_counts));
+	m_sampleCount = 0;
+	m_max = 0.0;
+}
+
+// バケット 0 は 1 マイクロ秒未満で、以降は [2^k, 2^(k+1)) を SubBucketCount 等分します。
+int FrameTimeHistogram::GetBucket(double microseconds)
+{
+	if (microseconds < 1.0)
+	{
+		return 0;
+	}
+
+	int exponent;
+	const double mantissa = frexp(microseconds, &exponent);	// microseconds = mantissa * 2^exponent, 0.5 <= mantissa < 1
+	const int octave = exponent - 1;
+	if (octave >= OctaveCount)
+	{
+		return BucketCount - 1;
+	}
+	const int subBucket = static_cast<int>((mantissa * 2.0 - 1.0) * SubBucketCount);
+	return 1 + octave * SubBucketCount + subBucket;
+}
+
+double FrameTimeHistogram::GetBucketUpperBound(int bucket)
+{
+	if (bucket == 0)
+	{
+		return 1.0;
+	}
+
+	const int octave = (bucket - 1) / SubBucketCount;
+	const int subBucket = (bucket - 1) % SubBucketCount;
+	return ldexp(1.0 + static_cast<double>(subBucket + 1) / SubBucketCount, octave);
+}
+
+void FrameTimeHistogram::Add(double milliseconds)
+{
+	++m_counts[GetBucket(milliseconds * 1000.0)];
+	++m_sampleCount;
+	m_max = std::max(m_max, milliseconds);
+}
+
+double FrameTimeHistogram::GetPercentile(double percentile) const
+{
+	if (m_sampleCount == 0)
+	{
+		return 0.0;
+	}
+
+	// 小さい方から数えて rank 番目の標本が入っているバケットの上限を返します。
+	const uint32_t rank = std::max(1u, static_cast<uint32_t>(ceil(percentile / 100.0 * m_sampleCount)));
+	uint32_t count = 0;
+	for (int bucket = 0; bucket < BucketCount; ++bucket)
+	{
+		count += m_counts[bucket];
+		if (count >= rank)
+		{
+			// 最後のバケットには範囲を超えた値も入るので、上限の代わりに最大値を返します。
+			return bucket == BucketCount - 1 ? m_max : std::min(GetBucketUpperBound(bucket) / 1000.0, m_max);
+		}
+	}
+	return m_max;
+}
+
+namespace
+{
+	// GpuThreadId と重ならないように 31 ビットに収めます。
+	uint32_t GetProfilerThreadId()
+	{
+		return static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()) & 0x7FFFFFFF);
+	}
+
+	void WriteJsonString(std::ostream& stream, const char* text)
+	{
+		stream << '"';
+		for (const char* c = text; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				stream << '\\' << *c;
+			}
+			else if (static_cast<unsigned char>(*c) < 0x20)
+			{
+				stream << ' ';
+			}
+			else
+			{
+				stream << *c;
+			}
+		}
+		stream << '"';
+	}
+}
+
+Profiler::Profiler(uint32_t capacity) :
+	m_events(capacity),
+	m_frame(0),
+	m_origin(ProfilerClock::Now()),
+	m_frequency(ProfilerClock::GetFrequency()),
+	m_frameBegin(m_origin),
+	m_readIndex(0)
+{
+}
+
+void Profiler::BeginFrame()
+{
+	m_frameBegin = ProfilerClock::Now();
+}
+
+void Profiler::EndFrame()
+{
+	Record("Frame", m_frameBegin, ProfilerClock::Now());
+
+	// 同じ名前の区間が 1 フレームに複数あれば合計します。
+	m_frameEvents.clear();
+	m_readIndex = m_events.Read(m_readIndex, m_frameEvents);
+	for (const ProfileEvent& event : m_frameEvents)
+	{
+		ZoneHistogram& zone = FindHistogram(event.name);
+		zone.frameTotal += static_cast<double>(event.end - event.begin) * 1000.0 / m_frequency;
+		zone.seenThisFrame = true;
+	}
+
+	for (ZoneHistogram& zone : m_histograms)
+	{
+		if (zone.seenThisFrame)
+		{
+			zone.histogram.Add(zone.frameTotal);
+			zone.frameTotal = 0.0;
+			zone.seenThisFrame = false;
+		}
+	}
+
+	m_frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::Record(const char* name, uint64_t begin, uint64_t end)
+{
+	Record(name, begin, end, GetProfilerThreadId());
+}
+
+void Profiler::Record(const char* name, uint64_t begin, uint64_t end, uint32_t threadId)
+{
+	ProfileEvent event;
+	event.name = name;
+	event.begin = begin;
+	event.end = std::max(begin, end);
+	event.threadId = threadId;
+	event.frame = m_frame.load(std::memory_order_relaxed);
+	m_events.Push(event);
+}
+
+// 名前はモジュールごとに別のポインターになることがあるので、文字列で比べます。
+Profiler::ZoneHistogram& Profiler::FindHistogram(const char* name)
+{
+	for (ZoneHistogram& zone : m_histograms)
+	{
+		if (zone.name == name || strcmp(zone.name, name) == 0)
+		{
+			return zone;
+		}
+	}
+
+	ZoneHistogram zone;
+	zone.name = name;
+	zone.frameTotal = 0.0;
+	zone.seenThisFrame = false;
+	m_histograms.push_back(zone);
+	return m_histograms.back();
+}
+
+void Profiler::GetStatistics(std::vector<ProfileZoneStatistics>& statistics) const
+{
+	statistics.clear();
+	for (const ZoneHistogram& zone : m_histograms)
+	{
+		ProfileZoneStatistics zoneStatistics;
+		zoneStatistics.name = zone.name;
+		zoneStatistics.frameCount = zone.histogram.GetSampleCount();
+		zoneStatistics.p50 = zone.histogram.GetPercentile(50.0);
+		zoneStatistics.p95 = zone.histogram.GetPercentile(95.0);
+		zoneStatistics.p99 = zone.histogram.GetPercentile(99.0);
+		zoneStatistics.max = zone.histogram.GetMax();
+		statistics.push_back(zoneStatistics);
+	}
+}
+
+void Profiler::ResetStatistics()
+{
+	for (ZoneHistogram& zone : m_histograms)
+	{
+		zone.histogram.Reset();
+	}
+}
+
+// 各区間を完了イベント ("ph": "X") として書き出します。時刻はプロファイラーを作成した時点からのマイクロ秒です。
+void Profiler::WriteChromeTrace(std::ostream& stream) const
+{
+	std::vector<ProfileEvent> events;
+	m_events.Read(0, events);
+
+	const std::ios::fmtflags flags = stream.flags(std::ios::fixed);
+	const std::streamsize precision = stream.precision(3);
+
+	stream << "{\"traceEvents\":[\n";
+	stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GpuThreadId << ",\"args\":{\"name\":\"GPU\"}}";
+
+	const double microsecondsPerTick = 1000000.0 / m_frequency;
+	for (const ProfileEvent& event : events)
+	{
+		const double begin = event.begin >= m_origin ? (event.begin - m_origin) * microsecondsPerTick : 0.0;
+		const double duration = (event.end - event.begin) * microsecondsPerTick;
+
+		stream << ",\n{\"name\":";
+		WriteJsonString(stream, event.name);
+		stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId;
+		stream << ",\"ts\":" << begin << ",\"dur\":" << duration;
+		stream << ",\"args\":{\"frame\":" << event.frame << "}}";
+	}
+	stream << "\n]}\n";
+
+	stream.flags(flags);
+	stream.precision(precision);
+}
@@ -0,0 +1,182 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// 計測に使う時計。Windows では QueryPerformanceCounter、それ以外では std::chrono::steady_clock を使います。
+namespace ProfilerClock
+{
+	uint64_t Now();
+	uint64_t GetFrequency();	// 1 秒あたりのティック数
+}
+
+// 計測した区間。時刻は ProfilerClock のティックです。
+struct ProfileEvent
+{
+	const char* name;	// 文字列リテラルなど、プロファイラーより長く生存する文字列
+	uint64_t begin;
+	uint64_t end;
+	uint32_t threadId;
+	uint32_t frame;
+};
+
+/**
+ * 複数のスレッドからロックなしで書き込める、固定長のリング バッファー。
+ * 書き込み位置は fetch_add で確保し、スロットごとのシーケンス番号で書き込みの完了を示します。
+ * 読み取り側はシーケンス番号を前後で比べ、読んでいる間に上書きされたイベントを捨てます。
+ * バッファーが一周すると古いイベントから上書きされます。
+ */
+class ProfileEventRing
+{
+public:
+	// capacity は 2 のべき乗に切り上げます。
+	explicit ProfileEventRing(uint32_t capacity);
+
+	void Push(const ProfileEvent& event);
+
+	// firstIndex 以降に書き込まれ、まだ上書きされていないイベントを events に追加します。
+	// 次に読み始める位置を返します。
+	uint64_t Read(uint64_t firstIndex, std::vector<ProfileEvent>& events) const;
+
+	uint64_t GetWriteIndex() const { return m_writeIndex.load(std::memory_order_acquire); }
+	uint32_t GetCapacity() const { return static_cast<uint32_t>(m_mask + 1); }
+
+private:
+	// すべてのフィールドを atomic にして、上書き中のスロットを読んでもデータ競合にならないようにします。
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence;	// 書き込み中は 0、完了後は書き込み位置 + 1
+		std::atomic<const char*> name;
+		std::atomic<uint64_t> begin;
+		std::atomic<uint64_t> end;
+		std::atomic<uint32_t> threadId;
+		std::atomic<uint32_t> frame;
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	uint64_t m_mask;
+	std::atomic<uint64_t> m_writeIndex;
+};
+
+// フレームごとの時間の分布。
+// 1 マイクロ秒から約 16 秒までを、2 倍ごとに 8 分割した対数のバケットで数えるので、
+// パーセンタイルの相対誤差は 12.5% 以下です。
+class FrameTimeHistogram
+{
+public:
+	FrameTimeHistogram();
+
+	void Add(double milliseconds);
+	void Reset();
+
+	// percentile は 0 から 100 の値です。標本がなければ 0 を返します。
+	double GetPercentile(double percentile) const;
+
+	uint32_t GetSampleCount() const { return m_sampleCount; }
+	double GetMax() const { return m_max; }
+
+private:
+	static const int SubBucketCount = 8;
+	static const int OctaveCount = 24;
+	static const int BucketCount = 1 + SubBucketCount * OctaveCount;
+
+	static int GetBucket(double microseconds);
+	static double GetBucketUpperBound(int bucket);
+
+	uint32_t m_counts[BucketCount];
+	uint32_t m_sampleCount;
+	double m_max;
+};
+
+// 区間の名前ごとの、1 フレームあたりの合計時間のパーセンタイル (ミリ秒)。
+struct ProfileZoneStatistics
+{
+	const char* name;
+	uint32_t frameCount;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+};
+
+/**
+ * CPU と GPU の区間を記録し、フレームごとの統計と Chrome のトレース形式の出力を作ります。
+ * Record、ProfileZone、WriteChromeTrace はどのスレッドからでも呼び出せます。
+ * BeginFrame、EndFrame、GetStatistics、ResetStatistics は 1 つのスレッドから呼び出してください。
+ */
+class Profiler
+{
+public:
+	// GPU の区間に使うスレッド ID。
+	static const uint32_t GpuThreadId = 0xFFFFFFFF;
+
+	explicit Profiler(uint32_t capacity = 1 << 16);
+
+	void BeginFrame();
+
+	// フレーム全体を "Frame" として記録し、このフレームに記録された区間を名前ごとに集計します。
+	void EndFrame();
+
+	uint32_t GetFrameIndex() const { return m_frame.load(std::memory_order_relaxed); }
+
+	// 呼び出したスレッドの区間として記録します。
+	void Record(const char* name, uint64_t begin, uint64_t end);
+	void Record(const char* name, uint64_t begin, uint64_t end, uint32_t threadId);
+
+	void GetStatistics(std::vector<ProfileZoneStatistics>& statistics) const;
+	void ResetStatistics();
+
+	// リング バッファーに残っているイベントを chrome://tracing で読める JSON で書き出します。
+	void WriteChromeTrace(std::ostream& stream) const;
+
+private:
+	struct ZoneHistogram
+	{
+		const char* name;
+		FrameTimeHistogram histogram;
+		double frameTotal;	// 集計中のフレームの合計 (ミリ秒)
+		bool seenThisFrame;
+	};
+
+	ZoneHistogram& FindHistogram(const char* name);
+
+	ProfileEventRing m_events;
+	std::atomic<uint32_t> m_frame;
+	uint64_t m_origin;
+	uint64_t m_frequency;
+	uint64_t m_frameBegin;
+	uint64_t m_readIndex;
+	std::vector<ProfileEvent> m_frameEvents;
+	std::vector<ZoneHistogram> m_histograms;
+};
+
+// スコープに入ってから出るまでを 1 つの区間として記録します。profiler が nullptr なら何もしません。
+class ProfileZone
+{
+public:
+	ProfileZone(Profiler* profiler, const char* name) :
+		m_profiler(profiler),
+		m_name(name),
+		m_begin(profiler != nullptr ? ProfilerClock::Now() : 0)
+	{
+	}
+
+	~ProfileZone()
+	{
+		if (m_profiler != nullptr)
+		{
+			m_profiler->Record(m_name, m_begin, ProfilerClock::Now());
+		}
+	}
+
+private:
+	ProfileZone(const ProfileZone&);
+	ProfileZone& operator=(const ProfileZone&);
+
+	Profiler* m_profiler;
+	const char* m_name;
+	uint64_t m_begin;
+};
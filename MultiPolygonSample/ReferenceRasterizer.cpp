@@ -0,0 +1,391 @@
+﻿#include "ReferenceRasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include "LodSelection.h"
+
+using namespace DirectX;
+
+// サブピクセル精度 (D3D11 と同じ 8 ビット)。
+static const int32_t SubPixelBits = 8;
+static const int32_t SubPixelScale = 1 << SubPixelBits;
+
+// ガード バンドの幅 (ビューポートの倍数)。これより外側だけを実際にクリップします。
+static const float GuardBand = 16.0f;
+
+static const uint32_t MaxClipVertices = 3 + 7;
+
+ReferenceRasterizer::ReferenceRasterizer(uint32_t width, uint32_t height) :
+	m_width(width),
+	m_height(height),
+	m_color(width * height),
+	m_depth(width * height)
+{
+}
+
+void ReferenceRasterizer::Clear(const float color[4], float depth)
+{
+	std::fill(m_color.begin(), m_color.end(), PackColor(color[0], color[1], color[2], color[3]));
+	std::fill(m_depth.begin(), m_depth.end(), PackDepth(depth));
+}
+
+void ReferenceRasterizer::DrawIndexed(
+	const VertexPositionColor* vertices,
+	const uint32_t* indices,
+	uint32_t indexCount,
+	const ModelViewProjectionConstantBuffer& constants,
+	CullMode cullMode
+	)
+{
+	ScreenTriangle triangles[MaxClippedTriangles];
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		ClipVertex clip[3];
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			const VertexPositionColor& vertex = vertices[indices[i + k]];
+
+			// SimpleVertexShader.hlsl と同じく model → view → projection の順に掛けます。
+			float pos[4] = { vertex.pos.x, vertex.pos.y, vertex.pos.z, 1.0f };
+			float temp[4];
+			TransformPosition(constants.model, pos, temp);
+			TransformPosition(constants.view, temp, pos);
+			TransformPosition(constants.projection, pos, temp);
+
+			clip[k].x = temp[0];
+			clip[k].y = temp[1];
+			clip[k].z = temp[2];
+			clip[k].w = temp[3];
+			clip[k].r = vertex.color.x;
+			clip[k].g = vertex.color.y;
+			clip[k].b = vertex.color.z;
+		}
+
+		uint32_t count = SetupTriangle(clip[0], clip[1], clip[2], cullMode, m_width, m_height, triangles);
+		for (uint32_t t = 0; t < count; ++t)
+		{
+			RasterizeTriangle(
+				triangles[t],
+				0,
+				0,
+				static_cast<int32_t>(m_width),
+				static_cast<int32_t>(m_height),
+				0,
+				0,
+				m_width,
+				&m_color[0],
+				&m_depth[0]
+				);
+		}
+	}
+}
+
+void ReferenceRasterizer::DrawTwoSided(
+	const VertexPositionColor* vertices,
+	const uint32_t* indices,
+	uint32_t indexCount,
+	const ModelViewProjectionConstantBuffer& constants,
+	TwoSidedMode mode
+	)
+{
+	if (mode == TwoSidedMode::SinglePass)
+	{
+		DrawIndexed(vertices, indices, indexCount, constants, CullMode::None);
+	}
+	else
+	{
+		DrawIndexed(vertices, indices, indexCount, constants, CullMode::Front);
+		DrawIndexed(vertices, indices, indexCount, constants, CullMode::Back);
+	}
+}
+
+// 定数バッファーの行列は転置して格納されているので、元の行列の行は shaderMatrix の列になります。
+void ReferenceRasterizer::TransformPosition(const XMFLOAT4X4& shaderMatrix, const float in[4], float out[4])
+{
+	for (int j = 0; j < 4; ++j)
+	{
+		out[j] =
+			in[0] * shaderMatrix.m[j][0] +
+			in[1] * shaderMatrix.m[j][1] +
+			in[2] * shaderMatrix.m[j][2] +
+			in[3] * shaderMatrix.m[j][3];
+	}
+}
+
+// 同次座標の平面に対する距離。正の側が内側です。
+static float PlaneDistance(const ClipVertex& v, int plane)
+{
+	switch (plane)
+	{
+	case 0: return v.w - 1.0e-5f;			// w > 0
+	case 1: return v.z;						// ニア (z >= 0)
+	case 2: return v.w - v.z;				// ファー (z <= w)
+	case 3: return GuardBand * v.w - v.x;
+	case 4: return GuardBand * v.w + v.x;
+	case 5: return GuardBand * v.w - v.y;
+	default: return GuardBand * v.w + v.y;
+	}
+}
+
+static ClipVertex LerpClipVertex(const ClipVertex& a, const ClipVertex& b, float t)
+{
+	ClipVertex v;
+	v.x = a.x + (b.x - a.x) * t;
+	v.y = a.y + (b.y - a.y) * t;
+	v.z = a.z + (b.z - a.z) * t;
+	v.w = a.w + (b.w - a.w) * t;
+	v.r = a.r + (b.r - a.r) * t;
+	v.g = a.g + (b.g - a.g) * t;
+	v.b = a.b + (b.b - a.b) * t;
+	return v;
+}
+
+uint32_t ReferenceRasterizer::SetupTriangle(
+	const ClipVertex& v0,
+	const ClipVertex& v1,
+	const ClipVertex& v2,
+	CullMode cullMode,
+	uint32_t targetWidth,
+	uint32_t targetHeight,
+	ScreenTriangle* out
+	)
+{
+	ClipVertex polygon[2][MaxClipVertices];
+	polygon[0][0] = v0;
+	polygon[0][1] = v1;
+	polygon[0][2] = v2;
+	uint32_t vertexCount = 3;
+	int current = 0;
+
+	// Sutherland-Hodgman 法で各平面に対してクリップします。
+	// 完全に内側にある三角形 (大半のケース) はコピーせずに通過させます。
+	for (int plane = 0; plane < 7; ++plane)
+	{
+		bool allInside = true;
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			if (PlaneDistance(polygon[current][i], plane) < 0.0f)
+			{
+				allInside = false;
+				break;
+			}
+		}
+		if (allInside)
+		{
+			continue;
+		}
+
+		const ClipVertex* input = polygon[current];
+		ClipVertex* output = polygon[current ^ 1];
+		uint32_t outputCount = 0;
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			const ClipVertex& a = input[i];
+			const ClipVertex& b = input[(i + 1) % vertexCount];
+			float da = PlaneDistance(a, plane);
+			float db = PlaneDistance(b, plane);
+			if (da >= 0.0f)
+			{
+				output[outputCount++] = a;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				output[outputCount++] = LerpClipVertex(a, b, da / (da - db));
+			}
+		}
+
+		vertexCount = outputCount;
+		current ^= 1;
+		if (vertexCount < 3)
+		{
+			return 0;
+		}
+	}
+
+	// ビューポート変換。D3D11 と同じく y 軸は下向きです。
+	const float halfWidth = static_cast<float>(targetWidth) * 0.5f;
+	const float halfHeight = static_cast<float>(targetHeight) * 0.5f;
+
+	int32_t fx[MaxClipVertices];
+	int32_t fy[MaxClipVertices];
+	float invW[MaxClipVertices];
+	for (uint32_t i = 0; i < vertexCount; ++i)
+	{
+		const ClipVertex& v = polygon[current][i];
+		invW[i] = 1.0f / v.w;
+		float sx = (v.x * invW[i] + 1.0f) * halfWidth;
+		float sy = (1.0f - v.y * invW[i]) * halfHeight;
+		fx[i] = static_cast<int32_t>(std::floor(sx * SubPixelScale + 0.5f));
+		fy[i] = static_cast<int32_t>(std::floor(sy * SubPixelScale + 0.5f));
+	}
+
+	// クリップ結果の凸多角形を扇形に三角形分割します。
+	uint32_t triangleCount = 0;
+	for (uint32_t i = 1; i + 1 < vertexCount; ++i)
+	{
+		uint32_t index[3] = { 0, i, i + 1 };
+
+		int64_t area =
+			static_cast<int64_t>(fx[index[1]] - fx[index[0]]) * (fy[index[2]] - fy[index[0]]) -
+			static_cast<int64_t>(fy[index[1]] - fy[index[0]]) * (fx[index[2]] - fx[index[0]]);
+		if (area == 0)
+		{
+			continue;
+		}
+
+		// y 軸が下向きなので、画面上で反時計回り (FrontCounterClockwise) の三角形は面積が負になります。
+		bool frontFacing = area < 0;
+		if ((cullMode == CullMode::Front && frontFacing) ||
+			(cullMode == CullMode::Back && !frontFacing))
+		{
+			continue;
+		}
+
+		if (area < 0)
+		{
+			std::swap(index[1], index[2]);
+			area = -area;
+		}
+
+		ScreenTriangle& triangle = out[triangleCount++];
+		triangle.area = area;
+		triangle.fade = 1.0f;
+		triangle.frontFacing = frontFacing;
+		int32_t minX = fx[index[0]], maxX = fx[index[0]];
+		int32_t minY = fy[index[0]], maxY = fy[index[0]];
+		for (int k = 0; k < 3; ++k)
+		{
+			const ClipVertex& v = polygon[current][index[k]];
+			triangle.x[k] = fx[index[k]];
+			triangle.y[k] = fy[index[k]];
+			triangle.invW[k] = invW[index[k]];
+			triangle.z[k] = v.z * invW[index[k]];
+			triangle.r[k] = v.r * invW[index[k]];
+			triangle.g[k] = v.g * invW[index[k]];
+			triangle.b[k] = v.b * invW[index[k]];
+			minX = std::min(minX, triangle.x[k]);
+			maxX = std::max(maxX, triangle.x[k]);
+			minY = std::min(minY, triangle.y[k]);
+			maxY = std::max(maxY, triangle.y[k]);
+		}
+
+		// ピクセル中心 (x + 0.5) が含まれうる範囲に切り詰めます。
+		triangle.minX = std::max(0, (minX - SubPixelScale / 2 + SubPixelScale - 1) >> SubPixelBits);
+		triangle.minY = std::max(0, (minY - SubPixelScale / 2 + SubPixelScale - 1) >> SubPixelBits);
+		triangle.maxX = std::min(static_cast<int32_t>(targetWidth), ((maxX - SubPixelScale / 2) >> SubPixelBits) + 1);
+		triangle.maxY = std::min(static_cast<int32_t>(targetHeight), ((maxY - SubPixelScale / 2) >> SubPixelBits) + 1);
+		if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY)
+		{
+			--triangleCount;
+		}
+	}
+
+	return triangleCount;
+}
+
+void ReferenceRasterizer::RasterizeTriangle(
+	const ScreenTriangle& triangle,
+	int32_t minX,
+	int32_t minY,
+	int32_t maxX,
+	int32_t maxY,
+	int32_t originX,
+	int32_t originY,
+	uint32_t pitch,
+	uint32_t* colorBuffer,
+	uint32_t* depthBuffer
+	)
+{
+	minX = std::max(minX, triangle.minX);
+	minY = std::max(minY, triangle.minY);
+	maxX = std::min(maxX, triangle.maxX);
+	maxY = std::min(maxY, triangle.maxY);
+	if (minX >= maxX || minY >= maxY)
+	{
+		return;
+	}
+
+	// エッジ関数 E_k は頂点 k の対辺に対するもので、重心座標は E_k / area になります。
+	// 上辺と左辺以外ではエッジ上のピクセルを含めないように 1 を引いておきます (トップレフト規則)。
+	int64_t stepX[3];
+	int64_t stepY[3];
+	int64_t rowStart[3];
+	const int64_t pixelX = static_cast<int64_t>(minX) * SubPixelScale + SubPixelScale / 2;
+	const int64_t pixelY = static_cast<int64_t>(minY) * SubPixelScale + SubPixelScale / 2;
+	for (int k = 0; k < 3; ++k)
+	{
+		const int a = (k + 1) % 3;
+		const int b = (k + 2) % 3;
+		const int64_t dx = triangle.x[b] - triangle.x[a];
+		const int64_t dy = triangle.y[b] - triangle.y[a];
+		const bool topLeft = (dy == 0 && dx > 0) || dy < 0;
+
+		rowStart[k] = dx * (pixelY - triangle.y[a]) - dy * (pixelX - triangle.x[a]) - (topLeft ? 0 : 1);
+		stepX[k] = -dy * SubPixelScale;
+		stepY[k] = dx * SubPixelScale;
+	}
+
+	const float invArea = 1.0f / static_cast<float>(triangle.area);
+
+	for (int32_t y = minY; y < maxY; ++y)
+	{
+		int64_t e0 = rowStart[0];
+		int64_t e1 = rowStart[1];
+		int64_t e2 = rowStart[2];
+		uint32_t* colorRow = colorBuffer + static_cast<size_t>(y - originY) * pitch - originX;
+		uint32_t* depthRow = depthBuffer + static_cast<size_t>(y - originY) * pitch - originX;
+
+		for (int32_t x = minX; x < maxX; ++x)
+		{
+			if ((e0 | e1 | e2) >= 0 && (triangle.fade >= 1.0f || LodSelection::IsFadeVisible(triangle.fade, x, y)))
+			{
+				const float l0 = static_cast<float>(e0) * invArea;
+				const float l1 = static_cast<float>(e1) * invArea;
+				const float l2 = 1.0f - l0 - l1;
+
+				float z = l0 * triangle.z[0] + l1 * triangle.z[1] + l2 * triangle.z[2];
+				z = std::min(std::max(z, 0.0f), 1.0f);
+				const uint32_t depth = PackDepth(z);
+				if (depth < depthRow[x])
+				{
+					const float w = 1.0f / (l0 * triangle.invW[0] + l1 * triangle.invW[1] + l2 * triangle.invW[2]);
+					const float r = (l0 * triangle.r[0] + l1 * triangle.r[1] + l2 * triangle.r[2]) * w;
+					const float g = (l0 * triangle.g[0] + l1 * triangle.g[1] + l2 * triangle.g[2]) * w;
+					const float b = (l0 * triangle.b[0] + l1 * triangle.b[1] + l2 * triangle.b[2]) * w;
+
+					// SimplePixelShader.hlsl: return float4(input.color, 1.0f);
+					colorRow[x] = PackColor(r, g, b, 1.0f);
+					depthRow[x] = depth;
+				}
+			}
+
+			e0 += stepX[0];
+			e1 += stepX[1];
+			e2 += stepX[2];
+		}
+
+		rowStart[0] += stepY[0];
+		rowStart[1] += stepY[1];
+		rowStart[2] += stepY[2];
+	}
+}
+
+// BGRA8 (メモリ上のバイト順は B, G, R, A) に変換します。
+uint32_t ReferenceRasterizer::PackColor(float r, float g, float b, float a)
+{
+	const float channels[4] = { b, g, r, a };
+	uint32_t packed = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		float c = std::min(std::max(channels[i], 0.0f), 1.0f);
+		packed |= static_cast<uint32_t>(c * 255.0f + 0.5f) << (i * 8);
+	}
+	return packed;
+}
+
+// D24_UNORM に変換します。
+uint32_t ReferenceRasterizer::PackDepth(float depth)
+{
+	float d = std::min(std::max(depth, 0.0f), 1.0f);
+	return static_cast<uint32_t>(d * 16777215.0f + 0.5f);
+}
@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ShaderStructures.h"
+#include "PipelineStates.h"
+
+// SimpleVertexShader.hlsl を通過した後のクリップ空間の頂点。
+struct ClipVertex
+{
+	float x, y, z, w;
+	float r, g, b;
+};
+
+// クリップ後、ビューポート変換を済ませた三角形。
+// 座標は 8 ビットのサブピクセル精度の固定小数点で、面積が正になるように頂点の順序を揃えてあります。
+struct ScreenTriangle
+{
+	int32_t x[3];
+	int32_t y[3];
+	float z[3];			// z / w
+	float invW[3];		// 1 / w
+	float r[3];			// r / w (パースペクティブ補正のために w で割ってあります)
+	float g[3];
+	float b[3];
+	int64_t area;		// 固定小数点での 2 倍の面積
+	int32_t minX, minY, maxX, maxY;	// ピクセル単位の外接矩形 (終端を含まない)
+	float fade;			// LOD のクロスフェード値 (LodSelection::IsFadeVisible)。SetupTriangle は 1 にします
+	bool frontFacing;
+};
+
+// D3D11 のラスタライズ規則 (ピクセル中心でのサンプリング、トップレフト規則、8 ビットのサブピクセル精度、
+// FrontCounterClockwise = true、DepthFunc = LESS) を CPU で再現するリファレンス実装。
+// 出力は BGRA8 のカラー バッファーと D24 の深度バッファーです。
+// 速度よりも正確さを優先しており、GPU の出力やほかの描画方法との比較に使います。
+class ReferenceRasterizer
+{
+public:
+	ReferenceRasterizer(uint32_t width, uint32_t height);
+
+	void Clear(const float color[4], float depth);
+
+	// SimpleVertexShader.hlsl と SimplePixelShader.hlsl と同じ計算でメッシュを描画します。
+	void DrawIndexed(
+		const VertexPositionColor* vertices,
+		const uint32_t* indices,
+		uint32_t indexCount,
+		const ModelViewProjectionConstantBuffer& constants,
+		CullMode cullMode
+		);
+
+	// 両面表示の方法を指定して描画します。TwoPass は CULL_FRONT → CULL_BACK の順に 2 回描画します。
+	void DrawTwoSided(
+		const VertexPositionColor* vertices,
+		const uint32_t* indices,
+		uint32_t indexCount,
+		const ModelViewProjectionConstantBuffer& constants,
+		TwoSidedMode mode
+		);
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	const std::vector<uint32_t>& GetColorBuffer() const { return m_color; }
+	const std::vector<uint32_t>& GetDepthBuffer() const { return m_depth; }
+
+	// 定数バッファー (転置済みの行列) を使って位置を変換します。HLSL の mul(pos, matrix) と同じ結果になります。
+	static void TransformPosition(const DirectX::XMFLOAT4X4& shaderMatrix, const float in[4], float out[4]);
+
+	// クリップ空間の三角形をクリップし、画面空間の三角形に変換します。
+	// カリングされた場合や面積が 0 の場合は 0 を返します。out には MaxClippedTriangles 個分の領域が必要です。
+	static uint32_t SetupTriangle(
+		const ClipVertex& v0,
+		const ClipVertex& v1,
+		const ClipVertex& v2,
+		CullMode cullMode,
+		uint32_t targetWidth,
+		uint32_t targetHeight,
+		ScreenTriangle* out
+		);
+
+	// 画面空間の三角形を、指定した矩形 [minX, maxX) x [minY, maxY) の範囲内でラスタライズします。
+	// バッファーは幅 pitch ピクセルの行で構成され、矩形の左上が (originX, originY) に対応します。
+	static void RasterizeTriangle(
+		const ScreenTriangle& triangle,
+		int32_t minX,
+		int32_t minY,
+		int32_t maxX,
+		int32_t maxY,
+		int32_t originX,
+		int32_t originY,
+		uint32_t pitch,
+		uint32_t* colorBuffer,
+		uint32_t* depthBuffer
+		);
+
+	static const uint32_t MaxClippedTriangles = 8;
+
+	static uint32_t PackColor(float r, float g, float b, float a);
+	static uint32_t PackDepth(float depth);
+
+private:
+	uint32_t m_width;
+	uint32_t m_height;
+	std::vector<uint32_t> m_color;
+	std::vector<uint32_t> m_depth;
+};
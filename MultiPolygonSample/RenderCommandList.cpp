@@ -0,0 +1,62 @@
+﻿#include "RenderCommandList.h"
+
+RenderCommandList::RenderCommandList()
+{
+	Reset();
+}
+
+// 記録済みのコマンドを破棄します。確保済みのメモリは次のフレームで再利用されます。
+void RenderCommandList::Reset()
+{
+	m_commands.clear();
+	m_instances.clear();
+	for (uint32_t i = 0; i < static_cast<uint32_t>(RenderCommandType::Count); ++i)
+	{
+		m_counts[i] = 0;
+	}
+}
+
+void RenderCommandList::SetPipelineState(uint32_t pipelineId)
+{
+	Record(RenderCommandType::SetPipelineState, pipelineId, 0, 0);
+}
+
+void RenderCommandList::SetMesh(uint32_t meshId)
+{
+	Record(RenderCommandType::SetMesh, meshId, 0, 0);
+}
+
+void RenderCommandList::DrawInstanced(uint32_t meshId, uint32_t startInstance, uint32_t instanceCount)
+{
+	Record(RenderCommandType::DrawInstanced, meshId, startInstance, instanceCount);
+}
+
+void RenderCommandList::DrawDynamic(uint32_t firstVertex, uint32_t vertexCount)
+{
+	InstanceData instance;
+	DirectX::XMStoreFloat4x4(&instance.model, DirectX::XMMatrixIdentity());
+	instance.color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	Record(RenderCommandType::DrawDynamic, firstVertex, vertexCount, AppendInstance(instance));
+}
+
+uint32_t RenderCommandList::AppendInstance(const InstanceData& instance)
+{
+	m_instances.push_back(instance);
+	return static_cast<uint32_t>(m_instances.size() - 1);
+}
+
+uint32_t RenderCommandList::GetCommandCount(RenderCommandType type) const
+{
+	return m_counts[static_cast<uint32_t>(type)];
+}
+
+void RenderCommandList::Record(RenderCommandType type, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+	RenderCommand command;
+	command.type = type;
+	command.arg0 = arg0;
+	command.arg1 = arg1;
+	command.arg2 = arg2;
+	m_commands.push_back(command);
+	m_counts[static_cast<uint32_t>(type)]++;
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ShaderStructures.h"
+
+// 記録される描画コマンドの種類。
+enum class RenderCommandType : uint32_t
+{
+	SetPipelineState,	// arg0 = パイプライン ID
+	SetMesh,			// arg0 = メッシュ ID
+	DrawInstanced,		// arg0 = メッシュ ID, arg1 = 開始インスタンス, arg2 = インスタンス数
+	DrawDynamic,		// arg0 = 動的頂点の開始位置, arg1 = 頂点数, arg2 = インスタンス
+	Count
+};
+
+struct RenderCommand
+{
+	RenderCommandType type;
+	uint32_t arg0;
+	uint32_t arg1;
+	uint32_t arg2;
+};
+
+// バックエンドに依存しない描画コマンドの記録先。
+// 1 フレーム分のコマンドとインスタンス データを保持し、実行側はこれを API 呼び出しに 1 対 1 で変換します。
+// GPU がなくてもコマンド数を数えて検証できます。
+class RenderCommandList
+{
+public:
+	RenderCommandList();
+
+	void Reset();
+
+	void SetPipelineState(uint32_t pipelineId);
+	void SetMesh(uint32_t meshId);
+	void DrawInstanced(uint32_t meshId, uint32_t startInstance, uint32_t instanceCount);
+
+	// RenderDevice::AppendDynamicVertices で追加した頂点を、インデックスなしの三角形リストとして描画します。
+	// 頂点はワールド座標で、単位行列と白のインスタンスが追加されます。
+	void DrawDynamic(uint32_t firstVertex, uint32_t vertexCount);
+
+	// インスタンス データを末尾に追加し、その開始インデックスを返します。
+	uint32_t AppendInstance(const InstanceData& instance);
+
+	const std::vector<RenderCommand>& GetCommands() const { return m_commands; }
+	const std::vector<InstanceData>& GetInstances() const { return m_instances; }
+	uint32_t GetCommandCount(RenderCommandType type) const;
+
+private:
+	void Record(RenderCommandType type, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
+	std::vector<RenderCommand> m_commands;
+	std::vector<InstanceData> m_instances;
+	uint32_t m_counts[static_cast<uint32_t>(RenderCommandType::Count)];
+};
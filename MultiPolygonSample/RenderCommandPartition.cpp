@@ -0,0 +1,73 @@
+﻿#include "RenderCommandPartition.h"
+#include <algorithm>
+#include <cassert>
+
+void RenderCommandPartitioner::Partition(
+	const RenderCommandList& commandList,
+	uint32_t maxPartitions,
+	uint32_t minDrawsPerPartition,
+	std::vector<RenderCommandPartition>& partitions
+	)
+{
+	partitions.clear();
+
+	const std::vector<RenderCommand>& commands = commandList.GetCommands();
+	if (commands.empty())
+	{
+		return;
+	}
+
+	const uint32_t drawCount =
+		commandList.GetCommandCount(RenderCommandType::DrawInstanced) +
+		commandList.GetCommandCount(RenderCommandType::DrawDynamic);
+	const uint32_t partitionCount = std::max(1u, std::min(maxPartitions, drawCount / std::max(minDrawsPerPartition, 1u)));
+	const uint32_t drawsPerPartition = (drawCount + partitionCount - 1) / partitionCount;
+
+	RenderCommandPartition partition = { 0, 0, RenderCommandPartition::NoState, RenderCommandPartition::NoState };
+	uint32_t pipelineId = RenderCommandPartition::NoState;
+	uint32_t meshId = RenderCommandPartition::NoState;
+	uint32_t partitionDraws = 0;
+	for (uint32_t i = 0; i < commands.size(); ++i)
+	{
+		// 描画の数が揃ったら、次のコマンドから新しい範囲を始めます。
+		if (partitionDraws == drawsPerPartition && partitions.size() + 1 < partitionCount)
+		{
+			partition.commandCount = i - partition.firstCommand;
+			partitions.push_back(partition);
+
+			partition.firstCommand = i;
+			partition.pipelineId = pipelineId;
+			partition.meshId = meshId;
+			partitionDraws = 0;
+		}
+
+		const RenderCommand& command = commands[i];
+		switch (command.type)
+		{
+		case RenderCommandType::SetPipelineState:
+			pipelineId = command.arg0;
+			break;
+
+		case RenderCommandType::SetMesh:
+			meshId = command.arg0;
+			break;
+
+		case RenderCommandType::DrawInstanced:
+			meshId = command.arg0;
+			++partitionDraws;
+			break;
+
+		case RenderCommandType::DrawDynamic:
+			meshId = RenderCommandPartition::NoState;
+			++partitionDraws;
+			break;
+
+		default:
+			assert(!"不明なコマンドです。");
+			break;
+		}
+	}
+
+	partition.commandCount = static_cast<uint32_t>(commands.size()) - partition.firstCommand;
+	partitions.push_back(partition);
+}
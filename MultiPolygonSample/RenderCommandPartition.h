@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderCommandList.h"
+
+// 並列に記録するための、RenderCommandList の連続したコマンドの範囲。
+// 範囲ごとに別のコマンド バッファー (D3D11 の遅延コンテキストなど) に記録し、元の順に実行します。
+// pipelineId と meshId は範囲の先頭で有効なステートで、記録する側は最初にこれを設定し直します。
+struct RenderCommandPartition
+{
+	static const uint32_t NoState = 0xFFFFFFFF;
+
+	uint32_t firstCommand;
+	uint32_t commandCount;
+	uint32_t pipelineId;	// 直前の SetPipelineState。なければ NoState
+	uint32_t meshId;		// 直前の SetMesh または DrawInstanced のメッシュ。DrawDynamic の後と先頭では NoState
+};
+
+namespace RenderCommandPartitioner
+{
+	/**
+	 * コマンドを最大 maxPartitions 個の範囲に分けます。
+	 * 描画 1 回あたりの記録の手間はほぼ同じなので、描画コマンドの数がそろうように分け、
+	 * 1 つの範囲の描画が minDrawsPerPartition 未満にならないようにします。
+	 * コマンドがなければ範囲も作りません。
+	 */
+	void Partition(
+		const RenderCommandList& commandList,
+		uint32_t maxPartitions,
+		uint32_t minDrawsPerPartition,
+		std::vector<RenderCommandPartition>& partitions
+		);
+}
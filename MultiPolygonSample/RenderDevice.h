@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ShaderStructures.h"
+#include "RenderCommandList.h"
+#include "VertexFormat.h"
+#include "ScreenRect.h"
+
+class FrameArena;
+
+// CPU 側に保持するメッシュのデータ。
+// format はデバイス上に格納するときの頂点の形式で、vertices は常に VertexPositionColor で保持します。
+// インデックスは 32 ビットで保持し、デバイスが頂点数に応じて 16 ビットか 32 ビットを選びます。
+struct MeshData
+{
+	MeshData() : format(VertexFormat::PositionColor) {}
+
+	std::vector<VertexPositionColor> vertices;
+	std::vector<uint32_t> indices;
+	VertexFormat format;
+};
+
+// 描画バックエンドの抽象インターフェイス。
+// D3D11 の実装 (D3D11RenderDevice) と CPU の実装 (SoftwareRenderDevice) があり、
+// どちらも RenderCommandList を同じ意味で実行します。
+class RenderDevice
+{
+public:
+	virtual ~RenderDevice() {}
+
+	// メッシュを作成し、コマンドで使う ID を返します。
+	virtual uint32_t CreateMesh(const MeshData& mesh) = 0;
+
+	// レンダー ターゲットを指定した色で、深度バッファーを 1.0 でクリアします。
+	// シザー矩形を設定しているときは、色も深度もその内側だけをクリアします。
+	virtual void Clear(const float color[4]) = 0;
+
+	// 以降の Clear と Execute で書き込むピクセルを rect の内側に限ります。nullptr (既定値) なら描画先全体に戻します。
+	// 矩形をクリアしてからフレームのコマンド リストを Execute すれば、描画先の一部だけを描き直せます。
+	virtual void SetScissorRect(const ScreenRect* rect) = 0;
+
+	// SimpleVertexShader.hlsl の定数バッファーと同じ内容 (転置済みの行列) を設定します。
+	virtual void SetConstants(const ModelViewProjectionConstantBuffer& constants) = 0;
+
+	// 毎フレーム変化する頂点を追加し、DrawDynamic で使う開始位置を返します。
+	// 追加した頂点は次の Execute で描画に使われ、その後破棄されます。
+	virtual uint32_t AppendDynamicVertices(const VertexPositionColor* vertices, uint32_t count) = 0;
+
+	virtual void Execute(const RenderCommandList& commandList) = 0;
+
+	// Execute でコマンドを記録するときに、最大 partitionCount 個の範囲に分けて並列に記録します。
+	// 範囲ごとの結果は元の順に実行するので、描画結果は分け方によりません。既定値は 1 です。
+	virtual void SetRecordingPartitionCount(uint32_t partitionCount) = 0;
+
+	// Execute がフレームの間だけ使う作業領域を確保するアロケーターを設定します。Reset は呼び出し側が Present の後に行います。
+	// nullptr (既定値) なら、デバイスが自分のアロケーターを持ち、Execute のたびに Reset します。
+	virtual void SetFrameArena(FrameArena* arena) = 0;
+};
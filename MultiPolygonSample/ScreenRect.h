@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// 描画先のピクセルの矩形 [left, right) × [top, bottom)。原点は左上で、y は下向きです。
+struct ScreenRect
+{
+	int32_t left;
+	int32_t top;
+	int32_t right;
+	int32_t bottom;
+
+	bool IsEmpty() const { return right <= left || bottom <= top; }
+
+	uint64_t GetArea() const
+	{
+		return IsEmpty() ? 0 : static_cast<uint64_t>(right - left) * static_cast<uint64_t>(bottom - top);
+	}
+};
+
+inline bool operator==(const ScreenRect& a, const ScreenRect& b)
+{
+	return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+inline bool operator!=(const ScreenRect& a, const ScreenRect& b)
+{
+	return !(a == b);
+}
+
+// a と b を含む最小の矩形。空の矩形は無視します。
+inline ScreenRect UnionRects(const ScreenRect& a, const ScreenRect& b)
+{
+	if (a.IsEmpty())
+	{
+		return b;
+	}
+	if (b.IsEmpty())
+	{
+		return a;
+	}
+	ScreenRect rect = { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+	return rect;
+}
+
+// a と b の共通部分。交わらなければ空の矩形になります。
+inline ScreenRect IntersectRects(const ScreenRect& a, const ScreenRect& b)
+{
+	ScreenRect rect = { std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right), std::min(a.bottom, b.bottom) };
+	return rect;
+}
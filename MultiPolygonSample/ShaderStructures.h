@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+// シェーダーと CPU 側で共有するデータ構造。
+// Windows 固有のヘッダーに依存しないので、ヘッドレスのビルドからも利用できます。
+
+struct ModelViewProjectionConstantBuffer
+{
+	DirectX::XMFLOAT4X4 model;
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+};
+
+// GPU 側では、ModelViewProjectionConstantBuffer を更新の頻度ごとに 3 つの定数バッファーに分けます。
+// b0: ウィンドウの大きさが変わったときだけ更新します。
+struct ProjectionConstantBuffer
+{
+	DirectX::XMFLOAT4X4 projection;
+};
+
+// b1: カメラが動いたときだけ更新します。
+struct ViewConstantBuffer
+{
+	DirectX::XMFLOAT4X4 view;
+};
+
+// b2: オブジェクトごとの定数。インスタンス描画では InstanceData を使うので、SimpleVertexShader だけが使います。
+struct ModelConstantBuffer
+{
+	DirectX::XMFLOAT4X4 model;
+};
+
+struct VertexPositionColor
+{
+	DirectX::XMFLOAT3 pos;
+	DirectX::XMFLOAT3 color;
+};
+
+// VertexFormat::Compact の 12 バイトの頂点。
+// pos は R16G16B16A16_SNORM で、メッシュごとの PositionQuantizationConstantBuffer で元の座標に戻します。
+// pos[3] は常に 32767 (1.0) です。color は R8G8B8A8_UNORM です。
+struct VertexPositionColorCompact
+{
+	int16_t pos[4];
+	uint8_t color[4];
+};
+
+// 量子化した位置を元に戻すための定数バッファー (b3)。位置 = snorm * scale + offset (w は使いません)。
+struct PositionQuantizationConstantBuffer
+{
+	DirectX::XMFLOAT4 scale;
+	DirectX::XMFLOAT4 offset;
+};
+
+// インスタンス描画用の 1 オブジェクト分のデータ。
+// model は定数バッファーとは異なり転置せずに格納します (入力アセンブラーで行として読み込むため)。
+// color の xyz は頂点カラーに乗算され、w は LOD のクロスフェード値 (LodSelection::IsFadeVisible) です。
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 model;
+	DirectX::XMFLOAT4 color;
+};
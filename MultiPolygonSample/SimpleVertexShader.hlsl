@@ -1,10 +1,19 @@
-cbuffer ModelViewProjectionConstantBuffer : register(b0)
+// Constant buffers are split by how often they change.
+cbuffer ProjectionConstantBuffer : register(b0)
 {
-	matrix model;
-	matrix view;
 	matrix projection;
 };
 
+cbuffer ViewConstantBuffer : register(b1)
+{
+	matrix view;
+};
+
+cbuffer ModelConstantBuffer : register(b2)
+{
+	matrix model;
+};
+
 struct VertexShaderInput
 {
 	float3 pos : POSITION;
@@ -0,0 +1,548 @@
+﻿#include "SoftwareRenderDevice.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+// 1 つのワーク アイテムで処理する頂点と三角形の数。
+static const uint32_t VerticesPerRange = 4096;
+static const uint32_t TrianglesPerRange = 2048;
+
+// コマンドの展開を分ける範囲の、最小の描画コマンド数。
+static const uint32_t MinDrawsPerPartition = 64;
+
+SoftwareRenderDevice::SoftwareRenderDevice(uint32_t width, uint32_t height, uint32_t threadCount) :
+	m_width(0),
+	m_height(0),
+	m_tilesX(0),
+	m_tilesY(0),
+	m_recordingPartitionCount(1),
+	m_ownedFrameArena(0),
+	m_frameArena(nullptr),
+	m_parallelBody(nullptr),
+	m_parallelCount(0),
+	m_parallelNext(0),
+	m_generation(0),
+	m_busyWorkers(0),
+	m_shutdown(false)
+{
+	Resize(width, height);
+	m_frameArena = &m_ownedFrameArena;
+
+	XMStoreFloat4x4(&m_constants.model, XMMatrixIdentity());
+	XMStoreFloat4x4(&m_constants.view, XMMatrixIdentity());
+	XMStoreFloat4x4(&m_constants.projection, XMMatrixIdentity());
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// 呼び出し元のスレッドも作業に参加するので、ワーカーは 1 つ少なく作ります。
+	for (uint32_t i = 1; i < threadCount; ++i)
+	{
+		m_workers.push_back(std::thread(&SoftwareRenderDevice::WorkerMain, this));
+	}
+}
+
+SoftwareRenderDevice::~SoftwareRenderDevice()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void SoftwareRenderDevice::Resize(uint32_t width, uint32_t height)
+{
+	m_width = width;
+	m_height = height;
+	m_tilesX = (width + TileSize - 1) / TileSize;
+	m_tilesY = (height + TileSize - 1) / TileSize;
+	m_color.assign(width * height, 0);
+	m_depth.assign(width * height, ReferenceRasterizer::PackDepth(1.0f));
+	SetScissorRect(nullptr);
+}
+
+uint32_t SoftwareRenderDevice::CreateMesh(const MeshData& mesh)
+{
+	SoftwareMesh softwareMesh;
+	softwareMesh.data = mesh;
+
+	// D3D11RenderDevice と同じ値で描画するように、量子化した頂点を元に戻して使います。
+	if (mesh.format == VertexFormat::Compact && !mesh.vertices.empty())
+	{
+		const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		const PositionQuantizationConstantBuffer quantization = CompactVertexEncoder::ComputeQuantization(&mesh.vertices[0], vertexCount);
+		std::vector<VertexPositionColorCompact> compactVertices(vertexCount);
+		CompactVertexEncoder::Encode(&mesh.vertices[0], vertexCount, quantization, &compactVertices[0], nullptr);
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			softwareMesh.data.vertices[i] = CompactVertexEncoder::Decode(compactVertices[i], quantization);
+		}
+	}
+
+	for (const VertexPositionColor& vertex : softwareMesh.data.vertices)
+	{
+		softwareMesh.x.push_back(vertex.pos.x);
+		softwareMesh.y.push_back(vertex.pos.y);
+		softwareMesh.z.push_back(vertex.pos.z);
+	}
+
+	m_meshes.push_back(softwareMesh);
+	return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+void SoftwareRenderDevice::Clear(const float color[4])
+{
+	const uint32_t packedColor = ReferenceRasterizer::PackColor(color[0], color[1], color[2], color[3]);
+	const uint32_t packedDepth = ReferenceRasterizer::PackDepth(1.0f);
+
+	// シザー矩形の内側を、行単位で並列にクリアします。
+	const uint32_t left = static_cast<uint32_t>(m_scissorRect.left);
+	const uint32_t right = static_cast<uint32_t>(m_scissorRect.right);
+	const uint32_t top = static_cast<uint32_t>(m_scissorRect.top);
+	ParallelFor(static_cast<uint32_t>(m_scissorRect.bottom - m_scissorRect.top), [&](uint32_t row) {
+		const uint32_t y = top + row;
+		std::fill(m_color.begin() + y * m_width + left, m_color.begin() + y * m_width + right, packedColor);
+		std::fill(m_depth.begin() + y * m_width + left, m_depth.begin() + y * m_width + right, packedDepth);
+	});
+}
+
+void SoftwareRenderDevice::SetScissorRect(const ScreenRect* rect)
+{
+	const ScreenRect target = { 0, 0, static_cast<int32_t>(m_width), static_cast<int32_t>(m_height) };
+	m_scissorRect = rect != nullptr ? IntersectRects(*rect, target) : target;
+	if (m_scissorRect.IsEmpty())
+	{
+		const ScreenRect empty = { 0, 0, 0, 0 };
+		m_scissorRect = empty;
+	}
+}
+
+void SoftwareRenderDevice::SetConstants(const ModelViewProjectionConstantBuffer& constants)
+{
+	m_constants = constants;
+}
+
+uint32_t SoftwareRenderDevice::AppendDynamicVertices(const VertexPositionColor* vertices, uint32_t count)
+{
+	const uint32_t firstVertex = static_cast<uint32_t>(m_dynamicMesh.data.vertices.size());
+	m_dynamicMesh.data.vertices.insert(m_dynamicMesh.data.vertices.end(), vertices, vertices + count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		m_dynamicMesh.x.push_back(vertices[i].pos.x);
+		m_dynamicMesh.y.push_back(vertices[i].pos.y);
+		m_dynamicMesh.z.push_back(vertices[i].pos.z);
+	}
+	return firstVertex;
+}
+
+void SoftwareRenderDevice::Execute(const RenderCommandList& commandList)
+{
+	if (m_frameArena == &m_ownedFrameArena)
+	{
+		m_ownedFrameArena.Reset();
+	}
+	ExecuteCommands(commandList);
+
+	m_dynamicMesh.data.vertices.clear();
+	m_dynamicMesh.x.clear();
+	m_dynamicMesh.y.clear();
+	m_dynamicMesh.z.clear();
+}
+
+void SoftwareRenderDevice::SetRecordingPartitionCount(uint32_t partitionCount)
+{
+	m_recordingPartitionCount = std::max(partitionCount, 1u);
+}
+
+void SoftwareRenderDevice::SetFrameArena(FrameArena* arena)
+{
+	m_frameArena = arena != nullptr ? arena : &m_ownedFrameArena;
+}
+
+void SoftwareRenderDevice::ExecuteCommands(const RenderCommandList& commandList)
+{
+	// コマンドを範囲ごとに並列にインスタンス単位の描画に展開し、元の順に連結します。
+	// 連結した結果は、すべてのコマンドを 1 つのスレッドで展開した場合と同じです。
+	RenderCommandPartitioner::Partition(commandList, m_recordingPartitionCount, MinDrawsPerPartition, m_partitions);
+	if (m_recordedPartitions.size() < m_partitions.size())
+	{
+		m_recordedPartitions.resize(m_partitions.size());
+	}
+
+	ParallelFor(static_cast<uint32_t>(m_partitions.size()), [&](uint32_t i) {
+		RecordPartition(commandList, m_partitions[i], m_recordedPartitions[i]);
+	});
+
+	m_records.clear();
+	m_vertexRanges.clear();
+	m_triangleRanges.clear();
+	uint32_t vertexCount = 0;
+	for (size_t p = 0; p < m_partitions.size(); ++p)
+	{
+		const RecordedPartition& partition = m_recordedPartitions[p];
+		const uint32_t recordBase = static_cast<uint32_t>(m_records.size());
+		for (DrawRecord record : partition.records)
+		{
+			record.firstVertex += vertexCount;
+			m_records.push_back(record);
+		}
+		for (WorkRange range : partition.vertexRanges)
+		{
+			range.record += recordBase;
+			m_vertexRanges.push_back(range);
+		}
+		for (WorkRange range : partition.triangleRanges)
+		{
+			range.record += recordBase;
+			m_triangleRanges.push_back(range);
+		}
+		vertexCount += partition.vertexCount;
+	}
+
+	if (m_records.empty())
+	{
+		return;
+	}
+
+	m_clipX.resize(vertexCount);
+	m_clipY.resize(vertexCount);
+	m_clipZ.resize(vertexCount);
+	m_clipW.resize(vertexCount);
+	m_clipCodes.resize(vertexCount);
+	if (m_chunks.size() < m_triangleRanges.size())
+	{
+		m_chunks.resize(m_triangleRanges.size());
+	}
+
+	ParallelFor(static_cast<uint32_t>(m_vertexRanges.size()), [&](uint32_t i) {
+		TransformVertices(m_vertexRanges[i]);
+	});
+
+	ParallelFor(static_cast<uint32_t>(m_triangleRanges.size()), [&](uint32_t i) {
+		SetupAndBinTriangles(m_triangleRanges[i], commandList, m_chunks[i]);
+	});
+
+	ParallelFor(m_tilesX * m_tilesY, [&](uint32_t tile) {
+		RasterizeTile(tile);
+	});
+}
+
+void SoftwareRenderDevice::RecordPartition(
+	const RenderCommandList& commandList,
+	const RenderCommandPartition& partition,
+	RecordedPartition& output
+	)
+{
+	output.records.clear();
+	output.vertexRanges.clear();
+	output.triangleRanges.clear();
+	output.vertexCount = 0;
+
+	// 範囲より前に SetPipelineState がなければ、D3D11RenderDevice と同じく PipelineDefault から始めます。
+	CullMode cullMode = GetPipelineCullMode(partition.pipelineId != RenderCommandPartition::NoState ? partition.pipelineId : PipelineDefault);
+	const std::vector<RenderCommand>& commands = commandList.GetCommands();
+	for (uint32_t c = partition.firstCommand; c < partition.firstCommand + partition.commandCount; ++c)
+	{
+		const RenderCommand& command = commands[c];
+		if (command.type == RenderCommandType::SetPipelineState)
+		{
+			cullMode = GetPipelineCullMode(command.arg0);
+		}
+		else if (command.type == RenderCommandType::DrawInstanced)
+		{
+			const SoftwareMesh& mesh = m_meshes[command.arg0];
+			for (uint32_t i = 0; i < command.arg2; ++i)
+			{
+				AddDrawRecord(
+					output,
+					mesh,
+					0,
+					static_cast<uint32_t>(mesh.data.vertices.size()),
+					static_cast<uint32_t>(mesh.data.indices.size() / 3),
+					true,
+					command.arg1 + i,
+					cullMode,
+					commandList
+					);
+			}
+		}
+		else if (command.type == RenderCommandType::DrawDynamic)
+		{
+			AddDrawRecord(
+				output,
+				m_dynamicMesh,
+				command.arg0,
+				command.arg1,
+				command.arg1 / 3,
+				false,
+				command.arg2,
+				cullMode,
+				commandList
+				);
+		}
+	}
+}
+
+// 1 インスタンス分の描画を追加し、頂点と三角形をワーク アイテムに分割します。
+void SoftwareRenderDevice::AddDrawRecord(
+	RecordedPartition& output,
+	const SoftwareMesh& mesh,
+	uint32_t vertexBase,
+	uint32_t meshVertexCount,
+	uint32_t meshTriangleCount,
+	bool indexed,
+	uint32_t instance,
+	CullMode cullMode,
+	const RenderCommandList& commandList
+	)
+{
+	DrawRecord record;
+	record.mesh = &mesh;
+	record.vertexBase = vertexBase;
+	record.indexed = indexed;
+	record.instance = instance;
+	record.cullMode = cullMode;
+	record.firstVertex = output.vertexCount;
+	record.transform = VertexTransform::ComposeInstanceViewProjection(
+		commandList.GetInstances()[instance].model,
+		m_constants
+		);
+
+	const uint32_t recordIndex = static_cast<uint32_t>(output.records.size());
+	output.records.push_back(record);
+	output.vertexCount += meshVertexCount;
+
+	for (uint32_t begin = 0; begin < meshVertexCount; begin += VerticesPerRange)
+	{
+		WorkRange range = { recordIndex, begin, std::min(begin + VerticesPerRange, meshVertexCount) };
+		output.vertexRanges.push_back(range);
+	}
+	for (uint32_t begin = 0; begin < meshTriangleCount; begin += TrianglesPerRange)
+	{
+		WorkRange range = { recordIndex, begin, std::min(begin + TrianglesPerRange, meshTriangleCount) };
+		output.triangleRanges.push_back(range);
+	}
+}
+
+// 頂点シェーダーの位置の変換に相当する処理です。
+// model, view, projection は DrawRecord で 1 つの行列にまとめてあり、SoA のまま一括で変換します。
+void SoftwareRenderDevice::TransformVertices(const WorkRange& range)
+{
+	const DrawRecord& record = m_records[range.record];
+	const SoftwareMesh& mesh = *record.mesh;
+	const uint32_t first = record.firstVertex + range.begin;
+	const uint32_t source = record.vertexBase + range.begin;
+
+	PositionStream input;
+	input.x = &mesh.x[source];
+	input.y = &mesh.y[source];
+	input.z = &mesh.z[source];
+
+	ClipSpaceStream output;
+	output.x = &m_clipX[first];
+	output.y = &m_clipY[first];
+	output.z = &m_clipZ[first];
+	output.w = &m_clipW[first];
+	output.clipCodes = &m_clipCodes[first];
+
+	VertexTransform::TransformPositions(record.transform, input, range.end - range.begin, output);
+}
+
+void SoftwareRenderDevice::SetupAndBinTriangles(const WorkRange& range, const RenderCommandList& commandList, TriangleChunk& chunk)
+{
+	const DrawRecord& record = m_records[range.record];
+	const MeshData& mesh = record.mesh->data;
+	const XMFLOAT4& tint = commandList.GetInstances()[record.instance].color;
+	const uint32_t base = record.firstVertex;
+
+	chunk.triangles.clear();
+	ScreenTriangle clipped[ReferenceRasterizer::MaxClippedTriangles];
+	for (uint32_t t = range.begin; t < range.end; ++t)
+	{
+		uint32_t index[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			index[k] = record.indexed ? mesh.indices[t * 3 + k] : t * 3 + k;
+		}
+
+		// 3 頂点とも同じ平面の外側にある三角形は、セットアップせずに捨てます。
+		if ((m_clipCodes[base + index[0]] & m_clipCodes[base + index[1]] & m_clipCodes[base + index[2]]) != 0)
+		{
+			continue;
+		}
+
+		ClipVertex vertices[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t v = base + index[k];
+			const XMFLOAT3& color = mesh.vertices[record.vertexBase + index[k]].color;
+			vertices[k].x = m_clipX[v];
+			vertices[k].y = m_clipY[v];
+			vertices[k].z = m_clipZ[v];
+			vertices[k].w = m_clipW[v];
+			vertices[k].r = color.x * tint.x;
+			vertices[k].g = color.y * tint.y;
+			vertices[k].b = color.z * tint.z;
+		}
+
+		uint32_t count = ReferenceRasterizer::SetupTriangle(
+			vertices[0],
+			vertices[1],
+			vertices[2],
+			record.cullMode,
+			m_width,
+			m_height,
+			clipped
+			);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			clipped[i].fade = tint.w;
+		}
+		chunk.triangles.insert(chunk.triangles.end(), clipped, clipped + count);
+	}
+
+	// 計数ソートで三角形をタイルごとのビンに振り分けます。
+	const uint32_t tileCount = m_tilesX * m_tilesY;
+	chunk.binOffsets = m_frameArena->AllocateArray<uint32_t>(tileCount + 1);
+	std::fill(chunk.binOffsets, chunk.binOffsets + tileCount + 1, 0u);
+	for (const ScreenTriangle& triangle : chunk.triangles)
+	{
+		for (int32_t ty = triangle.minY / TileSize; ty <= (triangle.maxY - 1) / static_cast<int32_t>(TileSize); ++ty)
+		{
+			for (int32_t tx = triangle.minX / TileSize; tx <= (triangle.maxX - 1) / static_cast<int32_t>(TileSize); ++tx)
+			{
+				chunk.binOffsets[ty * m_tilesX + tx + 1]++;
+			}
+		}
+	}
+	for (uint32_t tile = 0; tile < tileCount; ++tile)
+	{
+		chunk.binOffsets[tile + 1] += chunk.binOffsets[tile];
+	}
+
+	chunk.binTriangles = m_frameArena->AllocateArray<uint32_t>(chunk.binOffsets[tileCount]);
+	uint32_t* cursor = m_frameArena->AllocateArray<uint32_t>(tileCount);
+	std::copy(chunk.binOffsets, chunk.binOffsets + tileCount, cursor);
+	for (uint32_t i = 0; i < chunk.triangles.size(); ++i)
+	{
+		const ScreenTriangle& triangle = chunk.triangles[i];
+		for (int32_t ty = triangle.minY / TileSize; ty <= (triangle.maxY - 1) / static_cast<int32_t>(TileSize); ++ty)
+		{
+			for (int32_t tx = triangle.minX / TileSize; tx <= (triangle.maxX - 1) / static_cast<int32_t>(TileSize); ++tx)
+			{
+				chunk.binTriangles[cursor[ty * m_tilesX + tx]++] = i;
+			}
+		}
+	}
+}
+
+// ピクセル シェーダーに相当する処理です。タイルは重ならないので、ロックなしで書き込めます。
+void SoftwareRenderDevice::RasterizeTile(uint32_t tile)
+{
+	// タイルをシザー矩形で切り取り、外側のタイルは何もしません。
+	const int32_t tileX = static_cast<int32_t>((tile % m_tilesX) * TileSize);
+	const int32_t tileY = static_cast<int32_t>((tile / m_tilesX) * TileSize);
+	const int32_t minX = std::max(tileX, m_scissorRect.left);
+	const int32_t minY = std::max(tileY, m_scissorRect.top);
+	const int32_t maxX = std::min(tileX + static_cast<int32_t>(TileSize), m_scissorRect.right);
+	const int32_t maxY = std::min(tileY + static_cast<int32_t>(TileSize), m_scissorRect.bottom);
+	if (minX >= maxX || minY >= maxY)
+	{
+		return;
+	}
+
+	for (size_t c = 0; c < m_triangleRanges.size(); ++c)
+	{
+		const TriangleChunk& chunk = m_chunks[c];
+		for (uint32_t i = chunk.binOffsets[tile]; i < chunk.binOffsets[tile + 1]; ++i)
+		{
+			ReferenceRasterizer::RasterizeTriangle(
+				chunk.triangles[chunk.binTriangles[i]],
+				minX,
+				minY,
+				maxX,
+				maxY,
+				0,
+				0,
+				m_width,
+				&m_color[0],
+				&m_depth[0]
+				);
+		}
+	}
+}
+
+// body(0) から body(count - 1) までを全スレッドで分担して実行し、すべて終わるまで待ちます。
+void SoftwareRenderDevice::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& body)
+{
+	if (m_workers.empty() || count <= 1)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			body(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_parallelBody = &body;
+		m_parallelCount = count;
+		m_parallelNext = 0;
+		m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	RunParallelItems();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this] { return m_busyWorkers == 0; });
+	m_parallelBody = nullptr;
+}
+
+void SoftwareRenderDevice::RunParallelItems()
+{
+	for (;;)
+	{
+		uint32_t i = m_parallelNext.fetch_add(1);
+		if (i >= m_parallelCount)
+		{
+			break;
+		}
+		(*m_parallelBody)(i);
+	}
+}
+
+void SoftwareRenderDevice::WorkerMain()
+{
+	uint32_t generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&] { return m_shutdown || m_generation != generation; });
+			if (m_shutdown)
+			{
+				return;
+			}
+			generation = m_generation;
+		}
+
+		RunParallelItems();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busyWorkers == 0)
+		{
+			m_doneCondition.notify_one();
+		}
+	}
+}
@@ -0,0 +1,165 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RenderDevice.h"
+#include "ReferenceRasterizer.h"
+#include "VertexTransform.h"
+#include "RenderCommandPartition.h"
+#include "FrameArena.h"
+
+// CPU だけで描画するデバイス。CoreWindow や GPU のない環境 (Linux の CI など) で使います。
+// SimpleVertexShader.hlsl / InstancedVertexShader.hlsl と同じ変換と SimplePixelShader.hlsl と同じ色で、
+// メモリ上の BGRA8 のレンダー ターゲットと D24 の深度バッファーに描画します。
+//
+// 1 フレームは次の 3 段階で処理され、それぞれをワーカー スレッドで並列に実行します。
+//  0. コマンドの展開 (RenderCommandPartitioner の範囲単位。範囲ごとの結果を元の順に連結します)
+//  1. 頂点変換 (頂点のブロック単位、VertexTransform の SIMD カーネルを使用)
+//  2. 三角形のセットアップとタイルへのビニング (三角形のブロック単位)
+//  3. ラスタライズ (タイル単位)
+// タイル内では三角形を投入順に処理するので、結果はスレッド数に依存しません。
+class SoftwareRenderDevice : public RenderDevice
+{
+public:
+	// threadCount に 0 を指定すると、ハードウェア スレッド数を使います。
+	SoftwareRenderDevice(uint32_t width, uint32_t height, uint32_t threadCount);
+	virtual ~SoftwareRenderDevice();
+
+	void Resize(uint32_t width, uint32_t height);
+
+	// RenderDevice メソッド。
+	virtual uint32_t CreateMesh(const MeshData& mesh) override;
+	virtual void Clear(const float color[4]) override;
+	virtual void SetScissorRect(const ScreenRect* rect) override;
+	virtual void SetConstants(const ModelViewProjectionConstantBuffer& constants) override;
+	virtual uint32_t AppendDynamicVertices(const VertexPositionColor* vertices, uint32_t count) override;
+	virtual void Execute(const RenderCommandList& commandList) override;
+	virtual void SetRecordingPartitionCount(uint32_t partitionCount) override;
+	virtual void SetFrameArena(FrameArena* arena) override;
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+	// BGRA8 のカラー バッファーと D24 の深度バッファー (下位 24 ビット)。
+	const std::vector<uint32_t>& GetColorBuffer() const { return m_color; }
+	const std::vector<uint32_t>& GetDepthBuffer() const { return m_depth; }
+
+	static const uint32_t TileSize = 64;
+
+private:
+	// 頂点の位置を SoA 形式でも保持するメッシュ。
+	struct SoftwareMesh
+	{
+		MeshData data;
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+	};
+
+	// 1 インスタンス分の描画。
+	// インデックスなしの描画 (DrawDynamic) では、vertexBase から 3 頂点ずつが三角形になります。
+	struct DrawRecord
+	{
+		const SoftwareMesh* mesh;
+		uint32_t vertexBase;	// mesh 内の開始頂点
+		bool indexed;
+		uint32_t instance;
+		CullMode cullMode;
+		uint32_t firstVertex;	// クリップ空間のストリーム内の開始位置
+		DirectX::XMFLOAT4X4 transform;	// インスタンスの model * view * projection
+	};
+
+	// 頂点または三角形のブロック。
+	struct WorkRange
+	{
+		uint32_t record;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	// 三角形のブロックごとのセットアップ結果とタイルのビン。
+	// ビンの大きさはフレームごとに変わるので、フレームの作業領域に置きます。
+	struct TriangleChunk
+	{
+		std::vector<ScreenTriangle> triangles;
+		uint32_t* binOffsets;	// タイルごとの binTriangles 内の開始位置 (タイル数 + 1 個)
+		uint32_t* binTriangles;
+	};
+
+	// 1 つの範囲のコマンドを展開した結果。
+	// firstVertex と WorkRange::record は範囲内での値で、連結するときに付け直します。
+	struct RecordedPartition
+	{
+		std::vector<DrawRecord> records;
+		std::vector<WorkRange> vertexRanges;
+		std::vector<WorkRange> triangleRanges;
+		uint32_t vertexCount;
+	};
+
+	void ExecuteCommands(const RenderCommandList& commandList);
+	void RecordPartition(const RenderCommandList& commandList, const RenderCommandPartition& partition, RecordedPartition& output);
+	void AddDrawRecord(
+		RecordedPartition& output,
+		const SoftwareMesh& mesh,
+		uint32_t vertexBase,
+		uint32_t meshVertexCount,
+		uint32_t meshTriangleCount,
+		bool indexed,
+		uint32_t instance,
+		CullMode cullMode,
+		const RenderCommandList& commandList
+		);
+	void TransformVertices(const WorkRange& range);
+	void SetupAndBinTriangles(const WorkRange& range, const RenderCommandList& commandList, TriangleChunk& chunk);
+	void RasterizeTile(uint32_t tile);
+
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& body);
+	void RunParallelItems();
+	void WorkerMain();
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_tilesX;
+	uint32_t m_tilesY;
+	std::vector<uint32_t> m_color;
+	std::vector<uint32_t> m_depth;
+	ScreenRect m_scissorRect;	// 描画先の内側に切り取ったシザー矩形。設定していなければ描画先全体です
+
+	std::vector<SoftwareMesh> m_meshes;
+	SoftwareMesh m_dynamicMesh;		// AppendDynamicVertices で追加された頂点
+	ModelViewProjectionConstantBuffer m_constants;
+
+	// フレームごとの作業領域。確保したメモリは次のフレームで再利用します。
+	uint32_t m_recordingPartitionCount;
+	std::vector<RenderCommandPartition> m_partitions;
+	std::vector<RecordedPartition> m_recordedPartitions;
+	std::vector<DrawRecord> m_records;
+	std::vector<WorkRange> m_vertexRanges;
+	std::vector<WorkRange> m_triangleRanges;
+	std::vector<float> m_clipX;
+	std::vector<float> m_clipY;
+	std::vector<float> m_clipZ;
+	std::vector<float> m_clipW;
+	std::vector<uint8_t> m_clipCodes;
+	std::vector<TriangleChunk> m_chunks;
+	FrameArena m_ownedFrameArena;	// SetFrameArena で指定されていないときに使うアロケーター
+	FrameArena* m_frameArena;
+
+	// ワーカー スレッド。
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	const std::function<void(uint32_t)>* m_parallelBody;
+	uint32_t m_parallelCount;
+	std::atomic<uint32_t> m_parallelNext;
+	uint32_t m_generation;
+	uint32_t m_busyWorkers;
+	bool m_shutdown;
+};
@@ -0,0 +1,147 @@
+﻿#include "VertexFormat.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+static const float SnormMax = 32767.0f;
+static const float UnormMax = 255.0f;
+
+uint32_t GetVertexStride(VertexFormat format)
+{
+	return format == VertexFormat::Compact ? sizeof(VertexPositionColorCompact) : sizeof(VertexPositionColor);
+}
+
+static int16_t EncodeSnorm16(float value)
+{
+	const float clamped = std::min(std::max(value, -1.0f), 1.0f);
+	return static_cast<int16_t>(floorf(clamped * SnormMax + 0.5f));
+}
+
+// D3D の SNORM の変換規則では -32768 と -32767 がどちらも -1.0 になります。
+static float DecodeSnorm16(int16_t value)
+{
+	return std::max(value / SnormMax, -1.0f);
+}
+
+static uint8_t EncodeUnorm8(float value)
+{
+	const float clamped = std::min(std::max(value, 0.0f), 1.0f);
+	return static_cast<uint8_t>(floorf(clamped * UnormMax + 0.5f));
+}
+
+PositionQuantizationConstantBuffer CompactVertexEncoder::ComputeQuantization(const VertexPositionColor* vertices, uint32_t count)
+{
+	XMFLOAT3 minimum(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 maximum(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const XMFLOAT3& pos = vertices[i].pos;
+		minimum = XMFLOAT3(std::min(minimum.x, pos.x), std::min(minimum.y, pos.y), std::min(minimum.z, pos.z));
+		maximum = XMFLOAT3(std::max(maximum.x, pos.x), std::max(maximum.y, pos.y), std::max(maximum.z, pos.z));
+	}
+
+	PositionQuantizationConstantBuffer quantization;
+	if (count == 0)
+	{
+		quantization.scale = XMFLOAT4(1.0f, 1.0f, 1.0f, 0.0f);
+		quantization.offset = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+		return quantization;
+	}
+
+	// 幅のない軸は scale を 1 にして、0 除算を避けます。
+	const float minimums[] = { minimum.x, minimum.y, minimum.z };
+	const float maximums[] = { maximum.x, maximum.y, maximum.z };
+	float scale[3];
+	float offset[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		offset[axis] = (minimums[axis] + maximums[axis]) * 0.5f;
+		const float extent = std::max(maximums[axis] - offset[axis], offset[axis] - minimums[axis]);
+		scale[axis] = extent > 0.0f ? extent : 1.0f;
+	}
+
+	quantization.scale = XMFLOAT4(scale[0], scale[1], scale[2], 0.0f);
+	quantization.offset = XMFLOAT4(offset[0], offset[1], offset[2], 0.0f);
+	return quantization;
+}
+
+// 量子化の誤差 (半ステップ) に、浮動小数点の積和による丸め誤差を加えたものです。
+CompactVertexError CompactVertexEncoder::GetErrorBound(const PositionQuantizationConstantBuffer& quantization)
+{
+	const XMFLOAT4& s = quantization.scale;
+	const XMFLOAT4& o = quantization.offset;
+
+	CompactVertexError bound;
+	bound.position = XMFLOAT3(
+		s.x * (0.5f / SnormMax) + (s.x + fabsf(o.x)) * 2.0f * FLT_EPSILON,
+		s.y * (0.5f / SnormMax) + (s.y + fabsf(o.y)) * 2.0f * FLT_EPSILON,
+		s.z * (0.5f / SnormMax) + (s.z + fabsf(o.z)) * 2.0f * FLT_EPSILON
+		);
+	bound.color = 0.5f / UnormMax + FLT_EPSILON;
+	return bound;
+}
+
+void CompactVertexEncoder::Encode(
+	const VertexPositionColor* vertices,
+	uint32_t count,
+	const PositionQuantizationConstantBuffer& quantization,
+	VertexPositionColorCompact* output,
+	CompactVertexError* error
+	)
+{
+	const XMFLOAT4& s = quantization.scale;
+	const XMFLOAT4& o = quantization.offset;
+
+	CompactVertexError maximum = { XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f };
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const VertexPositionColor& vertex = vertices[i];
+		VertexPositionColorCompact& encoded = output[i];
+
+		encoded.pos[0] = EncodeSnorm16((vertex.pos.x - o.x) / s.x);
+		encoded.pos[1] = EncodeSnorm16((vertex.pos.y - o.y) / s.y);
+		encoded.pos[2] = EncodeSnorm16((vertex.pos.z - o.z) / s.z);
+		encoded.pos[3] = static_cast<int16_t>(SnormMax);
+		encoded.color[0] = EncodeUnorm8(vertex.color.x);
+		encoded.color[1] = EncodeUnorm8(vertex.color.y);
+		encoded.color[2] = EncodeUnorm8(vertex.color.z);
+		encoded.color[3] = static_cast<uint8_t>(UnormMax);
+
+		if (error != nullptr)
+		{
+			const VertexPositionColor decoded = Decode(encoded, quantization);
+			maximum.position.x = std::max(maximum.position.x, fabsf(decoded.pos.x - vertex.pos.x));
+			maximum.position.y = std::max(maximum.position.y, fabsf(decoded.pos.y - vertex.pos.y));
+			maximum.position.z = std::max(maximum.position.z, fabsf(decoded.pos.z - vertex.pos.z));
+			maximum.color = std::max(maximum.color, fabsf(decoded.color.x - vertex.color.x));
+			maximum.color = std::max(maximum.color, fabsf(decoded.color.y - vertex.color.y));
+			maximum.color = std::max(maximum.color, fabsf(decoded.color.z - vertex.color.z));
+		}
+	}
+
+	if (error != nullptr)
+	{
+		*error = maximum;
+	}
+}
+
+VertexPositionColor CompactVertexEncoder::Decode(const VertexPositionColorCompact& vertex, const PositionQuantizationConstantBuffer& quantization)
+{
+	const XMFLOAT4& s = quantization.scale;
+	const XMFLOAT4& o = quantization.offset;
+
+	VertexPositionColor decoded;
+	decoded.pos = XMFLOAT3(
+		DecodeSnorm16(vertex.pos[0]) * s.x + o.x,
+		DecodeSnorm16(vertex.pos[1]) * s.y + o.y,
+		DecodeSnorm16(vertex.pos[2]) * s.z + o.z
+		);
+	decoded.color = XMFLOAT3(
+		vertex.color[0] / UnormMax,
+		vertex.color[1] / UnormMax,
+		vertex.color[2] / UnormMax
+		);
+	return decoded;
+}
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cstdint>
+#include "ShaderStructures.h"
+
+// デバイス上の頂点バッファーの形式。
+enum class VertexFormat : uint32_t
+{
+	PositionColor,	// VertexPositionColor (24 バイト)
+	Compact			// VertexPositionColorCompact (12 バイト)
+};
+
+uint32_t GetVertexStride(VertexFormat format);
+
+// 各成分の最大の絶対誤差。
+struct CompactVertexError
+{
+	DirectX::XMFLOAT3 position;
+	float color;
+};
+
+// VertexPositionColor と VertexPositionColorCompact の変換。
+// 位置はメッシュの境界ボックスを [-1, 1] に写して 16 ビットに量子化するので、
+// 誤差は軸ごとに境界ボックスの半分の長さ / 65534 程度に収まります。
+// 色は [0, 1] にクランプして 8 ビットに量子化し、誤差は 0.5 / 255 以下です。
+namespace CompactVertexEncoder
+{
+	PositionQuantizationConstantBuffer ComputeQuantization(const VertexPositionColor* vertices, uint32_t count);
+
+	// 量子化パラメーターから決まる誤差の上限。[0, 1] の範囲外の色はこの上限に含まれません。
+	CompactVertexError GetErrorBound(const PositionQuantizationConstantBuffer& quantization);
+
+	// count 個の頂点をエンコードします。error が nullptr でなければ、実際の最大誤差を返します。
+	void Encode(
+		const VertexPositionColor* vertices,
+		uint32_t count,
+		const PositionQuantizationConstantBuffer& quantization,
+		VertexPositionColorCompact* output,
+		CompactVertexError* error
+		);
+
+	// 入力アセンブラーと CompactInstancedVertexShader.hlsl と同じ計算で元に戻します。
+	VertexPositionColor Decode(const VertexPositionColorCompact& vertex, const PositionQuantizationConstantBuffer& quantization);
+}
@@ -0,0 +1,136 @@
+﻿#include "VertexRingBuffer.h"
+#include <cstring>
+
+VertexRingBuffer::VertexRingBuffer(DynamicBufferDevice& device) :
+	m_device(device),
+	m_capacity(device.GetCapacity()),
+	m_head(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool VertexRingBuffer::Write(const void* data, uint32_t size, uint32_t alignment, uint32_t* offset)
+{
+	if (size == 0 || size > m_capacity)
+	{
+		m_stats.failedWrites++;
+		return false;
+	}
+
+	RetireCompletedRanges();
+
+	BufferMapMode mode = BufferMapMode::NoOverwrite;
+	uint32_t begin = (m_head + alignment - 1) / alignment * alignment;
+	if (begin + size > m_capacity || !IsFree(begin, begin + size))
+	{
+		// 末尾に入らなければ先頭に戻ります。
+		begin = 0;
+		if (IsFree(0, size))
+		{
+			m_stats.wraps++;
+		}
+		else if (m_unsubmitted.empty())
+		{
+			// GPU が使用中の領域と重なるので、バッファーごと破棄します。
+			// 発行済みの描画は古いメモリを参照し続けるので、保護していた領域はすべて解放できます。
+			mode = BufferMapMode::Discard;
+			m_pending.clear();
+			m_stats.discards++;
+		}
+		else
+		{
+			// 破棄すると、まだ描画を発行していない領域の内容が失われます。
+			m_stats.failedWrites++;
+			return false;
+		}
+	}
+
+	uint8_t* mapped = m_device.Map(mode, begin, size);
+	memcpy(mapped + begin, data, size);
+	m_device.Unmap();
+
+	// 未発行の領域を広げます。先頭に戻った場合は新しい領域を始めます。
+	if (!m_unsubmitted.empty() && m_unsubmitted.back().end <= begin)
+	{
+		m_unsubmitted.back().end = begin + size;
+	}
+	else
+	{
+		PendingRange range;
+		range.fence = 0;
+		range.begin = begin;
+		range.end = begin + size;
+		m_unsubmitted.push_back(range);
+	}
+	m_head = begin + size;
+
+	m_stats.bytesWritten += size;
+	m_stats.writes++;
+	*offset = begin;
+	return true;
+}
+
+void VertexRingBuffer::Submit()
+{
+	if (m_unsubmitted.empty())
+	{
+		return;
+	}
+
+	const uint64_t fence = m_device.InsertFence();
+	for (PendingRange& range : m_unsubmitted)
+	{
+		range.fence = fence;
+		m_pending.push_back(range);
+	}
+	m_unsubmitted.clear();
+}
+
+uint32_t VertexRingBuffer::GetBytesInFlight() const
+{
+	uint32_t bytes = 0;
+	for (const PendingRange& range : m_pending)
+	{
+		bytes += range.end - range.begin;
+	}
+	for (const PendingRange& range : m_unsubmitted)
+	{
+		bytes += range.end - range.begin;
+	}
+	return bytes;
+}
+
+// フェンスが完了した領域を古い順に解放します。
+void VertexRingBuffer::RetireCompletedRanges()
+{
+	if (m_pending.empty())
+	{
+		return;
+	}
+
+	const uint64_t completed = m_device.GetCompletedFence();
+	while (!m_pending.empty() && m_pending.front().fence <= completed)
+	{
+		m_pending.pop_front();
+	}
+}
+
+// [begin, end) が保護中の領域とも未発行の領域とも重ならないかどうかを返します。
+bool VertexRingBuffer::IsFree(uint32_t begin, uint32_t end) const
+{
+	for (const PendingRange& range : m_pending)
+	{
+		if (begin < range.end && range.begin < end)
+		{
+			return false;
+		}
+	}
+	for (const PendingRange& range : m_unsubmitted)
+	{
+		if (begin < range.end && range.begin < end)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "DynamicBufferDevice.h"
+
+struct RingBufferStats
+{
+	uint64_t bytesWritten;
+	uint32_t writes;
+	uint32_t wraps;			// 先頭に戻って NO_OVERWRITE で書き込んだ回数
+	uint32_t discards;		// 空きがなく DISCARD した回数
+	uint32_t failedWrites;	// 容量より大きいか、Submit していない領域のために空きがなく書き込めなかった回数
+};
+
+// 毎フレーム変化する頂点データをストリーミングするためのリング バッファー。
+// 書き込みは通常 NO_OVERWRITE で行い、GPU がまだ読んでいる可能性のある領域はフェンスで保護します。
+// リングの先頭に戻っても空きがない場合だけ DISCARD でバッファーを作り直します。
+//
+// 使い方: Write で得たオフセットを参照する描画を発行してから Submit を呼び出します。
+// Submit までの Write はいくつでもかまいませんが、フェンスは Submit でまとめて発行します。
+// DISCARD は発行済みの描画には影響しない一方、未発行の描画が参照する内容は失われるので、
+// Submit していない領域があるときに DISCARD が必要になった Write は失敗します。
+class VertexRingBuffer
+{
+public:
+	explicit VertexRingBuffer(DynamicBufferDevice& device);
+
+	// data を alignment の倍数のオフセットに書き込みます。
+	// 容量より大きい場合と、Submit していない領域があるのに空きがない場合は false を返します。
+	bool Write(const void* data, uint32_t size, uint32_t alignment, uint32_t* offset);
+
+	// 直前の Submit 以降に書き込んだ領域を、フェンスで保護します。
+	void Submit();
+
+	const RingBufferStats& GetStats() const { return m_stats; }
+
+	// GPU がまだ使用中の可能性があるバイト数。
+	uint32_t GetBytesInFlight() const;
+
+private:
+	// 書き込み済みの領域 [begin, end)。fence は Submit で発行したフェンスで、未発行の領域では使いません。
+	struct PendingRange
+	{
+		uint64_t fence;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	void RetireCompletedRanges();
+	bool IsFree(uint32_t begin, uint32_t end) const;
+
+	DynamicBufferDevice& m_device;
+	uint32_t m_capacity;
+	uint32_t m_head;			// 次に書き込む位置
+	std::vector<PendingRange> m_unsubmitted;	// 先頭に戻ると 2 つに分かれます
+	std::deque<PendingRange> m_pending;
+	RingBufferStats m_stats;
+};
@@ -0,0 +1,296 @@
+﻿#include "VertexTransform.h"
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VERTEX_TRANSFORM_AVX
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define VERTEX_TRANSFORM_SSE2
+#elif defined(_M_ARM) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VERTEX_TRANSFORM_NEON
+#endif
+
+using namespace DirectX;
+
+XMFLOAT4X4 VertexTransform::ComposeModelViewProjection(const ModelViewProjectionConstantBuffer& constants)
+{
+	XMMATRIX model = XMMatrixTranspose(XMLoadFloat4x4(&constants.model));
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&constants.view));
+	XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&constants.projection));
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, XMMatrixMultiply(XMMatrixMultiply(model, view), projection));
+	return result;
+}
+
+XMFLOAT4X4 VertexTransform::ComposeInstanceViewProjection(
+	const XMFLOAT4X4& instanceModel,
+	const ModelViewProjectionConstantBuffer& constants
+	)
+{
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&constants.view));
+	XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&constants.projection));
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, XMMatrixMultiply(XMMatrixMultiply(XMLoadFloat4x4(&instanceModel), view), projection));
+	return result;
+}
+
+// 1 頂点分のクリップ コードを求めます。
+static inline uint8_t ComputeClipCode(float x, float y, float z, float w)
+{
+	uint8_t code = 0;
+	if (x < -w) code |= ClipLeft;
+	if (x > w) code |= ClipRight;
+	if (y < -w) code |= ClipBottom;
+	if (y > w) code |= ClipTop;
+	if (z < 0.0f) code |= ClipNear;
+	if (z > w) code |= ClipFar;
+	return code;
+}
+
+// SIMD の幅に満たない末尾と、SIMD が使えない環境のための実装です。
+static void TransformScalar(
+	const XMFLOAT4X4& m,
+	const PositionStream& input,
+	uint32_t begin,
+	uint32_t end,
+	const ClipSpaceStream& output,
+	ClipCodeSummary& summary
+	)
+{
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		const float x = input.x[i];
+		const float y = input.y[i];
+		const float z = input.z[i];
+
+		const float cx = x * m._11 + y * m._21 + z * m._31 + m._41;
+		const float cy = x * m._12 + y * m._22 + z * m._32 + m._42;
+		const float cz = x * m._13 + y * m._23 + z * m._33 + m._43;
+		const float cw = x * m._14 + y * m._24 + z * m._34 + m._44;
+
+		output.x[i] = cx;
+		output.y[i] = cy;
+		output.z[i] = cz;
+		output.w[i] = cw;
+
+		const uint8_t code = ComputeClipCode(cx, cy, cz, cw);
+		if (output.clipCodes != nullptr)
+		{
+			output.clipCodes[i] = code;
+		}
+		summary.andCodes &= code;
+		summary.orCodes |= code;
+	}
+}
+
+#if defined(VERTEX_TRANSFORM_AVX) || defined(VERTEX_TRANSFORM_SSE2)
+// 先頭 laneCount バイトに詰めたクリップ コードの論理積と論理和を summary に畳み込みます。
+static void ReduceClipCodes(__m128i andCodes, __m128i orCodes, int laneCount, ClipCodeSummary& summary)
+{
+	uint8_t andBytes[16];
+	uint8_t orBytes[16];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(andBytes), andCodes);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(orBytes), orCodes);
+	for (int lane = 0; lane < laneCount; ++lane)
+	{
+		summary.andCodes &= andBytes[lane];
+		summary.orCodes |= orBytes[lane];
+	}
+}
+#endif
+
+ClipCodeSummary VertexTransform::TransformPositions(
+	const XMFLOAT4X4& m,
+	const PositionStream& input,
+	uint32_t count,
+	const ClipSpaceStream& output
+	)
+{
+	ClipCodeSummary summary;
+	summary.andCodes = 0xFF;
+	summary.orCodes = 0;
+	uint32_t i = 0;
+
+#if defined(VERTEX_TRANSFORM_AVX)
+	// 8 頂点ずつ処理します。
+	const __m256 m11 = _mm256_set1_ps(m._11), m12 = _mm256_set1_ps(m._12), m13 = _mm256_set1_ps(m._13), m14 = _mm256_set1_ps(m._14);
+	const __m256 m21 = _mm256_set1_ps(m._21), m22 = _mm256_set1_ps(m._22), m23 = _mm256_set1_ps(m._23), m24 = _mm256_set1_ps(m._24);
+	const __m256 m31 = _mm256_set1_ps(m._31), m32 = _mm256_set1_ps(m._32), m33 = _mm256_set1_ps(m._33), m34 = _mm256_set1_ps(m._34);
+	const __m256 m41 = _mm256_set1_ps(m._41), m42 = _mm256_set1_ps(m._42), m43 = _mm256_set1_ps(m._43), m44 = _mm256_set1_ps(m._44);
+	const __m256 zero = _mm256_setzero_ps();
+
+	// AVX (AVX2 なし) には 256 ビットの整数演算がないので、コードのビットは浮動小数点のビット演算で組み立てます。
+	const __m256 leftBit = _mm256_castsi256_ps(_mm256_set1_epi32(ClipLeft));
+	const __m256 rightBit = _mm256_castsi256_ps(_mm256_set1_epi32(ClipRight));
+	const __m256 bottomBit = _mm256_castsi256_ps(_mm256_set1_epi32(ClipBottom));
+	const __m256 topBit = _mm256_castsi256_ps(_mm256_set1_epi32(ClipTop));
+	const __m256 nearBit = _mm256_castsi256_ps(_mm256_set1_epi32(ClipNear));
+	const __m256 farBit = _mm256_castsi256_ps(_mm256_set1_epi32(ClipFar));
+	__m128i andCodes = _mm_set1_epi8(static_cast<char>(0xFF));
+	__m128i orCodes = _mm_setzero_si128();
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256 x = _mm256_loadu_ps(input.x + i);
+		const __m256 y = _mm256_loadu_ps(input.y + i);
+		const __m256 z = _mm256_loadu_ps(input.z + i);
+
+		const __m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m11), _mm256_mul_ps(y, m21)), _mm256_add_ps(_mm256_mul_ps(z, m31), m41));
+		const __m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m12), _mm256_mul_ps(y, m22)), _mm256_add_ps(_mm256_mul_ps(z, m32), m42));
+		const __m256 cz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m13), _mm256_mul_ps(y, m23)), _mm256_add_ps(_mm256_mul_ps(z, m33), m43));
+		const __m256 cw = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m14), _mm256_mul_ps(y, m24)), _mm256_add_ps(_mm256_mul_ps(z, m34), m44));
+
+		_mm256_storeu_ps(output.x + i, cx);
+		_mm256_storeu_ps(output.y + i, cy);
+		_mm256_storeu_ps(output.z + i, cz);
+		_mm256_storeu_ps(output.w + i, cw);
+
+		const __m256 negW = _mm256_sub_ps(zero, cw);
+		const __m256 codes = _mm256_or_ps(
+			_mm256_or_ps(
+				_mm256_or_ps(_mm256_and_ps(_mm256_cmp_ps(cx, negW, _CMP_LT_OQ), leftBit), _mm256_and_ps(_mm256_cmp_ps(cx, cw, _CMP_GT_OQ), rightBit)),
+				_mm256_or_ps(_mm256_and_ps(_mm256_cmp_ps(cy, negW, _CMP_LT_OQ), bottomBit), _mm256_and_ps(_mm256_cmp_ps(cy, cw, _CMP_GT_OQ), topBit))),
+			_mm256_or_ps(_mm256_and_ps(_mm256_cmp_ps(cz, zero, _CMP_LT_OQ), nearBit), _mm256_and_ps(_mm256_cmp_ps(cz, cw, _CMP_GT_OQ), farBit)));
+
+		// 8 個の 32 ビットのコードを 8 バイトに詰めます。
+		const __m128i codes16 = _mm_packs_epi32(
+			_mm_castps_si128(_mm256_castps256_ps128(codes)),
+			_mm_castps_si128(_mm256_extractf128_ps(codes, 1)));
+		const __m128i codes8 = _mm_packus_epi16(codes16, codes16);
+		if (output.clipCodes != nullptr)
+		{
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(output.clipCodes + i), codes8);
+		}
+		andCodes = _mm_and_si128(andCodes, codes8);
+		orCodes = _mm_or_si128(orCodes, codes8);
+	}
+
+	ReduceClipCodes(andCodes, orCodes, 8, summary);
+#elif defined(VERTEX_TRANSFORM_SSE2)
+	// 4 頂点ずつ処理します。
+	const __m128 m11 = _mm_set1_ps(m._11), m12 = _mm_set1_ps(m._12), m13 = _mm_set1_ps(m._13), m14 = _mm_set1_ps(m._14);
+	const __m128 m21 = _mm_set1_ps(m._21), m22 = _mm_set1_ps(m._22), m23 = _mm_set1_ps(m._23), m24 = _mm_set1_ps(m._24);
+	const __m128 m31 = _mm_set1_ps(m._31), m32 = _mm_set1_ps(m._32), m33 = _mm_set1_ps(m._33), m34 = _mm_set1_ps(m._34);
+	const __m128 m41 = _mm_set1_ps(m._41), m42 = _mm_set1_ps(m._42), m43 = _mm_set1_ps(m._43), m44 = _mm_set1_ps(m._44);
+	const __m128 zero = _mm_setzero_ps();
+
+	const __m128i leftBit = _mm_set1_epi32(ClipLeft);
+	const __m128i rightBit = _mm_set1_epi32(ClipRight);
+	const __m128i bottomBit = _mm_set1_epi32(ClipBottom);
+	const __m128i topBit = _mm_set1_epi32(ClipTop);
+	const __m128i nearBit = _mm_set1_epi32(ClipNear);
+	const __m128i farBit = _mm_set1_epi32(ClipFar);
+	__m128i andCodes = _mm_set1_epi8(static_cast<char>(0xFF));
+	__m128i orCodes = _mm_setzero_si128();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(input.x + i);
+		const __m128 y = _mm_loadu_ps(input.y + i);
+		const __m128 z = _mm_loadu_ps(input.z + i);
+
+		const __m128 cx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m11), _mm_mul_ps(y, m21)), _mm_add_ps(_mm_mul_ps(z, m31), m41));
+		const __m128 cy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m12), _mm_mul_ps(y, m22)), _mm_add_ps(_mm_mul_ps(z, m32), m42));
+		const __m128 cz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m13), _mm_mul_ps(y, m23)), _mm_add_ps(_mm_mul_ps(z, m33), m43));
+		const __m128 cw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m14), _mm_mul_ps(y, m24)), _mm_add_ps(_mm_mul_ps(z, m34), m44));
+
+		_mm_storeu_ps(output.x + i, cx);
+		_mm_storeu_ps(output.y + i, cy);
+		_mm_storeu_ps(output.z + i, cz);
+		_mm_storeu_ps(output.w + i, cw);
+
+		const __m128 negW = _mm_sub_ps(zero, cw);
+		const __m128i codes = _mm_or_si128(
+			_mm_or_si128(
+				_mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(cx, negW)), leftBit), _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(cx, cw)), rightBit)),
+				_mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(cy, negW)), bottomBit), _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(cy, cw)), topBit))),
+			_mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(cz, zero)), nearBit), _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(cz, cw)), farBit)));
+
+		// 4 個の 32 ビットのコードを 4 バイトに詰めます。
+		const __m128i codes16 = _mm_packs_epi32(codes, codes);
+		const __m128i codes8 = _mm_packus_epi16(codes16, codes16);
+		if (output.clipCodes != nullptr)
+		{
+			const int packed = _mm_cvtsi128_si32(codes8);
+			memcpy(output.clipCodes + i, &packed, 4);
+		}
+		andCodes = _mm_and_si128(andCodes, codes8);
+		orCodes = _mm_or_si128(orCodes, codes8);
+	}
+
+	ReduceClipCodes(andCodes, orCodes, 4, summary);
+#elif defined(VERTEX_TRANSFORM_NEON)
+	// 4 頂点ずつ処理します。
+	const float32x4_t m11 = vdupq_n_f32(m._11), m12 = vdupq_n_f32(m._12), m13 = vdupq_n_f32(m._13), m14 = vdupq_n_f32(m._14);
+	const float32x4_t m21 = vdupq_n_f32(m._21), m22 = vdupq_n_f32(m._22), m23 = vdupq_n_f32(m._23), m24 = vdupq_n_f32(m._24);
+	const float32x4_t m31 = vdupq_n_f32(m._31), m32 = vdupq_n_f32(m._32), m33 = vdupq_n_f32(m._33), m34 = vdupq_n_f32(m._34);
+	const float32x4_t m41 = vdupq_n_f32(m._41), m42 = vdupq_n_f32(m._42), m43 = vdupq_n_f32(m._43), m44 = vdupq_n_f32(m._44);
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	uint32x4_t andCodes = vdupq_n_u32(0xFF);
+	uint32x4_t orCodes = vdupq_n_u32(0);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const float32x4_t x = vld1q_f32(input.x + i);
+		const float32x4_t y = vld1q_f32(input.y + i);
+		const float32x4_t z = vld1q_f32(input.z + i);
+
+		const float32x4_t cx = vmlaq_f32(vmlaq_f32(vmlaq_f32(m41, x, m11), y, m21), z, m31);
+		const float32x4_t cy = vmlaq_f32(vmlaq_f32(vmlaq_f32(m42, x, m12), y, m22), z, m32);
+		const float32x4_t cz = vmlaq_f32(vmlaq_f32(vmlaq_f32(m43, x, m13), y, m23), z, m33);
+		const float32x4_t cw = vmlaq_f32(vmlaq_f32(vmlaq_f32(m44, x, m14), y, m24), z, m34);
+
+		vst1q_f32(output.x + i, cx);
+		vst1q_f32(output.y + i, cy);
+		vst1q_f32(output.z + i, cz);
+		vst1q_f32(output.w + i, cw);
+
+		const float32x4_t negW = vnegq_f32(cw);
+		const uint32x4_t codes = vorrq_u32(
+			vorrq_u32(
+				vorrq_u32(vandq_u32(vcltq_f32(cx, negW), vdupq_n_u32(ClipLeft)), vandq_u32(vcgtq_f32(cx, cw), vdupq_n_u32(ClipRight))),
+				vorrq_u32(vandq_u32(vcltq_f32(cy, negW), vdupq_n_u32(ClipBottom)), vandq_u32(vcgtq_f32(cy, cw), vdupq_n_u32(ClipTop)))),
+			vorrq_u32(vandq_u32(vcltq_f32(cz, zero), vdupq_n_u32(ClipNear)), vandq_u32(vcgtq_f32(cz, cw), vdupq_n_u32(ClipFar))));
+
+		if (output.clipCodes != nullptr)
+		{
+			output.clipCodes[i + 0] = static_cast<uint8_t>(vgetq_lane_u32(codes, 0));
+			output.clipCodes[i + 1] = static_cast<uint8_t>(vgetq_lane_u32(codes, 1));
+			output.clipCodes[i + 2] = static_cast<uint8_t>(vgetq_lane_u32(codes, 2));
+			output.clipCodes[i + 3] = static_cast<uint8_t>(vgetq_lane_u32(codes, 3));
+		}
+		andCodes = vandq_u32(andCodes, codes);
+		orCodes = vorrq_u32(orCodes, codes);
+	}
+
+	uint32_t andLanes[4];
+	uint32_t orLanes[4];
+	vst1q_u32(andLanes, andCodes);
+	vst1q_u32(orLanes, orCodes);
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		summary.andCodes &= static_cast<uint8_t>(andLanes[lane]);
+		summary.orCodes |= static_cast<uint8_t>(orLanes[lane]);
+	}
+#endif
+
+	TransformScalar(m, input, i, count, output, summary);
+	return summary;
+}
+
+const char* VertexTransform::GetImplementationName()
+{
+#if defined(VERTEX_TRANSFORM_AVX)
+	return "AVX";
+#elif defined(VERTEX_TRANSFORM_SSE2)
+	return "SSE2";
+#elif defined(VERTEX_TRANSFORM_NEON)
+	return "NEON";
+#else
+	return "Scalar";
+#endif
+}
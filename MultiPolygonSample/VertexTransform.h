@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <cstdint>
+#include "ShaderStructures.h"
+
+// クリップ コード。クリップ空間の頂点が外側にある平面のビットが立ちます。
+// 判定は D3D11 の可視範囲 (-w <= x <= w, -w <= y <= w, 0 <= z <= w) に従います。
+enum ClipCode : uint8_t
+{
+	ClipLeft	= 0x01,	// x < -w
+	ClipRight	= 0x02,	// x > w
+	ClipBottom	= 0x04,	// y < -w
+	ClipTop		= 0x08,	// y > w
+	ClipNear	= 0x10,	// z < 0
+	ClipFar		= 0x20	// z > w
+};
+
+// SoA 形式の入力位置ストリーム。
+struct PositionStream
+{
+	const float* x;
+	const float* y;
+	const float* z;
+};
+
+// SoA 形式の出力ストリーム。clipCodes は nullptr でもかまいません。
+struct ClipSpaceStream
+{
+	float* x;
+	float* y;
+	float* z;
+	float* w;
+	uint8_t* clipCodes;
+};
+
+// ストリーム全体のクリップ コードの論理積と論理和。
+// andCodes が 0 以外ならすべての頂点がいずれかの平面の外側にあり、まとめてカリングできます。
+// orCodes が 0 ならすべての頂点が可視範囲の内側にあり、クリップは不要です。
+struct ClipCodeSummary
+{
+	uint8_t andCodes;
+	uint8_t orCodes;
+};
+
+// SimpleVertexShader.hlsl の mul(pos, model) → view → projection を 1 つの行列にまとめ、
+// 頂点ストリームを SIMD (SSE2 / AVX / NEON) で一括変換するカーネル。
+// 返す行列は転置されていない (行ベクトルに右から掛ける) DirectXMath の規約に従います。
+namespace VertexTransform
+{
+	// 定数バッファー (転置済み) の 3 つの行列を掛け合わせます。
+	DirectX::XMFLOAT4X4 ComposeModelViewProjection(const ModelViewProjectionConstantBuffer& constants);
+
+	// インスタンスの行列 (転置なし) と定数バッファーの view, projection を掛け合わせます。
+	DirectX::XMFLOAT4X4 ComposeInstanceViewProjection(
+		const DirectX::XMFLOAT4X4& instanceModel,
+		const ModelViewProjectionConstantBuffer& constants
+		);
+
+	// count 個の位置 (w = 1) を変換し、クリップ コードを求めます。
+	ClipCodeSummary TransformPositions(
+		const DirectX::XMFLOAT4X4& transform,
+		const PositionStream& input,
+		uint32_t count,
+		const ClipSpaceStream& output
+		);
+
+	// コンパイル時に選択された SIMD の実装名 ("AVX", "SSE2", "NEON", "Scalar")。
+	const char* GetImplementationName();
+}
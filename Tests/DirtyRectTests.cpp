@@ -0,0 +1,155 @@
+﻿#include <cstdint>
+#include <vector>
+#include "DirtyRectTracker.h"
+#include "DrawQueue.h"
+#include "PolygonScene.h"
+#include "SoftwareRenderDevice.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+// CubeRenderer::RenderSnapshot と同じく、前のフレームから変わった矩形だけをクリアして描き直し、
+// 毎フレーム全体を描き直したときと同じ画像と深度になることを確かめます。
+namespace
+{
+	const uint32_t Width = 160;
+	const uint32_t Height = 120;
+	const uint32_t BufferCount = 2;
+
+	XMFLOAT4X4 MakeTransform(float scale, float x, float y)
+	{
+		XMFLOAT4X4 transform;
+		XMStoreFloat4x4(&transform, XMMatrixMultiply(XMMatrixScaling(scale, scale, scale), XMMatrixTranslation(x, y, 0.0f)));
+		return transform;
+	}
+
+	// 変わった矩形が全体の一部で済むフレームを含めて、スワップ チェーンのバッファーを交互に描き直します。
+	// 止まったオブジェクトを途中で削除して、消えた跡も描き直させます。
+	void TestRedrawMatchesFullRender()
+	{
+		SoftwareRenderDevice firstBuffer(Width, Height, 2);
+		SoftwareRenderDevice secondBuffer(Width, Height, 2);
+		SoftwareRenderDevice reference(Width, Height, 2);
+		SoftwareRenderDevice* const backBuffers[BufferCount] = { &firstBuffer, &secondBuffer };
+
+		PolygonScene scene;
+		scene.CreateDeviceResources(firstBuffer);
+		scene.CreateDeviceResources(secondBuffer);
+		scene.CreateDeviceResources(reference);
+		scene.SetSceneRotationSpeed(0.0f);
+		XMFLOAT4X4 orientationTransform;
+		XMStoreFloat4x4(&orientationTransform, XMMatrixIdentity());
+		scene.SetProjection(static_cast<float>(Width) / Height, orientationTransform);
+
+		LodSettings lodSettings;
+		lodSettings.fadeDuration = 0.0f;
+		lodSettings.viewportWidth = static_cast<float>(Width);
+		lodSettings.viewportHeight = static_cast<float>(Height);
+		scene.SetLodSettings(lodSettings);
+
+		const EntityHandle spinning = scene.AddObject(0, MakeTransform(0.15f, -0.6f, 0.5f), XMFLOAT4(1.0f, 0.5f, 0.5f, 1.0f));
+		const EntityHandle removed = scene.AddObject(0, MakeTransform(0.15f, 0.6f, 0.5f), XMFLOAT4(0.5f, 1.0f, 0.5f, 1.0f));
+		scene.SetAngularVelocity(spinning, 2.0f);
+
+		DirtyRectTracker tracker(BufferCount);
+		tracker.SetViewport(Width, Height);
+		scene.SetDirtyRectTracker(&tracker);
+
+		const float midnightBlue[] = { 0.098f, 0.098f, 0.439f, 1.000f };
+		const ScreenRect viewportRect = { 0, 0, static_cast<int32_t>(Width), static_cast<int32_t>(Height) };
+		SceneSnapshot snapshot;
+		DrawQueue drawQueue;
+		RenderCommandList commandList;
+		uint32_t partialFrames = 0;
+		bool colorsMatch = true;
+		bool depthsMatch = true;
+		for (uint32_t frame = 0; frame < 8; ++frame)
+		{
+			if (frame == 4)
+			{
+				CHECK(scene.RemoveObject(removed));
+			}
+
+			scene.Update(frame * 0.1f, 0.1f);
+			scene.CaptureSnapshot(snapshot);
+			commandList.Reset();
+			scene.Record(snapshot, drawQueue, TwoSidedMode::SinglePass);
+			drawQueue.Flush(commandList);
+			const ModelViewProjectionConstantBuffer constants = scene.GetConstants(snapshot);
+
+			SoftwareRenderDevice& backBuffer = *backBuffers[frame % BufferCount];
+			const ScreenRect& redrawRect = tracker.GetRedrawRect();
+			if (!redrawRect.IsEmpty())
+			{
+				backBuffer.SetScissorRect(&redrawRect);
+				backBuffer.Clear(midnightBlue);
+				backBuffer.SetConstants(constants);
+				backBuffer.Execute(commandList);
+				backBuffer.SetScissorRect(nullptr);
+			}
+			partialFrames += !redrawRect.IsEmpty() && redrawRect != viewportRect ? 1 : 0;
+
+			reference.Clear(midnightBlue);
+			reference.SetConstants(constants);
+			reference.Execute(commandList);
+
+			colorsMatch = colorsMatch && backBuffer.GetColorBuffer() == reference.GetColorBuffer();
+			depthsMatch = depthsMatch && backBuffer.GetDepthBuffer() == reference.GetDepthBuffer();
+		}
+
+		// 2 フレーム目までは前のフレームの状態がないので全体を変更とし、3 フレーム目はその変更を描き直すので全体を描きます。
+		// その後は回転するオブジェクトと、削除したオブジェクトの周りだけを描き直します。
+		CHECK(partialFrames == 8 - (BufferCount + 1));
+		CHECK(colorsMatch);
+		CHECK(depthsMatch);
+		CHECK(tracker.GetStats().fullFrames == BufferCount + 1);
+		CHECK(tracker.GetStats().pixelsRedrawn < tracker.GetStats().pixelsTotal / 2);
+	}
+
+	// 描き直す矩形は、このフレームとその間のフレームの変更をすべて含む 1 つの矩形です。
+	// 何も変わらなければ空になり、カメラが変わると全体になります。
+	void TestRedrawRectCoversHistory()
+	{
+		DirtyRectTracker tracker(BufferCount);
+		tracker.SetViewport(Width, Height);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+
+		const EntityHandle left = { 0, 1 };
+		const EntityHandle right = { 1, 1 };
+		auto runFrame = [&](uint64_t leftSignature, uint64_t rightSignature) {
+			CHECK(tracker.BeginFrame(viewProjection));
+			tracker.AddObject(left, leftSignature, -0.7f, 0.0f, 0.5f, 0.1f);
+			tracker.AddObject(right, rightSignature, 0.7f, 0.0f, 0.5f, 0.1f);
+			tracker.EndFrame();
+		};
+
+		runFrame(1, 1);
+		CHECK(tracker.IsFullFrame());
+		runFrame(1, 1);
+		runFrame(1, 1);
+		CHECK(tracker.GetRedrawRect().IsEmpty());
+
+		// 左だけが変わり、次のフレームで右だけが変わると、次に描くバッファーは両方の変更を描き直します。
+		runFrame(2, 1);
+		const ScreenRect leftRect = tracker.GetRedrawRect();
+		CHECK(!leftRect.IsEmpty() && leftRect.right < static_cast<int32_t>(Width) / 2);
+		runFrame(2, 2);
+		const ScreenRect redrawRect = tracker.GetRedrawRect();
+		CHECK(tracker.GetPresentRects().size() == 1 && tracker.GetPresentRects()[0].left > static_cast<int32_t>(Width) / 2);
+		CHECK(redrawRect.left == leftRect.left && redrawRect.right == tracker.GetPresentRects()[0].right);
+
+		XMStoreFloat4x4(&viewProjection, XMMatrixTranslation(0.1f, 0.0f, 0.0f));
+		CHECK(!tracker.BeginFrame(viewProjection));
+		tracker.EndFrame();
+		const ScreenRect viewportRect = { 0, 0, static_cast<int32_t>(Width), static_cast<int32_t>(Height) };
+		CHECK(tracker.GetRedrawRect() == viewportRect);
+	}
+}
+
+int main()
+{
+	TestRedrawMatchesFullRender();
+	TestRedrawRectCoversHistory();
+	return TestCheck::Finish();
+}
@@ -0,0 +1,139 @@
+﻿#include <cstdint>
+#include "DrawQueue.h"
+#include "PolygonScene.h"
+#include "SoftwareRenderDevice.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+namespace
+{
+	InstanceData MakeInstance(float id)
+	{
+		InstanceData instance;
+		XMStoreFloat4x4(&instance.model, XMMatrixIdentity());
+		instance.color = XMFLOAT4(id, 0.0f, 0.0f, 1.0f);
+		return instance;
+	}
+
+	// 同じパイプラインとメッシュのオブジェクトは、数によらず 1 回の DrawInstanced になります。
+	void TestSingleGroup()
+	{
+		DrawQueue queue;
+		RenderCommandList commandList;
+		for (uint32_t i = 0; i < 5000; ++i)
+		{
+			queue.Submit(PipelineCullNone, 0, MakeInstance(static_cast<float>(i)));
+		}
+		queue.Flush(commandList);
+
+		CHECK(queue.GetItemCount() == 0);
+		CHECK(commandList.GetCommands().size() == 3);
+		CHECK(commandList.GetCommandCount(RenderCommandType::SetPipelineState) == 1);
+		CHECK(commandList.GetCommandCount(RenderCommandType::SetMesh) == 1);
+		CHECK(commandList.GetCommandCount(RenderCommandType::DrawInstanced) == 1);
+		CHECK(commandList.GetCommands()[2].arg2 == 5000);
+		CHECK(commandList.GetInstances().size() == 5000);
+	}
+
+	// 投入の順によらずパイプライン → メッシュの順に並び、同じキーの中では投入順が保たれます。
+	void TestSortOrder()
+	{
+		DrawQueue queue;
+		RenderCommandList commandList;
+		const uint32_t pipelines[] = { PipelineCullBack, PipelineCullFront, PipelineCullBack, PipelineCullFront, PipelineCullBack };
+		const uint32_t meshes[] = { 1, 0, 0, 0, 1 };
+		for (uint32_t i = 0; i < 5; ++i)
+		{
+			queue.Submit(pipelines[i], meshes[i], MakeInstance(static_cast<float>(i)));
+		}
+		queue.Flush(commandList);
+
+		const std::vector<RenderCommand>& commands = commandList.GetCommands();
+		CHECK(commandList.GetCommandCount(RenderCommandType::SetPipelineState) == 2);
+		CHECK(commandList.GetCommandCount(RenderCommandType::DrawInstanced) == 3);
+		// メッシュ 0 は直前のグループと同じなので、2 つ目のパイプラインでは SetMesh を省きます。
+		CHECK(commands.size() == 7);
+		if (commands.size() == 7)
+		{
+			CHECK(commands[0].type == RenderCommandType::SetPipelineState && commands[0].arg0 == PipelineCullFront);
+			CHECK(commands[1].type == RenderCommandType::SetMesh && commands[1].arg0 == 0);
+			CHECK(commands[2].type == RenderCommandType::DrawInstanced && commands[2].arg2 == 2);
+			CHECK(commands[3].type == RenderCommandType::SetPipelineState && commands[3].arg0 == PipelineCullBack);
+			CHECK(commands[4].type == RenderCommandType::DrawInstanced && commands[4].arg0 == 0 && commands[4].arg2 == 1);
+			CHECK(commands[5].type == RenderCommandType::SetMesh && commands[5].arg0 == 1);
+			CHECK(commands[6].type == RenderCommandType::DrawInstanced && commands[6].arg2 == 2);
+		}
+
+		const std::vector<InstanceData>& instances = commandList.GetInstances();
+		const float expected[] = { 1.0f, 3.0f, 2.0f, 0.0f, 4.0f };
+		CHECK(instances.size() == 5);
+		for (uint32_t i = 0; i < 5 && i < instances.size(); ++i)
+		{
+			CHECK(instances[i].color.x == expected[i]);
+		}
+	}
+
+	uint32_t CountSceneCommands(uint32_t extraObjects, TwoSidedMode twoSidedMode)
+	{
+		SoftwareRenderDevice device(64, 64, 1);
+		PolygonScene scene;
+		scene.CreateDeviceResources(device);
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		scene.SetProjection(1.0f, identity);
+
+		XMFLOAT4X4 transform;
+		for (uint32_t i = 0; i < extraObjects; ++i)
+		{
+			XMStoreFloat4x4(&transform, XMMatrixTranslation((i % 10) * 0.05f - 0.25f, (i / 10 % 10) * 0.05f - 0.25f, 0.0f));
+			scene.AddObject(0, transform, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+		}
+
+		SceneSnapshot snapshot;
+		DrawQueue queue;
+		RenderCommandList commandList;
+		scene.Update(0.0f, 0.0f);
+		scene.CaptureSnapshot(snapshot);
+		scene.Record(snapshot, queue, twoSidedMode);
+		queue.Flush(commandList);
+		return static_cast<uint32_t>(commandList.GetCommands().size());
+	}
+
+	// シーンのオブジェクトを増やしても、コマンドの数は変わりません。
+	void TestSceneCommandCountIsConstant()
+	{
+		const uint32_t singlePass = CountSceneCommands(0, TwoSidedMode::SinglePass);
+		const uint32_t twoPass = CountSceneCommands(0, TwoSidedMode::TwoPass);
+		CHECK(singlePass >= 3);
+		CHECK(twoPass > singlePass);
+		CHECK(CountSceneCommands(1000, TwoSidedMode::SinglePass) == singlePass);
+		CHECK(CountSceneCommands(1000, TwoSidedMode::TwoPass) == twoPass);
+	}
+
+	// 追加していないメッシュを指すオブジェクトは作らず、無効なハンドルを返します。
+	void TestAddObjectRejectsUnknownMesh()
+	{
+		SoftwareRenderDevice device(64, 64, 1);
+		PolygonScene scene;
+		scene.CreateDeviceResources(device);
+		const uint32_t objectCount = scene.GetObjectCount();
+
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		CHECK(!scene.AddObject(1, identity, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f)).IsValid());
+		CHECK(scene.GetObjectCount() == objectCount);
+		CHECK(scene.AddObject(0, identity, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f)).IsValid());
+		CHECK(scene.GetObjectCount() == objectCount + 1);
+		scene.Update(0.0f, 0.0f);
+	}
+}
+
+int main()
+{
+	TestSingleGroup();
+	TestSortOrder();
+	TestSceneCommandCountIsConstant();
+	TestAddObjectRejectsUnknownMesh();
+	return TestCheck::Finish();
+}
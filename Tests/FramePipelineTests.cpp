@@ -0,0 +1,209 @@
+﻿#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "FramePipeline.h"
+#include "SimulatedVSyncPresenter.h"
+#include "TestCheck.h"
+
+namespace
+{
+	// スナップショットには、書き込んだ更新の通し番号を入れます。
+	struct PipelineRecorder
+	{
+		PipelineRecorder() : updateCount(0) { snapshots[0] = snapshots[1] = 0; }
+
+		uint32_t updateCount;
+		uint32_t snapshots[FramePipeline::SnapshotCount];
+		std::vector<uint32_t> rendered;
+	};
+
+	template <size_t N>
+	bool RenderedEquals(const PipelineRecorder& recorder, const uint32_t (&expected)[N])
+	{
+		return recorder.rendered == std::vector<uint32_t>(expected, expected + N);
+	}
+
+	// Serial ではフレームごとに更新してからその結果を描画します。
+	void TestSerial()
+	{
+		FramePipeline pipeline(FramePipelineMode::Serial);
+		PipelineRecorder recorder;
+		const std::thread::id mainThread = std::this_thread::get_id();
+		bool sameThread = true;
+
+		const FramePipeline::StageFunction update = [&](uint32_t slot) {
+			sameThread = sameThread && std::this_thread::get_id() == mainThread;
+			recorder.snapshots[slot] = ++recorder.updateCount;
+		};
+		const FramePipeline::StageFunction render = [&](uint32_t slot) {
+			recorder.rendered.push_back(recorder.snapshots[slot]);
+		};
+		for (uint32_t frame = 0; frame < 5; ++frame)
+		{
+			pipeline.RunFrame(update, render);
+		}
+
+		CHECK(sameThread);
+		CHECK(pipeline.GetFrameCount() == 5);
+		CHECK(recorder.updateCount == 5);
+		const uint32_t expected[] = { 1, 2, 3, 4, 5 };
+		CHECK(RenderedEquals(recorder, expected));
+	}
+
+	// Pipelined では次のフレームの更新がワーカー スレッドで描画と重なり、描画は 1 フレーム前の更新を読みます。
+	// 更新と描画が互いに相手の開始を待つので、重ならなければタイムアウトします。
+	void TestPipelinedOverlapsUpdateAndRender()
+	{
+		FramePipeline pipeline(FramePipelineMode::Pipelined);
+		PipelineRecorder recorder;
+		const std::thread::id mainThread = std::this_thread::get_id();
+		std::atomic<bool> updateStarted(false);
+		std::atomic<bool> renderStarted(false);
+		uint32_t overlappedFrames = 0;
+
+		auto waitFor = [](const std::atomic<bool>& flag) {
+			const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while (!flag.load() && std::chrono::steady_clock::now() < deadline)
+			{
+				std::this_thread::yield();
+			}
+			return flag.load();
+		};
+
+		const FramePipeline::StageFunction update = [&](uint32_t slot) {
+			if (std::this_thread::get_id() != mainThread)
+			{
+				updateStarted = true;
+				waitFor(renderStarted);
+			}
+			recorder.snapshots[slot] = ++recorder.updateCount;
+		};
+		const FramePipeline::StageFunction render = [&](uint32_t slot) {
+			renderStarted = true;
+			if (waitFor(updateStarted))
+			{
+				++overlappedFrames;
+			}
+			recorder.rendered.push_back(recorder.snapshots[slot]);
+		};
+		for (uint32_t frame = 0; frame < 5; ++frame)
+		{
+			updateStarted = false;
+			renderStarted = false;
+			pipeline.RunFrame(update, render);
+		}
+
+		CHECK(overlappedFrames == 5);
+		CHECK(recorder.updateCount == 6);
+		const uint32_t expected[] = { 1, 2, 3, 4, 5 };
+		CHECK(RenderedEquals(recorder, expected));
+	}
+
+	// ワーカー スレッドの更新で投げられた例外は RunFrame から投げ直され、次のフレームは更新からやり直します。
+	void TestPipelinedUpdateException()
+	{
+		FramePipeline pipeline(FramePipelineMode::Pipelined);
+		PipelineRecorder recorder;
+		bool fail = false;
+
+		const FramePipeline::StageFunction update = [&](uint32_t slot) {
+			if (fail)
+			{
+				throw std::runtime_error("update failed");
+			}
+			recorder.snapshots[slot] = ++recorder.updateCount;
+		};
+		const FramePipeline::StageFunction render = [&](uint32_t slot) {
+			recorder.rendered.push_back(recorder.snapshots[slot]);
+		};
+
+		pipeline.RunFrame(update, render);
+		fail = true;
+		bool thrown = false;
+		try
+		{
+			pipeline.RunFrame(update, render);
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		CHECK(thrown);
+
+		fail = false;
+		pipeline.RunFrame(update, render);
+		const uint32_t expected[] = { 1, 2, 3 };
+		CHECK(RenderedEquals(recorder, expected));
+		CHECK(recorder.updateCount == 4);
+	}
+
+	// モードを切り替えると、次のフレームはそのモードで実行します。
+	void TestSetMode()
+	{
+		FramePipeline pipeline(FramePipelineMode::Pipelined);
+		PipelineRecorder recorder;
+		const FramePipeline::StageFunction update = [&](uint32_t slot) {
+			recorder.snapshots[slot] = ++recorder.updateCount;
+		};
+		const FramePipeline::StageFunction render = [&](uint32_t slot) {
+			recorder.rendered.push_back(recorder.snapshots[slot]);
+		};
+
+		pipeline.RunFrame(update, render);
+		pipeline.SetMode(FramePipelineMode::Serial);
+		CHECK(pipeline.GetMode() == FramePipelineMode::Serial);
+		pipeline.RunFrame(update, render);
+		pipeline.SetMode(FramePipelineMode::Pipelined);
+		pipeline.RunFrame(update, render);
+
+		const uint32_t expected[] = { 1, 3, 4 };
+		CHECK(RenderedEquals(recorder, expected));
+		CHECK(recorder.updateCount == 5);
+	}
+
+	// 描画の最後の Present で、フレームを垂直同期の間隔に合わせます。
+	void TestPresentPacing()
+	{
+		const std::chrono::milliseconds work(6);
+		const FramePipeline::StageFunction update = [&](uint32_t) {
+			std::this_thread::sleep_for(work);
+		};
+
+		SimulatedVSyncPresenter presenter(100.0);
+		const FramePipeline::StageFunction render = [&](uint32_t) {
+			std::this_thread::sleep_for(work);
+			presenter.Present();
+		};
+
+		FramePipeline pipeline(FramePipelineMode::Pipelined);
+		const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < 10; ++frame)
+		{
+			pipeline.RunFrame(update, render);
+		}
+		const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - begin;
+
+		// Present は垂直同期より早く戻らないので、最初の表示から後は 1 間隔ずつ進みます。
+		CHECK(presenter.GetPresentCount() == 10);
+		CHECK(elapsed >= presenter.GetInterval() * 9);
+
+		// 1 間隔を超えて遅れた表示は数えます。
+		const uint64_t missed = presenter.GetMissedVSyncCount();
+		std::this_thread::sleep_for(presenter.GetInterval() * 3);
+		presenter.Present();
+		CHECK(presenter.GetMissedVSyncCount() == missed + 1);
+	}
+}
+
+int main()
+{
+	TestSerial();
+	TestPipelinedOverlapsUpdateAndRender();
+	TestPipelinedUpdateException();
+	TestSetMode();
+	TestPresentPacing();
+	return TestCheck::Finish();
+}
@@ -0,0 +1,140 @@
+﻿#include <cmath>
+#include <cstdint>
+#include "FrameScheduler.h"
+#include "TestCheck.h"
+
+namespace
+{
+	bool NearlyEqual(double a, double b)
+	{
+		return std::fabs(a - b) < 1e-9;
+	}
+
+	// 垂直同期ごとにフレームを始めると、刻みを 1 つずつ進め、描画する時刻は 1 刻み遅れます。
+	void TestFixedTimeStep()
+	{
+		FrameSchedulerSettings settings;
+		FrameScheduler scheduler(settings);
+		const double step = settings.fixedTimeStep;
+
+		FrameDecision first = scheduler.BeginFrame(10.0);
+		CHECK(first.render && first.simulationSteps == 0);
+		scheduler.EndFrame(0.001, true);
+
+		double lastRenderTime = first.renderTime;
+		bool monotonic = true;
+		for (uint32_t frame = 1; frame <= 120; ++frame)
+		{
+			// 半分の刻みごとに始めて、刻みの間を補間させます。
+			const FrameDecision decision = scheduler.BeginFrame(10.0 + frame * step * 0.5 + 1e-9);
+			CHECK(decision.render);
+			CHECK(decision.simulationSteps == (frame % 2 == 0 ? 1u : 0u));
+			// 最初の刻みまでは、描画する時刻は 0 より前に戻りません。
+			CHECK(frame < 2 || NearlyEqual(decision.renderTime, decision.simulationTime - step + decision.interpolation * step));
+			monotonic = monotonic && decision.renderDelta >= 0.0 && NearlyEqual(decision.renderTime - lastRenderTime, decision.renderDelta);
+			lastRenderTime = decision.renderTime;
+			scheduler.EndFrame(0.001, true);
+		}
+
+		CHECK(monotonic);
+		CHECK(scheduler.GetStats().simulationSteps == 60);
+		CHECK(scheduler.GetStats().renderedFrames == 121);
+		CHECK(scheduler.GetStats().droppedSteps == 0);
+	}
+
+	// 長く止まった後は maxStepsPerFrame までしか進めず、残りの刻みは捨てます。
+	void TestDroppedSteps()
+	{
+		FrameSchedulerSettings settings;
+		settings.fixedTimeStep = 0.01;
+		FrameScheduler scheduler(settings);
+
+		scheduler.BeginFrame(0.0);
+		scheduler.EndFrame(0.001, true);
+		const FrameDecision decision = scheduler.BeginFrame(1.0005);
+		CHECK(decision.simulationSteps == settings.maxStepsPerFrame);
+		CHECK(scheduler.GetStats().droppedSteps == 100 - settings.maxStepsPerFrame);
+		CHECK(NearlyEqual(decision.simulationTime, settings.maxStepsPerFrame * 0.01));
+	}
+
+	// シーンが止まると描画をやめ、待っていた時間を飛ばした垂直同期として数えます。
+	// 再描画を要求すると、待っていた時間をシミュレーションに加えずに redrawFrameCount フレームを描画します。
+	void TestIdleAndRedraw()
+	{
+		FrameSchedulerSettings settings;
+		settings.redrawFrameCount = 2;
+		FrameScheduler scheduler(settings);
+
+		const FrameDecision first = scheduler.BeginFrame(0.0);
+		CHECK(first.render);
+		scheduler.EndFrame(0.001, false);
+		CHECK(scheduler.IsIdle());
+
+		// イベントで起きても描画しません。
+		const FrameDecision woken = scheduler.BeginFrame(0.5);
+		CHECK(!woken.render);
+		CHECK(woken.simulationSteps == 0);
+		CHECK(scheduler.GetStats().idleWakeups == 1);
+		CHECK(scheduler.GetStats().skippedFrames == 30);
+
+		scheduler.RequestRedraw();
+		const FrameDecision redraw = scheduler.BeginFrame(1.0);
+		CHECK(redraw.render);
+		CHECK(redraw.simulationSteps == 0);
+		CHECK(redraw.simulationTime == first.simulationTime);
+		CHECK(scheduler.GetStats().skippedFrames == 60);
+		CHECK(NearlyEqual(scheduler.GetStats().idleSeconds, 1.0));
+		scheduler.EndFrame(0.001, false);
+		CHECK(!scheduler.IsIdle());
+
+		CHECK(scheduler.BeginFrame(1.0 + 1.0 / 60.0).render);
+		scheduler.EndFrame(0.001, false);
+		CHECK(scheduler.IsIdle());
+		CHECK(scheduler.GetStats().renderedFrames == 3);
+	}
+
+	// 締め切りに続けて遅れると、平均の処理時間が収まるまで垂直同期の間隔を広げ、
+	// 余裕のあるフレームが続くと 1 つずつ狭めます。間隔は maxSyncInterval を超えません。
+	void TestSyncIntervalAdaptation()
+	{
+		FrameSchedulerSettings settings;
+		FrameScheduler scheduler(settings);
+		double now = 0.0;
+		auto runFrames = [&](uint32_t count, double workSeconds) {
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const FrameDecision decision = scheduler.BeginFrame(now);
+				CHECK(decision.syncInterval == scheduler.GetSyncInterval());
+				scheduler.EndFrame(workSeconds, true);
+				now += scheduler.GetSyncInterval() / settings.refreshRate;
+			}
+		};
+
+		runFrames(2, 0.025);
+		CHECK(scheduler.GetSyncInterval() == 1);
+		runFrames(1, 0.025);
+		CHECK(scheduler.GetSyncInterval() == 2);
+		CHECK(scheduler.GetStats().deadlineMisses == 3);
+
+		// 2 間隔に収まっていても、1 間隔の余裕の内側でなければ狭めません。
+		runFrames(settings.adaptationFrames, 0.025);
+		CHECK(scheduler.GetSyncInterval() == 2);
+		CHECK(scheduler.GetStats().deadlineMisses == 3);
+
+		runFrames(settings.adaptationFrames, 0.005);
+		CHECK(scheduler.GetSyncInterval() == 1);
+
+		runFrames(settings.missesToSlowDown, 0.2);
+		CHECK(scheduler.GetSyncInterval() == settings.maxSyncInterval);
+		CHECK(scheduler.GetStats().syncIntervalChanges == 3);
+	}
+}
+
+int main()
+{
+	TestFixedTimeStep();
+	TestDroppedSteps();
+	TestIdleAndRedraw();
+	TestSyncIntervalAdaptation();
+	return TestCheck::Finish();
+}
@@ -0,0 +1,277 @@
+﻿#include "GoldenFrameHarness.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "Profiler.h"
+
+using namespace DirectX;
+
+GoldenFrameScene::GoldenFrameScene() :
+	twoSidedMode(TwoSidedMode::SinglePass),
+	channelTolerance(4),
+	maxDifferingPixels(32),
+	timingFrames(0),
+	frameBudgetMilliseconds(0.0)
+{
+}
+
+GoldenFrameSettings::GoldenFrameSettings() :
+	goldenDirectory("."),
+	width(320),
+	height(240),
+	threadCount(0),
+	updateGoldens(false)
+{
+}
+
+GoldenFrameHarness::GoldenFrameHarness(const GoldenFrameSettings& settings) :
+	m_settings(settings),
+	m_passed(true)
+{
+}
+
+bool GoldenFrameHarness::Run(const GoldenFrameScene& scene)
+{
+	OffscreenRenderer renderer(m_settings.width, m_settings.height, m_settings.threadCount);
+	renderer.SetTwoSidedMode(scene.twoSidedMode);
+	if (scene.setup)
+	{
+		scene.setup(renderer.GetScene());
+	}
+
+	const double ticksPerMillisecond = static_cast<double>(ProfilerClock::GetFrequency()) / 1000.0;
+	std::vector<double> frameMilliseconds;
+	Image actual;
+	Image expected;
+	Image difference;
+	bool passed = true;
+	float previousTime = 0.0f;
+
+	for (size_t i = 0; i < scene.times.size(); ++i)
+	{
+		const float time = scene.times[i];
+		const uint64_t begin = ProfilerClock::Now();
+		renderer.Update(time, i > 0 ? time - previousTime : 0.0f);
+		renderer.Render();
+		frameMilliseconds.push_back((ProfilerClock::Now() - begin) / ticksPerMillisecond);
+		previousTime = time;
+		renderer.ReadPixels(actual);
+
+		std::ostringstream imageName;
+		imageName << scene.name << "_" << i;
+
+		GoldenFrameResult result;
+		result.imageName = imageName.str();
+		result.time = time;
+		result.passed = false;
+		result.goldenMissing = false;
+		result.difference.sizeMatches = false;
+		result.difference.differingPixels = 0;
+		result.difference.maxChannelDifference = 0;
+
+		const std::string goldenPath = GetGoldenPath(result.imageName);
+		std::ifstream goldenFile(goldenPath.c_str(), std::ios::binary);
+		result.goldenMissing = !goldenFile || !ImageFile::ReadPpm(goldenFile, expected);
+		goldenFile.close();
+
+		if (m_settings.updateGoldens)
+		{
+			std::ofstream output(goldenPath.c_str(), std::ios::binary);
+			result.passed = output && ImageFile::WritePpm(output, actual);
+			result.difference = CompareImages(actual, actual, 0, nullptr);
+		}
+		else if (!result.goldenMissing)
+		{
+			result.difference = CompareImages(actual, expected, scene.channelTolerance, &difference);
+			result.passed = result.difference.sizeMatches && result.difference.differingPixels <= scene.maxDifferingPixels;
+		}
+
+		// 一致しなかった画像は、正解の画像と見比べられるように PNG で残します。
+		if (!result.passed && !m_settings.outputDirectory.empty())
+		{
+			std::ofstream actualFile(GetOutputPath(result.imageName + "_actual.png").c_str(), std::ios::binary);
+			ImageFile::WritePng(actualFile, actual);
+			if (!result.goldenMissing && result.difference.sizeMatches)
+			{
+				std::ofstream differenceFile(GetOutputPath(result.imageName + "_diff.png").c_str(), std::ios::binary);
+				ImageFile::WritePng(differenceFile, difference);
+			}
+		}
+
+		passed = passed && result.passed;
+		m_results.push_back(result);
+	}
+
+	// 最後の時刻のまま描画を繰り返し、描画時間の標本を増やします。
+	for (uint32_t i = 0; i < scene.timingFrames; ++i)
+	{
+		const uint64_t begin = ProfilerClock::Now();
+		renderer.Update(previousTime, 0.0f);
+		renderer.Render();
+		frameMilliseconds.push_back((ProfilerClock::Now() - begin) / ticksPerMillisecond);
+	}
+
+	GoldenFrameTiming timing;
+	timing.sceneName = scene.name;
+	timing.frames = static_cast<uint32_t>(frameMilliseconds.size());
+	timing.medianMilliseconds = 0.0;
+	timing.maxMilliseconds = 0.0;
+	if (!frameMilliseconds.empty())
+	{
+		std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+		timing.medianMilliseconds = frameMilliseconds[frameMilliseconds.size() / 2];
+		timing.maxMilliseconds = frameMilliseconds.back();
+	}
+	timing.withinBudget = scene.frameBudgetMilliseconds <= 0.0 || timing.medianMilliseconds <= scene.frameBudgetMilliseconds;
+	m_timings.push_back(timing);
+
+	passed = passed && timing.withinBudget;
+	m_passed = m_passed && passed;
+	return passed;
+}
+
+void GoldenFrameHarness::WriteReport(std::ostream& stream) const
+{
+	for (const GoldenFrameResult& result : m_results)
+	{
+		stream << (result.passed ? "PASS " : "FAIL ") << result.imageName << " t=" << result.time;
+		if (result.goldenMissing)
+		{
+			stream << (m_settings.updateGoldens ? " (new golden)" : " (golden missing)");
+		}
+		else if (!result.difference.sizeMatches)
+		{
+			stream << " (size mismatch)";
+		}
+		else
+		{
+			stream << " differing=" << result.difference.differingPixels << " maxDifference=" << result.difference.maxChannelDifference;
+		}
+		stream << "\n";
+	}
+	for (const GoldenFrameTiming& timing : m_timings)
+	{
+		stream << (timing.withinBudget ? "TIME " : "SLOW ") << timing.sceneName
+			<< " frames=" << timing.frames
+			<< " median=" << timing.medianMilliseconds << "ms"
+			<< " max=" << timing.maxMilliseconds << "ms\n";
+	}
+}
+
+std::vector<GoldenFrameScene> GoldenFrameHarness::CreateDefaultScenes()
+{
+	std::vector<GoldenFrameScene> scenes;
+
+	// CubeRenderer が描画する既定のシーン。
+	GoldenFrameScene defaultScene;
+	defaultScene.name = "default";
+	defaultScene.times.push_back(0.0f);
+	defaultScene.times.push_back(0.5f);
+	defaultScene.times.push_back(1.0f);
+	defaultScene.times.push_back(3.0f);	// 2 秒では真横を向いて何も描画されないので、裏面が見える時刻にします
+	scenes.push_back(defaultScene);
+
+	GoldenFrameScene twoPass = defaultScene;
+	twoPass.name = "default_two_pass";
+	twoPass.twoSidedMode = TwoSidedMode::TwoPass;
+	twoPass.times.assign(1, 1.5f);
+	scenes.push_back(twoPass);
+
+	// 止めたシーンの中で、色と回転の速さの違う三角形を格子状に並べます。
+	GoldenFrameScene spinningGrid;
+	spinningGrid.name = "spinning_grid";
+	spinningGrid.setup = [] (PolygonScene& scene)
+	{
+		scene.SetSceneRotationSpeed(0.0f);
+		XMFLOAT4X4 transform;
+		for (uint32_t y = 0; y < 12; ++y)
+		{
+			for (uint32_t x = 0; x < 16; ++x)
+			{
+				XMStoreFloat4x4(&transform, XMMatrixMultiply(XMMatrixScaling(0.25f, 0.25f, 1.0f), XMMatrixTranslation(x * 0.125f - 1.0f, y * 0.125f - 0.75f, 0.5f)));
+				const XMFLOAT4 color(x / 15.0f, y / 11.0f, 0.5f, 1.0f);
+				scene.SetAngularVelocity(scene.AddObject(0, transform, color), (x + y * 16) * 0.05f - 4.0f);
+			}
+		}
+	};
+	spinningGrid.times.push_back(0.0f);
+	spinningGrid.times.push_back(0.25f);
+	spinningGrid.times.push_back(0.5f);
+	scenes.push_back(spinningGrid);
+
+	// 性能を計るための、小さな三角形を大量に並べたシーン。画像は 1 枚だけ比べます。
+	GoldenFrameScene denseGrid;
+	denseGrid.name = "dense_grid";
+	denseGrid.setup = [] (PolygonScene& scene)
+	{
+		XMFLOAT4X4 transform;
+		for (uint32_t n = 0; n < 40000; ++n)
+		{
+			const uint32_t x = n % 200;
+			const uint32_t y = n / 200;
+			XMStoreFloat4x4(&transform, XMMatrixMultiply(XMMatrixScaling(0.02f, 0.02f, 1.0f), XMMatrixTranslation(x * 0.01f - 1.0f, y * 0.01f - 1.0f, 0.0f)));
+			scene.AddObject(0, transform, XMFLOAT4(1.0f, (n % 7) / 6.0f, (n % 5) / 4.0f, 1.0f));
+		}
+	};
+	denseGrid.times.push_back(1.0f);
+	denseGrid.timingFrames = 20;
+	scenes.push_back(denseGrid);
+
+	return scenes;
+}
+
+ImageDifference GoldenFrameHarness::CompareImages(const Image& actual, const Image& expected, uint32_t channelTolerance, Image* difference)
+{
+	ImageDifference result;
+	result.sizeMatches = actual.width == expected.width && actual.height == expected.height &&
+		actual.pixels.size() == expected.pixels.size() && actual.pixels.size() == static_cast<size_t>(actual.width) * actual.height;
+	result.differingPixels = 0;
+	result.maxChannelDifference = 0;
+	if (!result.sizeMatches)
+	{
+		return result;
+	}
+
+	if (difference != nullptr)
+	{
+		difference->width = actual.width;
+		difference->height = actual.height;
+		difference->pixels.resize(actual.pixels.size());
+	}
+
+	// アルファは画像ファイルに書き出さないので比べません。
+	for (size_t i = 0; i < actual.pixels.size(); ++i)
+	{
+		const uint32_t a = actual.pixels[i];
+		const uint32_t e = expected.pixels[i];
+		uint32_t maxDifference = 0;
+		for (int shift = 0; shift < 24; shift += 8)
+		{
+			const int channelDifference = std::abs(static_cast<int>((a >> shift) & 0xFF) - static_cast<int>((e >> shift) & 0xFF));
+			maxDifference = std::max(maxDifference, static_cast<uint32_t>(channelDifference));
+		}
+		result.maxChannelDifference = std::max(result.maxChannelDifference, maxDifference);
+		const bool differs = maxDifference > channelTolerance;
+		if (differs)
+		{
+			++result.differingPixels;
+		}
+		if (difference != nullptr)
+		{
+			// 同じピクセルは正解の画像を 1/4 の明るさで、違うピクセルは赤で表します。
+			difference->pixels[i] = differs ? 0xFFFF0000u : 0xFF000000u | ((e >> 2) & 0x003F3F3Fu);
+		}
+	}
+	return result;
+}
+
+std::string GoldenFrameHarness::GetGoldenPath(const std::string& imageName) const
+{
+	return m_settings.goldenDirectory + "/" + imageName + ".ppm";
+}
+
+std::string GoldenFrameHarness::GetOutputPath(const std::string& fileName) const
+{
+	return m_settings.outputDirectory + "/" + fileName;
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "OffscreenRenderer.h"
+
+// 1 つのシーンの台本。setup でシーンを組み立て、times の各時刻に Update して描画した画像を正解の画像と比べます。
+struct GoldenFrameScene
+{
+	GoldenFrameScene();
+
+	std::string name;		// 画像ファイルの名前の先頭。name_0.ppm のように times の番号を付けます
+	std::function<void(PolygonScene&)> setup;	// 空なら PolygonScene の既定のシーン (CubeRenderer と同じもの) のままです
+	std::vector<float> times;	// 比べる timeTotal。この順に Update するので、増えていく順に並べてください
+	TwoSidedMode twoSidedMode;
+	uint32_t channelTolerance;		// 同じとみなす、チャンネルごとの値の差
+	uint32_t maxDifferingPixels;	// 許す、channelTolerance を超えたピクセルの数
+	uint32_t timingFrames;			// 時間を計るために、最後の時刻でさらに描画する回数
+	double frameBudgetMilliseconds;	// 描画時間の中央値の上限。0 なら時間では失敗にしません
+};
+
+struct GoldenFrameSettings
+{
+	GoldenFrameSettings();
+
+	std::string goldenDirectory;	// 正解の画像 (PPM) を置くディレクトリ
+	std::string outputDirectory;	// 一致しなかった画像と差分の画像 (PNG) の書き出し先。空なら書き出しません
+	uint32_t width;
+	uint32_t height;
+	uint32_t threadCount;			// SoftwareRenderDevice のスレッド数。0 ならハードウェア スレッド数です
+	bool updateGoldens;				// true なら比べずに、描画した画像で正解の画像を書き換えます
+};
+
+// 2 つの画像の違い。
+struct ImageDifference
+{
+	bool sizeMatches;
+	uint32_t differingPixels;		// いずれかのチャンネルの差が許容値を超えたピクセルの数
+	uint32_t maxChannelDifference;
+};
+
+// 1 枚の画像の結果。
+struct GoldenFrameResult
+{
+	std::string imageName;		// 拡張子を除いたファイル名
+	float time;
+	bool passed;
+	bool goldenMissing;			// 正解の画像がなかった (updateGoldens なら新しく書き出した) かどうか
+	ImageDifference difference;
+};
+
+// シーンごとの描画時間。Update と Render を合わせた 1 フレームの時間です。
+struct GoldenFrameTiming
+{
+	std::string sceneName;
+	uint32_t frames;
+	double medianMilliseconds;
+	double maxMilliseconds;
+	bool withinBudget;
+};
+
+/**
+ * 台本どおりのシーンを OffscreenRenderer で描画し、正解の画像と比べる回帰テストの実行役。
+ * 同時に各フレームの描画時間を計り、中央値がシーンの予算を超えれば失敗にするので、性能の回帰も検出できます。
+ * CPU だけで描画するので、GPU のない Linux の CI でも同じ結果になります。
+ * 正解の画像は読み書きの簡単な PPM で保存し、一致しなかったときは見やすい PNG で実際の画像と差分を書き出します。
+ */
+class GoldenFrameHarness
+{
+public:
+	explicit GoldenFrameHarness(const GoldenFrameSettings& settings);
+
+	// scene を描画して比べ、結果を追加します。すべての画像が一致し、時間が予算内なら true を返します。
+	bool Run(const GoldenFrameScene& scene);
+
+	const std::vector<GoldenFrameResult>& GetResults() const { return m_results; }
+	const std::vector<GoldenFrameTiming>& GetTimings() const { return m_timings; }
+
+	// これまでのすべての結果が成功かどうか。
+	bool HasPassed() const { return m_passed; }
+
+	// 結果を 1 行に 1 つずつ、人が読める形で書き出します。
+	void WriteReport(std::ostream& stream) const;
+
+	// このサンプルのシーンを一通り確かめる台本。
+	static std::vector<GoldenFrameScene> CreateDefaultScenes();
+
+	// actual と expected を比べます。difference が nullptr でなければ、違うピクセルを赤、同じピクセルを暗くした画像を作ります。
+	static ImageDifference CompareImages(const Image& actual, const Image& expected, uint32_t channelTolerance, Image* difference);
+
+private:
+	std::string GetGoldenPath(const std::string& imageName) const;
+	std::string GetOutputPath(const std::string& fileName) const;
+
+	GoldenFrameSettings m_settings;
+	std::vector<GoldenFrameResult> m_results;
+	std::vector<GoldenFrameTiming> m_timings;
+	bool m_passed;
+};
@@ -0,0 +1,97 @@
+﻿#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "GoldenFrameHarness.h"
+#include "TestCheck.h"
+
+// 既定のシーンを描画して、Tests/Goldens の正解の画像と比べます。
+// シーンや描画を意図して変えたときは、次のように正解の画像を書き換えて差分を確かめてからコミットします。
+//   GoldenFrameTests --update
+// 一致しなかった画像と差分の画像は、ビルド ディレクトリの GoldenFrameOutput に PNG で書き出します。
+//
+// 正解の画像は 160x120 で描画します。
+namespace
+{
+	Image MakeImage(uint32_t width, uint32_t height, uint32_t color)
+	{
+		Image image;
+		image.width = width;
+		image.height = height;
+		image.pixels.assign(static_cast<size_t>(width) * height, color);
+		return image;
+	}
+
+	// 許容値を超えたピクセルだけを数え、アルファは比べません。
+	void TestCompareImages()
+	{
+		const Image expected = MakeImage(8, 4, 0xFF102030u);
+		Image actual = expected;
+		Image difference;
+
+		ImageDifference result = GoldenFrameHarness::CompareImages(actual, expected, 0, &difference);
+		CHECK(result.sizeMatches && result.differingPixels == 0 && result.maxChannelDifference == 0);
+
+		actual.pixels[0] = 0x00102030u;
+		actual.pixels[1] = 0xFF132030u;
+		actual.pixels[2] = 0xFF102038u;
+		result = GoldenFrameHarness::CompareImages(actual, expected, 4, &difference);
+		CHECK(result.differingPixels == 1);
+		CHECK(result.maxChannelDifference == 8);
+		CHECK(difference.pixels[2] == 0xFFFF0000u);
+		CHECK(difference.pixels[1] != 0xFFFF0000u);
+
+		result = GoldenFrameHarness::CompareImages(MakeImage(4, 8, 0xFF102030u), expected, 4, nullptr);
+		CHECK(!result.sizeMatches);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	GoldenFrameSettings settings;
+	settings.goldenDirectory = GOLDEN_DIRECTORY;
+	settings.outputDirectory = GOLDEN_OUTPUT_DIRECTORY;
+	settings.width = 160;
+	settings.height = 120;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--update") == 0)
+		{
+			settings.updateGoldens = true;
+		}
+		else if (strcmp(argv[i], "--goldens") == 0 && i + 1 < argc)
+		{
+			settings.goldenDirectory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+		{
+			settings.outputDirectory = argv[++i];
+		}
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--update] [--goldens directory] [--output directory]\n";
+			return 2;
+		}
+	}
+
+	TestCompareImages();
+
+	GoldenFrameHarness harness(settings);
+	const std::vector<GoldenFrameScene> scenes = GoldenFrameHarness::CreateDefaultScenes();
+	for (const GoldenFrameScene& scene : scenes)
+	{
+		harness.Run(scene);
+	}
+	harness.WriteReport(std::cout);
+
+	// 正解の画像がなければ、--update で作るまで失敗にします。
+	bool goldensPresent = true;
+	for (const GoldenFrameResult& result : harness.GetResults())
+	{
+		goldensPresent = goldensPresent && !result.goldenMissing;
+	}
+	CHECK(settings.updateGoldens || goldensPresent);
+	CHECK(harness.HasPassed());
+	return TestCheck::Finish();
+}
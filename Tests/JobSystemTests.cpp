@@ -0,0 +1,112 @@
+﻿#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "JobSystem.h"
+#include "TestCheck.h"
+
+namespace
+{
+	// 各インデックスを処理した回数を数えます。
+	class Counters
+	{
+	public:
+		explicit Counters(uint32_t count) : m_counts(new std::atomic<uint32_t>[count]), m_count(count)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				m_counts[i].store(0);
+			}
+		}
+
+		void Add(uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				m_counts[i].fetch_add(1);
+			}
+		}
+
+		bool AllEqual(uint32_t expected) const
+		{
+			for (uint32_t i = 0; i < m_count; ++i)
+			{
+				if (m_counts[i].load() != expected)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		std::unique_ptr<std::atomic<uint32_t>[]> m_counts;
+		uint32_t m_count;
+	};
+
+	// スレッドの数によらず、各インデックスを 1 回ずつ処理します。
+	void TestEachIndexOnce()
+	{
+		const uint32_t count = 10007;
+		for (uint32_t workers = 0; workers <= 3; ++workers)
+		{
+			JobSystem jobSystem(workers);
+			Counters counters(count);
+			jobSystem.ParallelFor(count, 64, [&] (uint32_t begin, uint32_t end) {
+				counters.Add(begin, end);
+			});
+			CHECK(counters.AllEqual(1));
+		}
+	}
+
+	// function の中からの ParallelFor は、呼び出したスレッドだけで直列に処理します。
+	// 外側の範囲は呼び出し元のスレッドとワーカーの両方が処理するので、どちらからの入れ子も含みます。
+	void TestNestedCallsRunSerially()
+	{
+		const uint32_t outerCount = 64;
+		const uint32_t innerCount = 1000;
+		JobSystem jobSystem(3);
+		Counters counters(outerCount * innerCount);
+		std::atomic<uint32_t> splitInnerCalls(0);
+		std::atomic<uint32_t> foreignThreadCalls(0);
+
+		jobSystem.ParallelFor(outerCount, 1, [&] (uint32_t begin, uint32_t end) {
+			for (uint32_t outer = begin; outer < end; ++outer)
+			{
+				const std::thread::id thread = std::this_thread::get_id();
+				uint32_t calls = 0;
+				jobSystem.ParallelFor(innerCount, 16, [&] (uint32_t innerBegin, uint32_t innerEnd) {
+					++calls;
+					if (std::this_thread::get_id() != thread)
+					{
+						foreignThreadCalls.fetch_add(1);
+					}
+					counters.Add(outer * innerCount + innerBegin, outer * innerCount + innerEnd);
+				});
+				if (calls != 1)
+				{
+					splitInnerCalls.fetch_add(1);
+				}
+			}
+		});
+
+		CHECK(counters.AllEqual(1));
+		CHECK(splitInnerCalls.load() == 0);
+		CHECK(foreignThreadCalls.load() == 0);
+
+		// 入れ子のあとも、並列の ParallelFor を続けて使えます。
+		Counters after(innerCount);
+		jobSystem.ParallelFor(innerCount, 16, [&] (uint32_t begin, uint32_t end) {
+			after.Add(begin, end);
+		});
+		CHECK(after.AllEqual(1));
+	}
+}
+
+int main()
+{
+	TestEachIndexOnce();
+	TestNestedCallsRunSerially();
+	return TestCheck::Finish();
+}
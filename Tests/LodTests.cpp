@@ -0,0 +1,266 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "LodSelection.h"
+#include "MeshSimplifier.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// 段の誤差 0, 1, 2, 4 と、誤差 1 ピクセル、余裕 25% の設定。
+	const float Errors[] = { 0.0f, 1.0f, 2.0f, 4.0f };
+	const uint32_t LevelCount = 4;
+
+	LodSettings CreateSettings()
+	{
+		LodSettings settings;
+		settings.pixelError = 1.0f;
+		settings.hysteresis = 0.25f;
+		settings.fadeDuration = 0.25f;
+		return settings;
+	}
+
+	// 粗い段へは誤差が pixelError * (1 - hysteresis) 以下になってから切り替え、細かい段へはすぐに戻します。
+	void TestSelectLevelHysteresis()
+	{
+		const LodSettings settings = CreateSettings();
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 0, 0.9f, settings) == 0);
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 0, 0.7f, settings) == 1);
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 1, 0.9f, settings) == 1);
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 1, 1.1f, settings) == 0);
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 0, 0.3f, settings) == 2);
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 0, 0.45f, settings) == 1);
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 3, 0.01f, settings) == 3);
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 3, 10.0f, settings) == 0);
+
+		// 境目の前後を行き来しても、段は切り替わりません。
+		uint32_t level = 0;
+		uint32_t switches = 0;
+		for (uint32_t frame = 0; frame < 100; ++frame)
+		{
+			const uint32_t next = LodSelection::SelectLevel(Errors, LevelCount, level, frame % 2 == 0 ? 0.99f : 1.01f, settings);
+			switches += next != level ? 1 : 0;
+			level = next;
+		}
+		CHECK(switches == 0);
+		CHECK(level == 0);
+
+		// 余裕がなければ、誤差が pixelError 以下になったところで切り替えます。
+		LodSettings noHysteresis = settings;
+		noHysteresis.hysteresis = 0.0f;
+		CHECK(LodSelection::SelectLevel(Errors, LevelCount, 0, 0.99f, noHysteresis) == 1);
+	}
+
+	// クロスフェード中の新しい段 (フェード値 p) と前の段 (p - 1) は、どのピクセルもちょうど一方だけが描画します。
+	void TestFadeIsComplementary()
+	{
+		uint32_t previousCount = 0;
+		for (uint32_t step = 0; step <= 32; ++step)
+		{
+			const float progress = step / 32.0f;
+			uint32_t newCount = 0;
+			bool complementary = true;
+			for (uint32_t y = 0; y < 8; ++y)
+			{
+				for (uint32_t x = 0; x < 8; ++x)
+				{
+					const bool newVisible = LodSelection::IsFadeVisible(progress, x, y);
+					const bool oldVisible = LodSelection::IsFadeVisible(progress - 1.0f, x, y);
+					complementary = complementary && newVisible != oldVisible;
+					newCount += newVisible ? 1 : 0;
+				}
+			}
+			CHECK(complementary);
+
+			// 進むほど新しい段のピクセルが増え、最初と最後はどちらか一方だけになります。
+			CHECK(newCount >= previousCount);
+			previousCount = newCount;
+			if (step == 0)
+			{
+				CHECK(newCount == 0);
+			}
+			if (step == 32)
+			{
+				CHECK(newCount == 64);
+			}
+		}
+
+		// 通常のオブジェクトのフェード値 1 は、すべてのピクセルを描画します。
+		bool allVisible = true;
+		for (uint32_t y = 0; y < 4; ++y)
+		{
+			for (uint32_t x = 0; x < 4; ++x)
+			{
+				allVisible = allVisible && LodSelection::IsFadeVisible(1.0f, x, y);
+			}
+		}
+		CHECK(allVisible);
+	}
+
+	// 続けて描画しているオブジェクトだけがフェードし、フェードの時間で進み具合が 0 から 1 になります。
+	void TestAdvanceFades()
+	{
+		const LodSettings settings = CreateSettings();
+		LodState state = {};
+		LodSelection::Advance(state, 2, 1, 0.0f, settings);
+		CHECK(state.level == 2 && !state.fading);
+
+		LodSelection::Advance(state, 1, 2, 1.0f, settings);
+		CHECK(state.level == 1 && state.previousLevel == 2 && state.fading);
+		CHECK(LodSelection::GetFadeProgress(state, 1.0f, settings) == 0.0f);
+		CHECK(std::fabs(LodSelection::GetFadeProgress(state, 1.125f, settings) - 0.5f) < 1e-6f);
+
+		// フェード中の切り替えは待ち、終わってから始めます。
+		LodSelection::Advance(state, 0, 3, 1.1f, settings);
+		CHECK(state.level == 1);
+		LodSelection::Advance(state, 0, 4, 1.3f, settings);
+		CHECK(state.level == 0 && state.previousLevel == 1 && state.fading);
+
+		// 描画しなかったフレームのあとは、フェードせずに切り替えます。
+		LodSelection::Advance(state, 3, 10, 2.0f, settings);
+		CHECK(state.level == 3 && !state.fading);
+		CHECK(LodSelection::GetFadeProgress(state, 2.0f, settings) == 1.0f);
+	}
+
+	// size x size の格子を xy 平面の [0, 1] に作ります。seam なら x = 0.5 の列の頂点を左右で分け、右半分の色を変えます。
+	MeshData CreateGrid(uint32_t size, bool seam)
+	{
+		MeshData mesh;
+		std::vector<uint32_t> left((size + 1) * (size + 1));
+		std::vector<uint32_t> right((size + 1) * (size + 1));
+		for (uint32_t row = 0; row <= size; ++row)
+		{
+			for (uint32_t column = 0; column <= size; ++column)
+			{
+				const uint32_t i = row * (size + 1) + column;
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(static_cast<float>(column) / size, static_cast<float>(row) / size, 0.0f);
+				const bool isRight = seam && column * 2 > size;
+				vertex.color = isRight ? XMFLOAT3(0.0f, 0.0f, 1.0f) : XMFLOAT3(1.0f, 0.0f, 0.0f);
+				left[i] = right[i] = static_cast<uint32_t>(mesh.vertices.size());
+				mesh.vertices.push_back(vertex);
+				if (seam && column * 2 == size)
+				{
+					vertex.color = XMFLOAT3(0.0f, 0.0f, 1.0f);
+					right[i] = static_cast<uint32_t>(mesh.vertices.size());
+					mesh.vertices.push_back(vertex);
+				}
+			}
+		}
+		for (uint32_t row = 0; row < size; ++row)
+		{
+			for (uint32_t column = 0; column < size; ++column)
+			{
+				const std::vector<uint32_t>& map = seam && column * 2 >= size ? right : left;
+				const uint32_t a = row * (size + 1) + column;
+				const uint32_t quad[] = { map[a], map[a + 1], map[a + size + 2], map[a], map[a + size + 2], map[a + size + 1] };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	double ComputeArea(const MeshData& mesh, const std::vector<uint32_t>& indices)
+	{
+		double area = 0.0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const XMFLOAT3& a = mesh.vertices[indices[i]].pos;
+			const XMFLOAT3& b = mesh.vertices[indices[i + 1]].pos;
+			const XMFLOAT3& c = mesh.vertices[indices[i + 2]].pos;
+			area += 0.5 * ((static_cast<double>(b.x) - a.x) * (c.y - a.y) - (static_cast<double>(c.x) - a.x) * (b.y - a.y));
+		}
+		return area;
+	}
+
+	bool IsOnSquareBorder(const XMFLOAT3& p)
+	{
+		return p.x == 0.0f || p.x == 1.0f || p.y == 0.0f || p.y == 1.0f;
+	}
+
+	// 開いた境界の頂点は境界に沿ってだけ動くので、平らな格子を大きく減らしても外周の正方形は変わりません。
+	void TestBorderIsPreserved()
+	{
+		const uint32_t size = 16;
+		const MeshData mesh = CreateGrid(size, false);
+		std::vector<uint32_t> output;
+		MeshSimplifier::Simplify(&mesh.vertices[0], static_cast<uint32_t>(mesh.vertices.size()), &mesh.indices[0],
+			static_cast<uint32_t>(mesh.indices.size()), 6, 0.01f, 1.0f, output);
+
+		CHECK(output.size() < mesh.indices.size() / 4);
+		CHECK(std::fabs(ComputeArea(mesh, output) - 1.0) < 1e-5);
+
+		// 逆向きの辺がない辺 (外周) は、正方形の辺の上にあります。
+		bool borderOnSquare = true;
+		for (size_t t = 0; t + 2 < output.size(); t += 3)
+		{
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				const uint32_t a = output[t + k];
+				const uint32_t b = output[t + (k + 1) % 3];
+				bool hasReverse = false;
+				for (size_t u = 0; u + 2 < output.size() && !hasReverse; u += 3)
+				{
+					for (uint32_t m = 0; m < 3; ++m)
+					{
+						hasReverse = hasReverse || (output[u + m] == b && output[u + (m + 1) % 3] == a);
+					}
+				}
+				if (!hasReverse)
+				{
+					borderOnSquare = borderOnSquare && IsOnSquareBorder(mesh.vertices[a].pos) && IsOnSquareBorder(mesh.vertices[b].pos);
+				}
+			}
+		}
+		CHECK(borderOnSquare);
+
+		// 四隅は動かせないので残ります。
+		const uint32_t corners[] = { 0, size, size * (size + 1), (size + 1) * (size + 1) - 1 };
+		for (uint32_t corner : corners)
+		{
+			CHECK(std::find(output.begin(), output.end(), corner) != output.end());
+		}
+	}
+
+	// 色の継ぎ目の頂点は動かさず、色の違う頂点どうしもまとめないので、三角形は継ぎ目の片側の色だけを使います。
+	void TestSeamIsLocked()
+	{
+		const uint32_t size = 16;
+		const MeshData mesh = CreateGrid(size, true);
+		std::vector<uint32_t> output;
+		MeshSimplifier::Simplify(&mesh.vertices[0], static_cast<uint32_t>(mesh.vertices.size()), &mesh.indices[0],
+			static_cast<uint32_t>(mesh.indices.size()), 6, 0.01f, 1.0f / 255.0f, output);
+
+		CHECK(output.size() < mesh.indices.size() / 2);
+		CHECK(std::fabs(ComputeArea(mesh, output) - 1.0) < 1e-5);
+
+		for (uint32_t v = 0; v < mesh.vertices.size(); ++v)
+		{
+			if (mesh.vertices[v].pos.x == 0.5f)
+			{
+				CHECK(std::find(output.begin(), output.end(), v) != output.end());
+			}
+		}
+
+		bool singleColor = true;
+		for (size_t t = 0; t + 2 < output.size(); t += 3)
+		{
+			const float blue = mesh.vertices[output[t]].color.z;
+			singleColor = singleColor && mesh.vertices[output[t + 1]].color.z == blue && mesh.vertices[output[t + 2]].color.z == blue;
+		}
+		CHECK(singleColor);
+	}
+}
+
+int main()
+{
+	TestSelectLevelHysteresis();
+	TestFadeIsComplementary();
+	TestAdvanceFades();
+	TestBorderIsPreserved();
+	TestSeamIsLocked();
+	return TestCheck::Finish();
+}
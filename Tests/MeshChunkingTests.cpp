@@ -0,0 +1,132 @@
+﻿#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "MeshChunking.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// size x size の格子。頂点はどれも位置が違うので、チャンクから戻した頂点を元の頂点と比べられます。
+	MeshData CreateGrid(uint32_t size)
+	{
+		MeshData mesh;
+		for (uint32_t row = 0; row <= size; ++row)
+		{
+			for (uint32_t column = 0; column <= size; ++column)
+			{
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(static_cast<float>(column), static_cast<float>(row), 0.0f);
+				vertex.color = XMFLOAT3(static_cast<float>(column % 7), static_cast<float>(row % 5), 1.0f);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t row = 0; row < size; ++row)
+		{
+			for (uint32_t column = 0; column < size; ++column)
+			{
+				const uint32_t a = row * (size + 1) + column;
+				const uint32_t quad[] = { a, a + 1, a + size + 2, a, a + size + 2, a + size + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	bool VerticesEqual(const VertexPositionColor& a, const VertexPositionColor& b)
+	{
+		return memcmp(&a, &b, sizeof(VertexPositionColor)) == 0;
+	}
+
+	// チャンクは隙間なく順に並び、頂点の数と三角形の数がどちらも上限以下で、
+	// baseVertex を足したインデックスで引いた頂点の列が、元の三角形の列と一致します。
+	void CheckLayout(const MeshData& mesh, const IndexedMeshLayout& layout, uint32_t maxTriangles)
+	{
+		CHECK(layout.indexFormat == IndexFormat::Uint16);
+		CHECK(layout.indices32.empty());
+		CHECK(layout.indices16.size() == mesh.indices.size());
+
+		uint32_t nextIndex = 0;
+		bool withinLimits = true;
+		bool rebuilt = true;
+		for (const MeshChunk& chunk : layout.chunks)
+		{
+			withinLimits = withinLimits && chunk.startIndex == nextIndex && chunk.indexCount % 3 == 0;
+			withinLimits = withinLimits && chunk.indexCount / 3 <= maxTriangles;
+			nextIndex = chunk.startIndex + chunk.indexCount;
+
+			uint32_t maxIndex = 0;
+			for (uint32_t i = chunk.startIndex; i < nextIndex; ++i)
+			{
+				const uint32_t index = layout.indices16[i];
+				maxIndex = index > maxIndex ? index : maxIndex;
+				rebuilt = rebuilt && chunk.baseVertex + index < layout.vertices.size() &&
+					VerticesEqual(layout.vertices[chunk.baseVertex + index], mesh.vertices[mesh.indices[i]]);
+			}
+			withinLimits = withinLimits && maxIndex < MeshChunking::MaxIndex16VertexCount;
+		}
+		CHECK(nextIndex == mesh.indices.size());
+		CHECK(withinLimits);
+		CHECK(rebuilt);
+	}
+
+	// 16 ビットに収まらないメッシュは、頂点数と機能レベル 9_1 の三角形数の上限に収まるチャンクに分けます。
+	void TestSplitsLargeMesh()
+	{
+		const MeshData mesh = CreateGrid(300);
+		CHECK(mesh.vertices.size() > MeshChunking::MaxIndex16VertexCount);
+
+		IndexedMeshLayout layout;
+		MeshChunking::BuildLayout(mesh, false, MeshChunking::MaxTrianglesPerDraw9_1, layout);
+		CHECK(layout.chunks.size() > 1);
+		CheckLayout(mesh, layout, MeshChunking::MaxTrianglesPerDraw9_1);
+
+		// 三角形数を制限しなくても、頂点数の上限で分けます。
+		MeshChunking::BuildLayout(mesh, false, 0, layout);
+		CHECK(layout.chunks.size() > 1);
+		CheckLayout(mesh, layout, UINT32_MAX);
+	}
+
+	// 16 ビットに収まるメッシュも、三角形数が上限を超えれば分けます。
+	void TestSplitsByTriangleCount()
+	{
+		const MeshData mesh = CreateGrid(40);
+		IndexedMeshLayout layout;
+		MeshChunking::BuildLayout(mesh, false, 500, layout);
+		CHECK(layout.chunks.size() == (mesh.indices.size() / 3 + 499) / 500);
+		CheckLayout(mesh, layout, 500);
+	}
+
+	// 分ける必要がなければ、頂点とインデックスをそのまま 1 つの範囲にします。
+	void TestSingleRange()
+	{
+		const MeshData small = CreateGrid(40);
+		IndexedMeshLayout layout;
+		MeshChunking::BuildLayout(small, false, MeshChunking::MaxTrianglesPerDraw9_1, layout);
+		CHECK(layout.chunks.size() == 1);
+		CHECK(layout.vertices.size() == small.vertices.size());
+		CheckLayout(small, layout, MeshChunking::MaxTrianglesPerDraw9_1);
+
+		const MeshData large = CreateGrid(300);
+		MeshChunking::BuildLayout(large, true, 0, layout);
+		CHECK(layout.indexFormat == IndexFormat::Uint32);
+		CHECK(layout.chunks.size() == 1);
+		CHECK(layout.chunks[0].indexCount == large.indices.size());
+		CHECK(layout.indices16.empty());
+		CHECK(layout.indices32 == large.indices);
+
+		const MeshData empty;
+		MeshChunking::BuildLayout(empty, false, MeshChunking::MaxTrianglesPerDraw9_1, layout);
+		CHECK(layout.chunks.size() == 1);
+		CHECK(layout.chunks[0].indexCount == 0);
+	}
+}
+
+int main()
+{
+	TestSplitsLargeMesh();
+	TestSplitsByTriangleCount();
+	TestSingleRange();
+	return TestCheck::Finish();
+}
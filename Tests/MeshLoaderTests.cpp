@@ -0,0 +1,188 @@
+﻿#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include "DrawQueue.h"
+#include "MeshLoader.h"
+#include "PolygonScene.h"
+#include "ReferenceRasterizer.h"
+#include "SoftwareRenderDevice.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+// アプリが Direct3DApp1::Load で読み込むメッシュ ファイル (Assets/Torus.pmsh) を、
+// CubeRenderer::LoadMeshAsync と ProcessLoadedMeshes と同じ手順で読み込んで描画します。
+// ファイルは CreateTorus から作ったもので、形を変えたら次のように書き換えます。
+//   MeshLoaderTests --update
+namespace
+{
+	const char* const TorusFileName = ASSET_DIRECTORY "/Torus.pmsh";
+
+	// y 軸を囲む、半径 1 の単色のトーラス。色が違う頂点はまとめないので、LOD を作れるように 1 色にします。
+	MeshData CreateTorus()
+	{
+		const uint32_t majorSegments = 32;
+		const uint32_t minorSegments = 16;
+		const float minorRadius = 0.35f;
+
+		MeshData mesh;
+		for (uint32_t i = 0; i < majorSegments; ++i)
+		{
+			const float u = i * XM_2PI / majorSegments;
+			for (uint32_t j = 0; j < minorSegments; ++j)
+			{
+				const float v = j * XM_2PI / minorSegments;
+				const float ring = 1.0f + minorRadius * std::cos(v);
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(ring * std::cos(u), minorRadius * std::sin(v), ring * std::sin(u));
+				vertex.color = XMFLOAT3(0.9f, 0.6f, 0.2f);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+
+		// 外から見て反時計回りになるように並べます。
+		for (uint32_t i = 0; i < majorSegments; ++i)
+		{
+			for (uint32_t j = 0; j < minorSegments; ++j)
+			{
+				const uint32_t a = i * minorSegments + j;
+				const uint32_t b = i * minorSegments + (j + 1) % minorSegments;
+				const uint32_t c = (i + 1) % majorSegments * minorSegments + j;
+				const uint32_t d = (i + 1) % majorSegments * minorSegments + (j + 1) % minorSegments;
+				const uint32_t quad[] = { a, b, c, c, b, d };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	bool WriteTorusFile()
+	{
+		const MeshData mesh = CreateTorus();
+		std::vector<uint8_t> data;
+		MeshFile::Write(mesh, FrustumCulling::ComputeMeshBounds(mesh), std::vector<MeshFileLod>(), data);
+		std::ofstream file(TorusFileName, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(&data[0]), data.size());
+		return static_cast<bool>(file);
+	}
+
+	// ワーカー スレッドの読み込みが終わるまで、ProcessLoadedMeshes と同じく毎回少しずつ受け取ります。
+	void TakeAll(MeshLoader& loader, std::vector<MeshLoadResult>& results)
+	{
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (loader.GetPendingCount() > 0 && std::chrono::steady_clock::now() < deadline)
+		{
+			if (loader.TakeCompleted(results, 1) == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	// コミットしたファイルは CreateTorus と同じ形で、読み込むと LOD が作られます。
+	void TestTorusAsset()
+	{
+		MeshLoadResult result;
+		MeshLoader::LoadFile(TorusFileName, result);
+		CHECK(result.status == MeshFileStatus::Ok);
+		if (result.status != MeshFileStatus::Ok)
+		{
+			return;
+		}
+
+		const MeshData expected = CreateTorus();
+		CHECK(result.lods.size() > 1);
+		CHECK(result.lods[0].indexCount == expected.indices.size());
+		CHECK(result.mesh.vertices.size() == expected.vertices.size());
+
+		// LOD を作るときにインデックスの順が変わるので、頂点の位置と色だけを比べます。
+		bool verticesMatch = result.mesh.vertices.size() == expected.vertices.size();
+		for (size_t i = 0; verticesMatch && i < expected.vertices.size(); ++i)
+		{
+			const VertexPositionColor& a = result.mesh.vertices[i];
+			const VertexPositionColor& b = expected.vertices[i];
+			verticesMatch =
+				std::fabs(a.pos.x - b.pos.x) < 1e-5f && std::fabs(a.pos.y - b.pos.y) < 1e-5f && std::fabs(a.pos.z - b.pos.z) < 1e-5f &&
+				std::fabs(a.color.x - b.color.x) < 1e-5f && std::fabs(a.color.y - b.color.y) < 1e-5f && std::fabs(a.color.z - b.color.z) < 1e-5f;
+		}
+		CHECK(verticesMatch);
+		CHECK(std::fabs(result.bounds.radius - 1.35f) < 1e-3f);
+	}
+
+	// ワーカー スレッドで読み込んだメッシュをシーンに追加すると、描画されます。読み込めないファイルは失敗の結果になります。
+	void TestLoadIntoScene()
+	{
+		MeshLoader loader(2);
+		const uint32_t torusRequest = loader.Enqueue(TorusFileName);
+		const uint32_t missingRequest = loader.Enqueue(ASSET_DIRECTORY "/Missing.pmsh");
+		std::vector<MeshLoadResult> results;
+		TakeAll(loader, results);
+		CHECK(results.size() == 2);
+
+		SoftwareRenderDevice device(160, 120, 2);
+		PolygonScene scene;
+		scene.CreateDeviceResources(device);
+		scene.SetSceneRotationSpeed(0.0f);
+		XMFLOAT4X4 orientationTransform;
+		XMStoreFloat4x4(&orientationTransform, XMMatrixIdentity());
+		scene.SetProjection(160.0f / 120.0f, orientationTransform);
+
+		uint32_t added = 0;
+		for (MeshLoadResult& result : results)
+		{
+			if (result.requestId == missingRequest)
+			{
+				CHECK(result.status == MeshFileStatus::OpenFailed);
+				continue;
+			}
+			CHECK(result.requestId == torusRequest && result.status == MeshFileStatus::Ok);
+			if (result.status == MeshFileStatus::Ok)
+			{
+				XMFLOAT4X4 transform;
+				XMStoreFloat4x4(&transform, XMMatrixMultiply(XMMatrixScaling(0.3f, 0.3f, 0.3f), XMMatrixTranslation(0.0f, 0.5f, 0.0f)));
+				const uint32_t mesh = scene.AddMesh(device, result.mesh, result.bounds, result.lods);
+				scene.AddObject(mesh, transform, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+				++added;
+			}
+		}
+		CHECK(added == 1);
+
+		SceneSnapshot snapshot;
+		DrawQueue drawQueue;
+		RenderCommandList commandList;
+		scene.Update(1.0f, 0.0f);
+		scene.CaptureSnapshot(snapshot);
+		scene.Record(snapshot, drawQueue, TwoSidedMode::SinglePass);
+		drawQueue.Flush(commandList);
+
+		// トーラスは既定のポリゴンより上にあるので、画面の上の方に描画されます。
+		const float black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		device.Clear(black);
+		device.SetConstants(scene.GetConstants(snapshot));
+		device.Execute(commandList);
+
+		const uint32_t packedBlack = ReferenceRasterizer::PackColor(black[0], black[1], black[2], black[3]);
+		uint32_t coveredTop = 0;
+		for (uint32_t i = 0; i < 160 * 30; ++i)
+		{
+			coveredTop += device.GetColorBuffer()[i] != packedBlack ? 1 : 0;
+		}
+		CHECK(coveredTop > 100);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc == 2 && strcmp(argv[1], "--update") == 0)
+	{
+		CHECK(WriteTorusFile());
+	}
+
+	TestTorusAsset();
+	TestLoadIntoScene();
+	return TestCheck::Finish();
+}
@@ -0,0 +1,52 @@
+﻿#include "OffscreenRenderer.h"
+
+using namespace DirectX;
+
+OffscreenRenderer::OffscreenRenderer(uint32_t width, uint32_t height, uint32_t threadCount) :
+	m_device(width, height, threadCount),
+	m_twoSidedMode(TwoSidedMode::SinglePass)
+{
+	m_scene.CreateDeviceResources(m_device);
+
+	// 描画先は回転しないので、表示方向の変換は単位行列です。
+	XMFLOAT4X4 orientationTransform;
+	XMStoreFloat4x4(&orientationTransform, XMMatrixIdentity());
+	m_scene.SetProjection(static_cast<float>(width) / static_cast<float>(height), orientationTransform);
+
+	// SoftwareRenderDevice はディザによるフェードをサポートするので、CubeRenderer の 1 パスの両面表示と同じ設定にします。
+	LodSettings settings;
+	settings.viewportWidth = static_cast<float>(width);
+	settings.viewportHeight = static_cast<float>(height);
+	m_scene.SetLodSettings(settings);
+}
+
+void OffscreenRenderer::SetTwoSidedMode(TwoSidedMode mode)
+{
+	m_twoSidedMode = mode;
+}
+
+void OffscreenRenderer::Update(float timeTotal, float timeDelta)
+{
+	m_scene.Update(timeTotal, timeDelta);
+	m_scene.CaptureSnapshot(m_snapshot);
+}
+
+void OffscreenRenderer::Render()
+{
+	const float midnightBlue[] = { 0.098f, 0.098f, 0.439f, 1.000f };
+	m_device.Clear(midnightBlue);
+
+	m_commandList.Reset();
+	m_scene.Record(m_snapshot, m_drawQueue, m_twoSidedMode);
+	m_drawQueue.Flush(m_commandList);
+
+	m_device.SetConstants(m_scene.GetConstants(m_snapshot));
+	m_device.Execute(m_commandList);
+}
+
+void OffscreenRenderer::ReadPixels(Image& image) const
+{
+	image.width = m_device.GetWidth();
+	image.height = m_device.GetHeight();
+	image.pixels = m_device.GetColorBuffer();
+}
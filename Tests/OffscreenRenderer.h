@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <cstdint>
+#include "PolygonScene.h"
+#include "SoftwareRenderDevice.h"
+#include "ImageFile.h"
+
+/**
+ * CubeRenderer と同じシーンを、ウィンドウもスワップ チェーンも使わずに SoftwareRenderDevice でメモリ上に描画します。
+ * Update と Render は CubeRenderer の Update と RenderSnapshot と同じ手順なので、
+ * 決まった timeTotal で描画した画像を正解の画像と比べたり、描画にかかる時間を計ったりできます。
+ * 変わった範囲だけを描き直すことはせず、毎フレーム全体を描画します。
+ */
+class OffscreenRenderer
+{
+public:
+	// threadCount は SoftwareRenderDevice のスレッド数です。結果はスレッド数によりません。
+	OffscreenRenderer(uint32_t width, uint32_t height, uint32_t threadCount);
+
+	// 描画するシーン。オブジェクトを追加したり、動きを変えたりするのに使います。
+	PolygonScene& GetScene() { return m_scene; }
+
+	// 両面表示の方法を切り替えます。既定値は TwoSidedMode::SinglePass です。
+	void SetTwoSidedMode(TwoSidedMode mode);
+
+	// CubeRenderer::Update と同じく、シーンを timeTotal の状態に更新します。
+	void Update(float timeTotal, float timeDelta);
+
+	// 最後に Update した状態を描画します。
+	void Render();
+
+	// 描画した画像を image にコピーします。
+	void ReadPixels(Image& image) const;
+
+	uint32_t GetWidth() const { return m_device.GetWidth(); }
+	uint32_t GetHeight() const { return m_device.GetHeight(); }
+
+private:
+	OffscreenRenderer(const OffscreenRenderer&);
+	OffscreenRenderer& operator=(const OffscreenRenderer&);
+
+	SoftwareRenderDevice m_device;
+	PolygonScene m_scene;
+	SceneSnapshot m_snapshot;
+	DrawQueue m_drawQueue;
+	RenderCommandList m_commandList;
+	TwoSidedMode m_twoSidedMode;
+};
@@ -0,0 +1,155 @@
+﻿#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "PolygonTriangulator.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+namespace
+{
+	double SignedArea(const std::vector<XMFLOAT2>& ring)
+	{
+		double area = 0.0;
+		for (size_t i = 0; i < ring.size(); ++i)
+		{
+			const XMFLOAT2& p = ring[i];
+			const XMFLOAT2& q = ring[(i + 1) % ring.size()];
+			area += static_cast<double>(p.x) * q.y - static_cast<double>(q.x) * p.y;
+		}
+		return area * 0.5;
+	}
+
+	// 中心からの距離が角度ごとに変わる星形の多角形。clockwise で向きを、hole で中央の四角い穴を指定します。
+	PolygonData CreateStarPolygon(uint32_t pointCount, uint32_t seed, bool clockwise, bool hole)
+	{
+		PolygonData polygon;
+		for (uint32_t i = 0; i < pointCount; ++i)
+		{
+			const uint32_t k = clockwise ? pointCount - i : i;
+			const float angle = k * XM_2PI / pointCount;
+			const float radius = 1.0f + 0.8f * static_cast<float>((k * 7919 + seed * 104729) % 97) / 97.0f;
+			polygon.outer.push_back(XMFLOAT2(radius * std::cos(angle), radius * std::sin(angle)));
+		}
+		if (hole)
+		{
+			std::vector<XMFLOAT2> square;
+			square.push_back(XMFLOAT2(-0.4f, -0.4f));
+			square.push_back(XMFLOAT2(0.4f, -0.4f));
+			square.push_back(XMFLOAT2(0.4f, 0.4f));
+			square.push_back(XMFLOAT2(-0.4f, 0.4f));
+			polygon.holes.push_back(square);
+		}
+		return polygon;
+	}
+
+	// 三角形の数、向き、面積の合計が多角形と一致するかどうかを返します。
+	bool IsValidTriangulation(const PolygonData& polygon, const std::vector<uint32_t>& indices)
+	{
+		MeshData mesh;
+		PolygonTriangulator::CreateMeshData(polygon, indices, XMFLOAT3(1.0f, 1.0f, 1.0f), mesh);
+
+		double expectedArea = std::fabs(SignedArea(polygon.outer));
+		for (const std::vector<XMFLOAT2>& hole : polygon.holes)
+		{
+			expectedArea -= std::fabs(SignedArea(hole));
+		}
+		const size_t expectedTriangles = mesh.vertices.size() - 2 + 2 * polygon.holes.size();
+		if (indices.size() != expectedTriangles * 3)
+		{
+			return false;
+		}
+
+		double area = 0.0;
+		for (size_t t = 0; t < indices.size(); t += 3)
+		{
+			if (indices[t] >= mesh.vertices.size() || indices[t + 1] >= mesh.vertices.size() || indices[t + 2] >= mesh.vertices.size())
+			{
+				return false;
+			}
+			const XMFLOAT3& a = mesh.vertices[indices[t]].pos;
+			const XMFLOAT3& b = mesh.vertices[indices[t + 1]].pos;
+			const XMFLOAT3& c = mesh.vertices[indices[t + 2]].pos;
+			const double triangleArea = 0.5 * ((static_cast<double>(b.x) - a.x) * (static_cast<double>(c.y) - a.y) - (static_cast<double>(c.x) - a.x) * (static_cast<double>(b.y) - a.y));
+			if (triangleArea <= 0.0)
+			{
+				return false;
+			}
+			area += triangleArea;
+		}
+		return std::fabs(area - expectedArea) <= expectedArea * 1e-6;
+	}
+
+	// 外周の向きや穴の有無によらず、面積を保った反時計回りの三角形に分割されます。
+	void TestTriangulate()
+	{
+		PolygonTriangulator triangulator;
+		for (uint32_t seed = 0; seed < 20; ++seed)
+		{
+			const PolygonData polygon = CreateStarPolygon(5 + seed * 13, seed, seed % 2 == 1, seed % 3 == 0);
+			std::vector<uint32_t> indices;
+			CHECK(triangulator.Triangulate(polygon, indices));
+			CHECK(IsValidTriangulation(polygon, indices));
+		}
+	}
+
+	// 連続する同じ点は無視し、点が 3 つに満たない多角形は失敗します。
+	void TestDegeneratePolygons()
+	{
+		PolygonTriangulator triangulator;
+		PolygonData polygon;
+		polygon.outer.push_back(XMFLOAT2(0.0f, 0.0f));
+		polygon.outer.push_back(XMFLOAT2(0.0f, 0.0f));
+		polygon.outer.push_back(XMFLOAT2(1.0f, 0.0f));
+		polygon.outer.push_back(XMFLOAT2(1.0f, 0.0f));
+		std::vector<uint32_t> indices;
+		CHECK(!triangulator.Triangulate(polygon, indices));
+
+		// 最後の点が最初の点と同じでも、閉じた輪として扱います。
+		polygon.outer.push_back(XMFLOAT2(0.0f, 1.0f));
+		polygon.outer.push_back(XMFLOAT2(0.0f, 0.0f));
+		indices.clear();
+		CHECK(triangulator.Triangulate(polygon, indices));
+		CHECK(indices.size() == 3);
+	}
+
+	// 複数のスレッドで分割しても、1 つずつ分割した結果と一致します。
+	void TestBatchMatchesSerial()
+	{
+		std::vector<PolygonData> polygons;
+		for (uint32_t seed = 0; seed < 200; ++seed)
+		{
+			polygons.push_back(CreateStarPolygon(4 + seed % 60, seed, seed % 2 == 0, seed % 4 == 1));
+		}
+		PolygonData invalid;
+		invalid.outer.push_back(XMFLOAT2(0.0f, 0.0f));
+		polygons.push_back(invalid);
+
+		std::vector<std::vector<uint32_t>> serial(polygons.size());
+		PolygonTriangulator triangulator;
+		for (size_t i = 0; i < polygons.size(); ++i)
+		{
+			triangulator.Triangulate(polygons[i], serial[i]);
+		}
+
+		// jobSystem なしの直列と、ワーカーの数を変えた並列のどれでも同じ結果になります。
+		const uint32_t threadCounts[] = { 0, 1, 3, 8 };
+		for (uint32_t threadCount : threadCounts)
+		{
+			std::unique_ptr<JobSystem> jobSystem(threadCount > 0 ? new JobSystem(threadCount - 1) : nullptr);
+			std::vector<std::vector<uint32_t>> results;
+			CHECK(PolygonTriangulator::TriangulateBatch(polygons, results, jobSystem.get()) == 200);
+			CHECK(results == serial);
+			CHECK(results.back().empty());
+		}
+	}
+}
+
+int main()
+{
+	TestTriangulate();
+	TestDegeneratePolygons();
+	TestBatchMatchesSerial();
+	return TestCheck::Finish();
+}
@@ -0,0 +1,223 @@
+﻿#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Profiler.h"
+#include "TestCheck.h"
+
+namespace
+{
+	const ProfileZoneStatistics* FindZone(const std::vector<ProfileZoneStatistics>& statistics, const char* name)
+	{
+		for (const ProfileZoneStatistics& zone : statistics)
+		{
+			if (strcmp(zone.name, name) == 0)
+			{
+				return &zone;
+			}
+		}
+		return nullptr;
+	}
+
+	size_t CountOccurrences(const std::string& text, const std::string& pattern)
+	{
+		size_t count = 0;
+		for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+		{
+			++count;
+		}
+		return count;
+	}
+
+	// パーセンタイルはバケットの上限を返すので、真の値より 12.5% まで大きくなります。
+	void TestHistogramPercentiles()
+	{
+		FrameTimeHistogram histogram;
+		CHECK(histogram.GetPercentile(50.0) == 0.0);
+
+		for (uint32_t i = 1; i <= 100; ++i)
+		{
+			histogram.Add(static_cast<double>(i));
+		}
+		CHECK(histogram.GetSampleCount() == 100);
+		CHECK(histogram.GetMax() == 100.0);
+		CHECK(histogram.GetPercentile(50.0) >= 50.0 && histogram.GetPercentile(50.0) <= 50.0 * 1.125);
+		CHECK(histogram.GetPercentile(95.0) >= 95.0 && histogram.GetPercentile(95.0) <= 95.0 * 1.125);
+		CHECK(histogram.GetPercentile(99.0) >= 99.0 && histogram.GetPercentile(99.0) <= 100.0);
+		CHECK(histogram.GetPercentile(100.0) == 100.0);
+
+		// 1 マイクロ秒未満と、範囲を超える値も数えます。
+		histogram.Reset();
+		histogram.Add(0.0001);
+		histogram.Add(60000.0);
+		CHECK(histogram.GetSampleCount() == 2);
+		CHECK(histogram.GetPercentile(50.0) <= 0.001);
+		CHECK(histogram.GetPercentile(100.0) == 60000.0);
+	}
+
+	// 一周したリングからは、上書きされていない新しいイベントだけを読みます。
+	void TestEventRingWraps()
+	{
+		ProfileEventRing ring(5);
+		CHECK(ring.GetCapacity() == 8);
+
+		for (uint32_t i = 0; i < 20; ++i)
+		{
+			ProfileEvent event = { "Event", i, i + 1, 1, 0 };
+			ring.Push(event);
+		}
+
+		std::vector<ProfileEvent> events;
+		CHECK(ring.Read(0, events) == 20);
+		CHECK(events.size() == 8);
+		for (size_t i = 0; i < events.size(); ++i)
+		{
+			CHECK(events[i].begin == 12 + i);
+		}
+
+		events.clear();
+		CHECK(ring.Read(18, events) == 20);
+		CHECK(events.size() == 2);
+	}
+
+	// 複数のスレッドが書き込んでいる間に読んでも、書きかけのイベントは返しません。
+	void TestEventRingConcurrentPush()
+	{
+		ProfileEventRing ring(256);
+		std::vector<std::thread> writers;
+		for (uint32_t t = 0; t < 4; ++t)
+		{
+			writers.push_back(std::thread([&ring, t]() {
+				for (uint32_t i = 0; i < 20000; ++i)
+				{
+					ProfileEvent event = { "Event", i, i * 3 + t, t, i ^ t };
+					ring.Push(event);
+				}
+			}));
+		}
+
+		bool consistent = true;
+		uint64_t readIndex = 0;
+		std::vector<ProfileEvent> events;
+		while (ring.GetWriteIndex() < 80000)
+		{
+			events.clear();
+			readIndex = ring.Read(readIndex, events);
+			for (const ProfileEvent& event : events)
+			{
+				const uint32_t i = static_cast<uint32_t>(event.begin);
+				consistent = consistent && event.threadId < 4 && event.end == i * 3 + event.threadId && event.frame == (i ^ event.threadId);
+			}
+		}
+		for (std::thread& writer : writers)
+		{
+			writer.join();
+		}
+
+		events.clear();
+		ring.Read(0, events);
+		CHECK(consistent);
+		CHECK(events.size() == 256);
+	}
+
+	// 同じ名前の区間は 1 フレームの中で合計し、記録のなかったフレームは数えません。
+	// 名前は文字列で比べるので、ポインターが違っても同じ区間になります。
+	void TestZoneStatistics()
+	{
+		Profiler profiler(1024);
+		const uint64_t millisecond = ProfilerClock::GetFrequency() / 1000;
+		char copiedName[] = "Update";
+
+		for (uint32_t frame = 0; frame < 10; ++frame)
+		{
+			profiler.BeginFrame();
+			const uint64_t now = ProfilerClock::Now();
+			profiler.Record("Update", now, now + millisecond);
+			profiler.Record(copiedName, now + millisecond, now + 2 * millisecond);
+			if (frame % 2 == 0)
+			{
+				profiler.Record("Render", now, now + 4 * millisecond, Profiler::GpuThreadId);
+			}
+			profiler.EndFrame();
+		}
+		CHECK(profiler.GetFrameIndex() == 10);
+
+		std::vector<ProfileZoneStatistics> statistics;
+		profiler.GetStatistics(statistics);
+		CHECK(statistics.size() == 3);
+
+		const ProfileZoneStatistics* update = FindZone(statistics, "Update");
+		CHECK(update != nullptr);
+		if (update != nullptr)
+		{
+			CHECK(update->frameCount == 10);
+			CHECK(update->p50 >= 2.0 && update->p50 <= 2.0 * 1.125);
+			CHECK(update->max >= 2.0 && update->max < 2.001);
+		}
+
+		const ProfileZoneStatistics* render = FindZone(statistics, "Render");
+		CHECK(render != nullptr && render->frameCount == 5);
+		CHECK(FindZone(statistics, "Frame") != nullptr && FindZone(statistics, "Frame")->frameCount == 10);
+
+		profiler.ResetStatistics();
+		profiler.GetStatistics(statistics);
+		CHECK(statistics.size() == 3 && statistics[0].frameCount == 0);
+	}
+
+	// ProfileZone はスコープを区間として記録し、プロファイラーがなければ何もしません。
+	void TestProfileZone()
+	{
+		Profiler profiler(64);
+		profiler.BeginFrame();
+		{
+			ProfileZone zone(&profiler, "Scope");
+			ProfileZone disabled(nullptr, "Disabled");
+		}
+		profiler.EndFrame();
+
+		std::vector<ProfileZoneStatistics> statistics;
+		profiler.GetStatistics(statistics);
+		CHECK(FindZone(statistics, "Scope") != nullptr);
+		CHECK(FindZone(statistics, "Disabled") == nullptr);
+	}
+
+	// 区間ごとに完了イベントを 1 つ書き出し、名前の引用符とバックスラッシュをエスケープします。
+	void TestChromeTrace()
+	{
+		Profiler profiler(64);
+		profiler.BeginFrame();
+		const uint64_t now = ProfilerClock::Now();
+		profiler.Record("Quote\"Back\\slash", now, now + 10);
+		profiler.Record("Gpu", now, now + 20, Profiler::GpuThreadId);
+		profiler.EndFrame();
+
+		std::ostringstream stream;
+		profiler.WriteChromeTrace(stream);
+		const std::string trace = stream.str();
+
+		CHECK(trace.compare(0, 16, "{\"traceEvents\":[") == 0);
+		CHECK(trace.find("\"name\":\"Quote\\\"Back\\\\slash\"") != std::string::npos);
+		CHECK(trace.find("\"tid\":4294967295,\"args\":{\"name\":\"GPU\"}") != std::string::npos);
+		CHECK(CountOccurrences(trace, "\"ph\":\"X\"") == 3);
+		CHECK(CountOccurrences(trace, "{") == CountOccurrences(trace, "}"));
+		CHECK(CountOccurrences(trace, "\"args\":{\"frame\":0}") == 3);
+
+		// ストリームの書式は元に戻します。
+		stream.str("");
+		stream << 1.5;
+		CHECK(stream.str() == "1.5");
+	}
+}
+
+int main()
+{
+	TestHistogramPercentiles();
+	TestEventRingWraps();
+	TestEventRingConcurrentPush();
+	TestZoneStatistics();
+	TestProfileZone();
+	TestChromeTrace();
+	return TestCheck::Finish();
+}
@@ -0,0 +1,207 @@
+﻿#include <cstdint>
+#include <vector>
+#include "ReferenceRasterizer.h"
+#include "RenderCommandPartition.h"
+#include "SoftwareRenderDevice.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// パイプラインとメッシュを切り替えながら drawCount 回描画するコマンド。drawDynamicEvery 回に 1 回は DrawDynamic にします。
+	void RecordCommands(uint32_t drawCount, uint32_t drawDynamicEvery, RenderCommandList& commandList)
+	{
+		const uint32_t pipelines[] = { PipelineCullBack, PipelineCullNone, PipelineCullFront };
+		for (uint32_t i = 0; i < drawCount; ++i)
+		{
+			if (i % 100 == 0)
+			{
+				commandList.SetPipelineState(pipelines[i / 100 % 3]);
+			}
+			if (i % 7 == 0)
+			{
+				commandList.SetMesh(i / 7 % 2);
+			}
+			if (drawDynamicEvery != 0 && i % drawDynamicEvery == drawDynamicEvery - 1)
+			{
+				commandList.DrawDynamic(i / drawDynamicEvery % 4 * 3, 3);
+				continue;
+			}
+
+			InstanceData instance;
+			XMStoreFloat4x4(&instance.model, XMMatrixTranslation((i % 31) * 0.06f - 0.9f, (i % 23) * 0.08f - 0.9f, (i % 11) * 0.05f));
+			instance.color = XMFLOAT4((i % 5) * 0.25f, 1.0f, (i % 3) * 0.5f, 1.0f);
+			commandList.DrawInstanced(i / 7 % 2, commandList.AppendInstance(instance), 1);
+		}
+	}
+
+	// 範囲の先頭のステートを、先頭からコマンドをたどって求めます。
+	void GetStateBefore(const RenderCommandList& commandList, uint32_t commandIndex, uint32_t& pipelineId, uint32_t& meshId)
+	{
+		pipelineId = RenderCommandPartition::NoState;
+		meshId = RenderCommandPartition::NoState;
+		for (uint32_t i = 0; i < commandIndex; ++i)
+		{
+			const RenderCommand& command = commandList.GetCommands()[i];
+			if (command.type == RenderCommandType::SetPipelineState)
+			{
+				pipelineId = command.arg0;
+			}
+			else if (command.type == RenderCommandType::SetMesh || command.type == RenderCommandType::DrawInstanced)
+			{
+				meshId = command.arg0;
+			}
+			else if (command.type == RenderCommandType::DrawDynamic)
+			{
+				meshId = RenderCommandPartition::NoState;
+			}
+		}
+	}
+
+	uint32_t CountDraws(const RenderCommandList& commandList, const RenderCommandPartition& partition)
+	{
+		uint32_t count = 0;
+		for (uint32_t i = partition.firstCommand; i < partition.firstCommand + partition.commandCount; ++i)
+		{
+			const RenderCommandType type = commandList.GetCommands()[i].type;
+			if (type == RenderCommandType::DrawInstanced || type == RenderCommandType::DrawDynamic)
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+
+	// コマンドがなければ範囲を作らず、描画が少なければ 1 つの範囲にまとめます。
+	void TestSmallLists()
+	{
+		std::vector<RenderCommandPartition> partitions;
+		RenderCommandList empty;
+		RenderCommandPartitioner::Partition(empty, 4, 64, partitions);
+		CHECK(partitions.empty());
+
+		RenderCommandList small;
+		RecordCommands(100, 0, small);
+		RenderCommandPartitioner::Partition(small, 4, 64, partitions);
+		CHECK(partitions.size() == 1);
+		CHECK(partitions[0].firstCommand == 0 && partitions[0].commandCount == small.GetCommands().size());
+		CHECK(partitions[0].pipelineId == RenderCommandPartition::NoState && partitions[0].meshId == RenderCommandPartition::NoState);
+	}
+
+	// 範囲は隙間なく続き、描画の数がそろい、先頭のステートが直前のコマンドと一致します。
+	void TestPartitionsCoverCommands()
+	{
+		RenderCommandList commandList;
+		RecordCommands(1000, 9, commandList);
+
+		const uint32_t maxPartitionCounts[] = { 2, 3, 4, 8, 15 };
+		for (uint32_t maxPartitions : maxPartitionCounts)
+		{
+			std::vector<RenderCommandPartition> partitions;
+			RenderCommandPartitioner::Partition(commandList, maxPartitions, 64, partitions);
+			CHECK(partitions.size() == maxPartitions);
+
+			uint32_t next = 0;
+			uint32_t draws = 0;
+			bool statesMatch = true;
+			bool balanced = true;
+			const uint32_t drawsPerPartition = (1000 + maxPartitions - 1) / maxPartitions;
+			for (size_t p = 0; p < partitions.size(); ++p)
+			{
+				const RenderCommandPartition& partition = partitions[p];
+				CHECK(partition.firstCommand == next);
+				next = partition.firstCommand + partition.commandCount;
+
+				uint32_t pipelineId;
+				uint32_t meshId;
+				GetStateBefore(commandList, partition.firstCommand, pipelineId, meshId);
+				statesMatch = statesMatch && partition.pipelineId == pipelineId && partition.meshId == meshId;
+
+				const uint32_t partitionDraws = CountDraws(commandList, partition);
+				balanced = balanced && (p + 1 == partitions.size() ? partitionDraws <= drawsPerPartition : partitionDraws == drawsPerPartition);
+				draws += partitionDraws;
+			}
+			CHECK(next == commandList.GetCommands().size());
+			CHECK(draws == 1000);
+			CHECK(statesMatch);
+			CHECK(balanced);
+		}
+
+		// 1 つの範囲の描画は minDrawsPerPartition 未満になりません。
+		std::vector<RenderCommandPartition> partitions;
+		RenderCommandPartitioner::Partition(commandList, 100, 64, partitions);
+		CHECK(partitions.size() == 1000 / 64);
+	}
+
+	MeshData CreateMesh(float size, float z)
+	{
+		MeshData mesh;
+		const VertexPositionColor vertices[] =
+		{
+			{ XMFLOAT3(-size, -size, z), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+			{ XMFLOAT3(size, -size, z), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+			{ XMFLOAT3(size, size, z + 0.1f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+			{ XMFLOAT3(-size, size, z + 0.1f), XMFLOAT3(1.0f, 1.0f, 1.0f) }
+		};
+		const uint32_t indices[] = { 0, 1, 2, 0, 3, 2 };
+		mesh.vertices.assign(vertices, vertices + 4);
+		mesh.indices.assign(indices, indices + 6);
+		return mesh;
+	}
+
+	void Render(SoftwareRenderDevice& device, uint32_t partitionCount)
+	{
+		device.CreateMesh(CreateMesh(0.1f, 0.2f));
+		device.CreateMesh(CreateMesh(0.05f, 0.4f));
+		device.SetRecordingPartitionCount(partitionCount);
+
+		RenderCommandList commandList;
+		RecordCommands(1000, 9, commandList);
+		const MeshData dynamicMesh = CreateMesh(0.3f, 0.3f);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			device.AppendDynamicVertices(&dynamicMesh.vertices[i % 2], 3);
+		}
+
+		ModelViewProjectionConstantBuffer constants;
+		XMStoreFloat4x4(&constants.model, XMMatrixIdentity());
+		XMStoreFloat4x4(&constants.view, XMMatrixIdentity());
+		XMStoreFloat4x4(&constants.projection, XMMatrixIdentity());
+		const float black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		device.Clear(black);
+		device.SetConstants(constants);
+		device.Execute(commandList);
+	}
+
+	// 範囲に分けて展開しても、1 つの範囲で展開したときと同じ画像になります。描画先の大部分を覆う描画で比べます。
+	void TestPartitionedReplayMatchesSerial()
+	{
+		SoftwareRenderDevice serial(128, 96, 2);
+		Render(serial, 1);
+		const uint32_t packedBlack = ReferenceRasterizer::PackColor(0.0f, 0.0f, 0.0f, 1.0f);
+		uint32_t covered = 0;
+		for (uint32_t color : serial.GetColorBuffer())
+		{
+			covered += color != packedBlack ? 1 : 0;
+		}
+		CHECK(covered > 128 * 96 / 4);
+
+		const uint32_t partitionCounts[] = { 2, 4, 7 };
+		for (uint32_t partitionCount : partitionCounts)
+		{
+			SoftwareRenderDevice partitioned(128, 96, 2);
+			Render(partitioned, partitionCount);
+			CHECK(partitioned.GetColorBuffer() == serial.GetColorBuffer());
+			CHECK(partitioned.GetDepthBuffer() == serial.GetDepthBuffer());
+		}
+	}
+}
+
+int main()
+{
+	TestSmallLists();
+	TestPartitionsCoverCommands();
+	TestPartitionedReplayMatchesSerial();
+	return TestCheck::Finish();
+}
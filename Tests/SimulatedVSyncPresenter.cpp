@@ -0,0 +1,26 @@
+﻿#include "SimulatedVSyncPresenter.h"
+#include <thread>
+
+SimulatedVSyncPresenter::SimulatedVSyncPresenter(double refreshRate) :
+	m_interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / refreshRate))),
+	m_nextVSync(std::chrono::steady_clock::now() + m_interval),
+	m_presentCount(0),
+	m_missedVSyncCount(0)
+{
+}
+
+void SimulatedVSyncPresenter::Present()
+{
+	// 垂直同期を過ぎていれば、過ぎた後の最初の垂直同期まで待ちます。
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now > m_nextVSync)
+	{
+		const int64_t late = (now - m_nextVSync) / m_interval + 1;
+		m_nextVSync += m_interval * late;
+		++m_missedVSyncCount;
+	}
+
+	std::this_thread::sleep_until(m_nextVSync);
+	m_nextVSync += m_interval;
+	++m_presentCount;
+}
@@ -0,0 +1,29 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * 垂直同期を待つ Present の代わりに使う、ウィンドウのない環境用の表示。
+ * Present は次の垂直同期の時刻まで待ち、間に合わなかった垂直同期の数を数えます。
+ */
+class SimulatedVSyncPresenter
+{
+public:
+	explicit SimulatedVSyncPresenter(double refreshRate);
+
+	void Present();
+
+	uint64_t GetPresentCount() const { return m_presentCount; }
+
+	// 直前の Present から 1 間隔より多く経過して表示が遅れた回数。
+	uint64_t GetMissedVSyncCount() const { return m_missedVSyncCount; }
+
+	std::chrono::steady_clock::duration GetInterval() const { return m_interval; }
+
+private:
+	std::chrono::steady_clock::duration m_interval;
+	std::chrono::steady_clock::time_point m_nextVSync;
+	uint64_t m_presentCount;
+	uint64_t m_missedVSyncCount;
+};
@@ -0,0 +1,288 @@
+﻿#include <cstdint>
+#include <vector>
+#include "ReferenceRasterizer.h"
+#include "SoftwareRenderDevice.h"
+#include "TestCheck.h"
+#include "VertexTransform.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const float MidnightBlue[] = { 0.098f, 0.098f, 0.439f, 1.000f };
+
+	// 再現できる疑似乱数 (xorshift32)。
+	class Random
+	{
+	public:
+		explicit Random(uint32_t seed) : m_state(seed) {}
+
+		float Next(float minValue, float maxValue)
+		{
+			m_state ^= m_state << 13;
+			m_state ^= m_state >> 17;
+			m_state ^= m_state << 5;
+			return minValue + (maxValue - minValue) * static_cast<float>(m_state & 0xFFFFFF) / 16777216.0f;
+		}
+
+	private:
+		uint32_t m_state;
+	};
+
+	// 画面の外にはみ出すものや、近クリップ面をまたぐものも含む、向きのばらばらな三角形のメッシュ。
+	MeshData CreateRandomTriangles(uint32_t triangleCount, uint32_t seed)
+	{
+		Random random(seed);
+		MeshData mesh;
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			const XMFLOAT3 center(random.Next(-1.5f, 1.5f), random.Next(-1.2f, 1.2f), random.Next(-1.0f, 1.2f));
+			const XMFLOAT3 color(random.Next(0.0f, 1.0f), random.Next(0.0f, 1.0f), random.Next(0.0f, 1.0f));
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				VertexPositionColor vertex;
+				vertex.pos = XMFLOAT3(center.x + random.Next(-0.3f, 0.3f), center.y + random.Next(-0.3f, 0.3f), center.z + random.Next(-0.3f, 0.3f));
+				vertex.color = XMFLOAT3(color.x, color.y * (k + 1) / 3.0f, color.z);
+				mesh.vertices.push_back(vertex);
+				mesh.indices.push_back(t * 3 + k);
+			}
+		}
+		return mesh;
+	}
+
+	// 重ならないように格子状に並べた、奥行きと傾きの違う三角形のメッシュ。表と裏の三角形が交互に並びます。
+	MeshData CreateTriangleGrid()
+	{
+		MeshData mesh;
+		for (uint32_t gy = 0; gy < 20; ++gy)
+		{
+			for (uint32_t gx = 0; gx < 20; ++gx)
+			{
+				const XMFLOAT3 corner(gx * 0.15f - 1.5f, gy * 0.12f - 1.2f, ((gx * 7 + gy * 3) % 11) * 0.1f - 0.5f);
+				const float tilt = (static_cast<int32_t>((gx + gy) % 5) - 2) * 0.05f;
+				const VertexPositionColor triangle[] =
+				{
+					{ corner, XMFLOAT3(gx / 20.0f, gy / 20.0f, 0.5f) },
+					{ XMFLOAT3(corner.x + 0.12f, corner.y + 0.01f, corner.z + tilt), XMFLOAT3(1.0f, 0.0f, gx / 20.0f) },
+					{ XMFLOAT3(corner.x + 0.03f, corner.y + 0.1f, corner.z - tilt), XMFLOAT3(0.0f, 1.0f, gy / 20.0f) }
+				};
+				const uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+				mesh.vertices.insert(mesh.vertices.end(), triangle, triangle + 3);
+				mesh.indices.push_back(base);
+				mesh.indices.push_back((gx + gy) % 2 == 0 ? base + 1 : base + 2);
+				mesh.indices.push_back((gx + gy) % 2 == 0 ? base + 2 : base + 1);
+			}
+		}
+		return mesh;
+	}
+
+	ModelViewProjectionConstantBuffer MakeConstants(uint32_t width, uint32_t height)
+	{
+		ModelViewProjectionConstantBuffer constants;
+		XMStoreFloat4x4(&constants.model, XMMatrixIdentity());
+		XMStoreFloat4x4(&constants.view, XMMatrixTranspose(XMMatrixLookAtRH(XMVectorSet(0.0f, 0.3f, 2.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f))));
+		XMStoreFloat4x4(&constants.projection, XMMatrixTranspose(XMMatrixPerspectiveFovRH(70.0f * XM_PI / 180.0f, static_cast<float>(width) / static_cast<float>(height), 0.5f, 100.0f)));
+		return constants;
+	}
+
+	// 回転と平行移動の違う 3 つのインスタンス。
+	void MakeInstances(float angle, std::vector<InstanceData>& instances)
+	{
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			InstanceData instance;
+			XMStoreFloat4x4(&instance.model, XMMatrixMultiply(XMMatrixRotationY(angle + i * 0.8f), XMMatrixTranslation(i * 0.25f - 0.25f, i * 0.125f, i * -0.5f)));
+			instance.color = XMFLOAT4(1.0f, 1.0f - i * 0.25f, 1.0f, 1.0f);
+			instances.push_back(instance);
+		}
+	}
+
+	void RenderWithDevice(SoftwareRenderDevice& device, const MeshData& mesh, const std::vector<InstanceData>& instances, CullMode cullMode)
+	{
+		const uint32_t meshId = device.CreateMesh(mesh);
+		RenderCommandList commandList;
+		commandList.SetPipelineState(cullMode == CullMode::None ? PipelineCullNone : cullMode == CullMode::Front ? PipelineCullFront : PipelineCullBack);
+		commandList.SetMesh(meshId);
+		uint32_t startInstance = 0;
+		for (size_t i = 0; i < instances.size(); ++i)
+		{
+			const uint32_t index = commandList.AppendInstance(instances[i]);
+			if (i == 0)
+			{
+				startInstance = index;
+			}
+		}
+		commandList.DrawInstanced(meshId, startInstance, static_cast<uint32_t>(instances.size()));
+
+		device.Clear(MidnightBlue);
+		device.SetConstants(MakeConstants(device.GetWidth(), device.GetHeight()));
+		device.Execute(commandList);
+	}
+
+	// インスタンスごとの行列をまとめた model と単位行列の view, projection で、SoftwareRenderDevice と同じ変換をさせます。
+	void RenderWithReference(ReferenceRasterizer& reference, const MeshData& mesh, const std::vector<InstanceData>& instances, CullMode cullMode)
+	{
+		reference.Clear(MidnightBlue, 1.0f);
+		const ModelViewProjectionConstantBuffer sceneConstants = MakeConstants(reference.GetWidth(), reference.GetHeight());
+		for (const InstanceData& instance : instances)
+		{
+			std::vector<VertexPositionColor> vertices = mesh.vertices;
+			for (VertexPositionColor& vertex : vertices)
+			{
+				vertex.color.x *= instance.color.x;
+				vertex.color.y *= instance.color.y;
+				vertex.color.z *= instance.color.z;
+			}
+
+			const XMFLOAT4X4 transform = VertexTransform::ComposeInstanceViewProjection(instance.model, sceneConstants);
+			ModelViewProjectionConstantBuffer constants;
+			XMStoreFloat4x4(&constants.model, XMMatrixTranspose(XMLoadFloat4x4(&transform)));
+			XMStoreFloat4x4(&constants.view, XMMatrixIdentity());
+			XMStoreFloat4x4(&constants.projection, XMMatrixIdentity());
+			reference.DrawIndexed(&vertices[0], &mesh.indices[0], static_cast<uint32_t>(mesh.indices.size()), constants, cullMode);
+		}
+	}
+
+	// 色が違うか、深度が 4 LSB より大きく違うピクセルの数。
+	uint32_t CountMismatches(const SoftwareRenderDevice& device, const ReferenceRasterizer& reference)
+	{
+		uint32_t count = 0;
+		for (size_t i = 0; i < device.GetColorBuffer().size(); ++i)
+		{
+			const int64_t depthDifference = static_cast<int64_t>(device.GetDepthBuffer()[i]) - static_cast<int64_t>(reference.GetDepthBuffer()[i]);
+			if (device.GetColorBuffer()[i] != reference.GetColorBuffer()[i] || depthDifference > 4 || depthDifference < -4)
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+
+	// タイルの大きさで割り切れない描画先に、画面の外や近クリップ面にかかる三角形も含めて描画し、リファレンスと比べます。
+	// VertexTransform の SIMD カーネルはリファレンスと積和の順が違うので、頂点の位置が最下位ビットだけずれます。
+	// そのため深度は数 LSB の違いを許し、斜めから見た三角形の縁などで結果の変わるわずかなピクセルも許します。
+	void TestMatchesReference()
+	{
+		const uint32_t width = 200;
+		const uint32_t height = 150;
+		const MeshData mesh = CreateTriangleGrid();
+
+		const CullMode cullModes[] = { CullMode::None, CullMode::Back, CullMode::Front };
+		for (uint32_t step = 0; step < 8; ++step)
+		{
+			std::vector<InstanceData> instances;
+			MakeInstances(step * 0.4f, instances);
+			for (CullMode cullMode : cullModes)
+			{
+				ReferenceRasterizer reference(width, height);
+				RenderWithReference(reference, mesh, instances, cullMode);
+
+				SoftwareRenderDevice device(width, height, 2);
+				RenderWithDevice(device, mesh, instances, cullMode);
+				CHECK(CountMismatches(device, reference) <= width * height / 200);
+			}
+		}
+	}
+
+	// タイル内では三角形を投入順に処理するので、結果はスレッド数によりません。
+	void TestThreadCountIndependence()
+	{
+		const MeshData mesh = CreateRandomTriangles(3000, 54321);
+		std::vector<InstanceData> instances;
+		MakeInstances(0.0f, instances);
+
+		SoftwareRenderDevice singleThreaded(333, 197, 1);
+		RenderWithDevice(singleThreaded, mesh, instances, CullMode::None);
+
+		const uint32_t threadCounts[] = { 2, 3, 8 };
+		for (uint32_t threadCount : threadCounts)
+		{
+			SoftwareRenderDevice device(333, 197, threadCount);
+			RenderWithDevice(device, mesh, instances, CullMode::None);
+			CHECK(device.GetColorBuffer() == singleThreaded.GetColorBuffer());
+			CHECK(device.GetDepthBuffer() == singleThreaded.GetDepthBuffer());
+		}
+	}
+
+	// SetPipelineState より前の描画は、D3D11RenderDevice と同じく PipelineDefault (裏面のカリング) で描画します。
+	// 範囲に分けて記録するスレッドの数によらず同じです。
+	void TestDefaultPipeline()
+	{
+		const MeshData mesh = CreateTriangleGrid();
+		std::vector<InstanceData> instances;
+		MakeInstances(0.0f, instances);
+
+		SoftwareRenderDevice explicitBack(200, 150, 1);
+		RenderWithDevice(explicitBack, mesh, instances, CullMode::Back);
+		SoftwareRenderDevice cullNone(200, 150, 1);
+		RenderWithDevice(cullNone, mesh, instances, CullMode::None);
+		CHECK(explicitBack.GetColorBuffer() != cullNone.GetColorBuffer());
+
+		const uint32_t threadCounts[] = { 1, 3 };
+		for (uint32_t threadCount : threadCounts)
+		{
+			SoftwareRenderDevice device(200, 150, threadCount);
+			const uint32_t meshId = device.CreateMesh(mesh);
+			RenderCommandList commandList;
+			for (const InstanceData& instance : instances)
+			{
+				commandList.DrawInstanced(meshId, commandList.AppendInstance(instance), 1);
+			}
+			device.Clear(MidnightBlue);
+			device.SetConstants(MakeConstants(device.GetWidth(), device.GetHeight()));
+			device.Execute(commandList);
+			CHECK(device.GetColorBuffer() == explicitBack.GetColorBuffer());
+			CHECK(device.GetDepthBuffer() == explicitBack.GetDepthBuffer());
+		}
+	}
+
+	// シザー矩形を設定したクリアと描画は、矩形の外側のピクセルを変えません。
+	void TestScissorRect()
+	{
+		const MeshData mesh = CreateRandomTriangles(500, 777);
+		std::vector<InstanceData> instances;
+		MakeInstances(0.0f, instances);
+
+		SoftwareRenderDevice full(160, 120, 2);
+		RenderWithDevice(full, mesh, instances, CullMode::None);
+
+		SoftwareRenderDevice partial(160, 120, 2);
+		const float black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		partial.Clear(black);
+		const ScreenRect rect = { 40, 30, 110, 100 };
+		partial.SetScissorRect(&rect);
+		RenderWithDevice(partial, mesh, instances, CullMode::None);
+		partial.SetScissorRect(nullptr);
+
+		const uint32_t packedBlack = ReferenceRasterizer::PackColor(black[0], black[1], black[2], black[3]);
+		uint32_t wrongInside = 0;
+		uint32_t wrongOutside = 0;
+		for (uint32_t y = 0; y < 120; ++y)
+		{
+			for (uint32_t x = 0; x < 160; ++x)
+			{
+				const size_t i = y * 160 + x;
+				const bool inside = x >= 40 && x < 110 && y >= 30 && y < 100;
+				if (inside && partial.GetColorBuffer()[i] != full.GetColorBuffer()[i])
+				{
+					++wrongInside;
+				}
+				if (!inside && partial.GetColorBuffer()[i] != packedBlack)
+				{
+					++wrongOutside;
+				}
+			}
+		}
+		CHECK(wrongInside == 0);
+		CHECK(wrongOutside == 0);
+	}
+}
+
+int main()
+{
+	TestMatchesReference();
+	TestThreadCountIndependence();
+	TestDefaultPipeline();
+	TestScissorRect();
+	return TestCheck::Finish();
+}
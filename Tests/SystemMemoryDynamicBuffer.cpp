@@ -0,0 +1,107 @@
+﻿#include "SystemMemoryDynamicBuffer.h"
+#include <algorithm>
+#include <cassert>
+
+SystemMemoryDynamicBuffer::SystemMemoryDynamicBuffer(uint32_t capacity, uint32_t gpuLatency) :
+	m_memory(capacity),
+	m_gpuLatency(gpuLatency),
+	m_lastFence(0),
+	m_completedFence(0),
+	m_overwriteViolations(0),
+	m_discards(0),
+	m_mapped(false)
+{
+}
+
+uint32_t SystemMemoryDynamicBuffer::GetCapacity() const
+{
+	return static_cast<uint32_t>(m_memory.size());
+}
+
+uint8_t* SystemMemoryDynamicBuffer::Map(BufferMapMode mode, uint32_t offset, uint32_t size)
+{
+	assert(!m_mapped);
+	assert(offset + size <= m_memory.size());
+	m_mapped = true;
+
+	if (mode == BufferMapMode::Discard)
+	{
+		// 実際のドライバーは別のメモリを割り当てるので、使用中の範囲はなくなります。
+		// フェンスを発行していない範囲は、まだ描画が参照していないまま内容が失われます。
+		for (const WrittenRange& range : m_ranges)
+		{
+			if (range.fence == 0)
+			{
+				m_overwriteViolations++;
+				break;
+			}
+		}
+		m_ranges.clear();
+		m_discards++;
+	}
+	else
+	{
+		// 完了していないフェンスに属する範囲と、フェンスを発行していない範囲には書き込めません。
+		RetireCompletedRanges();
+		for (const WrittenRange& range : m_ranges)
+		{
+			if (offset < range.end && range.begin < offset + size)
+			{
+				m_overwriteViolations++;
+				break;
+			}
+		}
+	}
+
+	WrittenRange written;
+	written.fence = 0;
+	written.begin = offset;
+	written.end = offset + size;
+	m_ranges.push_back(written);
+	return &m_memory[0];
+}
+
+void SystemMemoryDynamicBuffer::Unmap()
+{
+	assert(m_mapped);
+	m_mapped = false;
+}
+
+uint64_t SystemMemoryDynamicBuffer::InsertFence()
+{
+	m_lastFence++;
+	for (WrittenRange& range : m_ranges)
+	{
+		if (range.fence == 0)
+		{
+			range.fence = m_lastFence;
+		}
+	}
+
+	if (m_lastFence > m_gpuLatency)
+	{
+		CompleteFence(m_lastFence - m_gpuLatency);
+	}
+	return m_lastFence;
+}
+
+uint64_t SystemMemoryDynamicBuffer::GetCompletedFence()
+{
+	return m_completedFence;
+}
+
+void SystemMemoryDynamicBuffer::CompleteFence(uint64_t value)
+{
+	m_completedFence = std::max(m_completedFence, std::min(value, m_lastFence));
+}
+
+void SystemMemoryDynamicBuffer::RetireCompletedRanges()
+{
+	const uint64_t completed = m_completedFence;
+	m_ranges.erase(
+		std::remove_if(m_ranges.begin(), m_ranges.end(), [completed](const WrittenRange& range)
+		{
+			return range.fence != 0 && range.fence <= completed;
+		}),
+		m_ranges.end());
+}
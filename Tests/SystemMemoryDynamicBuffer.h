@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "DynamicBufferDevice.h"
+
+// システム メモリ上の DynamicBufferDevice。GPU を使わずにリング バッファーの動作を確認するためのものです。
+// 発行したフェンスは gpuLatency 個あとのフェンスが発行された時点で完了したものとみなします。
+// NO_OVERWRITE のマップで完了していないフェンスかまだフェンスのない範囲へ書き込もうとした回数と、
+// フェンスのない範囲を残したまま DISCARD した回数を、違反として数えます。
+class SystemMemoryDynamicBuffer : public DynamicBufferDevice
+{
+public:
+	SystemMemoryDynamicBuffer(uint32_t capacity, uint32_t gpuLatency);
+
+	virtual uint32_t GetCapacity() const override;
+	virtual uint8_t* Map(BufferMapMode mode, uint32_t offset, uint32_t size) override;
+	virtual void Unmap() override;
+	virtual uint64_t InsertFence() override;
+	virtual uint64_t GetCompletedFence() override;
+
+	// GPU の処理を value のフェンスまで進めます。
+	void CompleteFence(uint64_t value);
+
+	uint32_t GetOverwriteViolationCount() const { return m_overwriteViolations; }
+	uint32_t GetDiscardCount() const { return m_discards; }
+	const std::vector<uint8_t>& GetContents() const { return m_memory; }
+
+private:
+	struct WrittenRange
+	{
+		uint64_t fence;		// 0 はまだフェンスが発行されていないことを示します
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	void RetireCompletedRanges();
+
+	std::vector<uint8_t> m_memory;
+	std::vector<WrittenRange> m_ranges;
+	uint32_t m_gpuLatency;
+	uint64_t m_lastFence;
+	uint64_t m_completedFence;
+	uint32_t m_overwriteViolations;
+	uint32_t m_discards;
+	bool m_mapped;
+};
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <cstdio>
+
+// テスト用の小さなチェック関数。失敗しても最後まで続け、失敗の数を終了コードにします。
+//
+// 使い方:
+//   CHECK(queue.GetItemCount() == 0);
+//   return TestCheck::Finish();
+#define CHECK(condition) TestCheck::Check((condition), #condition, __FILE__, __LINE__)
+
+namespace TestCheck
+{
+	inline int& GetFailureCount()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline bool Check(bool condition, const char* expression, const char* file, int line)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "%s(%d): CHECK(%s) failed\n", file, line, expression);
+			++GetFailureCount();
+		}
+		return condition;
+	}
+
+	// 結果を表示し、main の戻り値を返します。
+	inline int Finish()
+	{
+		const int failures = GetFailureCount();
+		if (failures == 0)
+		{
+			std::printf("All checks passed.\n");
+			return 0;
+		}
+		std::printf("%d check(s) failed.\n", failures);
+		return 1;
+	}
+}
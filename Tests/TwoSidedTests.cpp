@@ -0,0 +1,171 @@
+﻿#include <cstdint>
+#include <vector>
+#include "DrawQueue.h"
+#include "PolygonScene.h"
+#include "ReferenceRasterizer.h"
+#include "SoftwareRenderDevice.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const float MidnightBlue[] = { 0.098f, 0.098f, 0.439f, 1.000f };
+
+	// 2 つのターゲットで色または深度が異なるピクセルの数を返します。
+	uint32_t CountDifferingPixels(
+		const std::vector<uint32_t>& colorA,
+		const std::vector<uint32_t>& depthA,
+		const std::vector<uint32_t>& colorB,
+		const std::vector<uint32_t>& depthB
+		)
+	{
+		if (colorA.size() != colorB.size() || depthA.size() != depthB.size())
+		{
+			return UINT32_MAX;
+		}
+
+		uint32_t count = 0;
+		for (size_t i = 0; i < colorA.size(); ++i)
+		{
+			if (colorA[i] != colorB[i] || depthA[i] != depthB[i])
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+
+	uint32_t CountCoveredPixels(const std::vector<uint32_t>& color, uint32_t clearColor)
+	{
+		uint32_t count = 0;
+		for (size_t i = 0; i < color.size(); ++i)
+		{
+			if (color[i] != clearColor)
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+
+	// 向きの違う薄い三角形を重ねたメッシュ。どの角度から見ても表と裏の両方が含まれます。
+	void CreateThinPolygons(std::vector<VertexPositionColor>& vertices, std::vector<uint32_t>& indices)
+	{
+		for (uint32_t i = 0; i < 6; ++i)
+		{
+			const float z = i * 0.1f - 0.25f;
+			const float offset = i * 0.07f - 0.2f;
+			const VertexPositionColor triangle[] =
+			{
+				{ XMFLOAT3(-0.5f + offset, -0.5f, z), XMFLOAT3(1.0f, i / 5.0f, 0.0f) },
+				{ XMFLOAT3(0.5f + offset, -0.4f, z), XMFLOAT3(0.0f, 1.0f, i / 5.0f) },
+				{ XMFLOAT3(offset, 0.6f, z), XMFLOAT3(i / 5.0f, 0.0f, 1.0f) }
+			};
+			const uint32_t base = static_cast<uint32_t>(vertices.size());
+			vertices.insert(vertices.end(), triangle, triangle + 3);
+
+			// 奇数番目の三角形は頂点の順を逆にして、反対の面を向けます。
+			indices.push_back(base);
+			indices.push_back(i % 2 == 0 ? base + 1 : base + 2);
+			indices.push_back(i % 2 == 0 ? base + 2 : base + 1);
+		}
+	}
+
+	ModelViewProjectionConstantBuffer MakeConstants(float angle)
+	{
+		ModelViewProjectionConstantBuffer constants;
+		XMStoreFloat4x4(&constants.model, XMMatrixTranspose(XMMatrixRotationY(angle)));
+		XMStoreFloat4x4(&constants.view, XMMatrixTranspose(XMMatrixLookAtRH(XMVectorSet(0.0f, 0.7f, 1.5f, 0.0f), XMVectorSet(0.0f, -0.1f, 0.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f))));
+		XMStoreFloat4x4(&constants.projection, XMMatrixTranspose(XMMatrixPerspectiveFovRH(70.0f * XM_PI / 180.0f, 4.0f / 3.0f, 0.01f, 100.0f)));
+		return constants;
+	}
+
+	// リファレンスの実装で、1 パスと 2 パスの結果が色も深度もピクセル単位で一致することを確かめます。
+	void TestReferenceSinglePassMatchesTwoPass()
+	{
+		std::vector<VertexPositionColor> vertices;
+		std::vector<uint32_t> indices;
+		CreateThinPolygons(vertices, indices);
+
+		const uint32_t clearColor = ReferenceRasterizer::PackColor(MidnightBlue[0], MidnightBlue[1], MidnightBlue[2], MidnightBlue[3]);
+		for (uint32_t step = 0; step < 16; ++step)
+		{
+			const ModelViewProjectionConstantBuffer constants = MakeConstants(step * XM_2PI / 16.0f);
+
+			ReferenceRasterizer twoPass(160, 120);
+			twoPass.Clear(MidnightBlue, 1.0f);
+			twoPass.DrawTwoSided(&vertices[0], &indices[0], static_cast<uint32_t>(indices.size()), constants, TwoSidedMode::TwoPass);
+
+			ReferenceRasterizer singlePass(160, 120);
+			singlePass.Clear(MidnightBlue, 1.0f);
+			singlePass.DrawTwoSided(&vertices[0], &indices[0], static_cast<uint32_t>(indices.size()), constants, TwoSidedMode::SinglePass);
+
+			CHECK(CountCoveredPixels(twoPass.GetColorBuffer(), clearColor) > 0);
+			CHECK(CountDifferingPixels(twoPass.GetColorBuffer(), twoPass.GetDepthBuffer(), singlePass.GetColorBuffer(), singlePass.GetDepthBuffer()) == 0);
+		}
+	}
+
+	// 1 方向のカリングだけでは、裏を向いた三角形が消えることを確かめます。比較が意味を持つための前提です。
+	void TestBackCullingDropsFaces()
+	{
+		std::vector<VertexPositionColor> vertices;
+		std::vector<uint32_t> indices;
+		CreateThinPolygons(vertices, indices);
+		const ModelViewProjectionConstantBuffer constants = MakeConstants(0.3f);
+
+		ReferenceRasterizer culled(160, 120);
+		culled.Clear(MidnightBlue, 1.0f);
+		culled.DrawIndexed(&vertices[0], &indices[0], static_cast<uint32_t>(indices.size()), constants, CullMode::Back);
+
+		ReferenceRasterizer singlePass(160, 120);
+		singlePass.Clear(MidnightBlue, 1.0f);
+		singlePass.DrawTwoSided(&vertices[0], &indices[0], static_cast<uint32_t>(indices.size()), constants, TwoSidedMode::SinglePass);
+
+		CHECK(CountDifferingPixels(culled.GetColorBuffer(), culled.GetDepthBuffer(), singlePass.GetColorBuffer(), singlePass.GetDepthBuffer()) > 0);
+	}
+
+	void RenderScene(SoftwareRenderDevice& device, float time, TwoSidedMode mode)
+	{
+		PolygonScene scene;
+		scene.CreateDeviceResources(device);
+		XMFLOAT4X4 orientationTransform;
+		XMStoreFloat4x4(&orientationTransform, XMMatrixIdentity());
+		scene.SetProjection(static_cast<float>(device.GetWidth()) / static_cast<float>(device.GetHeight()), orientationTransform);
+
+		SceneSnapshot snapshot;
+		DrawQueue drawQueue;
+		RenderCommandList commandList;
+		scene.Update(time, 0.0f);
+		scene.CaptureSnapshot(snapshot);
+		scene.Record(snapshot, drawQueue, mode);
+		drawQueue.Flush(commandList);
+
+		device.Clear(MidnightBlue);
+		device.SetConstants(scene.GetConstants(snapshot));
+		device.Execute(commandList);
+	}
+
+	// CubeRenderer と同じシーンを SoftwareRenderDevice で描画し、両面表示の方法によらず同じ画像になることを確かめます。
+	void TestSceneSinglePassMatchesTwoPass()
+	{
+		for (uint32_t step = 0; step < 8; ++step)
+		{
+			const float time = step * 1.0f;
+			SoftwareRenderDevice twoPass(160, 120, 2);
+			RenderScene(twoPass, time, TwoSidedMode::TwoPass);
+			SoftwareRenderDevice singlePass(160, 120, 2);
+			RenderScene(singlePass, time, TwoSidedMode::SinglePass);
+
+			CHECK(CountDifferingPixels(twoPass.GetColorBuffer(), twoPass.GetDepthBuffer(), singlePass.GetColorBuffer(), singlePass.GetDepthBuffer()) == 0);
+		}
+	}
+}
+
+int main()
+{
+	TestReferenceSinglePassMatchesTwoPass();
+	TestBackCullingDropsFaces();
+	TestSceneSinglePassMatchesTwoPass();
+	return TestCheck::Finish();
+}
@@ -0,0 +1,146 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "VertexFormat.h"
+#include "TestCheck.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// 境界ボックスの 8 つの角と、内側の乱数の点。原点から離れた細長いボックスにします。
+	std::vector<VertexPositionColor> CreateVertices(const XMFLOAT3& minimum, const XMFLOAT3& maximum, uint32_t randomCount)
+	{
+		std::vector<VertexPositionColor> vertices;
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			VertexPositionColor vertex;
+			vertex.pos = XMFLOAT3(corner & 1 ? maximum.x : minimum.x, corner & 2 ? maximum.y : minimum.y, corner & 4 ? maximum.z : minimum.z);
+			vertex.color = XMFLOAT3(corner & 1 ? 1.0f : 0.0f, corner & 2 ? 1.0f : 0.0f, corner & 4 ? 1.0f : 0.0f);
+			vertices.push_back(vertex);
+		}
+
+		std::mt19937 random(6);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (uint32_t i = 0; i < randomCount; ++i)
+		{
+			VertexPositionColor vertex;
+			vertex.pos = XMFLOAT3(
+				minimum.x + (maximum.x - minimum.x) * unit(random),
+				minimum.y + (maximum.y - minimum.y) * unit(random),
+				minimum.z + (maximum.z - minimum.z) * unit(random));
+			vertex.color = XMFLOAT3(unit(random), unit(random), unit(random));
+			vertices.push_back(vertex);
+		}
+		return vertices;
+	}
+
+	// デコードした頂点の誤差が、軸ごとに量子化の半ステップ (GetErrorBound) 以下で、Encode が返す誤差と一致します。
+	// 原点から遠く幅の狭い軸では float の丸め誤差のほうが大きくなるので、withinStep が false なら 1 ステップとは比べません。
+	void CheckRoundTrip(const std::vector<VertexPositionColor>& vertices, bool withinStep)
+	{
+		const uint32_t count = static_cast<uint32_t>(vertices.size());
+		const PositionQuantizationConstantBuffer quantization = CompactVertexEncoder::ComputeQuantization(&vertices[0], count);
+		const CompactVertexError bound = CompactVertexEncoder::GetErrorBound(quantization);
+
+		// 上限は 1 ステップ (scale / 32767) より小さくなります。
+		if (withinStep)
+		{
+			CHECK(bound.position.x < quantization.scale.x / 32767.0f);
+			CHECK(bound.position.y < quantization.scale.y / 32767.0f);
+			CHECK(bound.position.z < quantization.scale.z / 32767.0f);
+		}
+		CHECK(bound.color < 1.0f / 255.0f);
+
+		std::vector<VertexPositionColorCompact> encoded(count);
+		CompactVertexError reported;
+		CompactVertexEncoder::Encode(&vertices[0], count, quantization, &encoded[0], &reported);
+
+		CompactVertexError measured = { XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f };
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const VertexPositionColor decoded = CompactVertexEncoder::Decode(encoded[i], quantization);
+			measured.position.x = std::max(measured.position.x, std::fabs(decoded.pos.x - vertices[i].pos.x));
+			measured.position.y = std::max(measured.position.y, std::fabs(decoded.pos.y - vertices[i].pos.y));
+			measured.position.z = std::max(measured.position.z, std::fabs(decoded.pos.z - vertices[i].pos.z));
+			measured.color = std::max(measured.color, std::fabs(decoded.color.x - vertices[i].color.x));
+			measured.color = std::max(measured.color, std::fabs(decoded.color.y - vertices[i].color.y));
+			measured.color = std::max(measured.color, std::fabs(decoded.color.z - vertices[i].color.z));
+		}
+
+		CHECK(measured.position.x <= bound.position.x);
+		CHECK(measured.position.y <= bound.position.y);
+		CHECK(measured.position.z <= bound.position.z);
+		CHECK(measured.color <= bound.color);
+		CHECK(reported.position.x == measured.position.x);
+		CHECK(reported.position.y == measured.position.y);
+		CHECK(reported.position.z == measured.position.z);
+		CHECK(reported.color == measured.color);
+	}
+
+	// 境界ボックスの端の頂点は -1 と 1 に、色の 0 と 1 は 0 と 255 になります。
+	void TestCornersUseFullRange()
+	{
+		const std::vector<VertexPositionColor> vertices = CreateVertices(XMFLOAT3(-3.0f, 10.0f, 100.0f), XMFLOAT3(5.0f, 10.5f, 140.0f), 0);
+		const PositionQuantizationConstantBuffer quantization = CompactVertexEncoder::ComputeQuantization(&vertices[0], 8);
+		std::vector<VertexPositionColorCompact> encoded(8);
+		CompactVertexEncoder::Encode(&vertices[0], 8, quantization, &encoded[0], nullptr);
+
+		bool fullRange = true;
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const bool isMaximum = (corner & (1 << axis)) != 0;
+				fullRange = fullRange && encoded[corner].pos[axis] == (isMaximum ? 32767 : -32767);
+				fullRange = fullRange && encoded[corner].color[axis] == (isMaximum ? 255 : 0);
+			}
+			fullRange = fullRange && encoded[corner].pos[3] == 32767 && encoded[corner].color[3] == 255;
+		}
+		CHECK(fullRange);
+	}
+
+	void TestRoundTripWithinStep()
+	{
+		CheckRoundTrip(CreateVertices(XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), 10000), true);
+		CheckRoundTrip(CreateVertices(XMFLOAT3(-3.0f, 10.0f, 100.0f), XMFLOAT3(5.0f, 10.5f, 140.0f), 10000), true);
+		CheckRoundTrip(CreateVertices(XMFLOAT3(1000.0f, -2000.0f, 0.25f), XMFLOAT3(1000.001f, -1990.0f, 0.5f), 10000), false);
+	}
+
+	// 幅のない軸も、元の座標に戻ります。
+	void TestFlatAxis()
+	{
+		const std::vector<VertexPositionColor> vertices = CreateVertices(XMFLOAT3(-1.0f, 2.0f, -1.0f), XMFLOAT3(1.0f, 2.0f, 1.0f), 100);
+		CheckRoundTrip(vertices, true);
+
+		const PositionQuantizationConstantBuffer quantization = CompactVertexEncoder::ComputeQuantization(&vertices[0], static_cast<uint32_t>(vertices.size()));
+		VertexPositionColorCompact encoded;
+		CompactVertexEncoder::Encode(&vertices[0], 1, quantization, &encoded, nullptr);
+		CHECK(CompactVertexEncoder::Decode(encoded, quantization).pos.y == 2.0f);
+	}
+
+	// [0, 1] の範囲外の色はクランプします。
+	void TestColorIsClamped()
+	{
+		VertexPositionColor vertex;
+		vertex.pos = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		vertex.color = XMFLOAT3(-0.5f, 2.0f, 0.5f);
+		const PositionQuantizationConstantBuffer quantization = CompactVertexEncoder::ComputeQuantization(&vertex, 1);
+		VertexPositionColorCompact encoded;
+		CompactVertexEncoder::Encode(&vertex, 1, quantization, &encoded, nullptr);
+		CHECK(encoded.color[0] == 0);
+		CHECK(encoded.color[1] == 255);
+		CHECK(encoded.color[2] == 128);
+	}
+}
+
+int main()
+{
+	TestCornersUseFullRange();
+	TestRoundTripWithinStep();
+	TestFlatAxis();
+	TestColorIsClamped();
+	return TestCheck::Finish();
+}
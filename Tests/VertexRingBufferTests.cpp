@@ -0,0 +1,208 @@
+﻿#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "ReferenceRasterizer.h"
+#include "SoftwareRenderDevice.h"
+#include "SystemMemoryDynamicBuffer.h"
+#include "TestCheck.h"
+#include "VertexRingBuffer.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// size バイトの、書き込みごとに違う内容のデータを作ります。
+	std::vector<uint8_t> MakeData(uint32_t size, uint32_t seed)
+	{
+		std::vector<uint8_t> data(size);
+		for (uint32_t i = 0; i < size; ++i)
+		{
+			data[i] = static_cast<uint8_t>(seed * 31 + i);
+		}
+		return data;
+	}
+
+	bool ContentsMatch(const SystemMemoryDynamicBuffer& buffer, uint32_t offset, const std::vector<uint8_t>& data)
+	{
+		return memcmp(&buffer.GetContents()[offset], &data[0], data.size()) == 0;
+	}
+
+	// 1 フレームに大きさの違う書き込みを何回か行い、フレームの終わりに Submit します。
+	// GPU が 2 フレーム遅れて追いかけても、使用中の領域には書き込まず、DISCARD もしません。
+	void TestStreaming()
+	{
+		SystemMemoryDynamicBuffer buffer(64 * 1024, 2);
+		VertexRingBuffer ring(buffer);
+
+		bool contentsMatch = true;
+		bool aligned = true;
+		for (uint32_t frame = 0; frame < 500; ++frame)
+		{
+			for (uint32_t write = 0; write < 1 + frame % 4; ++write)
+			{
+				const std::vector<uint8_t> data = MakeData(24 * (50 + (frame * 7 + write * 13) % 150), frame * 4 + write);
+				uint32_t offset = 0;
+				CHECK(ring.Write(&data[0], static_cast<uint32_t>(data.size()), 24, &offset));
+				contentsMatch = contentsMatch && ContentsMatch(buffer, offset, data);
+				aligned = aligned && offset % 24 == 0;
+			}
+			ring.Submit();
+		}
+
+		CHECK(contentsMatch);
+		CHECK(aligned);
+		CHECK(buffer.GetOverwriteViolationCount() == 0);
+		CHECK(buffer.GetDiscardCount() == 0);
+		CHECK(ring.GetStats().wraps > 0);
+		CHECK(ring.GetStats().discards == 0);
+		CHECK(ring.GetStats().failedWrites == 0);
+	}
+
+	// 1 回の Submit までの書き込みが末尾から先頭に回り込んでも、先に書き込んだ領域のフェンスは描画を発行するまで発行しません。
+	// 回り込んだ後の書き込みは、未発行の領域とも重なりません。
+	void TestWrapBeforeSubmit()
+	{
+		SystemMemoryDynamicBuffer buffer(1000, 1);
+		VertexRingBuffer ring(buffer);
+
+		const std::vector<uint8_t> first = MakeData(600, 1);
+		uint32_t offset = 0;
+		CHECK(ring.Write(&first[0], 600, 4, &offset));
+		ring.Submit();
+		buffer.CompleteFence(1);
+
+		// 1 つ目は完了した領域に続けて書き込み、2 つ目は末尾に入らないので先頭に戻ります。
+		const std::vector<uint8_t> second = MakeData(300, 2);
+		const std::vector<uint8_t> third = MakeData(300, 3);
+		uint32_t secondOffset = 0;
+		uint32_t thirdOffset = 0;
+		CHECK(ring.Write(&second[0], 300, 4, &secondOffset));
+		CHECK(ring.Write(&third[0], 300, 4, &thirdOffset));
+		CHECK(secondOffset == 600);
+		CHECK(thirdOffset == 0);
+		CHECK(ring.GetStats().wraps == 1);
+		CHECK(ring.GetBytesInFlight() == 600);
+
+		// まだ描画を発行していないので、どちらの内容も残っていなければなりません。
+		CHECK(ContentsMatch(buffer, secondOffset, second));
+		CHECK(ContentsMatch(buffer, thirdOffset, third));
+
+		// 空きのない書き込みは、未発行の領域を DISCARD で失わないように失敗します。
+		const std::vector<uint8_t> fourth = MakeData(500, 4);
+		uint32_t fourthOffset = 0;
+		CHECK(!ring.Write(&fourth[0], 500, 4, &fourthOffset));
+		CHECK(ring.GetStats().failedWrites == 1);
+		CHECK(ContentsMatch(buffer, secondOffset, second));
+		CHECK(ContentsMatch(buffer, thirdOffset, third));
+
+		// Submit した後なら、DISCARD して書き込めます。
+		ring.Submit();
+		CHECK(ring.Write(&fourth[0], 500, 4, &fourthOffset));
+		CHECK(fourthOffset == 0);
+		CHECK(ring.GetStats().discards == 1);
+		CHECK(buffer.GetOverwriteViolationCount() == 0);
+	}
+
+	// GPU が止まったままなら、リングが一杯になるたびに DISCARD します。
+	void TestDiscardWhenFull()
+	{
+		SystemMemoryDynamicBuffer buffer(4096, 1000);
+		VertexRingBuffer ring(buffer);
+
+		const std::vector<uint8_t> data = MakeData(1000, 5);
+		for (uint32_t frame = 0; frame < 20; ++frame)
+		{
+			uint32_t offset = 0;
+			CHECK(ring.Write(&data[0], 1000, 1, &offset));
+			ring.Submit();
+		}
+
+		CHECK(ring.GetStats().discards == 4);
+		CHECK(buffer.GetDiscardCount() == 4);
+		CHECK(buffer.GetOverwriteViolationCount() == 0);
+	}
+
+	void TestRejectsOversizedWrites()
+	{
+		SystemMemoryDynamicBuffer buffer(256, 1);
+		VertexRingBuffer ring(buffer);
+		const std::vector<uint8_t> data = MakeData(257, 6);
+		uint32_t offset = 0;
+		CHECK(!ring.Write(&data[0], 257, 1, &offset));
+		CHECK(ring.GetStats().failedWrites == 1);
+		CHECK(ring.GetBytesInFlight() == 0);
+	}
+
+	// AppendDynamicVertices と DrawDynamic で描いた三角形は、同じ頂点のメッシュを単位行列のインスタンスで描いたものと一致します。
+	// 1 フレームに複数回追加した頂点も、Execute の最後まで有効です。
+	void TestDrawDynamicMatchesMesh()
+	{
+		MeshData mesh;
+		for (uint32_t t = 0; t < 4; ++t)
+		{
+			const float x = t * 0.4f - 0.8f;
+			const VertexPositionColor triangle[] =
+			{
+				{ XMFLOAT3(x, -0.5f, 0.5f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+				{ XMFLOAT3(x + 0.3f, -0.5f, 0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+				{ XMFLOAT3(x + 0.15f, 0.5f, 0.5f), XMFLOAT3(0.0f, 0.0f, t / 3.0f) }
+			};
+			mesh.vertices.insert(mesh.vertices.end(), triangle, triangle + 3);
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				mesh.indices.push_back(t * 3 + k);
+			}
+		}
+
+		ModelViewProjectionConstantBuffer constants;
+		XMStoreFloat4x4(&constants.model, XMMatrixIdentity());
+		XMStoreFloat4x4(&constants.view, XMMatrixIdentity());
+		XMStoreFloat4x4(&constants.projection, XMMatrixIdentity());
+		const float black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		SoftwareRenderDevice meshDevice(96, 64, 2);
+		const uint32_t meshId = meshDevice.CreateMesh(mesh);
+		RenderCommandList meshCommands;
+		InstanceData instance;
+		XMStoreFloat4x4(&instance.model, XMMatrixIdentity());
+		instance.color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		meshCommands.SetPipelineState(PipelineCullNone);
+		meshCommands.SetMesh(meshId);
+		meshCommands.DrawInstanced(meshId, meshCommands.AppendInstance(instance), 1);
+		meshDevice.Clear(black);
+		meshDevice.SetConstants(constants);
+		meshDevice.Execute(meshCommands);
+		const uint32_t packedBlack = ReferenceRasterizer::PackColor(black[0], black[1], black[2], black[3]);
+		CHECK(std::count(meshDevice.GetColorBuffer().begin(), meshDevice.GetColorBuffer().end(), packedBlack) < 96 * 64 * 9 / 10);
+
+		SoftwareRenderDevice dynamicDevice(96, 64, 2);
+		for (uint32_t frame = 0; frame < 2; ++frame)
+		{
+			RenderCommandList dynamicCommands;
+			dynamicCommands.SetPipelineState(PipelineCullNone);
+			const uint32_t first = dynamicDevice.AppendDynamicVertices(&mesh.vertices[0], 6);
+			const uint32_t second = dynamicDevice.AppendDynamicVertices(&mesh.vertices[6], 6);
+			dynamicCommands.DrawDynamic(first, 6);
+			dynamicCommands.DrawDynamic(second, 6);
+			dynamicDevice.Clear(black);
+			dynamicDevice.SetConstants(constants);
+			dynamicDevice.Execute(dynamicCommands);
+
+			CHECK(frame > 0 || first == 0);
+			CHECK(second == first + 6);
+			CHECK(dynamicDevice.GetColorBuffer() == meshDevice.GetColorBuffer());
+			CHECK(dynamicDevice.GetDepthBuffer() == meshDevice.GetDepthBuffer());
+		}
+	}
+}
+
+int main()
+{
+	TestStreaming();
+	TestWrapBeforeSubmit();
+	TestDiscardWhenFull();
+	TestRejectsOversizedWrites();
+	TestDrawDynamicMatchesMesh();
+	return TestCheck::Finish();
+}